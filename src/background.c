@@ -75,15 +75,21 @@ static void background_thread_update ()
 
 typedef struct {
   GtkTreeIter *iter;
-  gdouble percent;
+  gdouble percent; // Negative when unchanged
+  gchar *message;  // NULL when unchanged
 } progress_t;
 
 // In main thread
 static gboolean idle_progress_update ( gpointer user_data )
 {
   progress_t *progress = user_data;
-  if ( bgstore && progress->iter )
-    gtk_list_store_set ( GTK_LIST_STORE(bgstore), progress->iter, PROGRESS_COLUMN, progress->percent, -1 );
+  if ( bgstore && progress->iter ) {
+    if ( progress->percent >= 0.0 )
+      gtk_list_store_set ( GTK_LIST_STORE(bgstore), progress->iter, PROGRESS_COLUMN, progress->percent, -1 );
+    if ( progress->message )
+      gtk_list_store_set ( GTK_LIST_STORE(bgstore), progress->iter, TITLE_COLUMN, progress->message, -1 );
+  }
+  g_free ( progress->message );
   g_free ( progress );
   return FALSE;
 }
@@ -117,6 +123,25 @@ int a_background_thread_progress ( gpointer callbackdata, gdouble fraction )
   return res;
 }
 
+/**
+ * a_background_thread_message:
+ * @callbackdata: Thread data
+ * @message:      Replacement description of the task (e.g. to show how it is progressing)
+ *
+ * Called from other threads
+ */
+void a_background_thread_message ( gpointer callbackdata, const gchar *message )
+{
+  gpointer *args = (gpointer *) callbackdata;
+  if (args[5] != NULL) {
+    progress_t *progress = g_malloc0 ( sizeof(progress_t) );
+    progress->percent = -1.0;
+    progress->message = g_strdup ( message );
+    progress->iter = (GtkTreeIter*)args[5];
+    args[7] = GUINT_TO_POINTER(gdk_threads_add_idle ( idle_progress_update, progress ));
+  }
+}
+
 static void thread_die ( gpointer args[VIK_BG_NUM_ARGS] )
 {
   vik_thr_free_func userdata_free_func = args[3];
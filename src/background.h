@@ -43,6 +43,7 @@ typedef enum {
 
 void a_background_thread ( Background_Pool_Type bp, GtkWindow *parent, const gchar *message, vik_thr_func func, gpointer userdata, vik_thr_free_func userdata_free_func, vik_thr_free_func userdata_cancel_cleanup_func, gint number_items );
 int a_background_thread_progress ( gpointer callbackdata, gdouble fraction );
+void a_background_thread_message ( gpointer callbackdata, const gchar *message );
 int a_background_testcancel ( gpointer callbackdata );
 void a_background_show_window ();
 void a_background_init ();
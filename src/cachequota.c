@@ -0,0 +1,600 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+#include <glib/gstdio.h>
+#include "cachequota.h"
+#include "tileindex.h"
+#include "vik_compat.h"
+
+/*
+ * Without a limit the map tile cache just keeps growing.
+ *
+ * Each cache directory in use is scanned once (in the background) to find the size of each file,
+ *  and thereafter the usage is kept up to date as tiles are downloaded or deleted.
+ * When the usage goes over the quota, a background janitor removes the least recently used tiles.
+ *
+ * Access times are recorded in memory as tiles are read and saved to a sidecar file in the cache directory
+ *  (one '<time> <file>' line per tile), rather than relying on filesystem atime which is often disabled.
+ *
+ * MBTiles cache databases count towards the usage but are not reduced.
+ *
+ * Directories without a limit are not tracked at all.
+ */
+
+#define SIDECAR_FILE ".viking_tile_access"
+// Once over the quota, remove tiles until usage is this fraction of the quota
+#define LOW_WATER 0.9
+
+typedef struct {
+  guint32 atime;
+  guint32 size;
+} AccessEntry;
+
+typedef struct {
+  gchar *dir;          // Always ends with a separator
+  guint64 quota;       // Bytes, 0 for no limit
+  GHashTable *files;   // File name relative to dir -> AccessEntry
+  guint64 tracked;     // Total size of the files (including any ETag file of each tile)
+  guint64 untracked;   // Size of other files that are not removed (e.g. MBTiles databases)
+  GPtrArray *others;   // Names of those other files, relative to dir. Only used by the janitor
+  gboolean scanned;
+  gboolean queued;     // Janitor job pending
+  gboolean dirty;      // Access times changed since the sidecar was written
+} CacheDir;
+
+static GPtrArray *cache_dirs = NULL;
+static GMutex *cq_mutex = NULL;
+static GThreadPool *janitor_pool = NULL;
+static gboolean stopping = FALSE;
+
+static void cache_dir_free ( CacheDir *cd )
+{
+  g_hash_table_destroy ( cd->files );
+  if ( cd->others )
+    g_ptr_array_free ( cd->others, TRUE );
+  g_free ( cd->dir );
+  g_free ( cd );
+}
+
+static GHashTable *file_table_new ()
+{
+  return g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, g_free );
+}
+
+/**
+ * Must be called with the lock held
+ *
+ * Returns: The cache directory containing the file, and the file name relative to it
+ */
+static CacheDir *cache_dir_find ( const gchar *filename, const gchar **relative )
+{
+  CacheDir *found = NULL;
+  if ( !cache_dirs )
+    return NULL;
+  for ( guint ii = 0; ii < cache_dirs->len; ii++ ) {
+    CacheDir *cd = g_ptr_array_index ( cache_dirs, ii );
+    // Prefer the innermost directory
+    if ( g_str_has_prefix ( filename, cd->dir ) && (!found || strlen(cd->dir) > strlen(found->dir)) )
+      found = cd;
+  }
+  if ( found && relative )
+    *relative = filename + strlen ( found->dir );
+  return found;
+}
+
+static CacheDir *cache_dir_lookup ( const gchar *dir )
+{
+  if ( !cache_dirs )
+    return NULL;
+  for ( guint ii = 0; ii < cache_dirs->len; ii++ ) {
+    CacheDir *cd = g_ptr_array_index ( cache_dirs, ii );
+    if ( !g_strcmp0 ( cd->dir, dir ) )
+      return cd;
+  }
+  return NULL;
+}
+
+static gboolean over_quota ( CacheDir *cd )
+{
+  return cd->quota && (cd->tracked + cd->untracked) > cd->quota;
+}
+
+/**
+ * Must be called with the lock held
+ */
+static void janitor_queue ( CacheDir *cd )
+{
+  if ( cd->queued || !janitor_pool )
+    return;
+  cd->queued = TRUE;
+  g_thread_pool_push ( janitor_pool, g_strdup(cd->dir), NULL );
+}
+
+/**
+ * Whether the file is a tile that may be removed
+ */
+static gboolean is_removable ( const gchar *name )
+{
+  return !( g_str_has_suffix ( name, ".etag" ) ||
+            strstr ( name, ".mbtiles" ) ||
+            g_str_has_prefix ( name, "mbtiles.tmp" ) ||
+            !g_strcmp0 ( name, SIDECAR_FILE ) );
+}
+
+static GHashTable *sidecar_read ( const gchar *dir )
+{
+  GHashTable *atimes = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+  gchar *sidecar = g_strconcat ( dir, SIDECAR_FILE, NULL );
+  gchar *contents = NULL;
+  if ( g_file_get_contents ( sidecar, &contents, NULL, NULL ) ) {
+    gchar **lines = g_strsplit ( contents, "\n", -1 );
+    for ( guint ii = 0; lines[ii]; ii++ ) {
+      gchar *name = NULL;
+      guint64 atime = g_ascii_strtoull ( lines[ii], &name, 10 );
+      if ( name && *name == ' ' && name[1] )
+        g_hash_table_insert ( atimes, g_strdup(name+1), GUINT_TO_POINTER((guint32)atime) );
+    }
+    g_strfreev ( lines );
+    g_free ( contents );
+  }
+  g_free ( sidecar );
+  return atimes;
+}
+
+static void sidecar_write ( const gchar *dir, GString *contents )
+{
+  gchar *sidecar = g_strconcat ( dir, SIDECAR_FILE, NULL );
+  GError *error = NULL;
+  if ( !g_file_set_contents ( sidecar, contents->str, contents->len, &error ) ) {
+    g_warning ( "%s: %s", __FUNCTION__, error->message );
+    g_error_free ( error );
+  }
+  g_free ( sidecar );
+}
+
+/**
+ * Must be called with the lock held
+ */
+static GString *sidecar_contents ( CacheDir *cd )
+{
+  GString *contents = g_string_sized_new ( g_hash_table_size(cd->files) * 32 );
+  GHashTableIter iter;
+  gchar *name;
+  AccessEntry *ae;
+  g_hash_table_iter_init ( &iter, cd->files );
+  while ( g_hash_table_iter_next ( &iter, (gpointer*)&name, (gpointer*)&ae ) )
+    g_string_append_printf ( contents, "%u %s\n", ae->atime, name );
+  cd->dirty = FALSE;
+  return contents;
+}
+
+/**
+ * Add to the size of the tile's entry (creating it if need be)
+ */
+static AccessEntry *scan_add ( GHashTable *files, gchar *rel, guint32 size )
+{
+  AccessEntry *ae = g_hash_table_lookup ( files, rel );
+  if ( ae )
+    g_free ( rel );
+  else {
+    ae = g_malloc0 ( sizeof(AccessEntry) );
+    g_hash_table_insert ( files, rel, ae );
+  }
+  ae->size += size;
+  return ae;
+}
+
+static void scan_dir ( const gchar *base, const gchar *relative, GHashTable *atimes, GHashTable *files, GPtrArray *others )
+{
+  gchar *path = g_build_filename ( base, relative, NULL );
+  GDir *gdir = g_dir_open ( path, 0, NULL );
+  if ( gdir ) {
+    const gchar *name;
+    while ( !stopping && (name = g_dir_read_name ( gdir )) ) {
+      gchar *rel = relative[0] ? g_build_filename ( relative, name, NULL ) : g_strdup ( name );
+      gchar *full = g_build_filename ( base, rel, NULL );
+      GStatBuf stat_buf;
+      if ( g_lstat ( full, &stat_buf ) == 0 ) {
+        if ( S_ISDIR(stat_buf.st_mode) )
+          scan_dir ( base, rel, atimes, files, others );
+        else if ( S_ISREG(stat_buf.st_mode) ) {
+          if ( is_removable ( name ) && !g_str_has_prefix ( rel, "mbtiles.tmp" ) ) {
+            AccessEntry *ae = scan_add ( files, g_strdup(rel), (guint32)stat_buf.st_size );
+            ae->atime = GPOINTER_TO_UINT ( g_hash_table_lookup ( atimes, rel ) );
+            if ( !ae->atime )
+              ae->atime = (guint32)stat_buf.st_mtime;
+          }
+          else if ( g_str_has_suffix ( name, ".etag" ) ) {
+            // Counted with its tile, as removed along with it
+            //  (a tile that no longer exists is left with no access time, so its ETag file is removed first)
+            gchar *tile = g_strndup ( rel, strlen(rel) - strlen(".etag") );
+            (void)scan_add ( files, tile, (guint32)stat_buf.st_size );
+          }
+          else {
+            g_ptr_array_add ( others, rel );
+            rel = NULL;
+          }
+        }
+      }
+      g_free ( full );
+      g_free ( rel );
+    }
+    g_dir_close ( gdir );
+  }
+  g_free ( path );
+}
+
+/**
+ * The current size of the files that are not removed
+ */
+static guint64 others_size ( const gchar *dir, GPtrArray *others )
+{
+  guint64 size = 0;
+  for ( guint ii = 0; others && ii < others->len; ii++ ) {
+    gchar *full = g_build_filename ( dir, g_ptr_array_index(others, ii), NULL );
+    GStatBuf stat_buf;
+    if ( g_stat ( full, &stat_buf ) == 0 )
+      size += stat_buf.st_size;
+    g_free ( full );
+  }
+  return size;
+}
+
+/**
+ * Find all the files in the cache directory
+ */
+static void janitor_scan ( const gchar *dir )
+{
+  GHashTable *atimes = sidecar_read ( dir );
+  GHashTable *files = file_table_new ();
+  GPtrArray *others = g_ptr_array_new_with_free_func ( g_free );
+  scan_dir ( dir, "", atimes, files, others );
+  g_hash_table_destroy ( atimes );
+  guint64 untracked = others_size ( dir, others );
+
+  g_mutex_lock ( cq_mutex );
+  CacheDir *cd = cache_dir_lookup ( dir );
+  // Unless the limit was removed in the meantime
+  if ( cd && cd->quota && !stopping ) {
+    // Merge in anything that happened during the scan
+    GHashTableIter iter;
+    gchar *name;
+    AccessEntry *ae;
+    g_hash_table_iter_init ( &iter, cd->files );
+    while ( g_hash_table_iter_next ( &iter, (gpointer*)&name, (gpointer*)&ae ) ) {
+      AccessEntry *scanned = g_hash_table_lookup ( files, name );
+      if ( scanned )
+        scanned->atime = MAX ( scanned->atime, ae->atime );
+      else if ( ae->size )
+        g_hash_table_insert ( files, g_strdup(name), g_memdup(ae, sizeof(AccessEntry)) );
+    }
+    g_hash_table_destroy ( cd->files );
+    cd->files = files;
+    cd->tracked = 0;
+    g_hash_table_iter_init ( &iter, files );
+    while ( g_hash_table_iter_next ( &iter, NULL, (gpointer*)&ae ) )
+      cd->tracked += ae->size;
+    cd->untracked = untracked;
+    if ( cd->others )
+      g_ptr_array_free ( cd->others, TRUE );
+    cd->others = others;
+    others = NULL;
+    cd->scanned = TRUE;
+    g_debug ( "%s: %s uses %"G_GUINT64_FORMAT" bytes in %d tiles", __FUNCTION__, dir, cd->tracked + cd->untracked, g_hash_table_size(files) );
+  }
+  else
+    g_hash_table_destroy ( files );
+  g_mutex_unlock ( cq_mutex );
+  if ( others )
+    g_ptr_array_free ( others, TRUE );
+}
+
+typedef struct {
+  gchar *name;
+  guint32 atime;
+} Candidate;
+
+static gint candidate_compare ( gconstpointer a, gconstpointer b )
+{
+  const Candidate *ca = a, *cb = b;
+  return (ca->atime > cb->atime) - (ca->atime < cb->atime);
+}
+
+/**
+ * Remove the least recently used tiles until the usage is comfortably below the quota
+ */
+static void janitor_evict ( const gchar *dir )
+{
+  g_mutex_lock ( cq_mutex );
+  CacheDir *cd = cache_dir_lookup ( dir );
+  if ( !cd || !over_quota(cd) ) {
+    g_mutex_unlock ( cq_mutex );
+    return;
+  }
+  guint count = g_hash_table_size ( cd->files );
+  Candidate *candidates = g_malloc ( count * sizeof(Candidate) );
+  GHashTableIter iter;
+  gchar *name;
+  AccessEntry *ae;
+  guint nn = 0;
+  g_hash_table_iter_init ( &iter, cd->files );
+  while ( g_hash_table_iter_next ( &iter, (gpointer*)&name, (gpointer*)&ae ) ) {
+    candidates[nn].name = g_strdup ( name );
+    candidates[nn].atime = ae->atime;
+    nn++;
+  }
+  g_mutex_unlock ( cq_mutex );
+
+  qsort ( candidates, count, sizeof(Candidate), candidate_compare );
+
+  guint removed = 0;
+  for ( guint ii = 0; ii < count && !stopping; ii++ ) {
+    gboolean remove = FALSE;
+    g_mutex_lock ( cq_mutex );
+    cd = cache_dir_lookup ( dir );
+    if ( cd && cd->quota && (cd->tracked + cd->untracked) > cd->quota * LOW_WATER ) {
+      ae = g_hash_table_lookup ( cd->files, candidates[ii].name );
+      // Unless used since the candidates were chosen
+      if ( ae && ae->atime == candidates[ii].atime ) {
+        cd->tracked -= ae->size;
+        (void)g_hash_table_remove ( cd->files, candidates[ii].name );
+        remove = TRUE;
+      }
+    }
+    else
+      ii = count; // Done
+    g_mutex_unlock ( cq_mutex );
+
+    if ( remove ) {
+      gchar *filename = g_strconcat ( dir, candidates[ii].name, NULL );
+      if ( g_remove ( filename ) != 0 )
+        g_debug ( "%s: failed to remove %s", __FUNCTION__, filename );
+      a_tile_index_remove ( filename );
+      gchar *etagfile = g_strconcat ( filename, ".etag", NULL );
+      (void)g_remove ( etagfile );
+      g_free ( etagfile );
+      g_free ( filename );
+      // Give way to other disk access now and then
+      if ( ++removed % 64 == 0 )
+        g_usleep ( 10000 );
+    }
+  }
+  g_debug ( "%s: removed %d tiles from %s", __FUNCTION__, removed, dir );
+
+  for ( guint ii = 0; ii < count; ii++ )
+    g_free ( candidates[ii].name );
+  g_free ( candidates );
+}
+
+/**
+ * Scan (when necessary), reduce the usage to the quota and save the access times
+ */
+static void janitor_thread ( gchar *dir, gpointer user_data )
+{
+  g_mutex_lock ( cq_mutex );
+  CacheDir *cd = cache_dir_lookup ( dir );
+  gboolean scan = ( cd && cd->quota && !cd->scanned );
+  // NB Directories are only freed on shutdown, after the janitor has finished
+  GPtrArray *others = ( cd && cd->scanned ) ? cd->others : NULL;
+  g_mutex_unlock ( cq_mutex );
+
+  if ( scan )
+    janitor_scan ( dir );
+  else if ( others ) {
+    // These files can change size (e.g. MBTiles databases growing), so keep up to date
+    guint64 untracked = others_size ( dir, others );
+    g_mutex_lock ( cq_mutex );
+    cd->untracked = untracked;
+    g_mutex_unlock ( cq_mutex );
+  }
+  if ( !stopping )
+    janitor_evict ( dir );
+
+  GString *contents = NULL;
+  g_mutex_lock ( cq_mutex );
+  cd = cache_dir_lookup ( dir );
+  if ( cd ) {
+    cd->queued = FALSE;
+    if ( cd->scanned && cd->quota && !stopping )
+      contents = sidecar_contents ( cd );
+  }
+  g_mutex_unlock ( cq_mutex );
+
+  if ( contents ) {
+    sidecar_write ( dir, contents );
+    g_string_free ( contents, TRUE );
+  }
+  g_free ( dir );
+}
+
+/**
+ * a_cache_quota_register:
+ * @cache_dir: A map tile cache directory (ending with a separator)
+ * @quota:     Maximum size in bytes, or 0 for no limit
+ *
+ * Start tracking the usage of the directory (if not already)
+ *  and set the quota for it.
+ * Without a quota the directory is not tracked.
+ */
+void a_cache_quota_register ( const gchar *cache_dir, guint64 quota )
+{
+  if ( !cq_mutex || !cache_dir || !cache_dir[0] )
+    return;
+  g_mutex_lock ( cq_mutex );
+  CacheDir *cd = cache_dir_lookup ( cache_dir );
+  if ( !cd && !quota ) {
+    g_mutex_unlock ( cq_mutex );
+    return;
+  }
+  if ( !cd ) {
+    cd = g_malloc0 ( sizeof(CacheDir) );
+    cd->dir = g_strdup ( cache_dir );
+    cd->files = file_table_new ();
+    g_ptr_array_add ( cache_dirs, cd );
+  }
+  cd->quota = quota;
+  if ( !quota ) {
+    // Stop tracking, so a full scan is needed again should a limit be set
+    g_hash_table_remove_all ( cd->files );
+    cd->tracked = 0;
+    cd->scanned = FALSE;
+  }
+  else if ( !cd->scanned || over_quota(cd) )
+    janitor_queue ( cd );
+  g_mutex_unlock ( cq_mutex );
+}
+
+/**
+ * a_cache_quota_access:
+ *
+ * Record that the tile has been used
+ */
+void a_cache_quota_access ( const gchar *filename )
+{
+  if ( !cq_mutex )
+    return;
+  const gchar *relative;
+  g_mutex_lock ( cq_mutex );
+  CacheDir *cd = cache_dir_find ( filename, &relative );
+  if ( cd && cd->quota ) {
+    AccessEntry *ae = g_hash_table_lookup ( cd->files, relative );
+    if ( !ae && !cd->scanned ) {
+      // Size found when the scan completes
+      ae = g_malloc0 ( sizeof(AccessEntry) );
+      g_hash_table_insert ( cd->files, g_strdup(relative), ae );
+    }
+    if ( ae ) {
+      ae->atime = (guint32)time ( NULL );
+      cd->dirty = TRUE;
+    }
+  }
+  g_mutex_unlock ( cq_mutex );
+}
+
+/**
+ * a_cache_quota_add:
+ *
+ * Record that the tile has been (re)written
+ */
+void a_cache_quota_add ( const gchar *filename, guint64 size )
+{
+  if ( !cq_mutex )
+    return;
+  const gchar *relative;
+  g_mutex_lock ( cq_mutex );
+  CacheDir *cd = cache_dir_find ( filename, &relative );
+  if ( cd && cd->quota ) {
+    AccessEntry *ae = g_hash_table_lookup ( cd->files, relative );
+    if ( !ae ) {
+      ae = g_malloc0 ( sizeof(AccessEntry) );
+      g_hash_table_insert ( cd->files, g_strdup(relative), ae );
+    }
+    cd->tracked = cd->tracked - ae->size + size;
+    ae->size = (guint32)size;
+    ae->atime = (guint32)time ( NULL );
+    cd->dirty = TRUE;
+    if ( cd->scanned && over_quota(cd) )
+      janitor_queue ( cd );
+  }
+  g_mutex_unlock ( cq_mutex );
+}
+
+/**
+ * a_cache_quota_remove:
+ *
+ * Record that the tile has been removed
+ */
+void a_cache_quota_remove ( const gchar *filename )
+{
+  if ( !cq_mutex )
+    return;
+  const gchar *relative;
+  g_mutex_lock ( cq_mutex );
+  CacheDir *cd = cache_dir_find ( filename, &relative );
+  if ( cd && cd->quota ) {
+    AccessEntry *ae = g_hash_table_lookup ( cd->files, relative );
+    if ( ae ) {
+      cd->tracked -= ae->size;
+      (void)g_hash_table_remove ( cd->files, relative );
+      cd->dirty = TRUE;
+    }
+  }
+  g_mutex_unlock ( cq_mutex );
+}
+
+/**
+ * a_cache_quota_get_usage:
+ * @used:  Returns the disk space used by the directory
+ * @quota: Returns the quota for the directory
+ * @files: Returns the number of tiles in the directory
+ *
+ * Returns: FALSE if the usage is not (yet) known, which is always the case when there is no limit
+ */
+gboolean a_cache_quota_get_usage ( const gchar *cache_dir, guint64 *used, guint64 *quota, guint *files )
+{
+  gboolean known = FALSE;
+  if ( !cq_mutex )
+    return FALSE;
+  g_mutex_lock ( cq_mutex );
+  CacheDir *cd = cache_dir_lookup ( cache_dir );
+  if ( cd && cd->quota && cd->scanned ) {
+    *used = cd->tracked + cd->untracked;
+    *quota = cd->quota;
+    *files = g_hash_table_size ( cd->files );
+    known = TRUE;
+  }
+  g_mutex_unlock ( cq_mutex );
+  return known;
+}
+
+void a_cache_quota_init ()
+{
+  cq_mutex = vik_mutex_new ();
+  cache_dirs = g_ptr_array_new_with_free_func ( (GDestroyNotify)cache_dir_free );
+  // A single thread, so the janitor has minimal impact on other disk access
+  janitor_pool = g_thread_pool_new ( (GFunc)janitor_thread, NULL, 1, FALSE, NULL );
+}
+
+void a_cache_quota_uninit ()
+{
+  stopping = TRUE;
+  g_thread_pool_free ( janitor_pool, TRUE, TRUE );
+  janitor_pool = NULL;
+
+  // Save the latest access times
+  g_mutex_lock ( cq_mutex );
+  for ( guint ii = 0; ii < cache_dirs->len; ii++ ) {
+    CacheDir *cd = g_ptr_array_index ( cache_dirs, ii );
+    if ( cd->scanned && cd->dirty ) {
+      GString *contents = sidecar_contents ( cd );
+      sidecar_write ( cd->dir, contents );
+      g_string_free ( contents, TRUE );
+    }
+  }
+  g_ptr_array_free ( cache_dirs, TRUE );
+  cache_dirs = NULL;
+  g_mutex_unlock ( cq_mutex );
+  vik_mutex_free ( cq_mutex );
+  cq_mutex = NULL;
+}
@@ -0,0 +1,41 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __VIKING_CACHEQUOTA_H
+#define __VIKING_CACHEQUOTA_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Limits the disk space used by map tile cache directories,
+//  by removing the least recently used tiles.
+
+void a_cache_quota_init ();
+void a_cache_quota_uninit ();
+
+void a_cache_quota_register ( const gchar *cache_dir, guint64 quota );
+void a_cache_quota_access ( const gchar *filename );
+void a_cache_quota_add ( const gchar *filename, guint64 size );
+void a_cache_quota_remove ( const gchar *filename );
+gboolean a_cache_quota_get_usage ( const gchar *cache_dir, guint64 *used, guint64 *quota, guint *files );
+
+G_END_DECLS
+
+#endif
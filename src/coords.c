@@ -101,7 +101,7 @@ int a_coords_utm_equal( const struct UTM *utm1, const struct UTM *utm2 )
 
 double a_coords_utm_diff( const struct UTM *utm1, const struct UTM *utm2 )
 {
-  static struct LatLon tmp1, tmp2;
+  struct LatLon tmp1, tmp2;
   if ( utm1->zone == utm2->zone ) {
     return sqrt ( pow ( utm1->easting - utm2->easting, 2 ) + pow ( utm1->northing - utm2->northing, 2 ) );
   } else {
@@ -119,7 +119,7 @@ double a_coords_utm_diff( const struct UTM *utm1, const struct UTM *utm2 )
  */
 double a_coords_latlon_diff ( const struct LatLon *ll1, const struct LatLon *ll2 )
 {
-  static struct LatLon tmp1, tmp2;
+  struct LatLon tmp1, tmp2;
   gdouble tmp3;
   tmp1.lat = ll1->lat * PIOVER180;
   tmp1.lon = ll1->lon * PIOVER180;
@@ -63,6 +63,12 @@ static size_t curl_write_func(void *ptr, size_t size, size_t nmemb, FILE *stream
   return fwrite(ptr, size, nmemb, stream);
 }
 
+static size_t curl_write_buffer_func(void *ptr, size_t size, size_t nmemb, GByteArray *buffer)
+{
+  g_byte_array_append ( buffer, ptr, size * nmemb );
+  return size * nmemb;
+}
+
 static size_t curl_get_etag_func(void *ptr, size_t size, size_t nmemb, void *stream)
 {
 #define ETAG_KEYWORD "ETag: "
@@ -102,6 +108,36 @@ static char *get_cookie_file ( gboolean init )
 static gint curl_ssl_verifypeer = 1; // https://curl.haxx.se/libcurl/c/CURLOPT_SSL_VERIFYPEER.html
 static gchar* curl_cainfo = NULL;    // https://curl.haxx.se/libcurl/c/CURLOPT_CAINFO.html
 
+/*
+ * Sharing between handles
+ *
+ * DNS lookups and TLS sessions are shared by all transfers (whichever thread they are in),
+ *  so repeated requests to the same hosts avoid new lookups and full TLS handshakes.
+ * Cookies are shared too, so all transfers see the same cookies
+ *  and writes of the cookie file are serialized by the share lock.
+ * Easy handles are kept in a pool once finished with, as each one keeps its own
+ *  connections alive for the next transfer to the same host.
+ * NB The connection cache itself is not shared, as libcurl does not support
+ *  using shared connections from multiple concurrent threads.
+ */
+static CURLSH *curl_share = NULL;
+static GMutex *share_mutex[CURL_LOCK_DATA_LAST];
+
+#define VIK_SETTINGS_CURL_HANDLE_POOL_SIZE "curl_handle_pool_size"
+static guint handle_pool_size = 8;
+static GSList *handle_pool = NULL;
+static GMutex *handle_pool_mutex = NULL;
+
+static void share_lock ( CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr )
+{
+  g_mutex_lock ( share_mutex[data] );
+}
+
+static void share_unlock ( CURL *handle, curl_lock_data data, void *userptr )
+{
+  g_mutex_unlock ( share_mutex[data] );
+}
+
 /* This should to be called from main() to make sure thread safe */
 void curl_download_init()
 {
@@ -127,11 +163,37 @@ void curl_download_init()
     curl_cainfo = g_strdup ( str );
     g_free ( str );
   }
+
+  gint gitmp;
+  if ( a_settings_get_integer ( VIK_SETTINGS_CURL_HANDLE_POOL_SIZE, &gitmp ) && gitmp >= 0 )
+    handle_pool_size = gitmp;
+  handle_pool_mutex = vik_mutex_new ();
+
+  for ( guint ii = 0; ii < CURL_LOCK_DATA_LAST; ii++ )
+    share_mutex[ii] = vik_mutex_new ();
+  curl_share = curl_share_init ();
+  if ( curl_share ) {
+    curl_share_setopt ( curl_share, CURLSHOPT_LOCKFUNC, share_lock );
+    curl_share_setopt ( curl_share, CURLSHOPT_UNLOCKFUNC, share_unlock );
+    curl_share_setopt ( curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS );
+    curl_share_setopt ( curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION );
+    curl_share_setopt ( curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE );
+  }
 }
 
 /* This should to be called from main() to make sure thread safe */
 void curl_download_uninit()
 {
+  g_slist_free_full ( handle_pool, curl_easy_cleanup );
+  handle_pool = NULL;
+  vik_mutex_free ( handle_pool_mutex );
+  // Only possible once no handles use it
+  if ( curl_share )
+    curl_share_cleanup ( curl_share );
+  curl_share = NULL;
+  for ( guint ii = 0; ii < CURL_LOCK_DATA_LAST; ii++ )
+    vik_mutex_free ( share_mutex[ii] );
+
   curl_global_cleanup();
   g_free ( curl_cainfo );
   // Cookie file does not persist between sessions
@@ -139,6 +201,18 @@ void curl_download_uninit()
   g_free ( curl_download_user_agent );
 }
 
+/**
+ * Clear the options of a handle that has been finished with, so it can be reused
+ */
+static void handle_reset ( CURL *curl )
+{
+  // libcurl only writes the cookie jar when a handle is cleaned up (which a reused handle never is),
+  //  so save any cookies now
+  curl_easy_setopt ( curl, CURLOPT_COOKIELIST, "FLUSH" );
+  // Options are cleared, but connections, DNS and TLS session information are kept
+  curl_easy_reset ( curl );
+}
+
 /**
  *
  * Common curl options
@@ -149,6 +223,8 @@ static void common_opts ( CURL *curl, const char *uri, DownloadFileOptions *opti
   if ( vik_verbose )
     curl_easy_setopt ( curl, CURLOPT_VERBOSE, 1 );
   curl_easy_setopt ( curl, CURLOPT_NOSIGNAL, 1 ); // Yep, we're a multi-threaded program so don't let signals mess it up!
+  if ( curl_share )
+    curl_easy_setopt ( curl, CURLOPT_SHARE, curl_share );
   if ( options != NULL ) {
     if ( options->user_pass != NULL ) {
       curl_easy_setopt ( curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY );
@@ -174,18 +250,14 @@ static void common_opts ( CURL *curl, const char *uri, DownloadFileOptions *opti
 }
 
 /**
+ * Set the options for downloading into a file
  *
+ * Returns any HTTP headers list that needs to be freed once the transfer is complete
  */
-CURL_download_t curl_download_uri ( const char *uri, FILE *f, DownloadFileOptions *options, CurlDownloadOptions *cdo, void *handle )
+static struct curl_slist *file_opts ( CURL *curl, const char *uri, FILE *f, DownloadFileOptions *options, CurlDownloadOptions *cdo )
 {
-  CURL *curl;
   struct curl_slist *curl_send_headers = NULL;
-  CURLcode res = CURLE_FAILED_INIT;
 
-  curl = handle ? handle : curl_easy_init ();
-  if ( !curl ) {
-    return CURL_DOWNLOAD_ERROR;
-  }
   common_opts ( curl, uri, options );
   curl_easy_setopt ( curl, CURLOPT_WRITEDATA, f );
   curl_easy_setopt ( curl, CURLOPT_WRITEFUNCTION, curl_write_func);
@@ -230,13 +302,33 @@ CURL_download_t curl_download_uri ( const char *uri, FILE *f, DownloadFileOption
   if ( curl_send_headers )
     curl_easy_setopt ( curl, CURLOPT_HTTPHEADER , curl_send_headers );
 
-  res = curl_easy_perform ( curl );
+  return curl_send_headers;
+}
 
+/**
+ * Set the options for downloading into a memory buffer
+ *
+ * Returns any HTTP headers list that needs to be freed once the transfer is complete
+ */
+static struct curl_slist *buffer_opts ( CURL *curl, const char *uri, GByteArray *buffer, DownloadFileOptions *options, CurlDownloadOptions *cdo )
+{
+  struct curl_slist *curl_send_headers = file_opts ( curl, uri, NULL, options, cdo );
+  curl_easy_setopt ( curl, CURLOPT_WRITEDATA, buffer );
+  curl_easy_setopt ( curl, CURLOPT_WRITEFUNCTION, curl_write_buffer_func );
+  return curl_send_headers;
+}
+
+/**
+ * Interpret the outcome of a transfer
+ */
+static CURL_download_t file_result ( CURL *curl, CURLcode res, const char *uri )
+{
+  CURL_download_t ans;
   if (res == CURLE_OK) {
     glong response;
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response);
     if (response == 304) {         // 304 = Not Modified
-      res = CURL_DOWNLOAD_NO_NEWER_FILE;
+      ans = CURL_DOWNLOAD_NO_NEWER_FILE;
     } else if (response == 200 ||  // http: 200 = Ok
                response == 226) {  // ftp:  226 = sucess
       gdouble size;
@@ -244,64 +336,310 @@ CURL_download_t curl_download_uri ( const char *uri, FILE *f, DownloadFileOption
          when the server has a (incorrect) time earlier than the time on the file we already have */
       curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &size);
       if (size == 0)
-        res = CURL_DOWNLOAD_ERROR;
+        ans = CURL_DOWNLOAD_ERROR;
       else
-        res = CURL_DOWNLOAD_NO_ERROR;
+        ans = CURL_DOWNLOAD_NO_ERROR;
     } else {
       g_warning("%s: http response: %ld for uri %s", __FUNCTION__, response, uri);
-      res = CURL_DOWNLOAD_ERROR;
+      ans = CURL_DOWNLOAD_ERROR;
     }
   } else if (res == CURLE_ABORTED_BY_CALLBACK) {
-    res = CURL_DOWNLOAD_ABORTED;
+    ans = CURL_DOWNLOAD_ABORTED;
   } else {
     g_warning ( "%s: curl error: %d for uri %s", __FUNCTION__, res, uri );
-    res = CURL_DOWNLOAD_ERROR;
+    ans = CURL_DOWNLOAD_ERROR;
+  }
+  return ans;
+}
+
+/**
+ * Download into either the file @f or the memory @buffer
+ */
+static CURL_download_t download_uri ( const char *uri, FILE *f, GByteArray *buffer, DownloadFileOptions *options, CurlDownloadOptions *cdo, void *handle )
+{
+  CURL *curl;
+  struct curl_slist *curl_send_headers = NULL;
+
+  curl = handle ? handle : curl_download_handle_init ();
+  if ( !curl ) {
+    return CURL_DOWNLOAD_ERROR;
   }
+  if ( buffer )
+    curl_send_headers = buffer_opts ( curl, uri, buffer, options, cdo );
+  else
+    curl_send_headers = file_opts ( curl, uri, f, options, cdo );
+
+  CURL_download_t res = file_result ( curl, curl_easy_perform ( curl ), uri );
+
   if (curl_send_headers) {
     curl_slist_free_all(curl_send_headers);
     curl_send_headers = NULL;
     curl_easy_setopt ( curl, CURLOPT_HTTPHEADER , NULL);
   }
   if (!handle)
-     curl_easy_cleanup ( curl );
+     curl_download_handle_cleanup ( curl );
   return res;
 }
 
 /**
- * curl_download_get_url:
- *  Either hostname and/or uri should be defined
  *
  */
-CURL_download_t curl_download_get_url ( const char *hostname, const char *uri, FILE *f, DownloadFileOptions *options, gboolean ftp, CurlDownloadOptions *cdo, void *handle )
+CURL_download_t curl_download_uri ( const char *uri, FILE *f, DownloadFileOptions *options, CurlDownloadOptions *cdo, void *handle )
 {
-  gchar *full = NULL;
+  return download_uri ( uri, f, NULL, options, cdo, handle );
+}
 
+/**
+ * Either hostname and/or uri should be defined
+ *
+ * Returns the full URL, which should be freed after use
+ */
+static gchar *get_full_url ( const char *hostname, const char *uri, gboolean ftp )
+{
   if ( hostname && strstr ( hostname, "://" ) != NULL ) {
     if ( uri && strlen ( uri ) > 1 )
       // Simply append them together
-      full = g_strdup_printf ( "%s%s", hostname, uri );
+      return g_strdup_printf ( "%s%s", hostname, uri );
     else
       /* Already full url */
-      full = (gchar *) hostname;
+      return g_strdup ( hostname );
   }
   else if ( uri && strstr ( uri, "://" ) != NULL )
     /* Already full url */
-    full = (gchar *) uri;
+    return g_strdup ( uri );
   else if ( hostname && uri )
     /* Compose the full url */
-    full = g_strdup_printf ( "%s://%s%s", (ftp?"ftp":"http"), hostname, uri );
-  else {
+    return g_strdup_printf ( "%s://%s%s", (ftp?"ftp":"http"), hostname, uri );
+  return NULL;
+}
+
+/**
+ * curl_download_get_url:
+ *  Either hostname and/or uri should be defined
+ *
+ */
+CURL_download_t curl_download_get_url ( const char *hostname, const char *uri, FILE *f, DownloadFileOptions *options, gboolean ftp, CurlDownloadOptions *cdo, void *handle )
+{
+  gchar *full = get_full_url ( hostname, uri, ftp );
+  if ( !full )
     return CURL_DOWNLOAD_ERROR;
-  }
 
   CURL_download_t ret = curl_download_uri ( full, f, options, cdo, handle );
-  // Only free newly allocated memory
-  if ( hostname != full && uri != full )
-    g_free ( full );
+  g_free ( full );
 
   return ret;
 }
 
+/**
+ * curl_download_get_url_buffer:
+ *  As curl_download_get_url() but the content is appended to @buffer
+ *
+ */
+CURL_download_t curl_download_get_url_buffer ( const char *hostname, const char *uri, GByteArray *buffer, DownloadFileOptions *options, gboolean ftp, CurlDownloadOptions *cdo, void *handle )
+{
+  gchar *full = get_full_url ( hostname, uri, ftp );
+  if ( !full )
+    return CURL_DOWNLOAD_ERROR;
+
+  CURL_download_t ret = download_uri ( full, NULL, buffer, options, cdo, handle );
+  g_free ( full );
+
+  return ret;
+}
+
+/*
+ * Concurrent downloads
+ *
+ * Many transfers are driven from a single thread via a curl multi handle,
+ *  which allows connections to be reused and, for servers that support HTTP/2,
+ *  multiple requests to be multiplexed over one connection.
+ */
+
+typedef struct {
+  CURLM *multi;
+  GList *transfers; // Those in progress
+  GSList *idle;     // Easy handles available for reuse
+} CurlMulti;
+
+typedef struct {
+  CURL *curl;
+  struct curl_slist *headers;
+  gchar *uri;
+  CurlDownloadMultiFunc func;
+  gpointer user_data;
+} CurlTransfer;
+
+/**
+ * curl_download_multi_new:
+ * @max_host_connections: Limit of connections to a single host (0 for no limit)
+ */
+void *curl_download_multi_new ( guint max_host_connections )
+{
+  CURLM *multi = curl_multi_init ();
+  if ( !multi )
+    return NULL;
+
+#ifdef CURLPIPE_MULTIPLEX
+  curl_multi_setopt ( multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+#endif
+  if ( max_host_connections )
+    curl_multi_setopt ( multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)max_host_connections );
+
+  CurlMulti *cm = g_malloc0 ( sizeof(CurlMulti) );
+  cm->multi = multi;
+  return cm;
+}
+
+static void transfer_complete ( CurlMulti *cm, CurlTransfer *ct, CURL_download_t result )
+{
+  curl_multi_remove_handle ( cm->multi, ct->curl );
+  cm->transfers = g_list_remove ( cm->transfers, ct );
+
+  if ( ct->headers )
+    curl_slist_free_all ( ct->headers );
+  // Keep the handle (and so any of its cached information) for the next transfer
+  handle_reset ( ct->curl );
+  cm->idle = g_slist_prepend ( cm->idle, ct->curl );
+
+  if ( ct->func )
+    ct->func ( result, ct->user_data );
+
+  g_free ( ct->uri );
+  g_free ( ct );
+}
+
+static gboolean multi_add ( void *multi, const char *hostname, const char *uri, FILE *f, GByteArray *buffer, DownloadFileOptions *options, gboolean ftp,
+                            CurlDownloadOptions *cdo, CurlDownloadMultiFunc func, gpointer user_data )
+{
+  CurlMulti *cm = (CurlMulti*)multi;
+  gchar *full = get_full_url ( hostname, uri, ftp );
+  if ( !full )
+    return FALSE;
+
+  CURL *curl = NULL;
+  if ( cm->idle ) {
+    curl = cm->idle->data;
+    cm->idle = g_slist_delete_link ( cm->idle, cm->idle );
+  }
+  else
+    curl = curl_download_handle_init ();
+  if ( !curl ) {
+    g_free ( full );
+    return FALSE;
+  }
+
+  CurlTransfer *ct = g_malloc0 ( sizeof(CurlTransfer) );
+  ct->curl = curl;
+  ct->uri = full;
+  ct->func = func;
+  ct->user_data = user_data;
+  if ( buffer )
+    ct->headers = buffer_opts ( curl, full, buffer, options, cdo );
+  else
+    ct->headers = file_opts ( curl, full, f, options, cdo );
+  curl_easy_setopt ( curl, CURLOPT_PRIVATE, ct );
+#ifdef CURL_HTTP_VERSION_2TLS
+  curl_easy_setopt ( curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS );
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072b00
+  // Prefer waiting to multiplex on an existing connection over opening a new one
+  curl_easy_setopt ( curl, CURLOPT_PIPEWAIT, 1L );
+#endif
+
+  CURLMcode mc = curl_multi_add_handle ( cm->multi, curl );
+  if ( mc != CURLM_OK ) {
+    g_warning ( "%s: curl multi error: %d for uri %s", __FUNCTION__, mc, full );
+    ct->func = NULL;
+    cm->transfers = g_list_prepend ( cm->transfers, ct );
+    transfer_complete ( cm, ct, CURL_DOWNLOAD_ERROR );
+    return FALSE;
+  }
+  cm->transfers = g_list_prepend ( cm->transfers, ct );
+  return TRUE;
+}
+
+/**
+ * curl_download_multi_add:
+ *  Either hostname and/or uri should be defined
+ *
+ * Start a download into the file @f.
+ * @func will be called from curl_download_multi_perform() or curl_download_multi_free() on completion.
+ * The file, options and curl options must remain valid until then.
+ *
+ * Returns: FALSE if the transfer could not be started, in which case @func is not called
+ */
+gboolean curl_download_multi_add ( void *multi, const char *hostname, const char *uri, FILE *f, DownloadFileOptions *options, gboolean ftp,
+                                   CurlDownloadOptions *cdo, CurlDownloadMultiFunc func, gpointer user_data )
+{
+  return multi_add ( multi, hostname, uri, f, NULL, options, ftp, cdo, func, user_data );
+}
+
+/**
+ * curl_download_multi_add_buffer:
+ *
+ * As curl_download_multi_add() but the content is appended to @buffer
+ */
+gboolean curl_download_multi_add_buffer ( void *multi, const char *hostname, const char *uri, GByteArray *buffer, DownloadFileOptions *options, gboolean ftp,
+                                          CurlDownloadOptions *cdo, CurlDownloadMultiFunc func, gpointer user_data )
+{
+  return multi_add ( multi, hostname, uri, NULL, buffer, options, ftp, cdo, func, user_data );
+}
+
+/**
+ * curl_download_multi_perform:
+ * @timeout_ms: Maximum time to wait for network activity
+ *
+ * Progress the transfers, calling the completion function of any that finish
+ *
+ * Returns: The number of transfers still in progress
+ */
+guint curl_download_multi_perform ( void *multi, gint timeout_ms )
+{
+  CurlMulti *cm = (CurlMulti*)multi;
+  int running = 0;
+
+  if ( !cm->transfers )
+    return 0;
+
+  CURLMcode mc = curl_multi_perform ( cm->multi, &running );
+  if ( mc == CURLM_OK && running )
+    mc = curl_multi_wait ( cm->multi, NULL, 0, timeout_ms, NULL );
+  if ( mc == CURLM_OK )
+    mc = curl_multi_perform ( cm->multi, &running );
+  if ( mc != CURLM_OK )
+    g_warning ( "%s: curl multi error: %d", __FUNCTION__, mc );
+
+  CURLMsg *msg;
+  int msgs_left;
+  while ( (msg = curl_multi_info_read ( cm->multi, &msgs_left )) ) {
+    if ( msg->msg == CURLMSG_DONE ) {
+      CurlTransfer *ct = NULL;
+      curl_easy_getinfo ( msg->easy_handle, CURLINFO_PRIVATE, (char**)&ct );
+      if ( ct )
+        transfer_complete ( cm, ct, file_result ( ct->curl, msg->data.result, ct->uri ) );
+    }
+  }
+
+  return g_list_length ( cm->transfers );
+}
+
+/**
+ * curl_download_multi_free:
+ *
+ * Any transfers still in progress are aborted
+ */
+void curl_download_multi_free ( void *multi )
+{
+  CurlMulti *cm = (CurlMulti*)multi;
+  if ( !cm )
+    return;
+  while ( cm->transfers )
+    transfer_complete ( cm, cm->transfers->data, CURL_DOWNLOAD_ABORTED );
+  curl_multi_cleanup ( cm->multi );
+  g_slist_free_full ( cm->idle, curl_download_handle_cleanup );
+  g_free ( cm );
+}
+
 
 struct MemoryStruct {
   char *data;
@@ -332,7 +670,7 @@ static size_t WriteMemoryCallback(void *ptr, size_t size, size_t nmemb, void *da
 char* curl_download_get_ptr ( const char *uri, DownloadFileOptions *options )
 {
   struct MemoryStruct mem;
-  CURL *curl = curl_easy_init ();
+  CURL *curl = curl_download_handle_init ();
   if ( !curl )
     return NULL;
 
@@ -345,10 +683,10 @@ char* curl_download_get_ptr ( const char *uri, DownloadFileOptions *options )
 
   CURLcode result = curl_easy_perform ( curl );
 
-  curl_easy_cleanup ( curl );
-
   if ( result != CURLE_OK ) {
     g_warning ( "%s: curl error: %d for uri %s", __FUNCTION__, result, uri );
+    curl_download_handle_cleanup ( curl );
+    free ( mem.data );
     return NULL;
   }
   else if ( vik_debug ) {
@@ -359,15 +697,42 @@ char* curl_download_get_ptr ( const char *uri, DownloadFileOptions *options )
       g_debug ( "%s: received %.0f bytes in response %ld", __FUNCTION__, size, response );
   }
 
+  curl_download_handle_cleanup ( curl );
   return mem.data;
 }
 
+/**
+ * Get an easy handle, reusing one from the pool when available
+ *  (and so any connections it still has open)
+ */
 void * curl_download_handle_init ()
 {
-  return curl_easy_init();
+  CURL *curl = NULL;
+  g_mutex_lock ( handle_pool_mutex );
+  if ( handle_pool ) {
+    curl = handle_pool->data;
+    handle_pool = g_slist_delete_link ( handle_pool, handle_pool );
+  }
+  g_mutex_unlock ( handle_pool_mutex );
+  if ( !curl )
+    curl = curl_easy_init();
+  return curl;
 }
 
+/**
+ * Return the easy handle to the pool, or free it if the pool is full
+ */
 void curl_download_handle_cleanup ( void *handle )
 {
-  curl_easy_cleanup(handle);
+  if ( !handle )
+    return;
+  handle_reset ( handle );
+  g_mutex_lock ( handle_pool_mutex );
+  if ( g_slist_length(handle_pool) < handle_pool_size ) {
+    handle_pool = g_slist_prepend ( handle_pool, handle );
+    handle = NULL;
+  }
+  g_mutex_unlock ( handle_pool_mutex );
+  if ( handle )
+    curl_easy_cleanup ( handle );
 }
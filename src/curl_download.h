@@ -56,6 +56,17 @@ void curl_download_init ();
 void curl_download_uninit ();
 CURL_download_t curl_download_get_url ( const char *hostname, const char *uri, FILE *f, DownloadFileOptions *options, gboolean ftp, CurlDownloadOptions *curl_options, void *handle );
 CURL_download_t curl_download_uri ( const char *uri, FILE *f, DownloadFileOptions *options, CurlDownloadOptions *curl_options, void *handle );
+CURL_download_t curl_download_get_url_buffer ( const char *hostname, const char *uri, GByteArray *buffer, DownloadFileOptions *options, gboolean ftp, CurlDownloadOptions *curl_options, void *handle );
+typedef void (*CurlDownloadMultiFunc) ( CURL_download_t result, gpointer user_data );
+
+void *curl_download_multi_new ( guint max_host_connections );
+gboolean curl_download_multi_add ( void *multi, const char *hostname, const char *uri, FILE *f, DownloadFileOptions *options, gboolean ftp,
+                                   CurlDownloadOptions *cdo, CurlDownloadMultiFunc func, gpointer user_data );
+gboolean curl_download_multi_add_buffer ( void *multi, const char *hostname, const char *uri, GByteArray *buffer, DownloadFileOptions *options, gboolean ftp,
+                                          CurlDownloadOptions *cdo, CurlDownloadMultiFunc func, gpointer user_data );
+guint curl_download_multi_perform ( void *multi, gint timeout_ms );
+void curl_download_multi_free ( void *multi );
+
 void * curl_download_handle_init ();
 void curl_download_handle_cleanup ( void * handle );
 
@@ -125,6 +125,14 @@ gboolean a_check_kml_file(FILE* f)
 static GList *file_list = NULL;
 static GMutex *file_list_mutex = NULL;
 
+// Writes content downloaded into memory to the cache files
+static GThreadPool *save_pool = NULL;
+// The latest content waiting to be written for each file
+static GHashTable *save_pending = NULL;
+static GMutex *save_mutex = NULL;
+// Times of content held other than in the file to be downloaded to (also protected by save_mutex)
+static GHashTable *stored_times = NULL;
+
 /* spin button scales */
 static VikLayerParamScale params_scales[] = {
   {1, 365, 1, 0},		/* download_tile_age */
@@ -148,14 +156,32 @@ static VikLayerParam prefs[] = {
   { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_NAMESPACE "download_tile_age", VIK_LAYER_PARAM_UINT, VIK_LAYER_GROUP_NONE, N_("Maximum tile age (days):"), VIK_LAYER_WIDGET_SPINBUTTON, &params_scales[0], NULL, NULL, dtl_default, convert_to_display, convert_to_internal },
 };
 
+static void download_save_thread ( gpointer data, gpointer user_data );
+
 void a_download_init (void)
 {
 	a_preferences_register ( prefs, (VikLayerParamData){0}, VIKING_PREFERENCES_GROUP_KEY );
 	file_list_mutex = vik_mutex_new();
+	save_mutex = vik_mutex_new();
+	save_pending = g_hash_table_new ( g_str_hash, g_str_equal );
+	stored_times = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+	// Single thread so writes of a file happen in the order they were downloaded
+	save_pool = g_thread_pool_new ( download_save_thread, NULL, 1, FALSE, NULL );
 }
 
 void a_download_uninit (void)
 {
+	// Finish writing what has been downloaded
+	if ( save_pool )
+		g_thread_pool_free ( save_pool, FALSE, TRUE );
+	save_pool = NULL;
+	if ( save_pending )
+		g_hash_table_destroy ( save_pending );
+	save_pending = NULL;
+	if ( stored_times )
+		g_hash_table_destroy ( stored_times );
+	stored_times = NULL;
+	vik_mutex_free(save_mutex);
 	vik_mutex_free(file_list_mutex);
 }
 
@@ -335,16 +361,75 @@ static void set_etag(const char *fn, const char *fntmp, CurlDownloadOptions *cdo
   }
 }
 
-static DownloadResult_t download( const char *hostname, const char *uri, const char *fn, DownloadFileOptions *options, gboolean ftp, void *handle)
-{
-  FILE *f;
+typedef struct {
+  gchar *fn;
   gchar *tmpfilename;
-  gboolean failure = FALSE;
-  CurlDownloadOptions cdo = {0, NULL, NULL};
+  FILE *f;
+  gboolean file_exists;
+  CurlDownloadOptions cdo;
+  DownloadFileOptions *options;
+  GByteArray *buffer; // Only when downloading into memory
+  DownloadBytesFunc bytes_func;
+  // Only for concurrent downloads
+  DownloadDoneFunc func;
+  gpointer user_data;
+} DownloadTransfer;
+
+/**
+ * a_download_set_stored_time:
+ * @fn:    The file the next download is to
+ * @mtime: When the existing content was stored (0 to forget about it)
+ *
+ * For content held elsewhere rather than in @fn itself (e.g. in an MBTiles database),
+ *  so the next download to @fn treats it as an existing file of that age:
+ *  not downloading when it is more recent than the expiry age
+ *  and otherwise only when the server has something newer (if checking the server time)
+ */
+void a_download_set_stored_time ( const char *fn, time_t mtime )
+{
+  if ( !stored_times )
+    return;
+  g_mutex_lock ( save_mutex );
+  if ( mtime )
+    g_hash_table_replace ( stored_times, g_strdup(fn), GSIZE_TO_POINTER(mtime) );
+  else
+    (void)g_hash_table_remove ( stored_times, fn );
+  g_mutex_unlock ( save_mutex );
+}
+
+/**
+ * Returns: The time set by a_download_set_stored_time() for @fn (which is then forgotten) or 0 if none
+ */
+static time_t download_take_stored_time ( const char *fn )
+{
+  time_t mtime = 0;
+  if ( !stored_times )
+    return 0;
+  g_mutex_lock ( save_mutex );
+  gpointer value;
+  if ( g_hash_table_lookup_extended ( stored_times, fn, NULL, &value ) ) {
+    mtime = (time_t)GPOINTER_TO_SIZE ( value );
+    (void)g_hash_table_remove ( stored_times, fn );
+  }
+  g_mutex_unlock ( save_mutex );
+  return mtime;
+}
+
+/**
+ * Checks before downloading and setup of the temporary file
+ *
+ * Returns DOWNLOAD_SUCCESS if the download should proceed,
+ *  otherwise the final result of the download (and nothing needs tidying up)
+ */
+static DownloadResult_t download_start ( const char *hostname, const char *uri, const char *fn, DownloadFileOptions *options, DownloadTransfer *dt )
+{
+  dt->fn = g_strdup ( fn );
+  dt->options = options;
 
   /* Check file */
-  gboolean file_exists = g_file_test ( fn, G_FILE_TEST_EXISTS );
-  if ( file_exists )
+  time_t stored_time = download_take_stored_time ( fn );
+  dt->file_exists = g_file_test ( fn, G_FILE_TEST_EXISTS );
+  if ( dt->file_exists || stored_time )
   {
     // Options should always be specified when request downloading
     //  a file that already exists (i.e. map tiles)
@@ -352,24 +437,28 @@ static DownloadResult_t download( const char *hostname, const char *uri, const c
       return DOWNLOAD_NOT_REQUIRED;
 
     time_t file_age = options->expiry_age;
-    /* Get the modified time of this file */
-    GStatBuf buf;
-    (void)g_stat ( fn, &buf );
-    time_t file_time = buf.st_mtime;
+    time_t file_time = stored_time;
+    if ( dt->file_exists ) {
+      /* Get the modified time of this file */
+      GStatBuf buf;
+      (void)g_stat ( fn, &buf );
+      file_time = buf.st_mtime;
+    }
     if ( (time(NULL) - file_time) < file_age ) {
       /* File cache is too recent, so return */
       return DOWNLOAD_NOT_REQUIRED;
     }
 
     if ( options->check_file_server_time ) {
-      cdo.time_condition = file_time;
+      dt->cdo.time_condition = file_time;
     }
 
-    if ( options->use_etag ) {
-      get_etag(fn, &cdo);
+    if ( options->use_etag && dt->file_exists ) {
+      get_etag(fn, &dt->cdo);
     }
+  }
 
-  } else {
+  if ( !dt->file_exists ) {
     gchar *dir = g_path_get_dirname ( fn );
     if ( g_mkdir_with_parents ( dir , 0777 ) != 0)
       g_warning ("%s: Failed to mkdir %s", __FUNCTION__, dir );
@@ -379,30 +468,40 @@ static DownloadResult_t download( const char *hostname, const char *uri, const c
   // Early test for valid hostname & uri to avoid unnecessary tmp file
   if ( !hostname && !uri ) {
     g_warning ( "%s: Parameter error - neither hostname nor uri defined", __FUNCTION__ );
+    g_free ( dt->cdo.etag );
     return DOWNLOAD_PARAMETERS_ERROR;
   }
 
-  tmpfilename = g_strdup_printf("%s.tmp", fn);
-  if (!lock_file ( tmpfilename ) )
+  if ( dt->buffer )
+    return DOWNLOAD_SUCCESS;
+
+  dt->tmpfilename = g_strdup_printf("%s.tmp", fn);
+  if (!lock_file ( dt->tmpfilename ) )
   {
-    g_debug("%s: Couldn't take lock on temporary file \"%s\"", __FUNCTION__, tmpfilename);
-    g_free ( tmpfilename );
-    if (options->use_etag)
-      g_free ( cdo.etag );
+    g_debug("%s: Couldn't take lock on temporary file \"%s\"", __FUNCTION__, dt->tmpfilename);
+    g_free ( dt->tmpfilename );
+    g_free ( dt->cdo.etag );
     return DOWNLOAD_FILE_WRITE_ERROR;
   }
-  f = g_fopen ( tmpfilename, "w+b" );  /* truncate file and open it */
-  if ( ! f ) {
-    g_warning("Couldn't open temporary file \"%s\": %s", tmpfilename, g_strerror(errno));
-    g_free ( tmpfilename );
-    if (options->use_etag)
-      g_free ( cdo.etag );
+  dt->f = g_fopen ( dt->tmpfilename, "w+b" );  /* truncate file and open it */
+  if ( ! dt->f ) {
+    g_warning("Couldn't open temporary file \"%s\": %s", dt->tmpfilename, g_strerror(errno));
+    unlock_file ( dt->tmpfilename );
+    g_free ( dt->tmpfilename );
+    g_free ( dt->cdo.etag );
     return DOWNLOAD_FILE_WRITE_ERROR;
   }
 
-  /* Call the backend function */
-  CURL_download_t ret = curl_download_get_url ( hostname, uri, f, options, ftp, &cdo, handle );
+  return DOWNLOAD_SUCCESS;
+}
 
+/**
+ * Process the downloaded temporary file according to the result of the transfer
+ */
+static DownloadResult_t download_finish ( DownloadTransfer *dt, CURL_download_t ret )
+{
+  DownloadFileOptions *options = dt->options;
+  gboolean failure = FALSE;
   DownloadResult_t result = DOWNLOAD_SUCCESS;
 
   if (ret == CURL_DOWNLOAD_ABORTED) {
@@ -415,65 +514,254 @@ static DownloadResult_t download( const char *hostname, const char *uri, const c
     result = DOWNLOAD_HTTP_ERROR;
   }
 
-  if (!failure && options != NULL && options->check_file != NULL && ! options->check_file(f)) {
+  if (!failure && options != NULL && options->check_file != NULL && ! options->check_file(dt->f)) {
     g_debug("%s: file content checking failed", __FUNCTION__);
     failure = TRUE;
     result = DOWNLOAD_CONTENT_ERROR;
   }
 
-  fclose ( f );
-  f = NULL;
+  fclose ( dt->f );
+  dt->f = NULL;
 
   if (failure)
   {
-    g_warning(_("Download error: %s"), fn);
-    if ( g_remove ( tmpfilename ) != 0 )
-      g_warning( ("Failed to remove: %s"), tmpfilename);
-    unlock_file ( tmpfilename );
-    g_free ( tmpfilename );
-    if ( options != NULL && options->use_etag ) {
-      g_free ( cdo.etag );
-      g_free ( cdo.new_etag );
-    }
-    return result;
+    g_warning(_("Download error: %s"), dt->fn);
+    if ( g_remove ( dt->tmpfilename ) != 0 )
+      g_warning( ("Failed to remove: %s"), dt->tmpfilename);
   }
-
-  if (ret == CURL_DOWNLOAD_NO_NEWER_FILE)  {
-    (void)g_remove ( tmpfilename );
+  else if (ret == CURL_DOWNLOAD_NO_NEWER_FILE)  {
+    (void)g_remove ( dt->tmpfilename );
      // update mtime of local copy
      // Not security critical, thus potential Time of Check Time of Use race condition is not bad
      // coverity[toctou]
-     if ( g_utime ( fn, NULL ) != 0 )
-       g_warning ( "%s couldn't set time on: %s", __FUNCTION__, fn );
+     if ( dt->file_exists && g_utime ( dt->fn, NULL ) != 0 )
+       g_warning ( "%s couldn't set time on: %s", __FUNCTION__, dt->fn );
   } else {
     if ( options != NULL && options->convert_file )
-      options->convert_file ( tmpfilename );
+      options->convert_file ( dt->tmpfilename );
 
     if ( options != NULL && options->use_etag ) {
-      if ( cdo.new_etag ) {
+      if ( dt->cdo.new_etag ) {
         /* server returned an etag value */
-        set_etag(fn, tmpfilename, &cdo);
+        set_etag(dt->fn, dt->tmpfilename, &dt->cdo);
       }
     }
 
     // Remove existing file if it exists and then replace with the newly downloaded file
     // Potential TOCTOU, but we shouldn't be requesting downloads of the same file multiple times anyway.
-    if ( file_exists )
-      if ( g_remove ( fn ) )
-        g_warning ( "%s: failed to remove: %s", __FUNCTION__, fn );
+    if ( dt->file_exists )
+      if ( g_remove ( dt->fn ) )
+        g_warning ( "%s: failed to remove: %s", __FUNCTION__, dt->fn );
 
      /* move completely-downloaded file to permanent location */
-     if ( g_rename ( tmpfilename, fn ) )
-        g_warning ("%s: file rename failed [%s] to [%s]", __FUNCTION__, tmpfilename, fn );
+     if ( g_rename ( dt->tmpfilename, dt->fn ) )
+        g_warning ("%s: file rename failed [%s] to [%s]", __FUNCTION__, dt->tmpfilename, dt->fn );
+  }
+  unlock_file ( dt->tmpfilename );
+  g_free ( dt->tmpfilename );
+  dt->tmpfilename = NULL;
+
+  g_free ( dt->cdo.etag );
+  g_free ( dt->cdo.new_etag );
+  return result;
+}
+
+/*
+ * Downloading into memory
+ *
+ * Rather than the content being written to a temporary file, which the user of the content then reads back,
+ *  the content is handed over directly from memory and written to the file in the background.
+ * Checks on the file content (as per DownloadFileOptions.check_file) are not possible,
+ *  so this is only used when the user of the content validates it anyway (e.g. when decoding map tile images).
+ */
+
+typedef struct {
+  gchar *fn;
+  GBytes *bytes;
+  gchar *etag;
+} DownloadSave;
+
+/**
+ * Record the content as waiting to be written to the file
+ */
+static DownloadSave *download_save_new ( const char *fn, GBytes *bytes, const gchar *etag )
+{
+  DownloadSave *ds = g_malloc ( sizeof(DownloadSave) );
+  ds->fn = g_strdup ( fn );
+  ds->bytes = g_bytes_ref ( bytes );
+  ds->etag = g_strdup ( etag );
+  g_mutex_lock ( save_mutex );
+  // NB Replace the key too, as the previous one is freed when its content has been written
+  g_hash_table_replace ( save_pending, ds->fn, ds );
+  g_mutex_unlock ( save_mutex );
+  return ds;
+}
+
+static void download_save_free ( DownloadSave *ds )
+{
+  // Unless there is newer content still to be written
+  g_mutex_lock ( save_mutex );
+  if ( g_hash_table_lookup ( save_pending, ds->fn ) == ds )
+    g_hash_table_remove ( save_pending, ds->fn );
+  g_mutex_unlock ( save_mutex );
+
+  g_bytes_unref ( ds->bytes );
+  g_free ( ds->etag );
+  g_free ( ds->fn );
+  g_free ( ds );
+}
+
+static void download_save_thread ( gpointer data, gpointer user_data )
+{
+  DownloadSave *ds = data;
+  // Content not downloaded to this file itself (e.g. cut out of a larger image) has not been through download_start(),
+  //  so the directory may not exist yet
+  gchar *dir = g_path_get_dirname ( ds->fn );
+  if ( g_mkdir_with_parents ( dir, 0777 ) != 0 )
+    g_warning ( "%s: Failed to mkdir %s", __FUNCTION__, dir );
+  g_free ( dir );
+  gchar *tmpfilename = g_strdup_printf ( "%s.tmp", ds->fn );
+  // Leave the file alone whilst it is being downloaded again
+  if ( lock_file ( tmpfilename ) ) {
+    gsize length = 0;
+    const gchar *contents = g_bytes_get_data ( ds->bytes, &length );
+    GError *error = NULL;
+    if ( g_file_set_contents ( ds->fn, contents, length, &error ) ) {
+      if ( ds->etag ) {
+        CurlDownloadOptions cdo = { 0 };
+        cdo.new_etag = ds->etag;
+        set_etag ( ds->fn, ds->fn, &cdo );
+      }
+    }
+    else {
+      g_warning ( "%s: %s", __FUNCTION__, error->message );
+      g_error_free ( error );
+    }
+    unlock_file ( tmpfilename );
   }
-  unlock_file ( tmpfilename );
   g_free ( tmpfilename );
+  download_save_free ( ds );
+}
+
+/**
+ * Whether the download can be made into memory
+ */
+static gboolean download_buffer_supported ( DownloadFileOptions *options )
+{
+  // Map file checks are left to the decoding of the content
+  return options == NULL ||
+    ( options->convert_file == NULL && (options->check_file == NULL || options->check_file == a_check_map_file) );
+}
 
-  if ( options != NULL && options->use_etag ) {
-    g_free ( cdo.etag );
-    g_free ( cdo.new_etag );
+/**
+ * Process the content downloaded into memory according to the result of the transfer
+ */
+static DownloadResult_t download_finish_buffer ( DownloadTransfer *dt, CURL_download_t ret, GBytes **bytes )
+{
+  DownloadResult_t result = DOWNLOAD_SUCCESS;
+  *bytes = NULL;
+
+  if ( ret == CURL_DOWNLOAD_ABORTED ) {
+    g_debug ( "%s: download aborted: %s", __FUNCTION__, dt->fn );
+    result = DOWNLOAD_USER_ABORTED;
+  } else if ( ret == CURL_DOWNLOAD_ERROR ) {
+    g_warning ( _("Download error: %s"), dt->fn );
+    result = DOWNLOAD_HTTP_ERROR;
+  } else if ( ret == CURL_DOWNLOAD_NO_NEWER_FILE ) {
+    // update mtime of local copy
+    if ( dt->file_exists && g_utime ( dt->fn, NULL ) != 0 )
+      g_warning ( "%s couldn't set time on: %s", __FUNCTION__, dt->fn );
+  } else {
+    *bytes = g_byte_array_free_to_bytes ( dt->buffer );
+    dt->buffer = NULL;
   }
-  return DOWNLOAD_SUCCESS;
+
+  if ( dt->buffer )
+    g_byte_array_unref ( dt->buffer );
+  dt->buffer = NULL;
+  g_free ( dt->cdo.etag );
+  dt->cdo.etag = NULL;
+  return result;
+}
+
+/**
+ * Hand over the result (and any content) and then save the content if it was wanted
+ *
+ * The content is registered as pending before being handed over,
+ *  so it is available (via a_download_get_pending_save()) as soon as the receiver knows about it.
+ */
+static void download_deliver_full ( const char *fn, const gchar *etag, DownloadResult_t result, GBytes *bytes,
+                                    DownloadBytesFunc func, gpointer user_data )
+{
+  DownloadSave *ds = ( bytes && save_pool ) ? download_save_new ( fn, bytes, etag ) : NULL;
+  if ( func ( result, bytes, user_data ) && ds )
+    g_thread_pool_push ( save_pool, ds, NULL );
+  else if ( ds )
+    download_save_free ( ds );
+}
+
+/**
+ * a_download_get_pending_save:
+ * @fn: The file
+ *
+ * Content handed over for saving is not in the file until the background write completes.
+ *
+ * Returns: A new reference to the content still waiting to be written to @fn, or NULL if none
+ */
+GBytes *a_download_get_pending_save ( const char *fn )
+{
+  GBytes *bytes = NULL;
+  if ( !save_pending )
+    return NULL;
+  g_mutex_lock ( save_mutex );
+  DownloadSave *ds = g_hash_table_lookup ( save_pending, fn );
+  if ( ds )
+    bytes = g_bytes_ref ( ds->bytes );
+  g_mutex_unlock ( save_mutex );
+  return bytes;
+}
+
+/**
+ * a_download_deliver_bytes:
+ * @fn:        The file the content is for
+ * @result:    The result to report
+ * @bytes:     The content (may be NULL)
+ * @func:      Receives the result and content, returning whether the content should be saved
+ * @user_data: Passed to @func
+ *
+ * Deliver content obtained other than by a download of @fn itself
+ *  (e.g. a map tile cut out of a larger image) in the same way as a_http_download_get_url_bytes() does,
+ *  writing it to the file in the background if wanted
+ */
+void a_download_deliver_bytes ( const char *fn, DownloadResult_t result, GBytes *bytes, DownloadBytesFunc func, gpointer user_data )
+{
+  // Not downloaded itself, so any stored time is no longer of use
+  (void)download_take_stored_time ( fn );
+  download_deliver_full ( fn, NULL, result, bytes, func, user_data );
+}
+
+static void download_deliver ( DownloadTransfer *dt, DownloadResult_t result, GBytes *bytes )
+{
+  download_deliver_full ( dt->fn, ( dt->options && dt->options->use_etag ) ? dt->cdo.new_etag : NULL,
+                          result, bytes, dt->bytes_func, dt->user_data );
+  if ( bytes )
+    g_bytes_unref ( bytes );
+  g_free ( dt->cdo.new_etag );
+  dt->cdo.new_etag = NULL;
+}
+
+static DownloadResult_t download( const char *hostname, const char *uri, const char *fn, DownloadFileOptions *options, gboolean ftp, void *handle)
+{
+  DownloadTransfer dt = { 0 };
+
+  DownloadResult_t result = download_start ( hostname, uri, fn, options, &dt );
+  if ( result == DOWNLOAD_SUCCESS ) {
+    /* Call the backend function */
+    CURL_download_t ret = curl_download_get_url ( hostname, uri, dt.f, options, ftp, &dt.cdo, handle );
+    result = download_finish ( &dt, ret );
+  }
+  g_free ( dt.fn );
+  return result;
 }
 
 /**
@@ -490,6 +778,56 @@ DownloadResult_t a_ftp_download_get_url ( const char *hostname, const char *uri,
   return download ( hostname, uri, fn, opt, TRUE, handle );
 }
 
+static DownloadResult_t download_bytes ( const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, gboolean ftp, void *handle,
+                                         DownloadBytesFunc func, gpointer user_data )
+{
+  if ( !download_buffer_supported ( opt ) ) {
+    DownloadResult_t result = download ( hostname, uri, fn, opt, ftp, handle );
+    (void)func ( result, NULL, user_data );
+    return result;
+  }
+
+  DownloadTransfer dt = { 0 };
+  dt.buffer = g_byte_array_new ();
+  dt.bytes_func = func;
+  dt.user_data = user_data;
+
+  GBytes *bytes = NULL;
+  DownloadResult_t result = download_start ( hostname, uri, fn, opt, &dt );
+  if ( result == DOWNLOAD_SUCCESS ) {
+    CURL_download_t ret = curl_download_get_url_buffer ( hostname, uri, dt.buffer, opt, ftp, &dt.cdo, handle );
+    result = download_finish_buffer ( &dt, ret, &bytes );
+  }
+  download_deliver ( &dt, result, bytes );
+
+  if ( dt.buffer )
+    g_byte_array_unref ( dt.buffer );
+  g_free ( dt.fn );
+  return result;
+}
+
+/**
+ * a_http_download_get_url_bytes:
+ * @fn:   The file to compare the server version with and to save the content to
+ * @func: Called with the result and the content, before this function returns
+ *
+ * As a_http_download_get_url(), but the content is passed to @func straight from memory.
+ * If @func returns TRUE the content is then written to @fn in the background.
+ * The content is NULL when only available from the file
+ *  (e.g. not newer on the server, or the options require the download to go via a file).
+ */
+DownloadResult_t a_http_download_get_url_bytes ( const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, void *handle,
+                                                 DownloadBytesFunc func, gpointer user_data )
+{
+  return download_bytes ( hostname, uri, fn, opt, FALSE, handle, func, user_data );
+}
+
+DownloadResult_t a_ftp_download_get_url_bytes ( const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, void *handle,
+                                                DownloadBytesFunc func, gpointer user_data )
+{
+  return download_bytes ( hostname, uri, fn, opt, TRUE, handle, func, user_data );
+}
+
 void * a_download_handle_init ()
 {
   return curl_download_handle_init ();
@@ -500,6 +838,152 @@ void a_download_handle_cleanup ( void *handle )
   curl_download_handle_cleanup ( handle );
 }
 
+/**
+ * a_download_multi_new:
+ * @max_host_connections: Limit of connections to a single host (0 for no limit)
+ *
+ * Create a handle for running multiple downloads concurrently from a single thread
+ */
+void *a_download_multi_new ( guint max_host_connections )
+{
+  return curl_download_multi_new ( max_host_connections );
+}
+
+static void download_transfer_free ( DownloadTransfer *dt )
+{
+  if ( dt->options )
+    a_download_file_options_free ( dt->options );
+  if ( dt->buffer )
+    g_byte_array_unref ( dt->buffer );
+  g_free ( dt->fn );
+  g_free ( dt );
+}
+
+/**
+ * Report the result of a concurrent download made via a file
+ */
+static void download_multi_report ( DownloadTransfer *dt, DownloadResult_t result )
+{
+  if ( dt->bytes_func )
+    (void)dt->bytes_func ( result, NULL, dt->user_data );
+  else
+    dt->func ( result, dt->user_data );
+}
+
+static void download_multi_done ( CURL_download_t ret, gpointer user_data )
+{
+  DownloadTransfer *dt = user_data;
+  if ( dt->buffer ) {
+    GBytes *bytes = NULL;
+    DownloadResult_t result = download_finish_buffer ( dt, ret, &bytes );
+    download_deliver ( dt, result, bytes );
+  }
+  else
+    download_multi_report ( dt, download_finish ( dt, ret ) );
+  download_transfer_free ( dt );
+}
+
+static void download_multi_add ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, gboolean ftp,
+                                 DownloadDoneFunc func, gpointer user_data )
+{
+  DownloadTransfer *dt = g_malloc0 ( sizeof(DownloadTransfer) );
+  dt->func = func;
+  dt->user_data = user_data;
+
+  DownloadResult_t result = download_start ( hostname, uri, fn, opt, dt );
+  if ( result == DOWNLOAD_SUCCESS ) {
+    if ( curl_download_multi_add ( multi, hostname, uri, dt->f, opt, ftp, &dt->cdo, download_multi_done, dt ) )
+      return;
+    result = download_finish ( dt, CURL_DOWNLOAD_ERROR );
+  }
+  download_multi_report ( dt, result );
+  download_transfer_free ( dt );
+}
+
+/**
+ * a_http_download_multi_add:
+ * @opt:  Download options, which are owned by the download and freed on completion
+ * @func: Called when the download has finished (including when no download was necessary)
+ *
+ * Start a download as per a_http_download_get_url(), but without waiting for it to complete.
+ * @func is called either immediately, or from a_download_multi_perform() or a_download_multi_free()
+ */
+void a_http_download_multi_add ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, DownloadDoneFunc func, gpointer user_data )
+{
+  download_multi_add ( multi, hostname, uri, fn, opt, FALSE, func, user_data );
+}
+
+void a_ftp_download_multi_add ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, DownloadDoneFunc func, gpointer user_data )
+{
+  download_multi_add ( multi, hostname, uri, fn, opt, TRUE, func, user_data );
+}
+
+static void download_multi_add_bytes ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, gboolean ftp,
+                                       DownloadBytesFunc func, gpointer user_data )
+{
+  DownloadTransfer *dt = g_malloc0 ( sizeof(DownloadTransfer) );
+  dt->bytes_func = func;
+  dt->user_data = user_data;
+  if ( download_buffer_supported ( opt ) )
+    dt->buffer = g_byte_array_new ();
+
+  DownloadResult_t result = download_start ( hostname, uri, fn, opt, dt );
+  if ( result == DOWNLOAD_SUCCESS ) {
+    if ( dt->buffer ) {
+      if ( curl_download_multi_add_buffer ( multi, hostname, uri, dt->buffer, opt, ftp, &dt->cdo, download_multi_done, dt ) )
+        return;
+      GBytes *bytes = NULL;
+      result = download_finish_buffer ( dt, CURL_DOWNLOAD_ERROR, &bytes );
+    }
+    else {
+      if ( curl_download_multi_add ( multi, hostname, uri, dt->f, opt, ftp, &dt->cdo, download_multi_done, dt ) )
+        return;
+      result = download_finish ( dt, CURL_DOWNLOAD_ERROR );
+    }
+  }
+  download_multi_report ( dt, result );
+  download_transfer_free ( dt );
+}
+
+/**
+ * a_http_download_multi_add_bytes:
+ * @opt:  Download options, which are owned by the download and freed on completion
+ * @func: Called when the download has finished (including when no download was necessary)
+ *
+ * Start a download as per a_http_download_get_url_bytes(), but without waiting for it to complete.
+ * @func is called either immediately, or from a_download_multi_perform() or a_download_multi_free()
+ */
+void a_http_download_multi_add_bytes ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, DownloadBytesFunc func, gpointer user_data )
+{
+  download_multi_add_bytes ( multi, hostname, uri, fn, opt, FALSE, func, user_data );
+}
+
+void a_ftp_download_multi_add_bytes ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, DownloadBytesFunc func, gpointer user_data )
+{
+  download_multi_add_bytes ( multi, hostname, uri, fn, opt, TRUE, func, user_data );
+}
+
+/**
+ * a_download_multi_perform:
+ * @timeout_ms: Maximum time to wait for network activity
+ *
+ * Returns: The number of downloads still in progress
+ */
+guint a_download_multi_perform ( void *multi, gint timeout_ms )
+{
+  return curl_download_multi_perform ( multi, timeout_ms );
+}
+
+/**
+ * a_download_multi_free:
+ *
+ * Any downloads in progress are aborted (with a result of DOWNLOAD_USER_ABORTED)
+ */
+void a_download_multi_free ( void *multi )
+{
+  curl_download_multi_free ( multi );
+}
+
 /**
  * a_download_url_to_tmp_file:
  * @uri:         The URI (Uniform Resource Identifier)
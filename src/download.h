@@ -24,6 +24,7 @@
 #define _VIKING_DOWNLOAD_H
 
 #include <stdio.h>
+#include <time.h>
 
 G_BEGIN_DECLS
 
@@ -135,6 +136,26 @@ DownloadResult_t a_ftp_download_get_url ( const char *hostname, const char *uri,
 void *a_download_handle_init ();
 void a_download_handle_cleanup ( void *handle );
 
+typedef void (*DownloadDoneFunc) ( DownloadResult_t result, gpointer user_data );
+// Returns: Whether the content should be saved to the file
+typedef gboolean (*DownloadBytesFunc) ( DownloadResult_t result, GBytes *bytes, gpointer user_data );
+
+DownloadResult_t a_http_download_get_url_bytes ( const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, void *handle,
+                                                 DownloadBytesFunc func, gpointer user_data );
+DownloadResult_t a_ftp_download_get_url_bytes ( const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, void *handle,
+                                                DownloadBytesFunc func, gpointer user_data );
+void a_download_deliver_bytes ( const char *fn, DownloadResult_t result, GBytes *bytes, DownloadBytesFunc func, gpointer user_data );
+GBytes *a_download_get_pending_save ( const char *fn );
+void a_download_set_stored_time ( const char *fn, time_t mtime );
+
+void *a_download_multi_new ( guint max_host_connections );
+void a_http_download_multi_add ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, DownloadDoneFunc func, gpointer user_data );
+void a_http_download_multi_add_bytes ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, DownloadBytesFunc func, gpointer user_data );
+void a_ftp_download_multi_add ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, DownloadDoneFunc func, gpointer user_data );
+void a_ftp_download_multi_add_bytes ( void *multi, const char *hostname, const char *uri, const char *fn, DownloadFileOptions *opt, DownloadBytesFunc func, gpointer user_data );
+guint a_download_multi_perform ( void *multi, gint timeout_ms );
+void a_download_multi_free ( void *multi );
+
 gchar *a_download_uri_to_tmp_file ( const gchar *uri, DownloadFileOptions *options );
 
 G_END_DECLS
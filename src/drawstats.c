@@ -0,0 +1,302 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include "drawstats.h"
+#include "settings.h"
+#include "dir.h"
+
+/*
+ * Each frame the total drawing time, the time taken by each layer and various counts are collected.
+ * The results of the last frame can be shown (in the statusbar and/or on the viewport),
+ *  and optionally each frame is written as a line of JSON to a log file in the Viking configuration directory.
+ * When the log gets too big it is moved aside to a '.1' file and a new one started,
+ *  so at most two logs worth of history is kept.
+ */
+
+#define VIK_SETTINGS_DRAW_STATS "draw_stats"
+#define VIK_SETTINGS_DRAW_STATS_OVERLAY "draw_stats_overlay"
+#define VIK_SETTINGS_DRAW_STATS_LOG "draw_stats_log"
+#define VIK_SETTINGS_DRAW_STATS_LOG_SIZE "draw_stats_log_size"
+
+#define LOG_FILENAME "drawstats.log"
+#define LOG_SIZE_DEFAULT (1024*1024)
+
+typedef struct {
+  gchar *name;
+  gint64 usecs;
+} LayerTime;
+
+static gboolean enabled = FALSE;
+static gboolean overlay = FALSE;
+
+// Counts and layer times may be added from any thread (e.g. when decoding tiles or drawing in parallel)
+static gint counts[DRAWSTATS_NUM_COUNTS];
+static GMutex layers_mutex;   // Protects layers
+static GArray *layers = NULL; // LayerTimes of the frame being drawn
+
+static gint64 frame_begin = 0;
+static gint in_frame = FALSE; // Whether a frame is being drawn - read from any thread
+// Results of the last complete frame
+static gint64 frame_usecs = 0;
+static guint frame_counts[DRAWSTATS_NUM_COUNTS];
+static GArray *frame_layers = NULL;
+
+static gchar *log_filename = NULL;
+static FILE *log_file = NULL;
+static gint log_size_max = LOG_SIZE_DEFAULT;
+
+static void layer_time_clear ( LayerTime *lt )
+{
+  g_free ( lt->name );
+}
+
+static GArray *layer_times_new ()
+{
+  GArray *array = g_array_new ( FALSE, FALSE, sizeof(LayerTime) );
+  g_array_set_clear_func ( array, (GDestroyNotify)layer_time_clear );
+  return array;
+}
+
+void a_drawstats_init ()
+{
+  (void)a_settings_get_boolean ( VIK_SETTINGS_DRAW_STATS, &enabled );
+  if ( !enabled )
+    return;
+
+  (void)a_settings_get_boolean ( VIK_SETTINGS_DRAW_STATS_OVERLAY, &overlay );
+  layers = layer_times_new ();
+  frame_layers = layer_times_new ();
+
+  gboolean log = FALSE;
+  (void)a_settings_get_boolean ( VIK_SETTINGS_DRAW_STATS_LOG, &log );
+  if ( log ) {
+    gint tmp;
+    if ( a_settings_get_integer ( VIK_SETTINGS_DRAW_STATS_LOG_SIZE, &tmp ) && tmp > 0 )
+      log_size_max = tmp;
+    log_filename = g_build_filename ( a_get_viking_dir(), LOG_FILENAME, NULL );
+    log_file = g_fopen ( log_filename, "a" );
+    if ( !log_file )
+      g_warning ( "%s: Unable to open %s", __FUNCTION__, log_filename );
+  }
+}
+
+void a_drawstats_uninit ()
+{
+  enabled = FALSE;
+  if ( log_file )
+    fclose ( log_file );
+  log_file = NULL;
+  g_free ( log_filename );
+  log_filename = NULL;
+  if ( layers )
+    g_array_free ( layers, TRUE );
+  layers = NULL;
+  if ( frame_layers )
+    g_array_free ( frame_layers, TRUE );
+  frame_layers = NULL;
+}
+
+gboolean a_drawstats_enabled ()
+{
+  return enabled;
+}
+
+gboolean a_drawstats_show_overlay ()
+{
+  return enabled && overlay;
+}
+
+/**
+ * a_drawstats_add:
+ *
+ * Can be called from any thread
+ */
+void a_drawstats_add ( drawstats_count_t type, guint count )
+{
+  if ( !enabled || !count )
+    return;
+  // Decoding happens in the background, so count it whenever
+  if ( type == DRAWSTATS_TILES_DECODED || g_atomic_int_get ( &in_frame ) )
+    g_atomic_int_add ( &counts[type], count );
+}
+
+/**
+ * a_drawstats_layer_start:
+ *
+ * Returns: The start time to be passed to a_drawstats_layer_end()
+ */
+gint64 a_drawstats_layer_start ()
+{
+  return ( enabled && g_atomic_int_get ( &in_frame ) ) ? g_get_monotonic_time() : 0;
+}
+
+/**
+ * a_drawstats_layer_end:
+ *
+ * Record how long drawing a layer took
+ * Can be called from any thread
+ */
+void a_drawstats_layer_end ( const gchar *name, gint64 start )
+{
+  if ( !enabled || !start )
+    return;
+  LayerTime lt = { g_strdup ( name ? name : "" ), g_get_monotonic_time() - start };
+  g_mutex_lock ( &layers_mutex );
+  g_array_append_val ( layers, lt );
+  g_mutex_unlock ( &layers_mutex );
+}
+
+void a_drawstats_frame_start ()
+{
+  if ( !enabled )
+    return;
+  g_mutex_lock ( &layers_mutex );
+  g_array_set_size ( layers, 0 );
+  g_mutex_unlock ( &layers_mutex );
+  // Drop anything counted (other than decoding) since the last frame
+  for ( guint ii = 0; ii < DRAWSTATS_NUM_COUNTS; ii++ )
+    if ( ii != DRAWSTATS_TILES_DECODED )
+      g_atomic_int_set ( &counts[ii], 0 );
+  frame_begin = g_get_monotonic_time();
+  g_atomic_int_set ( &in_frame, TRUE );
+}
+
+static void json_append_string ( GString *gs, const gchar *str )
+{
+  g_string_append_c ( gs, '"' );
+  for ( const gchar *ch = str; *ch; ch++ ) {
+    if ( *ch == '"' || *ch == '\\' )
+      g_string_append_printf ( gs, "\\%c", *ch );
+    else if ( (guchar)*ch < 0x20 )
+      g_string_append_printf ( gs, "\\u%04x", (guchar)*ch );
+    else
+      g_string_append_c ( gs, *ch );
+  }
+  g_string_append_c ( gs, '"' );
+}
+
+/**
+ * Write the last frame as a line of JSON, moving the log aside when it gets too big
+ */
+static void log_frame ()
+{
+  GString *gs = g_string_new ( NULL );
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  g_string_append_printf ( gs, "{\"time\":%s", g_ascii_formatd ( buf, sizeof(buf), "%.3f", g_get_real_time() / (gdouble)G_USEC_PER_SEC ) );
+  g_string_append_printf ( gs, ",\"frame_ms\":%s", g_ascii_formatd ( buf, sizeof(buf), "%.3f", frame_usecs / 1000.0 ) );
+  g_string_append_printf ( gs, ",\"tiles_drawn\":%u,\"tiles_decoded\":%u,\"tiles_missed\":%u",
+                           frame_counts[DRAWSTATS_TILES_DRAWN], frame_counts[DRAWSTATS_TILES_DECODED], frame_counts[DRAWSTATS_TILES_MISSED] );
+  g_string_append_printf ( gs, ",\"trackpoints_visited\":%u,\"trackpoints_drawn\":%u",
+                           frame_counts[DRAWSTATS_TRACKPOINTS_VISITED], frame_counts[DRAWSTATS_TRACKPOINTS_DRAWN] );
+  g_string_append ( gs, ",\"layers\":[" );
+  for ( guint ii = 0; ii < frame_layers->len; ii++ ) {
+    LayerTime *lt = &g_array_index ( frame_layers, LayerTime, ii );
+    g_string_append ( gs, ii ? ",{\"name\":" : "{\"name\":" );
+    json_append_string ( gs, lt->name );
+    g_string_append_printf ( gs, ",\"ms\":%s}", g_ascii_formatd ( buf, sizeof(buf), "%.3f", lt->usecs / 1000.0 ) );
+  }
+  g_string_append ( gs, "]}\n" );
+
+  fputs ( gs->str, log_file );
+  fflush ( log_file );
+  g_string_free ( gs, TRUE );
+
+  if ( ftell ( log_file ) > log_size_max ) {
+    fclose ( log_file );
+    gchar *old = g_strconcat ( log_filename, ".1", NULL );
+    // Windows won't rename over an existing file
+    (void)g_remove ( old );
+    if ( g_rename ( log_filename, old ) )
+      g_warning ( "%s: Unable to rename %s", __FUNCTION__, log_filename );
+    g_free ( old );
+    log_file = g_fopen ( log_filename, "w" );
+    if ( !log_file )
+      g_warning ( "%s: Unable to open %s", __FUNCTION__, log_filename );
+  }
+}
+
+void a_drawstats_frame_end ()
+{
+  if ( !enabled || !frame_begin )
+    return;
+  frame_usecs = g_get_monotonic_time() - frame_begin;
+  frame_begin = 0;
+  g_atomic_int_set ( &in_frame, FALSE );
+
+  // Take what has been counted so far, without losing any counts being added at the same time
+  for ( guint ii = 0; ii < DRAWSTATS_NUM_COUNTS; ii++ ) {
+    gint count = g_atomic_int_get ( &counts[ii] );
+    g_atomic_int_add ( &counts[ii], -count );
+    frame_counts[ii] = count;
+  }
+
+  g_mutex_lock ( &layers_mutex );
+  GArray *tmp = frame_layers;
+  frame_layers = layers;
+  layers = tmp;
+  g_array_set_size ( layers, 0 );
+  g_mutex_unlock ( &layers_mutex );
+
+  if ( log_file )
+    log_frame ();
+}
+
+/**
+ * a_drawstats_get_summary:
+ *
+ * Returns: A short description of the last frame (e.g. for the statusbar), or NULL if not enabled
+ */
+gchar *a_drawstats_get_summary ()
+{
+  if ( !enabled )
+    return NULL;
+  return g_strdup_printf ( _("%.1f ms | %u tiles | %u points"),
+                           frame_usecs / 1000.0, frame_counts[DRAWSTATS_TILES_DRAWN], frame_counts[DRAWSTATS_TRACKPOINTS_DRAWN] );
+}
+
+/**
+ * a_drawstats_get_report:
+ *
+ * Returns: A multiline description of the last frame, or NULL if not enabled
+ */
+gchar *a_drawstats_get_report ()
+{
+  if ( !enabled )
+    return NULL;
+  GString *gs = g_string_new ( NULL );
+  g_string_append_printf ( gs, _("Frame: %.1f ms"), frame_usecs / 1000.0 );
+  g_string_append_c ( gs, '\n' );
+  g_string_append_printf ( gs, _("Tiles: %u drawn, %u decoded, %u missed"),
+                           frame_counts[DRAWSTATS_TILES_DRAWN], frame_counts[DRAWSTATS_TILES_DECODED], frame_counts[DRAWSTATS_TILES_MISSED] );
+  g_string_append_c ( gs, '\n' );
+  g_string_append_printf ( gs, _("Trackpoints: %u drawn of %u visited"),
+                           frame_counts[DRAWSTATS_TRACKPOINTS_DRAWN], frame_counts[DRAWSTATS_TRACKPOINTS_VISITED] );
+  for ( guint ii = 0; ii < frame_layers->len; ii++ ) {
+    LayerTime *lt = &g_array_index ( frame_layers, LayerTime, ii );
+    g_string_append_c ( gs, '\n' );
+    g_string_append_printf ( gs, _("%s: %.1f ms"), lt->name, lt->usecs / 1000.0 );
+  }
+  return g_string_free ( gs, FALSE );
+}
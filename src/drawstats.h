@@ -0,0 +1,59 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __VIKING_DRAWSTATS_H
+#define __VIKING_DRAWSTATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Measurements of how long drawing the viewport takes and how much work it involved,
+//  for each frame (i.e. each redraw of the whole viewport shown on screen).
+// Drawing outside of a frame (e.g. when saving the view to an image) is not counted.
+// Only collected when enabled via the 'draw_stats' setting.
+
+typedef enum {
+  DRAWSTATS_TILES_DRAWN,        // Including those filled in from a tile of another scale
+  DRAWSTATS_TILES_DECODED,      // Includes those decoded in the background since the previous frame
+  DRAWSTATS_TILES_MISSED,       // Nothing available to draw at any scale
+  DRAWSTATS_TRACKPOINTS_VISITED,
+  DRAWSTATS_TRACKPOINTS_DRAWN,
+  DRAWSTATS_NUM_COUNTS
+} drawstats_count_t;
+
+void a_drawstats_init ();
+void a_drawstats_uninit ();
+
+gboolean a_drawstats_enabled ();
+gboolean a_drawstats_show_overlay ();
+
+void a_drawstats_frame_start ();
+void a_drawstats_frame_end ();
+
+void a_drawstats_add ( drawstats_count_t type, guint count );
+gint64 a_drawstats_layer_start ();
+void a_drawstats_layer_end ( const gchar *name, gint64 start );
+
+gchar *a_drawstats_get_summary ();
+gchar *a_drawstats_get_report ();
+
+G_END_DECLS
+
+#endif
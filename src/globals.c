@@ -183,6 +183,8 @@ static VikLayerParam prefs_advanced[] = {
   { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_ADVANCED_NAMESPACE "select_newly_created_layer", VIK_LAYER_PARAM_BOOLEAN, VIK_LAYER_GROUP_NONE, N_("Select Newly Created Layer:"), VIK_LAYER_WIDGET_CHECKBUTTON, NULL, NULL, N_("Automatically select the newly created layer"), vik_lpd_true_default, NULL, NULL },
   { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_ADVANCED_NAMESPACE "viewport_popup_display_time", VIK_LAYER_PARAM_UINT, VIK_LAYER_GROUP_NONE, N_("Time(in ms) Popup is Shown on Viewport:"), VIK_LAYER_WIDGET_SPINBUTTON, params_disp_time, NULL,
     N_("Use a value of 0 to disable showing a popup"), disp_time_default, NULL, NULL },
+  { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_ADVANCED_NAMESPACE "draw_layers_in_parallel", VIK_LAYER_PARAM_BOOLEAN, VIK_LAYER_GROUP_NONE, N_("Draw Layers in Parallel:"), VIK_LAYER_WIDGET_CHECKBUTTON, NULL, NULL,
+    N_("Draw layers that support it in separate threads"), vik_lpd_false_default, NULL, NULL },
 };
 
 static gchar * params_startup_methods[] = {N_("Home Location"), N_("Last Location"), N_("Specified File"), N_("Auto Location"), NULL};
@@ -469,6 +471,11 @@ gboolean a_vik_get_auto_trackpoint_select ( )
   return a_preferences_get(VIKING_PREFERENCES_ADVANCED_NAMESPACE "auto_trackpoint_select")->b;
 }
 
+gboolean a_vik_get_draw_layers_in_parallel ( )
+{
+  return a_preferences_get(VIKING_PREFERENCES_ADVANCED_NAMESPACE "draw_layers_in_parallel")->b;
+}
+
 // Startup Options
 gboolean a_vik_get_restore_window_state ( )
 {
@@ -290,6 +290,8 @@ gboolean a_vik_get_select_double_click_to_zoom ( );
 
 gboolean a_vik_get_auto_trackpoint_select ( );
 
+gboolean a_vik_get_draw_layers_in_parallel ( );
+
 gboolean a_vik_get_restore_window_state ( );
 
 gboolean a_vik_get_add_default_map_layer ( );
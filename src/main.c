@@ -27,6 +27,12 @@
 #include "viking.h"
 #include "icons/icons.h"
 #include "mapcache.h"
+#include "mbtilescache.h"
+#include "metatilecache.h"
+#include "tileindex.h"
+#include "cachequota.h"
+#include "mapseed.h"
+#include "drawstats.h"
 #include "background.h"
 #include "dems.h"
 #include "babel.h"
@@ -224,6 +230,12 @@ int main( int argc, char *argv[] )
   maps_layer_init ();
   vik_dem_layer_init ();
   a_mapcache_init ();
+  a_mbtiles_cache_init ();
+  a_metatile_cache_init ();
+  a_tile_index_init ();
+  a_cache_quota_init ();
+  a_map_seed_init ();
+  a_drawstats_init ();
   a_background_init ();
 
   a_toolbar_init();
@@ -313,6 +325,12 @@ int main( int argc, char *argv[] )
   maps_layer_uninit ();
   vik_dem_layer_uninit ();
   a_mapcache_uninit ();
+  a_mbtiles_cache_uninit ();
+  a_metatile_cache_uninit ();
+  a_map_seed_uninit ();
+  a_drawstats_uninit ();
+  a_cache_quota_uninit ();
+  a_tile_index_uninit ();
   a_dems_uninit ();
   a_layer_defaults_uninit ();
   a_thumbnails_uninit ();
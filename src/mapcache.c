@@ -25,143 +25,383 @@
 #include <glib/gprintf.h>
 #include <glib/gi18n.h>
 #include <string.h>
+#include <math.h>
 #include "globals.h"
 #include "mapcache.h"
 #include "preferences.h"
 #include "vik_compat.h"
 
-#define MC_KEY_SIZE 64
+/*
+ * The cache is split into a number of shards, each with its own lock,
+ *  so that the drawing thread and the various download/render threads rarely contend.
+ * All variants of a tile (i.e. differing alpha and shrinkfactors) hash to the same shard,
+ *  so that removing all variants of a tile only needs a single shard.
+ *
+ * Each shard has two tiers:
+ *  . the decoded tier holding the ready to draw pixbufs
+ *  . the encoded tier holding the original (PNG/JPEG) file bytes of a tile,
+ *    so a tile evicted from the decoded tier can be decoded again without reading from disk.
+ *    Being much smaller this can hold many more tiles for the same amount of memory.
+ */
+#define MC_NUM_SHARDS 16
 
-typedef struct _List {
-  struct _List *next;
-  gchar *key;
-} List;
+/*
+ * Previously keys were formatted with "%.3f" for the shrinkfactors,
+ *  so retain the same resolution when converting these into integers
+ */
+#define MC_SHRINKFACTOR_RESOLUTION 1000.0
 
-/* a circular linked list, a pointer to the tail, and the tail points to the head */
-/* this is so we can free the last */
-static List *queue_tail = NULL;
-static int queue_count = 0;
+// Default memory for the encoded tier (in MB)
+#define MC_ENCODED_SIZE_DEFAULT 64
 
-static guint32 cache_size = 0;
-static guint32 max_cache_size = VIK_CONFIG_MAPCACHE_SIZE * 1024 * 1024;
+// Approximate overhead per cache entry (in addition to any pixbuf pixel data)
+#define MC_ITEM_OVERHEAD 100
 
-static GHashTable *cache = NULL;
+typedef mapcache_key_t mc_key_t;
 
-typedef struct {
-  GdkPixbuf *pixbuf;
+typedef struct _cache_item_t cache_item_t;
+
+struct _cache_item_t {
+  mc_key_t key;
+  GdkPixbuf *pixbuf; // Decoded tier only
+  GBytes *bytes;     // Encoded tier only
   mapcache_extra_t extra;
-} cache_item_t;
+  guint32 size;
+  // Intrusive doubly linked lists, so removal from any of them is O(1)
+  cache_item_t *lru_prev, *lru_next;   // Most recently used at the head
+  cache_item_t *tile_prev, *tile_next; // All alpha/shrinkfactor variants of the same tile
+  cache_item_t *type_prev, *type_next; // All items of the same map type
+};
 
-static GMutex *mc_mutex = NULL;
+typedef struct {
+  GHashTable *items; // mc_key_t* -> cache_item_t*
+  GHashTable *tiles; // mc_key_t* (alpha/shrinkfactors ignored) -> head cache_item_t* of the variants list
+  GHashTable *types; // type -> head cache_item_t* of the type list
+  cache_item_t *lru_head;
+  cache_item_t *lru_tail;
+  guint32 size;
+  gsize *total; // The size of this tier summed over all the shards
+  guint hits;
+  guint misses;
+} mc_tier_t;
 
-#define HASHKEY_FORMAT_STRING "%d-%d-%d-%d-%d-%d-%d-%.3f-%.3f"
-#define HASHKEY_FORMAT_STRING_NOSHRINK_NOR_ALPHA "%d-%d-%d-%d-%d-%d-"
-#define HASHKEY_FORMAT_STRING_TYPE "%d-"
+typedef struct {
+  GMutex *mutex;
+  mc_tier_t decoded;
+  mc_tier_t encoded;
+} mc_shard_t;
+
+static mc_shard_t shards[MC_NUM_SHARDS];
+
+// The limits apply to the whole cache, so the tier sizes are also totalled (atomically) across the shards
+static gsize decoded_total = 0;
+static gsize encoded_total = 0;
+
+// Next shard to remove an item from, when over the limit
+static gint evict_shard = 0;
+
+static guint32 max_cache_size = VIK_CONFIG_MAPCACHE_SIZE * 1024 * 1024;
+static guint32 max_encoded_cache_size = MC_ENCODED_SIZE_DEFAULT * 1024 * 1024;
 
 static VikLayerParamScale params_scales[] = {
   /* min, max, step, digits (decimal places) */
  { 1, 4096, 4, 0 },
+ { 0, 1024, 4, 0 },
 };
 
 static VikLayerParamData mcs_default ( void ) { return VIK_LPD_UINT(VIK_CONFIG_MAPCACHE_SIZE); }
+static VikLayerParamData mces_default ( void ) { return VIK_LPD_UINT(MC_ENCODED_SIZE_DEFAULT); }
 
 static VikLayerParam prefs[] = {
   { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_NAMESPACE "mapcache_size", VIK_LAYER_PARAM_UINT, VIK_LAYER_GROUP_NONE, N_("Map cache memory size (MB):"), VIK_LAYER_WIDGET_HSCALE, params_scales, NULL, NULL, mcs_default, NULL, NULL },
+  { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_NAMESPACE "mapcache_encoded_size", VIK_LAYER_PARAM_UINT, VIK_LAYER_GROUP_NONE, N_("Map cache compressed tiles memory size (MB):"), VIK_LAYER_WIDGET_HSCALE, &params_scales[1], NULL,
+    N_("Memory for keeping tiles in their original file format, so they can be redrawn without reading from disk again. Set to 0 to disable."), mces_default, NULL, NULL },
 };
 
-static void cache_item_free (cache_item_t *ci)
+/**
+ * Hash of the tile position - i.e. not including the alpha nor shrinkfactors
+ *  thus all variants of a tile share the same shard
+ */
+static guint mc_tile_hash ( gconstpointer ptr )
 {
-  if ( ci->pixbuf )
-    g_object_unref ( ci->pixbuf );
-  g_free ( ci );
+  const mc_key_t *key = ptr;
+  guint hash = key->type;
+  hash = hash * 31 + key->x;
+  hash = hash * 31 + key->y;
+  hash = hash * 31 + key->z;
+  hash = hash * 31 + key->zoom;
+  hash = hash * 31 + key->name_hash;
+  return hash;
 }
 
-void a_mapcache_init ()
+static gboolean mc_tile_equal ( gconstpointer aa, gconstpointer bb )
 {
-  a_preferences_register ( prefs, (VikLayerParamData){0}, VIKING_PREFERENCES_GROUP_KEY );
+  const mc_key_t *ka = aa;
+  const mc_key_t *kb = bb;
+  return ka->x == kb->x && ka->y == kb->y && ka->z == kb->z && ka->zoom == kb->zoom &&
+         ka->type == kb->type && ka->name_hash == kb->name_hash;
+}
 
-  mc_mutex = vik_mutex_new ();
-  cache = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, (GDestroyNotify) cache_item_free );
+static guint mc_key_hash ( gconstpointer ptr )
+{
+  const mc_key_t *key = ptr;
+  guint hash = mc_tile_hash ( key );
+  hash = hash * 31 + key->alpha;
+  hash = hash * 31 + key->xshrink;
+  hash = hash * 31 + key->yshrink;
+  return hash;
 }
 
-// Returns whether added or not (i.e. if key already exists - as per g_hash_table_insert() )
-static gboolean cache_add(gchar *key, GdkPixbuf *pixbuf, mapcache_extra_t extra)
+static gboolean mc_key_equal ( gconstpointer aa, gconstpointer bb )
 {
-  cache_item_t *ci = g_malloc ( sizeof(cache_item_t) );
-  ci->pixbuf = pixbuf;
-  ci->extra = extra;
-  gboolean added = g_hash_table_insert ( cache, key, ci );
-  if ( added )
-  {
-    // ATM size of 'extra' data hardly worth trying to count (compared to pixbuf sizes)
-    if ( pixbuf ) {
-      cache_size += gdk_pixbuf_get_rowstride(pixbuf) * gdk_pixbuf_get_height(pixbuf);
-      // Not sure what this 100 represents anyway - probably a guess at an average pixbuf metadata size
-      cache_size += 100;
-    }
+  const mc_key_t *ka = aa;
+  const mc_key_t *kb = bb;
+  return mc_tile_equal ( ka, kb ) &&
+         ka->alpha == kb->alpha && ka->xshrink == kb->xshrink && ka->yshrink == kb->yshrink;
+}
+
+static void mc_key_init ( mc_key_t *key, gint x, gint y, gint z, guint16 type, gint zoom, guint8 alpha, gdouble xshrinkfactor, gdouble yshrinkfactor, const gchar *name )
+{
+  key->x = x;
+  key->y = y;
+  key->z = z;
+  key->zoom = zoom;
+  key->name_hash = name ? g_str_hash ( name ) : 0;
+  key->type = type;
+  key->alpha = alpha;
+  key->xshrink = (gint)round ( xshrinkfactor * MC_SHRINKFACTOR_RESOLUTION );
+  key->yshrink = (gint)round ( yshrinkfactor * MC_SHRINKFACTOR_RESOLUTION );
+}
+
+/**
+ * a_mapcache_key_init:
+ *
+ * Set up a key identifying a tile as the mapcache does,
+ *  for others tracking tiles (e.g. those being read in the background) to use with
+ *  a_mapcache_key_hash() and a_mapcache_key_equal()
+ */
+void a_mapcache_key_init ( mapcache_key_t *key, gint x, gint y, gint z, guint16 type, gint zoom, guint8 alpha, gdouble xshrinkfactor, gdouble yshrinkfactor, const gchar *name )
+{
+  mc_key_init ( key, x, y, z, type, zoom, alpha, xshrinkfactor, yshrinkfactor, name );
+}
+
+guint a_mapcache_key_hash ( gconstpointer key )
+{
+  return mc_key_hash ( key );
+}
+
+gboolean a_mapcache_key_equal ( gconstpointer aa, gconstpointer bb )
+{
+  return mc_key_equal ( aa, bb );
+}
+
+static inline mc_shard_t *mc_shard_for_key ( const mc_key_t *key )
+{
+  return &shards[mc_tile_hash(key) % MC_NUM_SHARDS];
+}
+
+static guint32 pixbuf_size ( GdkPixbuf *pixbuf )
+{
+  if ( pixbuf )
+    return gdk_pixbuf_get_rowstride(pixbuf) * gdk_pixbuf_get_height(pixbuf);
+  return 0;
+}
+
+static void tier_init ( mc_tier_t *tier, gsize *total )
+{
+  // Keys point into the items themselves, so no key destroy functions
+  tier->items = g_hash_table_new ( mc_key_hash, mc_key_equal );
+  tier->tiles = g_hash_table_new ( mc_tile_hash, mc_tile_equal );
+  tier->types = g_hash_table_new ( g_direct_hash, g_direct_equal );
+  tier->lru_head = NULL;
+  tier->lru_tail = NULL;
+  tier->size = 0;
+  tier->total = total;
+  tier->hits = 0;
+  tier->misses = 0;
+}
+
+void a_mapcache_init ()
+{
+  a_preferences_register ( &prefs[0], (VikLayerParamData){0}, VIKING_PREFERENCES_GROUP_KEY );
+  a_preferences_register ( &prefs[1], (VikLayerParamData){0}, VIKING_PREFERENCES_GROUP_KEY );
+
+  for ( guint nn = 0; nn < MC_NUM_SHARDS; nn++ ) {
+    shards[nn].mutex = vik_mutex_new ();
+    tier_init ( &shards[nn].decoded, &decoded_total );
+    tier_init ( &shards[nn].encoded, &encoded_total );
   }
-  return added;
 }
 
-static void cache_remove(const gchar *key)
+/*
+ * NB All the tier functions below must be called with the owning shard mutex held
+ */
+
+static void lru_unlink ( mc_tier_t *tier, cache_item_t *ci )
+{
+  if ( ci->lru_prev )
+    ci->lru_prev->lru_next = ci->lru_next;
+  else
+    tier->lru_head = ci->lru_next;
+  if ( ci->lru_next )
+    ci->lru_next->lru_prev = ci->lru_prev;
+  else
+    tier->lru_tail = ci->lru_prev;
+  ci->lru_prev = ci->lru_next = NULL;
+}
+
+static void lru_push_head ( mc_tier_t *tier, cache_item_t *ci )
 {
-  cache_item_t *ci = g_hash_table_lookup ( cache, key );
-  if (ci && ci->pixbuf) {
-    cache_size -= gdk_pixbuf_get_rowstride(ci->pixbuf) * gdk_pixbuf_get_height(ci->pixbuf);
-    cache_size -= 100;
-    g_hash_table_remove ( cache, key );
+  ci->lru_prev = NULL;
+  ci->lru_next = tier->lru_head;
+  if ( tier->lru_head )
+    tier->lru_head->lru_prev = ci;
+  tier->lru_head = ci;
+  if ( !tier->lru_tail )
+    tier->lru_tail = ci;
+}
+
+static void lru_touch ( mc_tier_t *tier, cache_item_t *ci )
+{
+  if ( tier->lru_head != ci ) {
+    lru_unlink ( tier, ci );
+    lru_push_head ( tier, ci );
   }
 }
 
-#ifdef MAPCACHE_DEBUG
-static void print_queue()
-{
-  List *loop = queue_tail;
-  guint count = 0;
-  while ( loop ) {
-    g_printf ( "%s: [%d]=%s\n", __FUNCTION__, count, loop->key );
-    loop = loop->next;
-    count++;
-    if ( loop == queue_tail )
-      loop = NULL;
+static void tier_insert ( mc_tier_t *tier, cache_item_t *ci )
+{
+  g_hash_table_insert ( tier->items, &ci->key, ci );
+
+  // Add to the front of the variants list for this tile
+  cache_item_t *tile_head = g_hash_table_lookup ( tier->tiles, &ci->key );
+  ci->tile_prev = NULL;
+  ci->tile_next = tile_head;
+  if ( tile_head )
+    tile_head->tile_prev = ci;
+  // Replace the key as well, since the key memory belongs to the head item
+  g_hash_table_replace ( tier->tiles, &ci->key, ci );
+
+  // Add to the front of the list for this map type
+  cache_item_t *type_head = g_hash_table_lookup ( tier->types, GUINT_TO_POINTER((guint)ci->key.type) );
+  ci->type_prev = NULL;
+  ci->type_next = type_head;
+  if ( type_head )
+    type_head->type_prev = ci;
+  g_hash_table_insert ( tier->types, GUINT_TO_POINTER((guint)ci->key.type), ci );
+
+  lru_push_head ( tier, ci );
+  tier->size += ci->size;
+  (void)g_atomic_pointer_add ( tier->total, ci->size );
+}
+
+static void tier_remove ( mc_tier_t *tier, cache_item_t *ci )
+{
+  g_hash_table_remove ( tier->items, &ci->key );
+
+  if ( ci->tile_prev )
+    ci->tile_prev->tile_next = ci->tile_next;
+  else {
+    // Was the head
+    g_hash_table_remove ( tier->tiles, &ci->key );
+    if ( ci->tile_next )
+      g_hash_table_insert ( tier->tiles, &ci->tile_next->key, ci->tile_next );
   }
+  if ( ci->tile_next )
+    ci->tile_next->tile_prev = ci->tile_prev;
+
+  if ( ci->type_prev )
+    ci->type_prev->type_next = ci->type_next;
+  else {
+    if ( ci->type_next )
+      g_hash_table_insert ( tier->types, GUINT_TO_POINTER((guint)ci->key.type), ci->type_next );
+    else
+      g_hash_table_remove ( tier->types, GUINT_TO_POINTER((guint)ci->key.type) );
+  }
+  if ( ci->type_next )
+    ci->type_next->type_prev = ci->type_prev;
+
+  lru_unlink ( tier, ci );
+  tier->size -= ci->size;
+  (void)g_atomic_pointer_add ( tier->total, -(gssize)ci->size );
+
+  if ( ci->pixbuf )
+    g_object_unref ( ci->pixbuf );
+  if ( ci->bytes )
+    g_bytes_unref ( ci->bytes );
+  g_free ( ci );
 }
-#endif
 
-/* returns key from head, adds on newtailkey to tail. */
-static gchar *list_shift_add_entry ( gchar *newtailkey )
+static void tier_resize ( mc_tier_t *tier, cache_item_t *ci, guint32 size )
 {
-  gchar *oldheadkey = queue_tail->next->key;
-  queue_tail->next->key = newtailkey;
-  queue_tail = queue_tail->next;
-  return oldheadkey;
+  tier->size = tier->size - ci->size + size;
+  (void)g_atomic_pointer_add ( tier->total, (gssize)size - (gssize)ci->size );
+  ci->size = size;
 }
 
-static gchar *list_shift ()
+static void tier_remove_tile ( mc_tier_t *tier, const mc_key_t *key )
 {
-  gchar *oldheadkey = queue_tail->next->key;
-  List *oldhead = queue_tail->next;
-  queue_tail->next = queue_tail->next->next;
-  g_free ( oldhead );
-  queue_count--;
-  return oldheadkey;
+  cache_item_t *ci;
+  while ( (ci = g_hash_table_lookup(tier->tiles, key)) )
+    tier_remove ( tier, ci );
 }
 
-/* adds key to tail */
-static void list_add_entry ( gchar *key )
+static void tier_remove_type ( mc_tier_t *tier, guint16 type )
 {
-  List *newlist = g_malloc ( sizeof ( List ) );
-  newlist->key = key;
-  if ( queue_tail ) {
-    newlist->next = queue_tail->next;
-    queue_tail->next = newlist;
-  } else {
-    newlist->next = newlist;
+  cache_item_t *ci;
+  while ( (ci = g_hash_table_lookup(tier->types, GUINT_TO_POINTER((guint)type))) )
+    tier_remove ( tier, ci );
+}
+
+static void tier_flush ( mc_tier_t *tier )
+{
+  while ( tier->lru_head )
+    tier_remove ( tier, tier->lru_head );
+}
+
+static void tier_uninit ( mc_tier_t *tier )
+{
+  tier_flush ( tier );
+  g_hash_table_destroy ( tier->items );
+  g_hash_table_destroy ( tier->tiles );
+  g_hash_table_destroy ( tier->types );
+  tier->items = tier->tiles = tier->types = NULL;
+}
+
+/**
+ * Keep the size of a tier across all the shards within the limit,
+ *  by removing the least recently used item of each shard in turn.
+ * NB Must be called without any shard mutex held
+ */
+static void mc_evict ( gboolean encoded, guint32 max_size )
+{
+  gsize *total = encoded ? &encoded_total : &decoded_total;
+  guint idle = 0;
+  while ( idle < MC_NUM_SHARDS && GPOINTER_TO_SIZE(g_atomic_pointer_get(total)) > max_size ) {
+    mc_shard_t *shard = &shards[(guint)g_atomic_int_add(&evict_shard, 1) % MC_NUM_SHARDS];
+    g_mutex_lock ( shard->mutex );
+    mc_tier_t *tier = encoded ? &shard->encoded : &shard->decoded;
+    // Make sure there's more than one thing to delete, so a single oversized item is still cached
+    if ( tier->lru_tail && tier->lru_tail != tier->lru_head ) {
+      tier_remove ( tier, tier->lru_tail );
+      idle = 0;
+    }
+    else
+      idle++;
+    g_mutex_unlock ( shard->mutex );
   }
-  queue_tail = newlist;
-  queue_count++;
 }
 
+#ifdef MAPCACHE_DEBUG
+static void print_shards()
+{
+  for ( guint nn = 0; nn < MC_NUM_SHARDS; nn++ )
+    g_printf ( "%s: [%d] count=%d size=%u encoded count=%d size=%u\n", __FUNCTION__, nn,
+               g_hash_table_size(shards[nn].decoded.items), shards[nn].decoded.size,
+               g_hash_table_size(shards[nn].encoded.items), shards[nn].encoded.size );
+}
+#endif
+
 /**
  * Function increments reference counter of pixbuf.
  * Caller may (and should) decrease it's reference.
@@ -178,44 +418,42 @@ void a_mapcache_add ( GdkPixbuf *pixbuf, mapcache_extra_t extra, gint x, gint y,
     }
   }
 
-  guint nn = name ? g_str_hash ( name ) : 0;
-  gchar *key = g_strdup_printf ( HASHKEY_FORMAT_STRING, type, x, y, z, zoom, nn, alpha, xshrinkfactor, yshrinkfactor );
+  mc_key_t key;
+  mc_key_init ( &key, x, y, z, type, zoom, alpha, xshrinkfactor, yshrinkfactor, name );
+  mc_shard_t *shard = mc_shard_for_key ( &key );
 
-  g_mutex_lock(mc_mutex);
+  max_cache_size = a_preferences_get(VIKING_PREFERENCES_NAMESPACE "mapcache_size")->u * 1024 * 1024;
 
   if ( pixbuf )
-    g_object_ref(pixbuf);
-  gboolean added = cache_add(key, pixbuf, extra);
-
-  // Do not add already existing keys into list
-  //  and more importantly in this circumstance 'key' should not be reused
-  //  (since it has been freed by g_hash_table_insert() defined destructors) and so no longer valid
-  if ( added ) {
-
-    // TODO: that should be done on preference change only...
-    max_cache_size = a_preferences_get(VIKING_PREFERENCES_NAMESPACE "mapcache_size")->u * 1024 * 1024;
-
-    if ( cache_size > max_cache_size ) {
-      if ( queue_tail ) {
-        gchar *oldkey = list_shift_add_entry ( key );
-        cache_remove(oldkey);
-
-        while ( cache_size > max_cache_size &&
-                (queue_tail->next != queue_tail) ) { // make sure there's more than one thing to delete
-          oldkey = list_shift ();
-          cache_remove(oldkey);
-        }
-      }
-      // chop off 'start' etc
-    } else {
-      list_add_entry ( key );
-      // business as usual
-    }
+    g_object_ref ( pixbuf );
+
+  g_mutex_lock ( shard->mutex );
+
+  cache_item_t *ci = g_hash_table_lookup ( shard->decoded.items, &key );
+  if ( ci ) {
+    // Update existing entry in place
+    if ( ci->pixbuf )
+      g_object_unref ( ci->pixbuf );
+    ci->pixbuf = pixbuf;
+    ci->extra = extra;
+    tier_resize ( &shard->decoded, ci, pixbuf_size ( pixbuf ) + MC_ITEM_OVERHEAD );
+    lru_touch ( &shard->decoded, ci );
+  }
+  else {
+    ci = g_malloc0 ( sizeof(cache_item_t) );
+    ci->key = key;
+    ci->pixbuf = pixbuf;
+    ci->extra = extra;
+    ci->size = pixbuf_size ( pixbuf ) + MC_ITEM_OVERHEAD;
+    tier_insert ( &shard->decoded, ci );
   }
-  g_mutex_unlock(mc_mutex);
+
+  g_mutex_unlock ( shard->mutex );
+
+  mc_evict ( FALSE, max_cache_size );
 
   static int tmp = 0;
-  if ( (++tmp == 100 )) { g_debug("DEBUG: cache count=%d size=%u list count=%d", g_hash_table_size(cache), cache_size, queue_count ); tmp=0; }
+  if ( (++tmp == 100 )) { g_debug("DEBUG: cache count=%d size=%u", a_mapcache_get_count(), a_mapcache_get_size() ); tmp=0; }
 }
 
 /**
@@ -225,82 +463,115 @@ void a_mapcache_add ( GdkPixbuf *pixbuf, mapcache_extra_t extra, gint x, gint y,
  */
 GdkPixbuf *a_mapcache_get ( gint x, gint y, gint z, guint16 type, gint zoom, guint8 alpha, gdouble xshrinkfactor, gdouble yshrinkfactor, const gchar* name )
 {
-  static char key[MC_KEY_SIZE];
-  guint nn = name ? g_str_hash ( name ) : 0;
-  g_snprintf ( key, sizeof(key), HASHKEY_FORMAT_STRING, type, x, y, z, zoom, nn, alpha, xshrinkfactor, yshrinkfactor );
-  g_mutex_lock(mc_mutex); /* prevent returning pixbuf when cache is being cleared */
-  cache_item_t *ci = g_hash_table_lookup ( cache, key );
+  GdkPixbuf *pixbuf = NULL;
+  mc_key_t key;
+  mc_key_init ( &key, x, y, z, type, zoom, alpha, xshrinkfactor, yshrinkfactor, name );
+  mc_shard_t *shard = mc_shard_for_key ( &key );
+
+  g_mutex_lock ( shard->mutex ); /* prevent returning pixbuf when cache is being cleared */
+  cache_item_t *ci = g_hash_table_lookup ( shard->decoded.items, &key );
   if ( ci ) {
+    lru_touch ( &shard->decoded, ci );
     if ( ci->pixbuf )
-      g_object_ref(ci->pixbuf);
-    g_mutex_unlock(mc_mutex);
-    return ci->pixbuf;
-  } else {
-    g_mutex_unlock(mc_mutex);
-    return NULL;
+      pixbuf = g_object_ref ( ci->pixbuf );
   }
+  if ( pixbuf )
+    shard->decoded.hits++;
+  else
+    shard->decoded.misses++;
+  g_mutex_unlock ( shard->mutex );
+  return pixbuf;
 }
 
 mapcache_extra_t a_mapcache_get_extra ( gint x, gint y, gint z, guint16 type, gint zoom, guint8 alpha, gdouble xshrinkfactor, gdouble yshrinkfactor, const gchar* name )
 {
-  static char key[MC_KEY_SIZE];
-  guint nn = name ? g_str_hash ( name ) : 0;
-  g_snprintf ( key, sizeof(key), HASHKEY_FORMAT_STRING, type, x, y, z, zoom, nn, alpha, xshrinkfactor, yshrinkfactor );
-  cache_item_t *ci = g_hash_table_lookup ( cache, key );
+  mapcache_extra_t extra = { 0.0, MAPCACHE_STATUS_NOT_IN_CACHE };
+  mc_key_t key;
+  mc_key_init ( &key, x, y, z, type, zoom, alpha, xshrinkfactor, yshrinkfactor, name );
+  mc_shard_t *shard = mc_shard_for_key ( &key );
+
+  g_mutex_lock ( shard->mutex );
+  cache_item_t *ci = g_hash_table_lookup ( shard->decoded.items, &key );
   if ( ci )
-    return ci->extra;
-  else
-    return (mapcache_extra_t) { 0.0, MAPCACHE_STATUS_NOT_IN_CACHE };
+    extra = ci->extra;
+  g_mutex_unlock ( shard->mutex );
+  return extra;
 }
 
 /**
- * Common function to remove cache items for keys starting with the specified string
+ * a_mapcache_add_encoded:
+ * @bytes: The tile image in its original file format (e.g. PNG or JPEG)
+ * @extra: Status information to be returned alongside the bytes
+ *
+ * Keep the encoded tile image data, so that it can be quickly decoded again
+ *  should the decoded pixbuf get evicted from the cache.
+ * The reference count of the bytes is incremented.
  */
-static void flush_matching ( gchar *str )
+void a_mapcache_add_encoded ( GBytes *bytes, mapcache_extra_t extra, gint x, gint y, gint z, guint16 type, gint zoom, const gchar *name )
 {
-  g_mutex_lock(mc_mutex);
+  g_return_if_fail ( bytes != NULL );
 
-  if ( queue_tail == NULL ) {
-    g_mutex_unlock(mc_mutex);
+  max_encoded_cache_size = a_preferences_get(VIKING_PREFERENCES_NAMESPACE "mapcache_encoded_size")->u * 1024 * 1024;
+  if ( !max_encoded_cache_size )
     return;
+
+  mc_key_t key;
+  mc_key_init ( &key, x, y, z, type, zoom, 0, 0.0, 0.0, name );
+  mc_shard_t *shard = mc_shard_for_key ( &key );
+
+  g_bytes_ref ( bytes );
+
+  g_mutex_lock ( shard->mutex );
+
+  cache_item_t *ci = g_hash_table_lookup ( shard->encoded.items, &key );
+  if ( ci ) {
+    g_bytes_unref ( ci->bytes );
+    ci->bytes = bytes;
+    ci->extra = extra;
+    tier_resize ( &shard->encoded, ci, g_bytes_get_size ( bytes ) + MC_ITEM_OVERHEAD );
+    lru_touch ( &shard->encoded, ci );
+  }
+  else {
+    ci = g_malloc0 ( sizeof(cache_item_t) );
+    ci->key = key;
+    ci->bytes = bytes;
+    ci->extra = extra;
+    ci->size = g_bytes_get_size ( bytes ) + MC_ITEM_OVERHEAD;
+    tier_insert ( &shard->encoded, ci );
   }
 
-#ifdef MAPCACHE_DEBUG
-  print_queue();
-#endif
+  g_mutex_unlock ( shard->mutex );
 
-  // The 'loop' variable must be assigned within the mutex lock section,
-  //  otherwise where it points to might not be valid anymore when the actual processing occurs
-  List *loop = queue_tail;
-  List *tmp;
-  size_t len = strlen(str);
-
-  do {
-    tmp = loop->next;
-    if ( tmp ) {
-    if ( strncmp(tmp->key, str, len) == 0 )
-    {
-      cache_remove(tmp->key);
-      if ( tmp == loop ) /* we deleted the last thing in the queue! */
-        loop = queue_tail = NULL;
-      else {
-        loop->next = tmp->next;
-        if ( tmp == queue_tail )
-          queue_tail = tmp->next;
-      }
-      g_free ( tmp );
-      tmp = NULL;
-      queue_count--;
-    }
-    else
-      loop = tmp;
-    } else
-      loop = NULL;
-  } while ( loop && (loop != queue_tail || tmp == NULL) );
-  /* loop thru list, looking for the one, compare first whatever chars */
+  mc_evict ( TRUE, max_encoded_cache_size );
+}
 
-  cache_remove(str);
-  g_mutex_unlock(mc_mutex);
+/**
+ * a_mapcache_get_encoded:
+ * @extra: Optional return of the status information stored with the tile
+ *
+ * Returns: The encoded image data of the tile or NULL if not in the cache.
+ *  Caller must g_bytes_unref() the returned value.
+ */
+GBytes *a_mapcache_get_encoded ( gint x, gint y, gint z, guint16 type, gint zoom, const gchar *name, mapcache_extra_t *extra )
+{
+  GBytes *bytes = NULL;
+  mc_key_t key;
+  mc_key_init ( &key, x, y, z, type, zoom, 0, 0.0, 0.0, name );
+  mc_shard_t *shard = mc_shard_for_key ( &key );
+
+  g_mutex_lock ( shard->mutex );
+  cache_item_t *ci = g_hash_table_lookup ( shard->encoded.items, &key );
+  if ( ci ) {
+    lru_touch ( &shard->encoded, ci );
+    bytes = g_bytes_ref ( ci->bytes );
+    if ( extra )
+      *extra = ci->extra;
+    shard->encoded.hits++;
+  }
+  else
+    shard->encoded.misses++;
+  g_mutex_unlock ( shard->mutex );
+  return bytes;
 }
 
 /**
@@ -308,32 +579,24 @@ static void flush_matching ( gchar *str )
  */
 void a_mapcache_remove_all_shrinkfactors ( gint x, gint y, gint z, guint16 type, gint zoom, const gchar* name )
 {
-  char key[MC_KEY_SIZE];
-  guint nn = name ? g_str_hash ( name ) : 0;
-  g_snprintf ( key, sizeof(key), HASHKEY_FORMAT_STRING_NOSHRINK_NOR_ALPHA, type, x, y, z, zoom, nn );
-  flush_matching ( key );
+  mc_key_t key;
+  mc_key_init ( &key, x, y, z, type, zoom, 0, 0.0, 0.0, name );
+  mc_shard_t *shard = mc_shard_for_key ( &key );
+
+  g_mutex_lock ( shard->mutex );
+  tier_remove_tile ( &shard->decoded, &key );
+  tier_remove_tile ( &shard->encoded, &key );
+  g_mutex_unlock ( shard->mutex );
 }
 
 void a_mapcache_flush ()
 {
-  // Everything happens within the mutex lock section
-  g_mutex_lock(mc_mutex);
-
-  List *loop = queue_tail;
-  List *tmp;
-
-  while ( loop ) {
-    tmp = loop->next;
-    cache_remove(tmp->key);
-    if ( tmp == queue_tail ) /* we deleted the last thing in the queue */
-      loop = queue_tail = NULL;
-    else
-      loop->next = tmp->next;
-    g_free ( tmp );
-    tmp = NULL;
+  for ( guint nn = 0; nn < MC_NUM_SHARDS; nn++ ) {
+    g_mutex_lock ( shards[nn].mutex );
+    tier_flush ( &shards[nn].decoded );
+    tier_flush ( &shards[nn].encoded );
+    g_mutex_unlock ( shards[nn].mutex );
   }
-
-  g_mutex_unlock(mc_mutex);
 }
 
 /**
@@ -345,27 +608,101 @@ void a_mapcache_flush ()
  */
 void a_mapcache_flush_type ( guint16 type )
 {
-  char key[MC_KEY_SIZE];
-  g_snprintf ( key, sizeof(key), HASHKEY_FORMAT_STRING_TYPE, type );
-  flush_matching ( key );
+#ifdef MAPCACHE_DEBUG
+  print_shards();
+#endif
+  for ( guint nn = 0; nn < MC_NUM_SHARDS; nn++ ) {
+    g_mutex_lock ( shards[nn].mutex );
+    tier_remove_type ( &shards[nn].decoded, type );
+    tier_remove_type ( &shards[nn].encoded, type );
+    g_mutex_unlock ( shards[nn].mutex );
+  }
 }
 
 void a_mapcache_uninit ()
 {
-  g_hash_table_destroy ( cache );
-  /* free list */
-  cache = NULL;
-  vik_mutex_free (mc_mutex);
+  for ( guint nn = 0; nn < MC_NUM_SHARDS; nn++ ) {
+    tier_uninit ( &shards[nn].decoded );
+    tier_uninit ( &shards[nn].encoded );
+    vik_mutex_free ( shards[nn].mutex );
+    shards[nn].mutex = NULL;
+  }
+}
+
+typedef enum {
+  MC_STAT_COUNT,
+  MC_STAT_HITS,
+  MC_STAT_MISSES,
+} mc_stat_t;
+
+/**
+ * Sum a statistic of a tier over all the shards, reading each one under its lock
+ */
+static guint mc_stat ( gboolean encoded, mc_stat_t stat )
+{
+  guint value = 0;
+  for ( guint nn = 0; nn < MC_NUM_SHARDS; nn++ ) {
+    g_mutex_lock ( shards[nn].mutex );
+    mc_tier_t *tier = encoded ? &shards[nn].encoded : &shards[nn].decoded;
+    switch ( stat ) {
+    case MC_STAT_COUNT:  value += g_hash_table_size ( tier->items ); break;
+    case MC_STAT_HITS:   value += tier->hits; break;
+    case MC_STAT_MISSES: value += tier->misses; break;
+    default: break;
+    }
+    g_mutex_unlock ( shards[nn].mutex );
+  }
+  return value;
 }
 
 // Size of mapcache in memory
 guint a_mapcache_get_size ()
 {
-  return cache_size;
+  return GPOINTER_TO_SIZE(g_atomic_pointer_get(&decoded_total));
+}
+
+// Maximum size of the mapcache in memory
+guint a_mapcache_get_max_size ()
+{
+  return max_cache_size;
 }
 
 // Count of items in the mapcache
 guint a_mapcache_get_count ()
 {
-  return g_hash_table_size ( cache );
+  return mc_stat ( FALSE, MC_STAT_COUNT );
+}
+
+// Number of lookups that found a pixbuf
+guint a_mapcache_get_hits ()
+{
+  return mc_stat ( FALSE, MC_STAT_HITS );
+}
+
+// Number of lookups that did not find a pixbuf
+guint a_mapcache_get_misses ()
+{
+  return mc_stat ( FALSE, MC_STAT_MISSES );
+}
+
+// Size of the encoded tier in memory
+guint a_mapcache_get_encoded_size ()
+{
+  return GPOINTER_TO_SIZE(g_atomic_pointer_get(&encoded_total));
+}
+
+// Count of items in the encoded tier
+guint a_mapcache_get_encoded_count ()
+{
+  return mc_stat ( TRUE, MC_STAT_COUNT );
+}
+
+guint a_mapcache_get_encoded_hits ()
+{
+  return mc_stat ( TRUE, MC_STAT_HITS );
+}
+
+guint a_mapcache_get_encoded_misses ()
+{
+  return mc_stat ( TRUE, MC_STAT_MISSES );
 }
@@ -30,23 +30,53 @@ G_BEGIN_DECLS
 // Extended 'DownloadResult_t' values (see download.h)
 #define MAPCACHE_STATUS_NOT_IN_CACHE 16
 #define MAPCACHE_STATUS_FILE_EXPIRED 8
+#define MAPCACHE_STATUS_OVERVIEW 32 // Generated from tiles at other zoom levels
 
 typedef struct {
   gdouble duration; // Mostly for Mapnik Rendering duration - negative values indicate not rendered (i.e. read from disk)
   gint status;      // Tile download status - either a DownloadResult_t value or MAPCACHE_STATUS_*
 } mapcache_extra_t;
 
+/*
+ * Identifies a tile in the mapcache, with the shrinkfactors held in units of 1/1000
+ */
+typedef struct {
+  gint x;
+  gint y;
+  gint z;
+  gint zoom;
+  guint name_hash;
+  guint16 type;
+  guint8 alpha;
+  gint xshrink;
+  gint yshrink;
+} mapcache_key_t;
+
+void a_mapcache_key_init ( mapcache_key_t *key, gint x, gint y, gint z, guint16 type, gint zoom, guint8 alpha, gdouble xshrinkfactor, gdouble yshrinkfactor, const gchar *name );
+guint a_mapcache_key_hash ( gconstpointer key );
+gboolean a_mapcache_key_equal ( gconstpointer aa, gconstpointer bb );
+
 void a_mapcache_init ();
 void a_mapcache_add ( GdkPixbuf *pixbuf, mapcache_extra_t extra, gint x, gint y, gint z, guint16 type, gint zoom, guint8 alpha, gdouble xshrinkfactor, gdouble yshrinkfactor, const gchar *name );
 GdkPixbuf *a_mapcache_get ( gint x, gint y, gint z, guint16 type, gint zoom, guint8 alpha, gdouble xshrinkfactor, gdouble yshrinkfactor, const gchar *name );
 mapcache_extra_t a_mapcache_get_extra ( gint x, gint y, gint z, guint16 type, gint zoom, guint8 alpha, gdouble xshrinkfactor, gdouble yshrinkfactor, const gchar* name );
+void a_mapcache_add_encoded ( GBytes *bytes, mapcache_extra_t extra, gint x, gint y, gint z, guint16 type, gint zoom, const gchar *name );
+GBytes *a_mapcache_get_encoded ( gint x, gint y, gint z, guint16 type, gint zoom, const gchar *name, mapcache_extra_t *extra );
 void a_mapcache_remove_all_shrinkfactors ( gint x, gint y, gint z, guint16 type, gint zoom, const gchar* name );
 void a_mapcache_flush ();
 void a_mapcache_flush_type ( guint16 type );
 void a_mapcache_uninit ();
 
 guint a_mapcache_get_size ();
+guint a_mapcache_get_max_size ();
 guint a_mapcache_get_count ();
+guint a_mapcache_get_hits ();
+guint a_mapcache_get_misses ();
+
+guint a_mapcache_get_encoded_size ();
+guint a_mapcache_get_encoded_count ();
+guint a_mapcache_get_encoded_hits ();
+guint a_mapcache_get_encoded_misses ();
 
 G_END_DECLS
 
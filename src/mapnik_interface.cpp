@@ -89,6 +89,9 @@ struct _MapnikInterface {
 	GObject obj;
 	mapnik::Map *myMap;
 	gchar *copyright; // Cached Mapnik parameter to save looking it up each time
+	guint id;         // Identifies the thread copies of this map
+	guint generation; // Incremented on every (re)load, so thread copies are refreshed
+	GMutex mutex;     // Protects myMap whilst it is being loaded or copied
 };
 
 G_DEFINE_TYPE (MapnikInterface, mapnik_interface, G_TYPE_OBJECT)
@@ -100,19 +103,112 @@ static mapnik::projection prj( mapnik::MAPNIK_GMERC_PROJ );
 static mapnik::projection prj( mapnik::MAPNIK_WEBMERCATOR_PROJ );
 #endif
 
+/*
+ * Thread copies
+ *
+ * Rendering modifies the map (the area and size), so each rendering thread
+ *  uses its own copy of the main map object, which is kept between renders
+ *  rather than copying the whole map (and so all its styles) every time.
+ */
+typedef struct {
+	guint generation;
+	mapnik::Map *map;
+} ThreadMap;
+
+typedef struct {
+	GHashTable *maps; // Key is the MapnikInterface id
+	guint frees;      // Value of interface_frees when last tidied
+} ThreadMaps;
+
+static guint interface_ids = 0;
+static gint interface_frees = 0;
+static GHashTable *live_ids = NULL; // Of MapnikInterfaces not yet freed
+static GMutex live_mutex;
+
+static void thread_map_free ( ThreadMap *tm )
+{
+	delete tm->map;
+	g_free ( tm );
+}
+
+static void thread_maps_free ( gpointer data )
+{
+	ThreadMaps *tms = (ThreadMaps*)data;
+	g_hash_table_destroy ( tms->maps );
+	g_free ( tms );
+}
+
+static GPrivate thread_maps = G_PRIVATE_INIT ( thread_maps_free );
+
+static gboolean thread_map_is_dead ( gpointer key, gpointer value, gpointer user_data )
+{
+	return !g_hash_table_contains ( live_ids, key );
+}
+
+/**
+ * Get this thread's copy of the map, refreshing it if the main map has been reloaded
+ */
+static mapnik::Map *get_thread_map ( MapnikInterface* mi )
+{
+	ThreadMaps *tms = (ThreadMaps*)g_private_get ( &thread_maps );
+	if ( !tms ) {
+		tms = g_new0 ( ThreadMaps, 1 );
+		tms->maps = g_hash_table_new_full ( g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)thread_map_free );
+		g_private_set ( &thread_maps, tms );
+	}
+
+	// Drop copies of maps that have since been freed
+	guint frees = (guint)g_atomic_int_get ( &interface_frees );
+	if ( tms->frees != frees ) {
+		g_mutex_lock ( &live_mutex );
+		g_hash_table_foreach_remove ( tms->maps, thread_map_is_dead, NULL );
+		g_mutex_unlock ( &live_mutex );
+		tms->frees = frees;
+	}
+
+	ThreadMap *tm = (ThreadMap*)g_hash_table_lookup ( tms->maps, GUINT_TO_POINTER(mi->id) );
+	g_mutex_lock ( &mi->mutex );
+	if ( !tm || tm->generation != mi->generation ) {
+		if ( !tm ) {
+			tm = g_new0 ( ThreadMap, 1 );
+			g_hash_table_insert ( tms->maps, GUINT_TO_POINTER(mi->id), tm );
+		}
+		delete tm->map;
+		tm->map = new mapnik::Map(*mi->myMap);
+		tm->generation = mi->generation;
+	}
+	g_mutex_unlock ( &mi->mutex );
+	return tm->map;
+}
+
 MapnikInterface* mapnik_interface_new ()
 {
 	MapnikInterface* mi = MAPNIK_INTERFACE ( g_object_new ( MAPNIK_INTERFACE_TYPE, NULL ) );
 	mi->myMap = new mapnik::Map;
 	mi->copyright = NULL;
+	mi->generation = 0;
+	g_mutex_init ( &mi->mutex );
+
+	g_mutex_lock ( &live_mutex );
+	if ( !live_ids )
+		live_ids = g_hash_table_new ( g_direct_hash, g_direct_equal );
+	mi->id = ++interface_ids;
+	g_hash_table_add ( live_ids, GUINT_TO_POINTER(mi->id) );
+	g_mutex_unlock ( &live_mutex );
 	return mi;
 }
 
 void mapnik_interface_free (MapnikInterface* mi)
 {
 	if ( mi ) {
+		g_mutex_lock ( &live_mutex );
+		(void)g_hash_table_remove ( live_ids, GUINT_TO_POINTER(mi->id) );
+		g_mutex_unlock ( &live_mutex );
+		g_atomic_int_inc ( &interface_frees );
+
 		g_free ( mi->copyright );
 		delete mi->myMap;
+		g_mutex_clear ( &mi->mutex );
 	}
 	g_object_unref ( G_OBJECT(mi) );
 }
@@ -184,6 +280,8 @@ gchar* mapnik_interface_load_map_file ( MapnikInterface* mi,
 {
 	gchar *msg = NULL;
 	if ( !mi ) return g_strdup ("Internal Error");
+	g_mutex_lock ( &mi->mutex );
+	mi->generation++;
 	try {
 		mi->myMap->remove_all(); // Support reloading
 		mapnik::load_map(*mi->myMap, filename);
@@ -215,6 +313,7 @@ gchar* mapnik_interface_load_map_file ( MapnikInterface* mi,
 	} catch (...) {
 		msg = g_strdup ("unknown error");
 	}
+	g_mutex_unlock ( &mi->mutex );
 	return msg;
 }
 
@@ -225,17 +324,20 @@ static void destroy_fn ( guchar *pixels, gpointer data )
 }
 
 /**
- * mapnik_interface_render:
+ * mapnik_interface_render_metatile:
+ * @cols: Number of tiles across the area
+ * @rows: Number of tiles down the area
  *
- * Returns a #GdkPixbuf of the specified area. #GdkPixbuf may be NULL
+ * Render the specified area in one go (so labels are placed once over the whole area),
+ *  which is then split into tiles of the size the map was loaded with.
+ *
+ * Returns an array of @cols x @rows #GdkPixbuf (row by row), or NULL if not rendered.
+ *  Free the array after use, as well as unreferencing each #GdkPixbuf.
  */
-GdkPixbuf* mapnik_interface_render ( MapnikInterface* mi, double lat_tl, double lon_tl, double lat_br, double lon_br )
+GdkPixbuf** mapnik_interface_render_metatile ( MapnikInterface* mi, double lat_tl, double lon_tl, double lat_br, double lon_br, guint cols, guint rows )
 {
 	if ( !mi ) return NULL;
-
-	// Copy main object to local map variable
-	//  This enables rendering to work when this function is called from different threads
-	mapnik::Map myMap(*mi->myMap);
+	if ( cols < 1 || rows < 1 ) return NULL;
 
 	// Note prj & bbox want stuff in lon,lat order!
 	double p0x = lon_tl;
@@ -247,23 +349,41 @@ GdkPixbuf* mapnik_interface_render ( MapnikInterface* mi, double lat_tl, double
 	prj.forward(p0x, p0y);
 	prj.forward(p1x, p1y);
 
-	GdkPixbuf *pixbuf = NULL;
+	GdkPixbuf **pixbufs = NULL;
 	try {
-		unsigned width  = myMap.width();
-		unsigned height = myMap.height();
+		// Use a copy of the main map object
+		//  This enables rendering to work when this function is called from different threads
+		mapnik::Map *myMap = get_thread_map ( mi );
+		unsigned tile_width;
+		unsigned tile_height;
+		g_mutex_lock ( &mi->mutex );
+		tile_width = mi->myMap->width();
+		tile_height = mi->myMap->height();
+		g_mutex_unlock ( &mi->mutex );
+
+		unsigned width  = tile_width * cols;
+		unsigned height = tile_height * rows;
+		myMap->resize(width,height);
 		mapnik::image_32 image(width,height);
 		mapnik::box2d<double> bbox(p0x, p0y, p1x, p1y);
-		myMap.zoom_to_box(bbox);
+		myMap->zoom_to_box(bbox);
 		// FUTURE: option to use cairo / grid renderers?
-		mapnik::agg_renderer<mapnik::image_32> render(myMap,image);
+		mapnik::agg_renderer<mapnik::image_32> render(*myMap,image);
 		render.apply();
 
 		if ( image.painted() ) {
-			unsigned char *ImageRawDataPtr = (unsigned char *) g_malloc(width * 4 * height);
-			if (!ImageRawDataPtr)
-				return NULL;
-			memcpy(ImageRawDataPtr, image.raw_data(), width * height * 4);
-			pixbuf = gdk_pixbuf_new_from_data(ImageRawDataPtr, GDK_COLORSPACE_RGB, TRUE, 8, width, height, width * 4, destroy_fn, NULL);
+			const unsigned char *data = (const unsigned char *) image.raw_data();
+			pixbufs = g_new0 ( GdkPixbuf*, cols * rows );
+			for ( guint row = 0; row < rows; row++ ) {
+				for ( guint col = 0; col < cols; col++ ) {
+					unsigned char *ImageRawDataPtr = (unsigned char *) g_malloc(tile_width * 4 * tile_height);
+					for ( guint yy = 0; yy < tile_height; yy++ )
+						memcpy ( ImageRawDataPtr + (yy * tile_width * 4),
+						         data + (((row * tile_height) + yy) * width + (col * tile_width)) * 4,
+						         tile_width * 4 );
+					pixbufs[row*cols + col] = gdk_pixbuf_new_from_data(ImageRawDataPtr, GDK_COLORSPACE_RGB, TRUE, 8, tile_width, tile_height, tile_width * 4, destroy_fn, NULL);
+				}
+			}
 		}
 		else
 			g_warning ("%s not rendered", __FUNCTION__ );
@@ -274,6 +394,22 @@ GdkPixbuf* mapnik_interface_render ( MapnikInterface* mi, double lat_tl, double
 		g_warning ("An unknown error occurred while rendering");
 	}
 
+	return pixbufs;
+}
+
+/**
+ * mapnik_interface_render:
+ *
+ * Returns a #GdkPixbuf of the specified area. #GdkPixbuf may be NULL
+ */
+GdkPixbuf* mapnik_interface_render ( MapnikInterface* mi, double lat_tl, double lon_tl, double lat_br, double lon_br )
+{
+	GdkPixbuf *pixbuf = NULL;
+	GdkPixbuf **pixbufs = mapnik_interface_render_metatile ( mi, lat_tl, lon_tl, lat_br, lon_br, 1, 1 );
+	if ( pixbufs ) {
+		pixbuf = pixbufs[0];
+		g_free ( pixbufs );
+	}
 	return pixbuf;
 }
 
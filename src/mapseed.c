@@ -0,0 +1,486 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <errno.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include "mapseed.h"
+#include "dir.h"
+#include "vik_compat.h"
+
+/*
+ * Seeding a large area over several zoom levels can take hours.
+ *
+ * Each job is written to a journal file in the 'seeding' directory of the Viking configuration,
+ *  listing the areas and how many of the tiles are complete.
+ * Tiles are handed out in order (area by area, row by row), and the journal records the index of the
+ *  first tile not yet complete - so on resuming only the few tiles that were in progress are retried,
+ *  rather than having to check every tile again.
+ *
+ * Journals of jobs not being run are 'unclaimed' and can be resumed by a layer using the same map and cache.
+ */
+
+#define JOURNAL_GROUP "seed"
+#define JOURNAL_SUFFIX ".job"
+// Microseconds between writing the journal of a running job
+#define SAVE_INTERVAL (5 * G_USEC_PER_SEC)
+
+typedef struct {
+  gint scale, z;
+  gint x0, y0, xf, yf;
+} SeedArea;
+
+struct _MapSeedJob {
+  gint ref_count;
+  GMutex *mutex;        // Protects all the following
+  gchar *journal;
+  guint16 map_id;
+  gchar *cache_dir;
+  gint cache_layout;
+  gint redownload;
+  GArray *areas;        // SeedArea, in download order
+  guint64 total;        // Tiles in all the areas
+  guint64 next;         // Index of the next tile to hand out
+  GArray *inflight;     // Indices of the tiles handed out but not yet complete
+  guint area;           // The area containing the next tile
+  guint64 area_start;   // Index of the first tile of that area
+  gint64 started;       // For the statistics of this session
+  guint64 done;
+  guint64 bytes;
+  gint64 saved;         // When the journal was last written
+};
+
+static GMutex *js_mutex = NULL;
+static GHashTable *claimed = NULL; // Set of journal file names in use
+static gchar *journal_dir = NULL;
+
+static guint64 area_size ( const SeedArea *sa )
+{
+  return (guint64)(sa->xf - sa->x0 + 1) * (guint64)(sa->yf - sa->y0 + 1);
+}
+
+static void claim ( const gchar *journal )
+{
+  g_mutex_lock ( js_mutex );
+  if ( claimed )
+    g_hash_table_add ( claimed, g_strdup(journal) );
+  g_mutex_unlock ( js_mutex );
+}
+
+static void unclaim ( const gchar *journal )
+{
+  if ( !js_mutex )
+    return;
+  g_mutex_lock ( js_mutex );
+  if ( claimed )
+    (void)g_hash_table_remove ( claimed, journal );
+  g_mutex_unlock ( js_mutex );
+}
+
+static MapSeedJob *job_new ( gchar *journal, guint16 map_id, const gchar *cache_dir, gint cache_layout, gint redownload )
+{
+  MapSeedJob *job = g_malloc0 ( sizeof(MapSeedJob) );
+  job->ref_count = 1;
+  job->mutex = vik_mutex_new ();
+  job->journal = journal;
+  job->map_id = map_id;
+  job->cache_dir = g_strdup ( cache_dir );
+  job->cache_layout = cache_layout;
+  job->redownload = redownload;
+  job->areas = g_array_new ( FALSE, FALSE, sizeof(SeedArea) );
+  job->inflight = g_array_new ( FALSE, FALSE, sizeof(guint64) );
+  job->started = g_get_monotonic_time ();
+  job->saved = job->started;
+  claim ( journal );
+  return job;
+}
+
+/**
+ * a_map_seed_job_new:
+ * @redownload: The REDOWNLOAD_* method to use for each tile
+ *
+ * Returns: A new empty job, to which the areas are to be added
+ */
+MapSeedJob *a_map_seed_job_new ( guint16 map_id, const gchar *cache_dir, gint cache_layout, gint redownload )
+{
+  gchar *name = g_strdup_printf ( "%"G_GINT64_FORMAT"-%u%s", g_get_real_time(), g_random_int(), JOURNAL_SUFFIX );
+  gchar *journal = g_build_filename ( journal_dir, name, NULL );
+  g_free ( name );
+  return job_new ( journal, map_id, cache_dir, cache_layout, redownload );
+}
+
+MapSeedJob *a_map_seed_job_ref ( MapSeedJob *job )
+{
+  g_atomic_int_inc ( &job->ref_count );
+  return job;
+}
+
+/**
+ * Returns: The index of the first tile not yet complete
+ * Must be called with the job mutex held
+ */
+static guint64 job_completed ( MapSeedJob *job )
+{
+  guint64 completed = job->next;
+  for ( guint ii = 0; ii < job->inflight->len; ii++ )
+    completed = MIN ( completed, g_array_index(job->inflight, guint64, ii) );
+  return completed;
+}
+
+/**
+ * Must be called with the job mutex held
+ */
+static void job_save ( MapSeedJob *job )
+{
+  GKeyFile *kf = g_key_file_new ();
+  g_key_file_set_integer ( kf, JOURNAL_GROUP, "map_id", job->map_id );
+  g_key_file_set_string ( kf, JOURNAL_GROUP, "cache_dir", job->cache_dir );
+  g_key_file_set_integer ( kf, JOURNAL_GROUP, "cache_layout", job->cache_layout );
+  g_key_file_set_integer ( kf, JOURNAL_GROUP, "redownload", job->redownload );
+  gchar **areas = g_new0 ( gchar*, job->areas->len + 1 );
+  for ( guint ii = 0; ii < job->areas->len; ii++ ) {
+    SeedArea *sa = &g_array_index ( job->areas, SeedArea, ii );
+    areas[ii] = g_strdup_printf ( "%d %d %d %d %d %d", sa->scale, sa->z, sa->x0, sa->y0, sa->xf, sa->yf );
+  }
+  g_key_file_set_string_list ( kf, JOURNAL_GROUP, "areas", (const gchar* const*)areas, job->areas->len );
+  g_strfreev ( areas );
+  g_key_file_set_uint64 ( kf, JOURNAL_GROUP, "completed", job_completed(job) );
+
+  gsize length;
+  gchar *contents = g_key_file_to_data ( kf, &length, NULL );
+  GError *error = NULL;
+  gchar *dir = g_path_get_dirname ( job->journal );
+  if ( g_mkdir_with_parents ( dir, 0755 ) != 0 ||
+       !g_file_set_contents ( job->journal, contents, length, &error ) ) {
+    g_warning ( "%s: Unable to write %s: %s", __FUNCTION__, job->journal, error ? error->message : g_strerror(errno) );
+    if ( error )
+      g_error_free ( error );
+  }
+  g_free ( dir );
+  g_free ( contents );
+  g_key_file_free ( kf );
+  job->saved = g_get_monotonic_time ();
+}
+
+/**
+ * a_map_seed_job_unref:
+ *
+ * When no longer used, the journal is removed if the job has been completed,
+ *  otherwise it is updated so the job can be resumed
+ */
+void a_map_seed_job_unref ( MapSeedJob *job )
+{
+  if ( !g_atomic_int_dec_and_test ( &job->ref_count ) )
+    return;
+
+  // Unless only being inspected
+  if ( job->journal[0] ) {
+    if ( a_map_seed_job_is_finished ( job ) )
+      (void)g_remove ( job->journal );
+    else
+      job_save ( job );
+    unclaim ( job->journal );
+  }
+
+  g_array_free ( job->areas, TRUE );
+  g_array_free ( job->inflight, TRUE );
+  vik_mutex_free ( job->mutex );
+  g_free ( job->cache_dir );
+  g_free ( job->journal );
+  g_free ( job );
+}
+
+void a_map_seed_job_add_area ( MapSeedJob *job, gint scale, gint z, gint x0, gint y0, gint xf, gint yf )
+{
+  SeedArea sa = { scale, z, MIN(x0,xf), MIN(y0,yf), MAX(x0,xf), MAX(y0,yf) };
+  g_mutex_lock ( job->mutex );
+  g_array_append_val ( job->areas, sa );
+  job->total += area_size ( &sa );
+  g_mutex_unlock ( job->mutex );
+}
+
+gint a_map_seed_job_get_redownload ( MapSeedJob *job )
+{
+  return job->redownload;
+}
+
+/**
+ * a_map_seed_job_get_remaining:
+ *
+ * Returns: The number of tiles not yet complete
+ */
+guint64 a_map_seed_job_get_remaining ( MapSeedJob *job )
+{
+  g_mutex_lock ( job->mutex );
+  guint64 remaining = job->total - job_completed ( job );
+  g_mutex_unlock ( job->mutex );
+  return remaining;
+}
+
+/**
+ * a_map_seed_job_next:
+ * @mc:    Returns the next tile to download
+ * @index: Returns the index of the tile, to be passed to a_map_seed_job_complete()
+ *
+ * Returns: FALSE when all the tiles have been handed out
+ */
+gboolean a_map_seed_job_next ( MapSeedJob *job, MapCoord *mc, guint64 *index )
+{
+  gboolean found = FALSE;
+  g_mutex_lock ( job->mutex );
+  while ( job->next < job->total && job->area < job->areas->len ) {
+    SeedArea *sa = &g_array_index ( job->areas, SeedArea, job->area );
+    guint64 size = area_size ( sa );
+    guint64 pos = job->next - job->area_start;
+    if ( pos >= size ) {
+      job->area_start += size;
+      job->area++;
+      continue;
+    }
+    gint width = sa->xf - sa->x0 + 1;
+    mc->scale = sa->scale;
+    mc->z = sa->z;
+    mc->x = sa->x0 + (gint)(pos % width);
+    mc->y = sa->y0 + (gint)(pos / width);
+    g_array_append_val ( job->inflight, job->next );
+    *index = job->next++;
+    found = TRUE;
+    break;
+  }
+  g_mutex_unlock ( job->mutex );
+  return found;
+}
+
+/**
+ * a_map_seed_job_complete:
+ * @bytes: The size of the downloaded tile (0 if not downloaded)
+ *
+ * Record the tile as done - which should not be called if the download was aborted,
+ *  so the tile will be retried when resumed.
+ */
+void a_map_seed_job_complete ( MapSeedJob *job, guint64 index, guint64 bytes )
+{
+  g_mutex_lock ( job->mutex );
+  for ( guint ii = 0; ii < job->inflight->len; ii++ ) {
+    if ( g_array_index(job->inflight, guint64, ii) == index ) {
+      g_array_remove_index_fast ( job->inflight, ii );
+      break;
+    }
+  }
+  job->done++;
+  job->bytes += bytes;
+  if ( g_get_monotonic_time() - job->saved > SAVE_INTERVAL )
+    job_save ( job );
+  g_mutex_unlock ( job->mutex );
+}
+
+/**
+ * a_map_seed_job_is_finished:
+ *
+ * Returns: Whether all the tiles are complete
+ */
+gboolean a_map_seed_job_is_finished ( MapSeedJob *job )
+{
+  g_mutex_lock ( job->mutex );
+  gboolean finished = ( job->next >= job->total && job->inflight->len == 0 );
+  g_mutex_unlock ( job->mutex );
+  return finished;
+}
+
+/**
+ * a_map_seed_job_get_status:
+ *
+ * Returns: A description of the progress, throughput and estimated time to complete
+ */
+gchar *a_map_seed_job_get_status ( MapSeedJob *job )
+{
+  g_mutex_lock ( job->mutex );
+  guint64 completed = job_completed ( job );
+  guint64 total = job->total;
+  guint64 done = job->done;
+  guint64 bytes = job->bytes;
+  gdouble elapsed = (g_get_monotonic_time() - job->started) / (gdouble)G_USEC_PER_SEC;
+  g_mutex_unlock ( job->mutex );
+
+  // The counts are formatted separately, as translatable strings can not contain the platform specific 64 bit formats
+  gchar *completed_str = g_strdup_printf ( "%"G_GUINT64_FORMAT, completed );
+  gchar *total_str = g_strdup_printf ( "%"G_GUINT64_FORMAT, total );
+  gchar *status;
+  if ( done == 0 || elapsed < 1.0 )
+    status = g_strdup_printf ( _("%s of %s tiles"), completed_str, total_str );
+  else {
+    gdouble rate = done / elapsed;
+    guint eta = (guint)((total - completed) / rate);
+    gchar *bytes_rate = g_format_size ( (guint64)(bytes / elapsed) );
+    status = g_strdup_printf ( _("%s of %s tiles, %.1f tiles/s, %s/s, %d:%02d:%02d remaining"),
+                               completed_str, total_str, rate, bytes_rate, eta / 3600, (eta / 60) % 60, eta % 60 );
+    g_free ( bytes_rate );
+  }
+  g_free ( completed_str );
+  g_free ( total_str );
+  return status;
+}
+
+/**
+ * a_map_seed_job_save:
+ *
+ * Write the journal now (otherwise it is written periodically whilst running)
+ */
+void a_map_seed_job_save ( MapSeedJob *job )
+{
+  g_mutex_lock ( job->mutex );
+  job_save ( job );
+  g_mutex_unlock ( job->mutex );
+}
+
+/**
+ * Read a journal, if it matches the map and cache
+ */
+static MapSeedJob *journal_load ( const gchar *journal, guint16 map_id, const gchar *cache_dir, gint cache_layout )
+{
+  GKeyFile *kf = g_key_file_new ();
+  MapSeedJob *job = NULL;
+  if ( !g_key_file_load_from_file ( kf, journal, G_KEY_FILE_NONE, NULL ) ) {
+    g_key_file_free ( kf );
+    return NULL;
+  }
+  gchar *dir = g_key_file_get_string ( kf, JOURNAL_GROUP, "cache_dir", NULL );
+  if ( g_key_file_get_integer ( kf, JOURNAL_GROUP, "map_id", NULL ) == map_id &&
+       g_key_file_get_integer ( kf, JOURNAL_GROUP, "cache_layout", NULL ) == cache_layout &&
+       !g_strcmp0 ( dir, cache_dir ) ) {
+    job = job_new ( g_strdup(journal), map_id, cache_dir, cache_layout,
+                    g_key_file_get_integer ( kf, JOURNAL_GROUP, "redownload", NULL ) );
+    gchar **areas = g_key_file_get_string_list ( kf, JOURNAL_GROUP, "areas", NULL, NULL );
+    for ( guint ii = 0; areas && areas[ii]; ii++ ) {
+      gint vals[6];
+      if ( sscanf ( areas[ii], "%d %d %d %d %d %d", &vals[0], &vals[1], &vals[2], &vals[3], &vals[4], &vals[5] ) == 6 )
+        a_map_seed_job_add_area ( job, vals[0], vals[1], vals[2], vals[3], vals[4], vals[5] );
+    }
+    g_strfreev ( areas );
+    job->next = MIN ( job->total, g_key_file_get_uint64 ( kf, JOURNAL_GROUP, "completed", NULL ) );
+  }
+  g_free ( dir );
+  g_key_file_free ( kf );
+  return job;
+}
+
+/**
+ * Returns: The file names of the unclaimed journals
+ */
+static GSList *journals_unclaimed ()
+{
+  GSList *journals = NULL;
+  GDir *gdir = g_dir_open ( journal_dir, 0, NULL );
+  if ( !gdir )
+    return NULL;
+  const gchar *name;
+  g_mutex_lock ( js_mutex );
+  while ( (name = g_dir_read_name ( gdir )) ) {
+    if ( !g_str_has_suffix ( name, JOURNAL_SUFFIX ) )
+      continue;
+    gchar *journal = g_build_filename ( journal_dir, name, NULL );
+    if ( claimed && !g_hash_table_contains ( claimed, journal ) )
+      journals = g_slist_prepend ( journals, journal );
+    else
+      g_free ( journal );
+  }
+  g_mutex_unlock ( js_mutex );
+  g_dir_close ( gdir );
+  // In the order created
+  return g_slist_sort ( journals, (GCompareFunc)g_strcmp0 );
+}
+
+/**
+ * a_map_seed_jobs_claim:
+ *
+ * Returns: A list of the unfinished jobs for this map and cache that are not in use, which are now in use
+ */
+GList *a_map_seed_jobs_claim ( guint16 map_id, const gchar *cache_dir, gint cache_layout )
+{
+  GList *jobs = NULL;
+  if ( !journal_dir )
+    return NULL;
+  GSList *journals = journals_unclaimed ();
+  for ( GSList *iter = journals; iter; iter = iter->next ) {
+    MapSeedJob *job = journal_load ( iter->data, map_id, cache_dir, cache_layout );
+    if ( job )
+      jobs = g_list_append ( jobs, job );
+  }
+  g_slist_free_full ( journals, g_free );
+  return jobs;
+}
+
+/**
+ * a_map_seed_jobs_count:
+ *
+ * Returns: The number of unfinished jobs for this map and cache that are not in use
+ */
+guint a_map_seed_jobs_count ( guint16 map_id, const gchar *cache_dir, gint cache_layout )
+{
+  GList *jobs = a_map_seed_jobs_claim ( map_id, cache_dir, cache_layout );
+  guint count = g_list_length ( jobs );
+  // Only releasing them, so no need to rewrite the journals
+  for ( GList *iter = jobs; iter; iter = iter->next ) {
+    MapSeedJob *job = iter->data;
+    unclaim ( job->journal );
+    job->journal[0] = '\0';
+  }
+  g_list_free_full ( jobs, (GDestroyNotify)a_map_seed_job_unref );
+  return count;
+}
+
+/**
+ * a_map_seed_jobs_discard:
+ *
+ * Remove the unfinished jobs for this map and cache that are not in use
+ */
+void a_map_seed_jobs_discard ( guint16 map_id, const gchar *cache_dir, gint cache_layout )
+{
+  GList *jobs = a_map_seed_jobs_claim ( map_id, cache_dir, cache_layout );
+  for ( GList *iter = jobs; iter; iter = iter->next ) {
+    MapSeedJob *job = iter->data;
+    if ( g_remove ( job->journal ) )
+      g_warning ( "%s: failed to remove: %s", __FUNCTION__, job->journal );
+    unclaim ( job->journal );
+    job->journal[0] = '\0';
+  }
+  g_list_free_full ( jobs, (GDestroyNotify)a_map_seed_job_unref );
+}
+
+void a_map_seed_init ()
+{
+  js_mutex = vik_mutex_new ();
+  claimed = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+  journal_dir = g_build_filename ( a_get_viking_dir(), "seeding", NULL );
+}
+
+void a_map_seed_uninit ()
+{
+  g_mutex_lock ( js_mutex );
+  g_hash_table_destroy ( claimed );
+  claimed = NULL;
+  g_mutex_unlock ( js_mutex );
+  // The mutex is kept, as any jobs still finishing off will be unclaimed
+  g_free ( journal_dir );
+  journal_dir = NULL;
+}
@@ -0,0 +1,56 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __VIKING_MAPSEED_H
+#define __VIKING_MAPSEED_H
+
+#include <glib.h>
+#include "mapcoord.h"
+
+G_BEGIN_DECLS
+
+// A request to download all the tiles of some areas (at various zoom levels),
+//  which is recorded in a journal so it can be resumed after being cancelled or Viking restarting.
+// The tiles are handed out in a fixed order, so the journal only needs to record how many are complete.
+
+typedef struct _MapSeedJob MapSeedJob;
+
+void a_map_seed_init ();
+void a_map_seed_uninit ();
+
+MapSeedJob *a_map_seed_job_new ( guint16 map_id, const gchar *cache_dir, gint cache_layout, gint redownload );
+MapSeedJob *a_map_seed_job_ref ( MapSeedJob *job );
+void a_map_seed_job_unref ( MapSeedJob *job );
+
+void a_map_seed_job_add_area ( MapSeedJob *job, gint scale, gint z, gint x0, gint y0, gint xf, gint yf );
+gint a_map_seed_job_get_redownload ( MapSeedJob *job );
+guint64 a_map_seed_job_get_remaining ( MapSeedJob *job );
+gboolean a_map_seed_job_next ( MapSeedJob *job, MapCoord *mc, guint64 *index );
+void a_map_seed_job_complete ( MapSeedJob *job, guint64 index, guint64 bytes );
+gboolean a_map_seed_job_is_finished ( MapSeedJob *job );
+gchar *a_map_seed_job_get_status ( MapSeedJob *job );
+void a_map_seed_job_save ( MapSeedJob *job );
+
+GList *a_map_seed_jobs_claim ( guint16 map_id, const gchar *cache_dir, gint cache_layout );
+guint a_map_seed_jobs_count ( guint16 map_id, const gchar *cache_dir, gint cache_layout );
+void a_map_seed_jobs_discard ( guint16 map_id, const gchar *cache_dir, gint cache_layout );
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,641 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+#include <math.h>
+#include "mbtilescache.h"
+#include "globals.h"
+#include "settings.h"
+#include "vik_compat.h"
+#ifdef HAVE_SQLITE3_H
+#include "sqlite3.h"
+#endif
+
+/*
+ * Storing each tile in its own file means large caches can use millions of files,
+ *  which can exhaust inodes and makes scanning or deleting a cache very slow.
+ * Instead the tiles can be kept in an MBTiles database per map.
+ *
+ * Download threads write via a single connection per database,
+ *  collecting the writes into batches so there is one transaction per batch rather than per tile.
+ * The database uses Write-Ahead-Logging so reads via separate connections
+ *  (e.g. for drawing) are not blocked whilst a batch is being written.
+ *
+ * Reads (for both the cache and MBTiles map files) go via a small pool of read only connections,
+ *  so several decode threads can read in parallel,
+ *  each connection keeping its statements prepared for reuse.
+ */
+
+#ifdef HAVE_SQLITE3_H
+// Commit once a batch has this many tiles
+#define VIK_SETTINGS_MBTILES_CACHE_BATCH_SIZE "mbtiles_cache_batch_size"
+static gint BATCH_SIZE = 100;
+// Or has been open for this long (microseconds)
+#define BATCH_TIME (2 * G_USEC_PER_SEC)
+// Wait for locks held by other processes for up to (milliseconds)
+#define BUSY_TIMEOUT 5000
+// Maximum number of read connections per database
+#define VIK_SETTINGS_MBTILES_READ_CONNECTIONS "mbtiles_read_connections"
+static gint READ_CONNECTIONS = 4;
+// Amount of each database to access via memory mapping (the setting is in megabytes)
+#define VIK_SETTINGS_MBTILES_MMAP_SIZE "mbtiles_mmap_size"
+static gint64 MMAP_SIZE = 256 * 1024 * 1024;
+
+typedef struct {
+  sqlite3 *sql;
+  sqlite3_stmt *get;     // Tile data and stored time of a tile
+  sqlite3_stmt *exists;  // Just whether a tile is present (and its stored time)
+  sqlite3_stmt *rect;    // All tiles within a range
+} Connection;
+
+struct _MBTilesPool {
+  gchar *filename;
+  gint ref_count;
+  GMutex *mutex;         // Protects the opened value
+  guint opened;
+  GAsyncQueue *idle;     // Connections not currently in use
+};
+
+typedef struct {
+  gchar *dbname;
+  GMutex *write_mutex;  // Protects the writer and pending values
+  Connection writer;
+  sqlite3_stmt *insert;
+  guint pending;        // Number of writes in the open transaction
+  gint64 batch_start;
+  MBTilesPool *readers;
+} MBTilesCache;
+
+static GHashTable *caches = NULL;
+static GMutex *caches_mutex = NULL;
+
+static void cache_exec ( sqlite3 *sql, const gchar *statement )
+{
+  char *errMsg = NULL;
+  int ans = sqlite3_exec ( sql, statement, NULL, NULL, &errMsg );
+  if ( ans != SQLITE_OK ) {
+    g_warning ( "%s: %s - %s", __FUNCTION__, statement, errMsg );
+    sqlite3_free ( errMsg );
+  }
+}
+
+static gint flip_y ( gint y, gint zoom )
+{
+  // MBTiles stored internally with the flipping y thingy (i.e. TMS scheme).
+  return (gint) pow(2, zoom)-1 - y;
+}
+
+/**
+ * Prepare the statement, using the alternative form when the tiles table has no mtime column
+ *  (i.e. MBTiles files not created by Viking)
+ */
+static sqlite3_stmt *conn_prepare ( sqlite3 *sql, const gchar *statement, const gchar *no_mtime_statement )
+{
+  sqlite3_stmt *stmt = NULL;
+  if ( sqlite3_prepare_v2 ( sql, statement, -1, &stmt, NULL ) != SQLITE_OK ) {
+    (void)sqlite3_finalize ( stmt );
+    stmt = NULL;
+    if ( no_mtime_statement )
+      if ( sqlite3_prepare_v2 ( sql, no_mtime_statement, -1, &stmt, NULL ) != SQLITE_OK ) {
+        g_warning ( "%s: %s - %s", __FUNCTION__, "prepare failure", sqlite3_errmsg(sql) );
+        (void)sqlite3_finalize ( stmt );
+        stmt = NULL;
+      }
+  }
+  return stmt;
+}
+
+static void conn_prepare_reads ( Connection *conn )
+{
+  conn->get = conn_prepare ( conn->sql,
+                             "SELECT tile_data, mtime FROM tiles WHERE zoom_level=?1 AND tile_column=?2 AND tile_row=?3;",
+                             "SELECT tile_data, 0 FROM tiles WHERE zoom_level=?1 AND tile_column=?2 AND tile_row=?3;" );
+  // The length is available without reading the whole tile
+  conn->exists = conn_prepare ( conn->sql,
+                                "SELECT length(tile_data), mtime FROM tiles WHERE zoom_level=?1 AND tile_column=?2 AND tile_row=?3;",
+                                "SELECT length(tile_data), 0 FROM tiles WHERE zoom_level=?1 AND tile_column=?2 AND tile_row=?3;" );
+  conn->rect = conn_prepare ( conn->sql,
+                              "SELECT tile_column, tile_row, tile_data FROM tiles WHERE zoom_level=?1 AND tile_column BETWEEN ?2 AND ?3 AND tile_row BETWEEN ?4 AND ?5;",
+                              NULL );
+}
+
+static void conn_close ( Connection *conn )
+{
+  (void)sqlite3_finalize ( conn->get );
+  (void)sqlite3_finalize ( conn->exists );
+  (void)sqlite3_finalize ( conn->rect );
+  (void)sqlite3_close ( conn->sql );
+  conn->get = conn->exists = conn->rect = NULL;
+  conn->sql = NULL;
+}
+
+static Connection *conn_open_read ( const gchar *filename )
+{
+  Connection *conn = g_malloc0 ( sizeof(Connection) );
+  // Each connection is only used by one thread at a time
+  int ans = sqlite3_open_v2 ( filename, &conn->sql, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, NULL );
+  if ( ans != SQLITE_OK ) {
+    g_warning ( "%s: %s - %s", __FUNCTION__, filename, sqlite3_errstr(ans) );
+    (void)sqlite3_close ( conn->sql );
+    g_free ( conn );
+    return NULL;
+  }
+  (void)sqlite3_busy_timeout ( conn->sql, BUSY_TIMEOUT );
+  gchar *statement = g_strdup_printf ( "PRAGMA mmap_size=%"G_GINT64_FORMAT";", MMAP_SIZE );
+  cache_exec ( conn->sql, statement );
+  g_free ( statement );
+  conn_prepare_reads ( conn );
+  return conn;
+}
+
+/**
+ * Get the tile and its stored time
+ *  (either or both of the data and the time may be requested)
+ */
+static gboolean conn_lookup ( Connection *conn, gint x, gint y, gint zoom, GBytes **data, time_t *mtime )
+{
+  sqlite3_stmt *stmt = data ? conn->get : conn->exists;
+  if ( !stmt )
+    return FALSE;
+
+  gboolean found = FALSE;
+  (void)sqlite3_bind_int ( stmt, 1, zoom );
+  (void)sqlite3_bind_int ( stmt, 2, x );
+  (void)sqlite3_bind_int ( stmt, 3, flip_y(y, zoom) );
+  int ans = sqlite3_step ( stmt );
+  if ( ans == SQLITE_ROW ) {
+    if ( data ) {
+      const void *blob = sqlite3_column_blob ( stmt, 0 );
+      int bytes = sqlite3_column_bytes ( stmt, 0 );
+      if ( bytes < 1 )
+        g_warning ( "%s: %s (%d)", __FUNCTION__, "not enough bytes", bytes );
+      else {
+        // Keep a copy of the blob as it is only valid until the statement is reset
+        *data = g_bytes_new ( blob, bytes );
+        found = TRUE;
+      }
+    }
+    else
+      found = ( sqlite3_column_int ( stmt, 0 ) > 0 );
+    if ( found && mtime )
+      *mtime = (time_t)sqlite3_column_int64 ( stmt, 1 );
+  }
+  else if ( ans != SQLITE_DONE )
+    g_warning ( "%s: %s - %s", __FUNCTION__, "step issue", sqlite3_errstr(ans) );
+  (void)sqlite3_reset ( stmt );
+  return found;
+}
+#endif
+
+/**
+ * a_mbtiles_pool_new:
+ * @filename: An existing MBTiles file
+ *
+ * Open a pool of read only connections to the file.
+ * Further connections (up to 'mbtiles_read_connections') are opened on demand
+ *  when several threads read at the same time.
+ *
+ * Returns: The pool or NULL if the file could not be opened
+ */
+MBTilesPool *a_mbtiles_pool_new ( const gchar *filename )
+{
+#ifdef HAVE_SQLITE3_H
+  Connection *conn = conn_open_read ( filename );
+  if ( !conn )
+    return NULL;
+
+  MBTilesPool *pool = g_malloc0 ( sizeof(MBTilesPool) );
+  pool->filename = g_strdup ( filename );
+  pool->ref_count = 1;
+  pool->mutex = vik_mutex_new ();
+  pool->idle = g_async_queue_new ();
+  pool->opened = 1;
+  g_async_queue_push ( pool->idle, conn );
+  return pool;
+#else
+  return NULL;
+#endif
+}
+
+/**
+ * a_mbtiles_pool_ref:
+ */
+MBTilesPool *a_mbtiles_pool_ref ( MBTilesPool *pool )
+{
+  g_atomic_int_inc ( &pool->ref_count );
+  return pool;
+}
+
+/**
+ * a_mbtiles_pool_unref:
+ *
+ * Closes all the connections once the last reference has gone
+ */
+void a_mbtiles_pool_unref ( MBTilesPool *pool )
+{
+  if ( !pool )
+    return;
+  if ( !g_atomic_int_dec_and_test ( &pool->ref_count ) )
+    return;
+#ifdef HAVE_SQLITE3_H
+  Connection *conn;
+  while ( (conn = g_async_queue_try_pop ( pool->idle )) ) {
+    conn_close ( conn );
+    g_free ( conn );
+  }
+#endif
+  g_async_queue_unref ( pool->idle );
+  vik_mutex_free ( pool->mutex );
+  g_free ( pool->filename );
+  g_free ( pool );
+}
+
+#ifdef HAVE_SQLITE3_H
+/**
+ * Get a connection for the sole use of this thread,
+ *  waiting for one to be released if the pool is fully in use
+ */
+static Connection *pool_acquire ( MBTilesPool *pool )
+{
+  Connection *conn = g_async_queue_try_pop ( pool->idle );
+  if ( conn )
+    return conn;
+
+  gboolean open = FALSE;
+  g_mutex_lock ( pool->mutex );
+  if ( pool->opened < (guint)READ_CONNECTIONS ) {
+    pool->opened++;
+    open = TRUE;
+  }
+  g_mutex_unlock ( pool->mutex );
+
+  if ( open ) {
+    conn = conn_open_read ( pool->filename );
+    if ( conn )
+      return conn;
+    g_mutex_lock ( pool->mutex );
+    pool->opened--;
+    g_mutex_unlock ( pool->mutex );
+  }
+  // NB The first connection always exists, so one will become available
+  return g_async_queue_pop ( pool->idle );
+}
+
+static void pool_release ( MBTilesPool *pool, Connection *conn )
+{
+  g_async_queue_push ( pool->idle, conn );
+}
+#endif
+
+/**
+ * a_mbtiles_pool_get:
+ * @mtime: Optionally return when the tile was stored (0 if the file does not record this)
+ *
+ * Returns: The image data of the tile or NULL if not available
+ */
+GBytes *a_mbtiles_pool_get ( MBTilesPool *pool, gint x, gint y, gint zoom, time_t *mtime )
+{
+  GBytes *data = NULL;
+#ifdef HAVE_SQLITE3_H
+  Connection *conn = pool_acquire ( pool );
+  (void)conn_lookup ( conn, x, y, zoom, &data, mtime );
+  pool_release ( pool, conn );
+#endif
+  return data;
+}
+
+/**
+ * a_mbtiles_pool_exists:
+ * @mtime: Optionally return when the tile was stored (0 if the file does not record this)
+ */
+gboolean a_mbtiles_pool_exists ( MBTilesPool *pool, gint x, gint y, gint zoom, time_t *mtime )
+{
+  gboolean found = FALSE;
+#ifdef HAVE_SQLITE3_H
+  Connection *conn = pool_acquire ( pool );
+  found = conn_lookup ( conn, x, y, zoom, NULL, mtime );
+  pool_release ( pool, conn );
+#endif
+  return found;
+}
+
+/**
+ * a_mbtiles_pool_get_rect:
+ * @func: Called for each tile found, a reference must be taken to keep the data
+ *
+ * Read all the tiles within the range (inclusive) in one query,
+ *  rather than a query per tile.
+ *
+ * Returns: The number of tiles found
+ */
+guint a_mbtiles_pool_get_rect ( MBTilesPool *pool, gint zoom, gint x0, gint y0, gint xf, gint yf, MBTilesTileFunc func, gpointer user_data )
+{
+  guint count = 0;
+#ifdef HAVE_SQLITE3_H
+  Connection *conn = pool_acquire ( pool );
+  sqlite3_stmt *stmt = conn->rect;
+  if ( stmt ) {
+    (void)sqlite3_bind_int ( stmt, 1, zoom );
+    (void)sqlite3_bind_int ( stmt, 2, MIN(x0, xf) );
+    (void)sqlite3_bind_int ( stmt, 3, MAX(x0, xf) );
+    (void)sqlite3_bind_int ( stmt, 4, MIN(flip_y(y0, zoom), flip_y(yf, zoom)) );
+    (void)sqlite3_bind_int ( stmt, 5, MAX(flip_y(y0, zoom), flip_y(yf, zoom)) );
+    int ans;
+    while ( (ans = sqlite3_step ( stmt )) == SQLITE_ROW ) {
+      const void *blob = sqlite3_column_blob ( stmt, 2 );
+      int bytes = sqlite3_column_bytes ( stmt, 2 );
+      if ( bytes < 1 )
+        continue;
+      GBytes *data = g_bytes_new ( blob, bytes );
+      func ( sqlite3_column_int ( stmt, 0 ), flip_y(sqlite3_column_int ( stmt, 1 ), zoom), data, user_data );
+      g_bytes_unref ( data );
+      count++;
+    }
+    if ( ans != SQLITE_DONE )
+      g_warning ( "%s: %s - %s", __FUNCTION__, "step issue", sqlite3_errstr(ans) );
+    (void)sqlite3_reset ( stmt );
+  }
+  pool_release ( pool, conn );
+#endif
+  return count;
+}
+
+#ifdef HAVE_SQLITE3_H
+static void cache_commit ( MBTilesCache *mbc )
+{
+  if ( mbc->pending ) {
+    cache_exec ( mbc->writer.sql, "COMMIT;" );
+    mbc->pending = 0;
+  }
+}
+
+static void cache_free ( MBTilesCache *mbc )
+{
+  a_mbtiles_pool_unref ( mbc->readers );
+  if ( mbc->writer.sql ) {
+    cache_commit ( mbc );
+    (void)sqlite3_finalize ( mbc->insert );
+    conn_close ( &mbc->writer );
+  }
+  vik_mutex_free ( mbc->write_mutex );
+  g_free ( mbc->dbname );
+  g_free ( mbc );
+}
+
+static MBTilesCache *cache_open ( const gchar *dbname )
+{
+  MBTilesCache *mbc = g_malloc0 ( sizeof(MBTilesCache) );
+  mbc->dbname = g_strdup ( dbname );
+  mbc->write_mutex = vik_mutex_new ();
+
+  gchar *dir = g_path_get_dirname ( dbname );
+  if ( g_mkdir_with_parents ( dir, 0777 ) != 0 )
+    g_warning ( "%s: Failed to mkdir %s", __FUNCTION__, dir );
+  g_free ( dir );
+
+  // Access to the writer is serialized by the mutex above
+  int ans = sqlite3_open_v2 ( dbname, &mbc->writer.sql, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, NULL );
+  if ( ans != SQLITE_OK ) {
+    g_warning ( "%s: %s - %s", __FUNCTION__, dbname, sqlite3_errstr(ans) );
+    (void)sqlite3_close ( mbc->writer.sql );
+    mbc->writer.sql = NULL;
+    return mbc;
+  }
+  (void)sqlite3_busy_timeout ( mbc->writer.sql, BUSY_TIMEOUT );
+
+  cache_exec ( mbc->writer.sql, "PRAGMA journal_mode=WAL;" );
+  cache_exec ( mbc->writer.sql, "PRAGMA synchronous=NORMAL;" );
+  cache_exec ( mbc->writer.sql, "CREATE TABLE IF NOT EXISTS metadata (name TEXT, value TEXT);" );
+  // Compatible with the MBTiles specification, with an extra column to record when a tile was stored
+  cache_exec ( mbc->writer.sql, "CREATE TABLE IF NOT EXISTS tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB, mtime INTEGER);" );
+  cache_exec ( mbc->writer.sql, "CREATE UNIQUE INDEX IF NOT EXISTS tile_index ON tiles (zoom_level, tile_column, tile_row);" );
+
+  mbc->insert = conn_prepare ( mbc->writer.sql,
+                               "INSERT OR REPLACE INTO tiles (zoom_level, tile_column, tile_row, tile_data, mtime) VALUES (?,?,?,?,?);",
+                               NULL );
+  // Only for reading tiles in the open batch
+  conn_prepare_reads ( &mbc->writer );
+
+  mbc->readers = a_mbtiles_pool_new ( dbname );
+
+  return mbc;
+}
+
+/**
+ * Get the cache for the database, opening (or creating) it on first use
+ */
+static MBTilesCache *cache_get ( const gchar *dbname )
+{
+  if ( !caches_mutex )
+    return NULL;
+  g_mutex_lock ( caches_mutex );
+  if ( !caches ) {
+    g_mutex_unlock ( caches_mutex );
+    return NULL;
+  }
+  MBTilesCache *mbc = g_hash_table_lookup ( caches, dbname );
+  if ( !mbc ) {
+    mbc = cache_open ( dbname );
+    g_hash_table_insert ( caches, mbc->dbname, mbc );
+  }
+  g_mutex_unlock ( caches_mutex );
+  return mbc->writer.sql ? mbc : NULL;
+}
+
+/**
+ * Get the tile and its stored time
+ *  (either or both of the data and the time may be requested)
+ */
+static gboolean cache_lookup ( MBTilesCache *mbc, gint x, gint y, gint zoom, GBytes **data, time_t *mtime )
+{
+  gboolean found = FALSE;
+  if ( mbc->readers ) {
+    Connection *conn = pool_acquire ( mbc->readers );
+    found = conn_lookup ( conn, x, y, zoom, data, mtime );
+    pool_release ( mbc->readers, conn );
+  }
+
+  // Tiles in the open batch are only visible via the writer
+  if ( !found ) {
+    g_mutex_lock ( mbc->write_mutex );
+    if ( mbc->pending || !mbc->readers )
+      found = conn_lookup ( &mbc->writer, x, y, zoom, data, mtime );
+    g_mutex_unlock ( mbc->write_mutex );
+  }
+  return found;
+}
+#endif
+
+/**
+ * a_mbtiles_cache_available:
+ *
+ * Returns: Whether tiles can be stored in MBTiles databases
+ */
+gboolean a_mbtiles_cache_available ()
+{
+#ifdef HAVE_SQLITE3_H
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+/**
+ * a_mbtiles_cache_exists:
+ * @mtime: Optionally return when the tile was stored
+ */
+gboolean a_mbtiles_cache_exists ( const gchar *dbname, gint x, gint y, gint zoom, time_t *mtime )
+{
+#ifdef HAVE_SQLITE3_H
+  MBTilesCache *mbc = cache_get ( dbname );
+  if ( mbc )
+    return cache_lookup ( mbc, x, y, zoom, NULL, mtime );
+#endif
+  return FALSE;
+}
+
+/**
+ * a_mbtiles_cache_get:
+ * @mtime: Optionally return when the tile was stored
+ *
+ * Returns: The image data of the tile or NULL if not available
+ */
+GBytes *a_mbtiles_cache_get ( const gchar *dbname, gint x, gint y, gint zoom, time_t *mtime )
+{
+  GBytes *data = NULL;
+#ifdef HAVE_SQLITE3_H
+  MBTilesCache *mbc = cache_get ( dbname );
+  if ( mbc )
+    (void)cache_lookup ( mbc, x, y, zoom, &data, mtime );
+#endif
+  return data;
+}
+
+/**
+ * a_mbtiles_cache_put:
+ *
+ * Store the tile, replacing any existing version of it.
+ * The write is committed with others in a batch,
+ *  use a_mbtiles_cache_flush() to ensure it is committed.
+ */
+gboolean a_mbtiles_cache_put ( const gchar *dbname, gint x, gint y, gint zoom, GBytes *data )
+{
+  gboolean ok = FALSE;
+#ifdef HAVE_SQLITE3_H
+  MBTilesCache *mbc = cache_get ( dbname );
+  if ( !mbc || !mbc->insert )
+    return FALSE;
+
+  g_mutex_lock ( mbc->write_mutex );
+  if ( mbc->pending == 0 ) {
+    cache_exec ( mbc->writer.sql, "BEGIN;" );
+    mbc->batch_start = g_get_monotonic_time ();
+  }
+
+  gsize size;
+  gconstpointer bytes = g_bytes_get_data ( data, &size );
+  (void)sqlite3_bind_int ( mbc->insert, 1, zoom );
+  (void)sqlite3_bind_int ( mbc->insert, 2, x );
+  (void)sqlite3_bind_int ( mbc->insert, 3, flip_y(y, zoom) );
+  (void)sqlite3_bind_blob ( mbc->insert, 4, bytes, size, SQLITE_STATIC );
+  (void)sqlite3_bind_int64 ( mbc->insert, 5, (sqlite3_int64)time(NULL) );
+  int ans = sqlite3_step ( mbc->insert );
+  ok = ( ans == SQLITE_DONE );
+  if ( !ok )
+    g_warning ( "%s: %s - %s", __FUNCTION__, dbname, sqlite3_errmsg(mbc->writer.sql) );
+  (void)sqlite3_reset ( mbc->insert );
+  (void)sqlite3_clear_bindings ( mbc->insert );
+
+  // Only count writes that are in the transaction
+  if ( ok )
+    mbc->pending++;
+  else if ( mbc->pending == 0 )
+    cache_exec ( mbc->writer.sql, "ROLLBACK;" );
+  if ( mbc->pending >= BATCH_SIZE || (g_get_monotonic_time() - mbc->batch_start) > BATCH_TIME )
+    cache_commit ( mbc );
+  g_mutex_unlock ( mbc->write_mutex );
+#endif
+  return ok;
+}
+
+/**
+ * a_mbtiles_cache_remove:
+ */
+void a_mbtiles_cache_remove ( const gchar *dbname, gint x, gint y, gint zoom )
+{
+#ifdef HAVE_SQLITE3_H
+  MBTilesCache *mbc = cache_get ( dbname );
+  if ( !mbc )
+    return;
+  gchar *statement = g_strdup_printf ( "DELETE FROM tiles WHERE zoom_level=%d AND tile_column=%d AND tile_row=%d;", zoom, x, flip_y(y, zoom) );
+  g_mutex_lock ( mbc->write_mutex );
+  cache_exec ( mbc->writer.sql, statement );
+  g_mutex_unlock ( mbc->write_mutex );
+  g_free ( statement );
+#endif
+}
+
+/**
+ * a_mbtiles_cache_flush:
+ *
+ * Commit any outstanding writes
+ */
+void a_mbtiles_cache_flush ( const gchar *dbname )
+{
+#ifdef HAVE_SQLITE3_H
+  MBTilesCache *mbc = cache_get ( dbname );
+  if ( !mbc )
+    return;
+  g_mutex_lock ( mbc->write_mutex );
+  cache_commit ( mbc );
+  g_mutex_unlock ( mbc->write_mutex );
+#endif
+}
+
+void a_mbtiles_cache_init ()
+{
+#ifdef HAVE_SQLITE3_H
+  gint gitmp = 0;
+  if ( a_settings_get_integer ( VIK_SETTINGS_MBTILES_CACHE_BATCH_SIZE, &gitmp ) && gitmp > 0 )
+    BATCH_SIZE = gitmp;
+  if ( a_settings_get_integer ( VIK_SETTINGS_MBTILES_READ_CONNECTIONS, &gitmp ) && gitmp > 0 )
+    READ_CONNECTIONS = gitmp;
+  if ( a_settings_get_integer ( VIK_SETTINGS_MBTILES_MMAP_SIZE, &gitmp ) && gitmp >= 0 )
+    MMAP_SIZE = (gint64)gitmp * 1024 * 1024;
+
+  caches_mutex = vik_mutex_new ();
+  caches = g_hash_table_new_full ( g_str_hash, g_str_equal, NULL, (GDestroyNotify)cache_free );
+#endif
+}
+
+void a_mbtiles_cache_uninit ()
+{
+#ifdef HAVE_SQLITE3_H
+  // Any outstanding writes are committed as each database is closed
+  g_mutex_lock ( caches_mutex );
+  g_hash_table_destroy ( caches );
+  caches = NULL;
+  g_mutex_unlock ( caches_mutex );
+  vik_mutex_free ( caches_mutex );
+  caches_mutex = NULL;
+#endif
+}
@@ -0,0 +1,56 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __VIKING_MBTILESCACHE_H
+#define __VIKING_MBTILESCACHE_H
+
+#include <glib.h>
+#include <time.h>
+
+G_BEGIN_DECLS
+
+// Tiles are stored in a single SQLite database per map (as MBTiles)
+//  rather than individual files.
+// Zoom levels and y values are as per the OSM scheme, the conversion to the TMS scheme is handled internally.
+
+void a_mbtiles_cache_init ();
+void a_mbtiles_cache_uninit ();
+
+gboolean a_mbtiles_cache_available ();
+gboolean a_mbtiles_cache_exists ( const gchar *dbname, gint x, gint y, gint zoom, time_t *mtime );
+GBytes *a_mbtiles_cache_get ( const gchar *dbname, gint x, gint y, gint zoom, time_t *mtime );
+gboolean a_mbtiles_cache_put ( const gchar *dbname, gint x, gint y, gint zoom, GBytes *data );
+void a_mbtiles_cache_remove ( const gchar *dbname, gint x, gint y, gint zoom );
+void a_mbtiles_cache_flush ( const gchar *dbname );
+
+// Shared read only access to any MBTiles file
+typedef struct _MBTilesPool MBTilesPool;
+
+typedef void (*MBTilesTileFunc) ( gint x, gint y, GBytes *data, gpointer user_data );
+
+MBTilesPool *a_mbtiles_pool_new ( const gchar *filename );
+MBTilesPool *a_mbtiles_pool_ref ( MBTilesPool *pool );
+void a_mbtiles_pool_unref ( MBTilesPool *pool );
+GBytes *a_mbtiles_pool_get ( MBTilesPool *pool, gint x, gint y, gint zoom, time_t *mtime );
+gboolean a_mbtiles_pool_exists ( MBTilesPool *pool, gint x, gint y, gint zoom, time_t *mtime );
+guint a_mbtiles_pool_get_rect ( MBTilesPool *pool, gint zoom, gint x0, gint y0, gint xf, gint yf, MBTilesTileFunc func, gpointer user_data );
+
+G_END_DECLS
+
+#endif
@@ -191,3 +191,51 @@ int metatile_read(const char *dir, int x, int y, int z, char *buf, size_t sz, in
     close(fd);
     return pos;
 }
+
+/**
+ * metatile_index:
+ * Validates the header of a whole metatile file held in memory
+ *  and extracts the offset and size of each tile within it
+ *  (so all the tiles can be served from a single read of the file)
+ *
+ * offsets and sizes must have space for METATILE_TILES entries
+ *
+ * Returns 0 on success, or a negative value on error
+ *
+ * Error messages returned in log_msg
+ */
+int metatile_index(const char *buf, size_t len, int *offsets, int *sizes, int * compressed, char * log_msg)
+{
+    unsigned int header_len = sizeof(struct meta_layout) + METATILE*METATILE*sizeof(struct entry);
+    const struct meta_layout *meta = (const struct meta_layout *)buf;
+    int i;
+
+    if (len < header_len) {
+        snprintf(log_msg, PATH_MAX - 1, "Meta file too small to contain header\n");
+        return -3;
+    }
+    if (memcmp(meta->magic, META_MAGIC, strlen(META_MAGIC))) {
+        if (memcmp(meta->magic, META_MAGIC_COMPRESSED, strlen(META_MAGIC_COMPRESSED))) {
+            snprintf(log_msg, PATH_MAX - 1, "Meta file header magic mismatch\n");
+            return -4;
+        } else {
+            *compressed = 1;
+        }
+    } else *compressed = 0;
+
+    if (meta->count != (METATILE * METATILE)) {
+        snprintf(log_msg, PATH_MAX - 1, "Meta file header bad count %d != %d\n", meta->count, METATILE * METATILE);
+        return -5;
+    }
+
+    for (i = 0; i < meta->count; i++) {
+        if (meta->index[i].offset < 0 || meta->index[i].size < 0 ||
+            (size_t)meta->index[i].offset + meta->index[i].size > len) {
+            snprintf(log_msg, PATH_MAX - 1, "Meta file index entry %d beyond end of file\n", i);
+            return -6;
+        }
+        offsets[i] = meta->index[i].offset;
+        sizes[i] = meta->index[i].size;
+    }
+    return 0;
+}
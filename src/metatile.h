@@ -23,6 +23,11 @@
 // MAX_SIZE is the biggest file which we will return to the user
 #define METATILE_MAX_SIZE (1 * 1024 * 1024)
 
+// Number of tiles in each metatile
+#define METATILE_TILES (8 * 8)
+
 int xyz_to_meta(char *path, size_t len, const char *dir, int x, int y, int z);
 
 int metatile_read(const char *dir, int x, int y, int z, char *buf, size_t sz, int * compressed, char * log_msg);
+
+int metatile_index(const char *buf, size_t len, int *offsets, int *sizes, int * compressed, char * log_msg);
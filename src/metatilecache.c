@@ -0,0 +1,236 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <limits.h>
+#include <glib/gstdio.h>
+#include "metatilecache.h"
+#include "metatile.h"
+#include "settings.h"
+#include "vik_compat.h"
+
+/*
+ * Each renderd metatile file holds 8x8 tiles,
+ *  so reading each tile separately means opening and reading the header of the same file up to 64 times.
+ * Instead the whole file is read once and indexed, and kept (in a small LRU)
+ *  for the other tiles within it.
+ * Missing files are also remembered, as most of the tiles of an area not yet rendered will be requested.
+ */
+
+// Number of metatiles to keep
+#define VIK_SETTINGS_METATILE_CACHE_SIZE "metatile_cache_size"
+static guint CACHE_SIZE = 16;
+// Check a kept metatile is still current (e.g. not re-rendered) after this long (microseconds)
+#define CHECK_INTERVAL (2 * G_USEC_PER_SEC)
+
+typedef struct {
+  gchar *path;
+  GBytes *data;     // The whole file, NULL when it could not be read
+  GError *error;    // Why the file could not be read
+  gint offsets[METATILE_TILES];
+  gint sizes[METATILE_TILES];
+  gboolean compressed;
+  time_t mtime;
+  gint64 checked;   // When the file was read or last confirmed as unchanged
+} MetaFile;
+
+static GHashTable *metafiles = NULL; // path -> link in the LRU queue
+static GQueue lru = G_QUEUE_INIT;     // Most recently used at the head
+static GMutex *mf_mutex = NULL;
+
+static void metafile_free ( MetaFile *mf )
+{
+  if ( mf->data )
+    g_bytes_unref ( mf->data );
+  if ( mf->error )
+    g_error_free ( mf->error );
+  g_free ( mf->path );
+  g_free ( mf );
+}
+
+static time_t file_mtime ( const gchar *path )
+{
+  GStatBuf stat_buf;
+  if ( g_stat ( path, &stat_buf ) != 0 )
+    return 0;
+  return stat_buf.st_mtime;
+}
+
+/**
+ * Read and index the whole metatile
+ */
+static MetaFile *metafile_read ( const gchar *path )
+{
+  MetaFile *mf = g_malloc0 ( sizeof(MetaFile) );
+  mf->path = g_strdup ( path );
+  mf->checked = g_get_monotonic_time ();
+  mf->mtime = file_mtime ( path );
+
+  gchar *contents = NULL;
+  gsize len = 0;
+  if ( !g_file_get_contents ( path, &contents, &len, &mf->error ) )
+    return mf;
+
+  char log_msg[PATH_MAX];
+  int compressed = 0;
+  log_msg[0] = '\0';
+  if ( metatile_index ( contents, len, mf->offsets, mf->sizes, &compressed, log_msg ) < 0 ) {
+    g_set_error ( &mf->error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s: %s", path, g_strchomp(log_msg) );
+    g_free ( contents );
+    return mf;
+  }
+  mf->compressed = compressed;
+  mf->data = g_bytes_new_take ( contents, len );
+  return mf;
+}
+
+/**
+ * Whether the kept metatile still reflects the file
+ */
+static gboolean metafile_current ( MetaFile *mf, gint64 now )
+{
+  if ( now - mf->checked < CHECK_INTERVAL )
+    return TRUE;
+  if ( file_mtime(mf->path) != mf->mtime )
+    return FALSE;
+  mf->checked = now;
+  return TRUE;
+}
+
+/**
+ * Keep the metatile, replacing any other version of it
+ *  and dropping the least recently used metatiles beyond the cache size
+ */
+static void metafile_add ( MetaFile *mf )
+{
+  GList *old = g_hash_table_lookup ( metafiles, mf->path );
+  if ( old ) {
+    g_hash_table_remove ( metafiles, mf->path );
+    metafile_free ( old->data );
+    g_queue_delete_link ( &lru, old );
+  }
+  g_queue_push_head ( &lru, mf );
+  g_hash_table_insert ( metafiles, mf->path, lru.head );
+
+  while ( lru.length > CACHE_SIZE ) {
+    MetaFile *oldest = g_queue_pop_tail ( &lru );
+    g_hash_table_remove ( metafiles, oldest->path );
+    metafile_free ( oldest );
+  }
+}
+
+/**
+ * Returns: The tile within the kept metatile (sharing the memory of the whole file)
+ */
+static GBytes *metafile_get_tile ( MetaFile *mf, gint offset, gboolean *compressed, GError **error )
+{
+  if ( !mf->data ) {
+    if ( error )
+      *error = g_error_copy ( mf->error );
+    return NULL;
+  }
+  if ( mf->sizes[offset] == 0 ) {
+    g_set_error ( error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "%s: No data for tile %d", mf->path, offset );
+    return NULL;
+  }
+  if ( compressed )
+    *compressed = mf->compressed;
+  return g_bytes_new_from_bytes ( mf->data, mf->offsets[offset], mf->sizes[offset] );
+}
+
+/**
+ * a_metatile_cache_get:
+ * @dir: The base directory of the renderd tiles
+ * @compressed: Returns whether the tile data is in a compressed format
+ *
+ * Returns: The image data of the tile or NULL if not available (with the reason in @error)
+ */
+GBytes *a_metatile_cache_get ( const gchar *dir, gint x, gint y, gint z, gboolean *compressed, GError **error )
+{
+  char path[PATH_MAX];
+  gint offset = xyz_to_meta ( path, sizeof(path), dir, x, y, z );
+
+  if ( !mf_mutex )
+    return NULL;
+
+  GBytes *bytes = NULL;
+  gboolean found = FALSE;
+  g_mutex_lock ( mf_mutex );
+  GList *link = metafiles ? g_hash_table_lookup ( metafiles, path ) : NULL;
+  if ( link && metafile_current ( link->data, g_get_monotonic_time() ) ) {
+    g_queue_unlink ( &lru, link );
+    g_queue_push_head_link ( &lru, link );
+    bytes = metafile_get_tile ( link->data, offset, compressed, error );
+    found = TRUE;
+  }
+  g_mutex_unlock ( mf_mutex );
+  if ( found )
+    return bytes;
+
+  // Read outside of the lock, so other threads can still use the kept metatiles
+  MetaFile *mf = metafile_read ( path );
+  g_mutex_lock ( mf_mutex );
+  bytes = metafile_get_tile ( mf, offset, compressed, error );
+  if ( metafiles )
+    metafile_add ( mf );
+  else
+    metafile_free ( mf );
+  g_mutex_unlock ( mf_mutex );
+  return bytes;
+}
+
+/**
+ * a_metatile_cache_flush:
+ *
+ * Forget all the metatiles, so the files will be read again
+ */
+void a_metatile_cache_flush ()
+{
+  if ( !mf_mutex )
+    return;
+  g_mutex_lock ( mf_mutex );
+  if ( metafiles )
+    g_hash_table_remove_all ( metafiles );
+  g_queue_foreach ( &lru, (GFunc)metafile_free, NULL );
+  g_queue_clear ( &lru );
+  g_mutex_unlock ( mf_mutex );
+}
+
+void a_metatile_cache_init ()
+{
+  gint gitmp = 0;
+  if ( a_settings_get_integer ( VIK_SETTINGS_METATILE_CACHE_SIZE, &gitmp ) && gitmp > 0 )
+    CACHE_SIZE = gitmp;
+
+  mf_mutex = vik_mutex_new ();
+  metafiles = g_hash_table_new ( g_str_hash, g_str_equal );
+}
+
+void a_metatile_cache_uninit ()
+{
+  a_metatile_cache_flush ();
+  g_mutex_lock ( mf_mutex );
+  g_hash_table_destroy ( metafiles );
+  metafiles = NULL;
+  g_mutex_unlock ( mf_mutex );
+  vik_mutex_free ( mf_mutex );
+  mf_mutex = NULL;
+}
@@ -0,0 +1,38 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __VIKING_METATILECACHE_H
+#define __VIKING_METATILECACHE_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+// Keeps recently read renderd metatiles in memory,
+//  so the tiles within a metatile are served from a single read of the file.
+
+void a_metatile_cache_init ();
+void a_metatile_cache_uninit ();
+
+GBytes *a_metatile_cache_get ( const gchar *dir, gint x, gint y, gint z, gboolean *compressed, GError **error );
+void a_metatile_cache_flush ();
+
+G_END_DECLS
+
+#endif
@@ -51,6 +51,8 @@
 #endif
 
 static gchar* thumb_dir = NULL;
+// Loaded up front as the icon theme can only be used from the main thread
+static GdkPixbuf *default_thumbnail = NULL;
 
 #ifdef WINDOWS
 static void set_thumb_dir ()
@@ -84,9 +86,13 @@ gboolean a_thumbnails_exists ( const gchar *filename )
   return FALSE;
 }
 
+/**
+ * Returns a new reference to the 'not yet loaded' image
+ * Can be called from any thread
+ */
 GdkPixbuf *a_thumbnails_get_default ()
 {
-  return ui_get_icon ( "thumbnails", 128 );
+  return default_thumbnail ? g_object_ref ( default_thumbnail ) : NULL;
 }
 
 /* filename must be absolute. you could have a function to make sure it exists and absolutize it */
@@ -311,9 +317,12 @@ out:
 void a_thumbnails_init ()
 {
   set_thumb_dir ();
+  default_thumbnail = ui_get_icon ( "thumbnails", 128 );
 }
 
 void a_thumbnails_uninit ()
 {
   g_free ( thumb_dir );
+  if ( default_thumbnail )
+    g_object_unref ( default_thumbnail );
 }
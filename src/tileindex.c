@@ -0,0 +1,342 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include "tileindex.h"
+#include "settings.h"
+#include "vik_compat.h"
+
+/*
+ * Drawing, planning downloads and estimating download sizes all need to know whether tiles exist,
+ *  which on large caches or network filesystems means many thousands of file tests.
+ *
+ * Instead each zoom level directory is scanned once in the background,
+ *  recording the tiles present (and their modification times).
+ * Until the scan completes lookups return TILE_INDEX_UNKNOWN, so callers fall back to testing the file.
+ * Downloads and deletions keep the index current, and the directory is rescanned occasionally
+ *  to pick up changes made by other programs.
+ */
+
+#define VIK_SETTINGS_MAP_TILE_INDEX "maps_tile_index"
+static gboolean USE_INDEX = TRUE;
+// Seconds
+#define VIK_SETTINGS_MAP_TILE_INDEX_RESCAN "maps_tile_index_rescan"
+static gint RESCAN_INTERVAL = 300;
+
+typedef struct {
+  gint x;
+  gint y;
+  time_t mtime;
+} TileEntry;
+
+typedef struct {
+  gchar *dir;         // The zoom level directory
+  gchar *suffix;      // Of the tile file names (e.g. ".png")
+  GHashTable *tiles;  // Set of TileEntry
+  gboolean ready;     // Whether the tiles are known
+  gboolean scanning;
+  gint64 scanned;     // When the last scan completed
+} ZoomIndex;
+
+typedef struct {
+  gchar *dir;
+  gchar *suffix;
+  time_t started;
+} ScanJob;
+
+static GHashTable *zooms = NULL; // dir -> ZoomIndex
+static GMutex *ti_mutex = NULL;
+static GThreadPool *scan_pool = NULL;
+static gboolean stopping = FALSE;
+
+static guint tile_entry_hash ( gconstpointer key )
+{
+  const TileEntry *te = key;
+  return ((guint)te->x * 0x9E3779B1u) ^ (guint)te->y;
+}
+
+static gboolean tile_entry_equal ( gconstpointer a, gconstpointer b )
+{
+  const TileEntry *ta = a, *tb = b;
+  return ta->x == tb->x && ta->y == tb->y;
+}
+
+static GHashTable *tile_set_new ()
+{
+  return g_hash_table_new_full ( tile_entry_hash, tile_entry_equal, g_free, NULL );
+}
+
+static void tile_set_add ( GHashTable *tiles, gint x, gint y, time_t mtime )
+{
+  TileEntry *te = g_malloc ( sizeof(TileEntry) );
+  te->x = x;
+  te->y = y;
+  te->mtime = mtime;
+  g_hash_table_add ( tiles, te );
+}
+
+static void zoom_index_free ( ZoomIndex *zi )
+{
+  g_hash_table_destroy ( zi->tiles );
+  g_free ( zi->dir );
+  g_free ( zi->suffix );
+  g_free ( zi );
+}
+
+static void scan_job_free ( ScanJob *job )
+{
+  g_free ( job->dir );
+  g_free ( job->suffix );
+  g_free ( job );
+}
+
+/**
+ * Split a tile file name into its zoom level directory, x and y values and the remaining suffix
+ */
+static gboolean split_filename ( const gchar *filename, gchar **dir, gint *x, gint *y, const gchar **suffix )
+{
+  const gchar *ysep = strrchr ( filename, G_DIR_SEPARATOR );
+  if ( !ysep || ysep == filename )
+    return FALSE;
+  const gchar *xsep = g_strrstr_len ( filename, ysep - filename, G_DIR_SEPARATOR_S );
+  if ( !xsep )
+    return FALSE;
+
+  gchar *end = NULL;
+  *x = (gint)g_ascii_strtoll ( xsep+1, &end, 10 );
+  if ( end == xsep+1 || end != ysep )
+    return FALSE;
+  *y = (gint)g_ascii_strtoll ( ysep+1, &end, 10 );
+  if ( end == ysep+1 )
+    return FALSE;
+
+  *suffix = end;
+  *dir = g_strndup ( filename, xsep - filename );
+  return TRUE;
+}
+
+/**
+ * Parse the whole of a name as an integer
+ */
+static gboolean parse_int ( const gchar *name, const gchar *suffix, gint *value )
+{
+  gchar *end = NULL;
+  *value = (gint)g_ascii_strtoll ( name, &end, 10 );
+  return ( end != name && g_strcmp0 ( end, suffix ) == 0 );
+}
+
+/**
+ * Find all the tiles of a zoom level (in a background thread)
+ */
+static void scan_thread ( ScanJob *job, gpointer user_data )
+{
+  GHashTable *tiles = tile_set_new ();
+  GDir *zdir = g_dir_open ( job->dir, 0, NULL );
+  if ( zdir ) {
+    const gchar *xname;
+    while ( !stopping && (xname = g_dir_read_name ( zdir )) ) {
+      gint x;
+      if ( !parse_int ( xname, "", &x ) )
+        continue;
+      gchar *xpath = g_build_filename ( job->dir, xname, NULL );
+      GDir *xdir = g_dir_open ( xpath, 0, NULL );
+      if ( xdir ) {
+        const gchar *yname;
+        while ( !stopping && (yname = g_dir_read_name ( xdir )) ) {
+          gint y;
+          if ( !parse_int ( yname, job->suffix, &y ) )
+            continue;
+          gchar *ypath = g_build_filename ( xpath, yname, NULL );
+          GStatBuf stat_buf;
+          if ( g_stat ( ypath, &stat_buf ) == 0 )
+            tile_set_add ( tiles, x, y, stat_buf.st_mtime );
+          g_free ( ypath );
+        }
+        g_dir_close ( xdir );
+      }
+      g_free ( xpath );
+    }
+    g_dir_close ( zdir );
+  }
+
+  g_mutex_lock ( ti_mutex );
+  ZoomIndex *zi = ( zooms && !stopping ) ? g_hash_table_lookup ( zooms, job->dir ) : NULL;
+  if ( zi ) {
+    // Keep any tiles downloaded whilst scanning
+    GHashTableIter iter;
+    TileEntry *te;
+    g_hash_table_iter_init ( &iter, zi->tiles );
+    while ( g_hash_table_iter_next ( &iter, (gpointer*)&te, NULL ) )
+      if ( te->mtime >= job->started && !g_hash_table_contains ( tiles, te ) )
+        tile_set_add ( tiles, te->x, te->y, te->mtime );
+    g_hash_table_destroy ( zi->tiles );
+    zi->tiles = tiles;
+    zi->ready = TRUE;
+    zi->scanning = FALSE;
+    zi->scanned = g_get_monotonic_time ();
+    g_debug ( "%s: %s has %d tiles", __FUNCTION__, job->dir, g_hash_table_size(tiles) );
+  }
+  else
+    g_hash_table_destroy ( tiles );
+  g_mutex_unlock ( ti_mutex );
+
+  scan_job_free ( job );
+}
+
+/**
+ * Must be called with the lock held
+ */
+static void zoom_index_scan ( ZoomIndex *zi )
+{
+  ScanJob *job = g_malloc ( sizeof(ScanJob) );
+  job->dir = g_strdup ( zi->dir );
+  job->suffix = g_strdup ( zi->suffix );
+  job->started = time ( NULL );
+  zi->scanning = TRUE;
+  g_thread_pool_push ( scan_pool, job, NULL );
+}
+
+/**
+ * a_tile_index_lookup:
+ * @filename: The tile file
+ * @mtime:    Optionally return the modification time of the file
+ *
+ * The first lookup within a zoom level directory starts indexing that directory.
+ *
+ * Returns: Whether the file exists, or TILE_INDEX_UNKNOWN if the directory has not been indexed yet.
+ */
+TileIndexState a_tile_index_lookup ( const gchar *filename, time_t *mtime )
+{
+  if ( !USE_INDEX || !ti_mutex )
+    return TILE_INDEX_UNKNOWN;
+
+  gchar *dir;
+  gint x, y;
+  const gchar *suffix;
+  if ( !split_filename ( filename, &dir, &x, &y, &suffix ) )
+    return TILE_INDEX_UNKNOWN;
+
+  TileIndexState state = TILE_INDEX_UNKNOWN;
+  g_mutex_lock ( ti_mutex );
+  if ( zooms ) {
+    ZoomIndex *zi = g_hash_table_lookup ( zooms, dir );
+    if ( !zi ) {
+      zi = g_malloc0 ( sizeof(ZoomIndex) );
+      zi->dir = dir;
+      dir = NULL;
+      zi->suffix = g_strdup ( suffix );
+      zi->tiles = tile_set_new ();
+      g_hash_table_insert ( zooms, zi->dir, zi );
+      zoom_index_scan ( zi );
+    }
+    else if ( zi->ready && !zi->scanning &&
+              (g_get_monotonic_time() - zi->scanned) > (gint64)RESCAN_INTERVAL * G_USEC_PER_SEC )
+      zoom_index_scan ( zi );
+
+    if ( zi->ready ) {
+      TileEntry key = { x, y, 0 };
+      TileEntry *te = g_hash_table_lookup ( zi->tiles, &key );
+      state = te ? TILE_INDEX_EXISTS : TILE_INDEX_MISSING;
+      if ( te && mtime )
+        *mtime = te->mtime;
+    }
+  }
+  g_mutex_unlock ( ti_mutex );
+  g_free ( dir );
+  return state;
+}
+
+/**
+ * a_tile_index_add:
+ *
+ * Record that the tile file has been (re)written
+ */
+void a_tile_index_add ( const gchar *filename, time_t mtime )
+{
+  gchar *dir;
+  gint x, y;
+  const gchar *suffix;
+  if ( !ti_mutex || !split_filename ( filename, &dir, &x, &y, &suffix ) )
+    return;
+
+  g_mutex_lock ( ti_mutex );
+  // Directories not yet indexed will find the file when scanned
+  ZoomIndex *zi = zooms ? g_hash_table_lookup ( zooms, dir ) : NULL;
+  if ( zi )
+    tile_set_add ( zi->tiles, x, y, mtime );
+  g_mutex_unlock ( ti_mutex );
+  g_free ( dir );
+}
+
+/**
+ * a_tile_index_remove:
+ *
+ * Record that the tile file has been removed (or found to be missing)
+ */
+void a_tile_index_remove ( const gchar *filename )
+{
+  gchar *dir;
+  gint x, y;
+  const gchar *suffix;
+  if ( !ti_mutex || !split_filename ( filename, &dir, &x, &y, &suffix ) )
+    return;
+
+  g_mutex_lock ( ti_mutex );
+  ZoomIndex *zi = zooms ? g_hash_table_lookup ( zooms, dir ) : NULL;
+  if ( zi ) {
+    TileEntry key = { x, y, 0 };
+    (void)g_hash_table_remove ( zi->tiles, &key );
+  }
+  g_mutex_unlock ( ti_mutex );
+  g_free ( dir );
+}
+
+void a_tile_index_init ()
+{
+  gboolean gbtmp = TRUE;
+  if ( a_settings_get_boolean ( VIK_SETTINGS_MAP_TILE_INDEX, &gbtmp ) )
+    USE_INDEX = gbtmp;
+  gint gitmp = 0;
+  if ( a_settings_get_integer ( VIK_SETTINGS_MAP_TILE_INDEX_RESCAN, &gitmp ) && gitmp > 0 )
+    RESCAN_INTERVAL = gitmp;
+
+  ti_mutex = vik_mutex_new ();
+  zooms = g_hash_table_new_full ( g_str_hash, g_str_equal, NULL, (GDestroyNotify)zoom_index_free );
+  // Scanning is limited by the filesystem, so one directory at a time
+  scan_pool = g_thread_pool_new ( (GFunc)scan_thread, NULL, 1, FALSE, NULL );
+}
+
+void a_tile_index_uninit ()
+{
+  // Abandon any scan in progress
+  stopping = TRUE;
+  g_thread_pool_free ( scan_pool, TRUE, TRUE );
+  scan_pool = NULL;
+
+  g_mutex_lock ( ti_mutex );
+  g_hash_table_destroy ( zooms );
+  zooms = NULL;
+  g_mutex_unlock ( ti_mutex );
+  vik_mutex_free ( ti_mutex );
+  ti_mutex = NULL;
+}
@@ -0,0 +1,47 @@
+/*
+ * viking -- GPS Data and Topo Analyzer, Explorer, and Manager
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef __VIKING_TILEINDEX_H
+#define __VIKING_TILEINDEX_H
+
+#include <glib.h>
+#include <time.h>
+
+G_BEGIN_DECLS
+
+// In memory record of which tile files exist in the cache directories,
+//  to avoid testing the filesystem for each tile.
+// Tiles are identified by their file name, which must be of the form '<zoom directory>/<x>/<y><suffix>'
+
+typedef enum {
+  TILE_INDEX_UNKNOWN = 0, // Not (yet) indexed - so check the file itself
+  TILE_INDEX_MISSING,
+  TILE_INDEX_EXISTS,
+} TileIndexState;
+
+void a_tile_index_init ();
+void a_tile_index_uninit ();
+
+TileIndexState a_tile_index_lookup ( const gchar *filename, time_t *mtime );
+void a_tile_index_add ( const gchar *filename, time_t mtime );
+void a_tile_index_remove ( const gchar *filename );
+
+G_END_DECLS
+
+#endif
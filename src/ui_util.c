@@ -231,6 +231,26 @@ GdkPixbuf *ui_pixbuf_new ( GdkColor *color, guint width, guint height )
 	return pixbuf;
 }
 
+/**
+ * Decode image file data (e.g. PNG or JPEG) held in memory
+ */
+GdkPixbuf *ui_pixbuf_new_from_bytes ( GBytes *bytes, GError **error )
+{
+	GdkPixbufLoader *loader = gdk_pixbuf_loader_new ();
+	GdkPixbuf *pixbuf = NULL;
+	if ( gdk_pixbuf_loader_write_bytes ( loader, bytes, error ) ) {
+		if ( gdk_pixbuf_loader_close ( loader, error ) ) {
+			pixbuf = gdk_pixbuf_loader_get_pixbuf ( loader );
+			if ( pixbuf )
+				g_object_ref ( pixbuf );
+		}
+	}
+	else
+		(void)gdk_pixbuf_loader_close ( loader, NULL );
+	g_object_unref ( loader );
+	return pixbuf;
+}
+
 /**
  * Apply the alpha value to the specified pixbuf
  */
@@ -46,6 +46,7 @@ GtkWidget *ui_attach_to_table ( GtkTable *table, int i, char *mylabel, GtkWidget
 GtkWidget *ui_create_table ( int cnt, char *labels[], GtkWidget *contents[], gchar *value_potentialURL[], guint spacing );
 
 GdkPixbuf *ui_pixbuf_new ( GdkColor *color, guint width, guint height );
+GdkPixbuf *ui_pixbuf_new_from_bytes ( GBytes *bytes, GError **error );
 GdkPixbuf *ui_pixbuf_set_alpha ( GdkPixbuf *pixbuf, guint8 alpha );
 GdkPixbuf *ui_pixbuf_scale_alpha ( GdkPixbuf *pixbuf, guint8 alpha );
 GdkPixbuf *ui_pixbuf_rotate_full ( GdkPixbuf *pixbuf, gdouble degrees );
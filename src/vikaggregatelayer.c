@@ -1272,7 +1272,7 @@ static void hm_draw ( VikAggregateLayer *val, VikViewport *vp )
 
   if ( BBOX_INTERSECT ( bbox, val->hm_bbox ) ) {
 
-    clock_t begin, end;
+    gint64 begin, end;
 
     gint zz = (gint)vik_viewport_get_zoom ( vp );
     // Avoid excessive image scaling as it will be too slow
@@ -1301,13 +1301,14 @@ static void hm_draw ( VikAggregateLayer *val, VikViewport *vp )
         val->hm_scaled = TRUE;
         GdkInterpType interp_type = GDK_INTERP_BILINEAR;
         // When scaling up: use the fastest method (as scaling up is much slower than scaling down)
-        //  especially since this is being performed in the main thread
+        //  especially when this is being performed in the main thread
         if ( val->hm_scaled_zoom < val->hm_zoom )
           interp_type = GDK_INTERP_NEAREST;
-        begin = clock();
+        // Elapsed rather than processor time, as other drawing may be going on in parallel
+        begin = g_get_monotonic_time();
         val->hm_pbf_scaled = gdk_pixbuf_scale_simple ( val->hm_pixbuf, ww, hh, interp_type );
-        end = clock();
-        double time_spent = (double)(end - begin) / CLOCKS_PER_SEC;
+        end = g_get_monotonic_time();
+        double time_spent = (double)(end - begin) / G_USEC_PER_SEC;
         // Last usable zoom-level as the next one is going to be an order of magnitude worse or more
         if ( interp_type == GDK_INTERP_NEAREST && time_spent > 0.05 )
           val->hm_zoom_max = zz;
@@ -1334,17 +1335,39 @@ static void hm_draw ( VikAggregateLayer *val, VikViewport *vp )
  */
 void vik_aggregate_layer_draw ( VikAggregateLayer *val, VikViewport *vp )
 {
-  GList *iter = val->children;
-  while ( iter ) {
-    vik_layer_draw ( VIK_LAYER(iter->data), vp );
-    iter = iter->next;
+  // Any layers that can be drawn in parallel are all started off first,
+  //  then everything is put together in order (with the other layers drawn here in the meantime)
+  guint nn = g_list_length ( val->children );
+  VikViewportDrawJob **jobs = g_new0 ( VikViewportDrawJob*, nn );
+  guint ii = 0;
+  for ( GList *iter = val->children; iter; iter = iter->next, ii++ )
+    jobs[ii] = vik_layer_draw_start ( VIK_LAYER(iter->data), vp );
+
+  // Rescaling the heatmap can take a while too
+  VikViewportDrawJob *hm_job = NULL;
+  gboolean draw_hm = !val->hm_calculating && val->hm_pixbuf;
+  if ( draw_hm )
+    hm_job = vik_layer_draw_start_func ( VIK_LAYER(val), vp, (VikViewportCacheDrawFunc)hm_draw, val );
+
+  ii = 0;
+  for ( GList *iter = val->children; iter; iter = iter->next, ii++ ) {
+    if ( jobs[ii] )
+      vik_layer_draw_finish ( VIK_LAYER(iter->data), vp, jobs[ii] );
+    else
+      vik_layer_draw ( VIK_LAYER(iter->data), vp );
   }
+  g_free ( jobs );
+
   // Make coverage to be drawn last (i.e. over the top of any maps)
   if ( val->on[BASIC] ) {
     tac_draw ( val, vp );
   }
 
-  if ( !val->hm_calculating && val->hm_pixbuf ) {
+  if ( hm_job ) {
+    vik_viewport_draw_job_paint ( hm_job, vp );
+    vik_viewport_draw_job_free ( hm_job );
+  }
+  else if ( draw_hm ) {
     hm_draw ( val, vp );
   }
 }
@@ -25,6 +25,7 @@
 
 static VikCoordLayer *coord_layer_new ( VikViewport *vp );
 static void coord_layer_draw ( VikCoordLayer *vcl, VikViewport *vp );
+static gboolean coord_layer_draw_threadsafe ( VikCoordLayer *vcl );
 static void coord_layer_free ( VikCoordLayer *vcl );
 static VikCoordLayer *coord_layer_create ( VikViewport *vp );
 static void coord_layer_marshall( VikCoordLayer *vcl, guint8 **data, guint *len );
@@ -128,6 +129,10 @@ VikLayerInterface vik_coord_layer_interface = {
   (VikLayerFuncSelectedViewportMenu)    NULL,
 
   (VikLayerFuncRefresh)                 NULL,
+
+  (VikLayerDrawCache)                   VIK_LAYER_DRAW_CACHE_VIEW,
+
+  (VikLayerFuncDrawThreadsafe)          coord_layer_draw_threadsafe,
 };
 
 struct _VikCoordLayer {
@@ -235,6 +240,12 @@ static VikCoordLayer *coord_layer_new ( VikViewport *vvp )
   return vcl;
 }
 
+// Only draws lines
+static gboolean coord_layer_draw_threadsafe ( VikCoordLayer *vcl )
+{
+  return TRUE;
+}
+
 static void coord_layer_draw ( VikCoordLayer *vcl, VikViewport *vp )
 {
   if ( !vcl->gc ) {
@@ -68,6 +68,7 @@ static gchar *base_url = NULL;
 
 static VikDEMLayer *dem_layer_new ( VikViewport *vvp );
 static void dem_layer_draw ( VikDEMLayer *vdl, VikViewport *vp );
+static gboolean dem_layer_draw_threadsafe ( VikDEMLayer *vdl );
 static void dem_layer_free ( VikDEMLayer *vdl );
 static VikDEMLayer *dem_layer_create ( VikViewport *vp );
 static const gchar* dem_layer_tooltip( VikDEMLayer *vdl );
@@ -342,6 +343,10 @@ VikLayerInterface vik_dem_layer_interface = {
   (VikLayerFuncSelectedViewportMenu)    NULL,
 
   (VikLayerFuncRefresh)                 NULL,
+
+  (VikLayerDrawCache)                   VIK_LAYER_DRAW_CACHE_PAN,
+
+  (VikLayerFuncDrawThreadsafe)          dem_layer_draw_threadsafe,
 };
 
 struct _VikDEMLayer {
@@ -367,6 +372,9 @@ struct _VikDEMLayer {
   GdkColor *gradient_colors;
 
   guchar *pixels;
+  // The parts of the view being drawn, whilst drawing
+  GdkRectangle *area;
+  gint n_area;
 
   // right click menu only stuff - similar to mapslayer
   GtkMenu *right_click_menu;
@@ -989,6 +997,10 @@ static void vik_dem_layer_draw_dem ( VikDEMLayer *vdl, VikViewport *vp, VikDEM *
           if ( (box_x > width) || (box_y > height) )
             continue;
 
+          // Or not in the part of the view being drawn
+          if ( !vik_viewport_draw_area_contains ( vdl->area, vdl->n_area, box_x, box_y, box_width, box_height ) )
+            continue;
+
           gboolean minimum_level = FALSE;
           if(vdl->type == DEM_TYPE_HEIGHT) {
             if ( elev != VIK_DEM_INVALID_ELEVATION && elev <= vdl->min_elev ) {
@@ -1148,6 +1160,8 @@ static void vik_dem_layer_draw_dem ( VikDEMLayer *vdl, VikViewport *vp, VikDEM *
             // Check a & b are in bounds:
             if ( a < 0 || b < 0 || (a > width) || (b > height) )
               continue;
+            if ( !vik_viewport_draw_area_contains ( vdl->area, vdl->n_area, a-1, b-1, 2, 2 ) )
+              continue;
             if ( elev == VIK_DEM_INVALID_ELEVATION )
               ; /* don't draw it */
             else if ( elev <= 0 ) {
@@ -1174,19 +1188,21 @@ static const gchar *srtm_continent_dir ( gint lat, gint lon )
   const gchar *continent;
   gchar name[16];
 
-  if (!srtm_continent) {
+  // Drawing may be in any thread
+  if (g_once_init_enter(&srtm_continent)) {
     const gchar **s;
 
-    srtm_continent = g_hash_table_new(g_str_hash, g_str_equal);
+    GHashTable *table = g_hash_table_new(g_str_hash, g_str_equal);
     s = _srtm_continent_data;
     while (*s != (gchar *)-1) {
       continent = *s++;
       while (*s) {
-        g_hash_table_insert(srtm_continent, (gpointer) *s, (gpointer) continent);
+        g_hash_table_insert(table, (gpointer) *s, (gpointer) continent);
         s++;
       }
       s++;
     }
+    g_once_init_leave(&srtm_continent, table);
   }
   g_snprintf(name, sizeof(name), "%c%02d%c%03d",
                   (lat >= 0) ? 'N' : 'S', ABS(lat),
@@ -1215,6 +1231,7 @@ static void dem_layer_draw ( VikDEMLayer *vdl, VikViewport *vp )
 
   // RGBA, natural alignment of rows on 4 byte boundary
   vdl->pixels = g_malloc0 ( sizeof(guchar*) * width * height * 4 );
+  vdl->area = vik_viewport_get_draw_area ( vp, &vdl->n_area );
 
   while ( dems_iter ) {
     dem = a_dems_get ( (const char *) (dems_iter->data) );
@@ -1227,6 +1244,14 @@ static void dem_layer_draw ( VikDEMLayer *vdl, VikViewport *vp )
   vik_viewport_draw_pixbuf ( vp, pixbuf, 0, 0, 0, 0, width, height );
   g_object_unref ( pixbuf );
   g_free ( vdl->pixels );
+  g_free ( vdl->area );
+  vdl->area = NULL;
+}
+
+// Only draws into its own pixel buffer (and the file existence outlines)
+static gboolean dem_layer_draw_threadsafe ( VikDEMLayer *vdl )
+{
+  return TRUE;
 }
 
 static void dem_layer_free ( VikDEMLayer *vdl )
@@ -166,6 +166,8 @@ VikLayerInterface vik_georef_layer_interface = {
   (VikLayerFuncSelectedViewportMenu)    NULL,
 
   (VikLayerFuncRefresh)                 NULL,
+
+  (VikLayerDrawCache)                   VIK_LAYER_DRAW_CACHE_PAN,
 };
 
 typedef struct {
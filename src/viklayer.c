@@ -22,6 +22,7 @@
  */
 #include "viking.h"
 #include "viklayer_defaults.h"
+#include "drawstats.h"
 
 /* functions common to all layers. */
 /* TODO longone: rename interface free -> finalize */
@@ -107,6 +108,7 @@ static VikLayerInterface *vik_layer_interfaces[VIK_LAYER_NUM_TYPES] = {
  */
 void vik_layer_redraw ( VikLayer *vl )
 {
+  vik_viewport_cache_invalidate ( vl->draw_cache );
   if ( vl->visible && vl->realized ) {
     GThread *thread = vik_window_get_thread ( VIK_WINDOW(VIK_GTK_WINDOW_FROM_LAYER(vl)) );
     if ( !thread )
@@ -131,6 +133,8 @@ void vik_layer_redraw ( VikLayer *vl )
  */
 void vik_layer_emit_update ( VikLayer *vl, gboolean is_modified )
 {
+  // Whatever the layer draws may have changed
+  vik_viewport_cache_invalidate ( vl->draw_cache );
   if ( vl->visible && vl->realized ) {
     GThread *thread = vik_window_get_thread ( VIK_WINDOW(VIK_GTK_WINDOW_FROM_LAYER(vl)) );
     if ( !thread )
@@ -170,6 +174,7 @@ void vik_layer_emit_update ( VikLayer *vl, gboolean is_modified )
  */
 void vik_layer_emit_update_although_invisible ( VikLayer *vl )
 {
+  vik_viewport_cache_invalidate ( vl->draw_cache );
   (void)g_idle_add ( (GSourceFunc)idle_draw, vl );
 }
 
@@ -311,11 +316,135 @@ gboolean vik_layer_properties ( VikLayer *layer, VikViewport *vp, gboolean have_
   return vik_layer_properties_factory ( layer, vp, have_apply );
 }
 
+#define VIK_SETTINGS_LAYER_DRAW_CACHE "layers_draw_cache"
+
+/**
+ * Whether the layer should be drawn via its cache
+ * Only for the layer's own viewport as shown on the screen
+ *  (e.g. not when it has been resized to save an image)
+ */
+static gboolean layer_draw_cache_wanted ( VikLayer *l, VikViewport *vp )
+{
+  static gint draw_cache = -1;
+  if ( draw_cache < 0 ) {
+    gboolean tmp = TRUE;
+    (void)a_settings_get_boolean ( VIK_SETTINGS_LAYER_DRAW_CACHE, &tmp );
+    draw_cache = tmp;
+  }
+  return draw_cache &&
+    vik_layer_interfaces[l->type]->draw_cache != VIK_LAYER_DRAW_CACHE_NONE &&
+    l->realized && vp == l->vvp && !vik_viewport_is_off_screen ( vp );
+}
+
+/**
+ * Whilst panning some layers hold back on work such as downloading
+ *  so a drawing made then is only for shifting and is redone once panning has finished
+ */
+static gboolean layer_panning ( VikLayer *l )
+{
+  return vik_window_get_pan_move ( VIK_WINDOW(VIK_GTK_WINDOW_FROM_LAYER(l)) );
+}
+
+/**
+ * The layer's own drawing, timed for the draw statistics
+ */
+static void layer_draw_timed ( VikLayer *l, VikViewport *vp )
+{
+  // Aggregate layers are just the sum of their children
+  if ( l->type == VIK_LAYER_AGGREGATE ) {
+    vik_layer_interfaces[l->type]->draw ( l, vp );
+    return;
+  }
+  gint64 start = a_drawstats_layer_start ();
+  vik_layer_interfaces[l->type]->draw ( l, vp );
+  a_drawstats_layer_end ( l->name, start );
+}
+
 void vik_layer_draw ( VikLayer *l, VikViewport *vp )
 {
   if ( l->visible )
-    if ( vik_layer_interfaces[l->type]->draw )
-      vik_layer_interfaces[l->type]->draw ( l, vp );
+    if ( vik_layer_interfaces[l->type]->draw ) {
+      if ( layer_draw_cache_wanted ( l, vp ) ) {
+        if ( !l->draw_cache )
+          l->draw_cache = vik_viewport_cache_new ();
+        vik_viewport_cache_draw ( vp, l->draw_cache,
+                                  vik_layer_interfaces[l->type]->draw_cache == VIK_LAYER_DRAW_CACHE_PAN,
+                                  layer_panning ( l ),
+                                  (VikViewportCacheDrawFunc)layer_draw_timed, l );
+      }
+      else
+        layer_draw_timed ( l, vp );
+    }
+}
+
+/**
+ * vik_layer_draw_start_func:
+ *
+ * Start some drawing for the layer in another thread, when drawing in parallel is enabled.
+ * Only for the layer's own viewport.
+ *
+ * Returns: The drawing in progress to be put into the viewport in turn via vik_viewport_draw_job_paint(),
+ *  or NULL when it should just be drawn directly.
+ */
+static gboolean layer_draw_parallel_wanted ( VikLayer *l, VikViewport *vp )
+{
+  return l->realized && vp == l->vvp && a_vik_get_draw_layers_in_parallel();
+}
+
+VikViewportDrawJob *vik_layer_draw_start_func ( VikLayer *l, VikViewport *vp, VikViewportCacheDrawFunc func, gpointer data )
+{
+  if ( !layer_draw_parallel_wanted ( l, vp ) )
+    return NULL;
+  return vik_viewport_draw_job_start ( vp, func, data );
+}
+
+/**
+ * vik_layer_draw_start:
+ *
+ * Start drawing the layer in another thread, if its drawing is able to be done in parallel
+ *  and there is actually something to draw afresh.
+ * Any drawing started must be completed by vik_layer_draw_finish() (in order with the other layers),
+ *  otherwise (when NULL is returned) simply use vik_layer_draw().
+ */
+VikViewportDrawJob *vik_layer_draw_start ( VikLayer *l, VikViewport *vp )
+{
+  VikLayerInterface *vli = vik_layer_interfaces[l->type];
+  if ( !l->visible || !vli->draw || !vli->draw_threadsafe || !layer_draw_parallel_wanted ( l, vp ) )
+    return NULL;
+  // Nothing to be gained when the previous drawing is just going to be put back
+  if ( layer_draw_cache_wanted ( l, vp ) && l->draw_cache &&
+       vik_viewport_cache_is_current ( vp, l->draw_cache, layer_panning ( l ) ) )
+    return NULL;
+  // Last, as it prepares the layer for the draw that follows
+  if ( !vli->draw_threadsafe ( l ) )
+    return NULL;
+  // Via the cache only what it is missing gets drawn (e.g. the exposed edges when panning)
+  if ( layer_draw_cache_wanted ( l, vp ) ) {
+    if ( !l->draw_cache )
+      l->draw_cache = vik_viewport_cache_new ();
+    return vik_viewport_cache_draw_job_start ( vp, l->draw_cache, vli->draw_cache == VIK_LAYER_DRAW_CACHE_PAN, layer_panning ( l ),
+                                               (VikViewportCacheDrawFunc)layer_draw_timed, l );
+  }
+  return vik_viewport_draw_job_start ( vp, (VikViewportCacheDrawFunc)layer_draw_timed, l );
+}
+
+/**
+ * vik_layer_draw_finish:
+ *
+ * Put the drawing from vik_layer_draw_start() into the viewport (via the layer's cache as usual)
+ */
+void vik_layer_draw_finish ( VikLayer *l, VikViewport *vp, VikViewportDrawJob *job )
+{
+  if ( layer_draw_cache_wanted ( l, vp ) ) {
+    if ( !l->draw_cache )
+      l->draw_cache = vik_viewport_cache_new ();
+    vik_viewport_cache_draw_job ( vp, l->draw_cache,
+                                  vik_layer_interfaces[l->type]->draw_cache == VIK_LAYER_DRAW_CACHE_PAN,
+                                  layer_panning ( l ), job );
+  }
+  else
+    vik_viewport_draw_job_paint ( job, vp );
+  vik_viewport_draw_job_free ( job );
 }
 
 void vik_layer_configure ( VikLayer *l, VikViewport *vp )
@@ -511,6 +640,7 @@ static void vik_layer_finalize ( VikLayer *vl )
     vik_layer_interfaces[vl->type]->free ( vl );
   if ( vl->name )
     g_free ( vl->name );
+  vik_viewport_cache_free ( vl->draw_cache );
   G_OBJECT_CLASS(parent_class)->finalize(G_OBJECT(vl));
 }
 
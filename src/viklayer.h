@@ -63,6 +63,8 @@ struct _VikLayer {
 
   /* for explicit "polymorphism" (function type switching) */
   VikLayerTypeEnum type;
+
+  VikViewportCache *draw_cache; // Only for layer types that allow it
 };
 
 /* I think most of these are ignored,
@@ -203,8 +205,27 @@ typedef double        (*VikLayerFuncGetTimestamp)          (VikLayer *);
 //  useful to hook in a separate redraw
 typedef gboolean      (*VikLayerFuncRefresh)               (VikLayer *);
 
+// Whether the layer can currently be drawn outside of the main thread (i.e. in parallel with other layers)
+//  Such drawing must only use the vik_viewport_draw_*() functions
+//  (or direct drawing with a GC via vik_viewport_get_gc_target()) and not touch any GTK+ widgets
+//  (nor use Pango layouts from them).
+//  This is called in the main thread immediately before such a draw,
+//   so any state of the widgets that the drawing depends upon can be obtained here instead.
+typedef gboolean      (*VikLayerFuncDrawThreadsafe)        (VikLayer *);
+
 typedef struct _VikLayerInterface VikLayerInterface;
 
+/*
+ * Whether what a layer draws can be kept and reused, rather than the layer being drawn again.
+ * This requires what is drawn to only depend on the view and the layer itself,
+ *  and for the layer to call vik_layer_emit_update() (or vik_layer_redraw()) whenever that changes.
+ */
+typedef enum {
+  VIK_LAYER_DRAW_CACHE_NONE = 0, // Always drawn afresh
+  VIK_LAYER_DRAW_CACHE_VIEW,     // Reused whilst the view is unchanged
+  VIK_LAYER_DRAW_CACHE_PAN,      // Also shifted along when the view is panned, so only the newly exposed edges are drawn
+} VikLayerDrawCache;
+
 /* See vik_layer_* for function parameter names */
 struct _VikLayerInterface {
   const gchar *                     fixed_layer_name; // Used in .vik files - this should never change to maintain file compatibility
@@ -275,6 +296,10 @@ struct _VikLayerInterface {
   VikLayerFuncSelectedViewportMenu  show_viewport_menu;
 
   VikLayerFuncRefresh               refresh;
+
+  VikLayerDrawCache                 draw_cache;
+
+  VikLayerFuncDrawThreadsafe        draw_threadsafe;
 };
 
 VikLayerInterface *vik_layer_get_interface ( VikLayerTypeEnum type );
@@ -282,6 +307,9 @@ VikLayerInterface *vik_layer_get_interface ( VikLayerTypeEnum type );
 
 void vik_layer_set_type ( VikLayer *vl, VikLayerTypeEnum type );
 void vik_layer_draw ( VikLayer *l, VikViewport *vp );
+VikViewportDrawJob *vik_layer_draw_start_func ( VikLayer *l, VikViewport *vp, VikViewportCacheDrawFunc func, gpointer data );
+VikViewportDrawJob *vik_layer_draw_start ( VikLayer *l, VikViewport *vp );
+void vik_layer_draw_finish ( VikLayer *l, VikViewport *vp, VikViewportDrawJob *job );
 void vik_layer_configure ( VikLayer *l, VikViewport *vp );
 void vik_layer_change_coord_mode ( VikLayer *l, VikCoordMode mode );
 void vik_layer_rename ( VikLayer *l, const gchar *new_name );
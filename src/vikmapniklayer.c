@@ -28,6 +28,8 @@
 #include "mapcache.h"
 #include "dir.h"
 #include "mapnik_interface.h"
+#include "mbtilescache.h"
+#include "cachequota.h"
 #include "background.h"
 
 #include "vikmapslayer.h"
@@ -48,6 +50,7 @@ static VikLayerParamData file_default ( void )
 
 static VikLayerParamData size_default ( void ) { return VIK_LPD_UINT ( 256 ); }
 static VikLayerParamData alpha_default ( void ) { return VIK_LPD_UINT ( 255 ); }
+static VikLayerParamData metatile_default ( void ) { return VIK_LPD_UINT ( 8 ); }
 
 static VikLayerParamData cache_dir_default ( void )
 {
@@ -60,6 +63,7 @@ static VikLayerParamScale scales[] = {
 	{ 0, 255, 5, 0 }, // Alpha
 	{ 64, 1024, 8, 0 }, // Tile size
 	{ 0, 1024, 12, 0 }, // Rerender timeout hours
+	{ 1, 16, 1, 0 }, // Metatile size
 };
 
 static void reset_cb ( GtkWidget *widget, gpointer ptr )
@@ -80,6 +84,8 @@ VikLayerParam mapnik_layer_params[] = {
     NULL, vik_lpd_true_default, NULL, NULL },
   { VIK_LAYER_MAPNIK, "file-cache-dir", VIK_LAYER_PARAM_STRING, VIK_LAYER_GROUP_NONE, N_("File Cache Directory:"), VIK_LAYER_WIDGET_FOLDERENTRY, NULL, NULL,
     NULL, cache_dir_default, NULL, NULL },
+  { VIK_LAYER_MAPNIK, "metatile-size", VIK_LAYER_PARAM_UINT, VIK_LAYER_GROUP_NONE, N_("Metatile Size:"), VIK_LAYER_WIDGET_SPINBUTTON, &scales[3], NULL,
+    N_("Tiles are rendered in blocks of this many tiles across and down, so labels are placed once for the whole block. Set to 1 to render each tile individually."), metatile_default, NULL, NULL },
   { VIK_LAYER_MAPNIK, "reset", VIK_LAYER_PARAM_PTR_DEFAULT, VIK_LAYER_GROUP_NONE, NULL,
     VIK_LAYER_WIDGET_BUTTON, N_("Reset to Defaults"), NULL, NULL, reset_default, NULL, NULL },
 };
@@ -90,6 +96,7 @@ enum {
   PARAM_ALPHA,
   PARAM_USE_FILE_CACHE,
   PARAM_FILE_CACHE_DIR,
+  PARAM_METATILE_SIZE,
   PARAM_RESET,
   NUM_PARAMS };
 
@@ -103,6 +110,7 @@ static VikMapnikLayer *mapnik_layer_create ( VikViewport *vp );
 static void mapnik_layer_free ( VikMapnikLayer *vml );
 static void mapnik_layer_draw ( VikMapnikLayer *vml, VikViewport *vp );
 static void mapnik_layer_add_menu_items ( VikMapnikLayer *vml, GtkMenu *menu, gpointer vlp, VikStdLayerMenuItem selection );
+static void mapnik_layer_set_cache_db ( VikMapnikLayer *vml );
 
 static gpointer mapnik_feature_create ( VikWindow *vw, VikViewport *vvp)
 {
@@ -198,8 +206,14 @@ VikLayerInterface vik_mapnik_layer_interface = {
 	(VikLayerFuncSelectedViewportMenu)    NULL,
 
 	(VikLayerFuncRefresh)                 NULL,
+
+	(VikLayerDrawCache)                   VIK_LAYER_DRAW_CACHE_PAN,
 };
 
+typedef struct _RenderScheduler RenderScheduler;
+static RenderScheduler *render_scheduler_new ( VikMapnikLayer *vml );
+static void render_scheduler_detach ( RenderScheduler *rs );
+
 struct _VikMapnikLayer {
 	VikLayer vl;
 	gchar *filename_css; // CartoCSS MML File - use 'carto' to convert into xml
@@ -213,6 +227,9 @@ struct _VikMapnikLayer {
 
 	gboolean use_file_cache;
 	gchar *file_cache_dir;
+	gchar *cache_dbname; // When the file cache is an MBTiles database for the loaded style
+	RenderScheduler *scheduler;
+	guint metatile_size; // Number of tiles across (and down) rendered in one go
 
 	VikCoord rerender_ul;
 	VikCoord rerender_br;
@@ -423,6 +440,12 @@ static gboolean mapnik_layer_set_param ( VikMapnikLayer *vml, VikLayerSetParam *
 			break;
 		case PARAM_FILE_CACHE_DIR:
 			changed = vik_layer_param_change_string ( vlsp->data, &vml->file_cache_dir );
+			if ( changed && vml->loaded )
+				mapnik_layer_set_cache_db ( vml );
+			break;
+		case PARAM_METATILE_SIZE:
+			if ( vlsp->data.u >= scales[3].min && vlsp->data.u <= scales[3].max )
+				changed = vik_layer_param_change_uint ( vlsp->data, &vml->metatile_size );
 			break;
 		default: break;
 	}
@@ -472,6 +495,7 @@ static VikLayerParamData mapnik_layer_get_param ( VikMapnikLayer *vml, guint16 i
 		case PARAM_ALPHA: data.u = vml->alpha; break;
 		case PARAM_USE_FILE_CACHE: data.b = vml->use_file_cache; break;
 		case PARAM_FILE_CACHE_DIR: data.s = vml->file_cache_dir; break;
+		case PARAM_METATILE_SIZE: data.u = vml->metatile_size; break;
 		case PARAM_RESET: data.ptr = reset_cb; break;
 		default: break;
 	}
@@ -489,6 +513,7 @@ static VikMapnikLayer *mapnik_layer_new ( VikViewport *vvp )
 	vml->tile_size_x = size_default().u; // FUTURE: Is there any use in this being configurable?
 	vml->loaded = FALSE;
 	vml->mi = mapnik_interface_new();
+	vml->scheduler = render_scheduler_new ( vml );
 	return vml;
 }
 
@@ -573,6 +598,100 @@ gboolean carto_load ( VikMapnikLayer *vml, VikViewport *vvp )
 	return answer;
 }
 
+/**
+ * A hash of the style configuration, so tiles rendered with a different style are kept apart
+ *
+ * Free returned string after use
+ */
+static gchar *get_style_hash ( VikMapnikLayer *vml )
+{
+	GChecksum *checksum = g_checksum_new ( G_CHECKSUM_SHA256 );
+	const gchar *files[2] = { vml->filename_css, vml->filename_xml };
+	for ( guint ii = 0; ii < G_N_ELEMENTS(files); ii++ ) {
+		gchar *contents = NULL;
+		gsize length = 0;
+		if ( files[ii] && strlen(files[ii]) > 1 && g_file_get_contents ( files[ii], &contents, &length, NULL ) ) {
+			g_checksum_update ( checksum, (const guchar*)contents, length );
+			g_free ( contents );
+		}
+	}
+	gchar *hash = g_strdup ( g_checksum_get_string ( checksum ) );
+	g_checksum_free ( checksum );
+	return hash;
+}
+
+/**
+ * Remove the databases of other versions of the style for the same tile size,
+ *  as tiles rendered with them will not be used again
+ */
+static void mapnik_layer_remove_old_cache_dbs ( VikMapnikLayer *vml, const gchar *basename )
+{
+	GDir *dir = g_dir_open ( vml->file_cache_dir, 0, NULL );
+	if ( !dir )
+		return;
+	gchar *prefix = g_strdup_printf ( "%s-", basename );
+	gchar *suffix = g_strdup_printf ( "-%d.mbtiles", vml->tile_size_x );
+	const gchar *name;
+	while ( (name = g_dir_read_name ( dir )) ) {
+		// Only names as made by mapnik_layer_set_cache_db()
+		if ( strlen(name) != strlen(prefix) + 16 + strlen(suffix) ||
+		     !g_str_has_prefix ( name, prefix ) || !g_str_has_suffix ( name, suffix ) )
+			continue;
+		gchar *fn = g_build_filename ( vml->file_cache_dir, name, NULL );
+		if ( g_strcmp0 ( fn, vml->cache_dbname ) ) {
+			if ( g_remove ( fn ) == 0 ) {
+				a_cache_quota_remove ( fn );
+				const gchar *journals[2] = { "-wal", "-shm" };
+				for ( guint ii = 0; ii < G_N_ELEMENTS(journals); ii++ ) {
+					gchar *journal = g_strconcat ( fn, journals[ii], NULL );
+					(void)g_remove ( journal );
+					g_free ( journal );
+				}
+			}
+			else
+				g_warning ( "%s: Failed to remove %s", __FUNCTION__, fn );
+		}
+		g_free ( fn );
+	}
+	g_free ( suffix );
+	g_free ( prefix );
+	g_dir_close ( dir );
+}
+
+/**
+ * Rendered tiles are kept in an MBTiles database per style (when possible)
+ *  rather than a file per tile.
+ * The database is named after the content of the style and the tile size,
+ *  so an edited style simply uses a new database (and the databases of previous versions are removed)
+ *  and layers of the same style with different tile sizes do not interfere with each other.
+ */
+static void mapnik_layer_set_cache_db ( VikMapnikLayer *vml )
+{
+	gchar *previous = vml->cache_dbname;
+	vml->cache_dbname = NULL;
+
+	if ( a_mbtiles_cache_available() && vml->file_cache_dir && vml->filename_xml && strlen(vml->filename_xml) ) {
+		// The stylesheet name is just to make the database recognizable
+		gchar *basename = g_path_get_basename ( vml->filename_xml );
+		gchar *ext = g_strrstr ( basename, "." );
+		if ( ext )
+			*ext = '\0';
+		gchar *hash = get_style_hash ( vml );
+		gchar *name = g_strdup_printf ( "%s-%.16s-%d.mbtiles", basename, hash, vml->tile_size_x );
+		vml->cache_dbname = g_build_filename ( vml->file_cache_dir, name, NULL );
+		if ( g_strcmp0 ( previous, vml->cache_dbname ) )
+			mapnik_layer_remove_old_cache_dbs ( vml, basename );
+		g_free ( name );
+		g_free ( hash );
+		g_free ( basename );
+	}
+
+	// Any tiles in memory may have been rendered with the previous style
+	if ( previous && g_strcmp0 ( previous, vml->cache_dbname ) )
+		a_mapcache_flush_type ( MAP_ID_MAPNIK_RENDER );
+	g_free ( previous );
+}
+
 /**
  *
  */
@@ -621,6 +740,7 @@ static void mapnik_layer_post_read (VikLayer *vl, VikViewport *vvp, gboolean fro
 	}
 	else {
 		vml->loaded = TRUE;
+		mapnik_layer_set_cache_db ( vml );
 		if ( !from_file )
 			ui_add_recent_file ( vml->filename_xml );
 	}
@@ -637,7 +757,21 @@ static gchar *get_filename ( gchar *dir, guint x, guint y, guint z)
 static void possibly_save_pixbuf ( VikMapnikLayer *vml, GdkPixbuf *pixbuf, MapCoord *ulm )
 {
 	if ( vml->use_file_cache ) {
-		if ( vml->file_cache_dir ) {
+		if ( vml->cache_dbname ) {
+			gchar *buffer = NULL;
+			gsize size = 0;
+			GError *error = NULL;
+			if ( gdk_pixbuf_save_to_buffer ( pixbuf, &buffer, &size, "png", &error, NULL ) ) {
+				GBytes *bytes = g_bytes_new_take ( buffer, size );
+				(void)a_mbtiles_cache_put ( vml->cache_dbname, ulm->x, ulm->y, (17-ulm->scale), bytes );
+				g_bytes_unref ( bytes );
+			}
+			else {
+				g_warning ("%s: %s", __FUNCTION__, error->message );
+				g_error_free (error);
+			}
+		}
+		else if ( vml->file_cache_dir ) {
 			GError *error = NULL;
 			gchar *filename = get_filename ( vml->file_cache_dir, ulm->x, ulm->y, ulm->scale );
 
@@ -656,79 +790,403 @@ static void possibly_save_pixbuf ( VikMapnikLayer *vml, GdkPixbuf *pixbuf, MapCo
 	}
 }
 
-typedef struct
+/**
+ * Determine the block of tiles that is rendered together with the specified tile
+ */
+static void get_metatile ( VikMapnikLayer *vml, const MapCoord *mc, MapCoord *mtm, guint *cols, guint *rows )
 {
-	VikMapnikLayer *vml;
-	VikCoord *ul;
-	VikCoord *br;
-	MapCoord *ulmc;
-	const gchar* request;
-} RenderInfo;
+	*mtm = *mc;
+	*cols = 1;
+	*rows = 1;
+	gint nn = vml->metatile_size;
+	gint zoom = 17 - mc->scale;
+	if ( nn < 2 || zoom < 0 || zoom > 30 )
+		return;
+	// Don't extend beyond the edges of the world
+	gint max = 1 << zoom;
+	if ( mc->x < 0 || mc->x >= max || mc->y < 0 || mc->y >= max )
+		return;
+	mtm->x = mc->x - (mc->x % nn);
+	mtm->y = mc->y - (mc->y % nn);
+	*cols = MIN ( nn, max - mtm->x );
+	*rows = MIN ( nn, max - mtm->y );
+}
 
 /**
  * render:
  *
  * Common render function which can run in separate thread
+ * Renders a block of @cols x @rows tiles starting at @ulm in one go
+ *
+ * Returns: The time taken in seconds
  */
-static void render ( VikMapnikLayer *vml, VikCoord *ul, VikCoord *br, MapCoord *ulm )
+static gdouble render ( VikMapnikLayer *vml, MapCoord *ulm, guint cols, guint rows )
 {
+	VikCoord ul, br;
+	MapCoord brm = *ulm;
+	brm.x = brm.x + cols;
+	brm.y = brm.y + rows;
+	map_utils_iTMS_to_vikcoord ( ulm, &ul );
+	map_utils_iTMS_to_vikcoord ( &brm, &br );
+
 	gint64 tt1 = g_get_real_time ();
-	GdkPixbuf *pixbuf = mapnik_interface_render ( vml->mi, ul->north_south, ul->east_west, br->north_south, br->east_west );
+	GdkPixbuf **pixbufs = mapnik_interface_render_metatile ( vml->mi, ul.north_south, ul.east_west, br.north_south, br.east_west, cols, rows );
 	gint64 tt2 = g_get_real_time ();
 	gdouble tt = (gdouble)(tt2-tt1)/1000000;
-	g_debug ( "Mapnik rendering completed in %.3f seconds", tt );
-	if ( !pixbuf ) {
-		// A pixbuf to stick into cache incase of an unrenderable area - otherwise will get continually re-requested
-		pixbuf = gdk_pixbuf_scale_simple ( ui_get_icon("vikmapniklayer", 16), vml->tile_size_x, vml->tile_size_x, GDK_INTERP_BILINEAR );
+	g_debug ( "Mapnik rendering of %dx%d tiles completed in %.3f seconds", cols, rows, tt );
+
+	for ( guint row = 0; row < rows; row++ ) {
+		for ( guint col = 0; col < cols; col++ ) {
+			MapCoord mc = *ulm;
+			mc.x = mc.x + col;
+			mc.y = mc.y + row;
+			GdkPixbuf *pixbuf = pixbufs ? pixbufs[row*cols + col] : NULL;
+			if ( !pixbuf ) {
+				// A pixbuf to stick into cache incase of an unrenderable area - otherwise will get continually re-requested
+				pixbuf = gdk_pixbuf_scale_simple ( ui_get_icon("vikmapniklayer", 16), vml->tile_size_x, vml->tile_size_x, GDK_INTERP_BILINEAR );
+			}
+			possibly_save_pixbuf ( vml, pixbuf, &mc );
+
+			// NB Mapnik can apply alpha, but use our own function for now
+			if ( vml->alpha < 255 )
+				pixbuf = ui_pixbuf_scale_alpha ( pixbuf, vml->alpha );
+			a_mapcache_add ( pixbuf, (mapcache_extra_t){ tt, 0 }, mc.x, mc.y, mc.z, MAP_ID_MAPNIK_RENDER, mc.scale, vml->alpha, 0.0, 0.0, vml->filename_xml );
+			g_object_unref(pixbuf);
+		}
 	}
-	possibly_save_pixbuf ( vml, pixbuf, ulm );
+	g_free ( pixbufs );
+	// NB The tiles are committed to the database in batches, see render_worker()
+	return tt;
+}
 
-	// NB Mapnik can apply alpha, but use our own function for now
-	if ( vml->alpha < 255 )
-		pixbuf = ui_pixbuf_scale_alpha ( pixbuf, vml->alpha );
-	a_mapcache_add ( pixbuf, (mapcache_extra_t){ tt, 0 }, ulm->x, ulm->y, ulm->z, MAP_ID_MAPNIK_RENDER, ulm->scale, vml->alpha, 0.0, 0.0, vml->filename_xml );
-	g_object_unref(pixbuf);
+/*
+ * Render scheduling
+ *
+ * Render requests are queued per layer rather than being started in the order they arrive.
+ * Each request is tagged with the generation of the view that wanted it,
+ *  the generation being incremented whenever the visible area changes.
+ * Requests for tiles currently visible are rendered first (latest generation first, then nearest the centre),
+ *  whilst requests that are no longer anywhere near the view (e.g. after zooming) are dropped before they start.
+ *
+ * Up to the configured number of Mapnik threads take requests from the queue until it is empty.
+ */
+
+// Number of render times kept for the statistics
+#define RENDER_TIMES 256
+
+typedef struct {
+	MapCoord mc;      // Top left tile of the metatile
+	guint cols;
+	guint rows;
+	guint generation; // Of the view that requested it
+	gboolean visible;
+	gdouble dist;     // Squared distance in tiles from the view centre
+	guint64 seq;
+	gchar *request;   // Key into the global requests table
+} RenderRequest;
+
+struct _RenderScheduler {
+	VikMapnikLayer *vml;
+	GMutex *mutex;         // Protects all the following
+	gboolean alive;        // Whether vml is still valid
+	GSequence *queue;
+	guint64 seq;
+	guint generation;
+	gint x0, y0, xf, yf;   // Visible tiles
+	gint scale;
+	gdouble cx, cy;        // Tile position of the view centre
+	guint workers;
+	guint rendering;       // Requests currently being rendered (and so using vml)
+	GCond finished;        // Signalled when a render completes
+	gint ref_count;
+	// Statistics
+	guint max_queued;
+	guint rendered;
+	guint dropped;
+	gdouble times[RENDER_TIMES]; // Seconds per render (of a whole metatile)
+	guint ntimes;
+};
+
+static void render_request_free ( RenderRequest *rr )
+{
+	g_free ( rr->request );
+	g_free ( rr );
 }
 
-static void render_info_free ( RenderInfo *data )
+/**
+ * Finish with a request (whether rendered or not), so it can be requested again later on
+ */
+static void render_request_drop ( RenderRequest *rr )
+{
+	g_mutex_lock(tp_mutex);
+	g_hash_table_remove (requests, rr->request);
+	g_mutex_unlock(tp_mutex);
+	render_request_free ( rr );
+}
+
+static gint render_request_compare ( gconstpointer a, gconstpointer b, gpointer user_data )
 {
-	g_free ( data->ul );
-	g_free ( data->br );
-	g_free ( data->ulmc );
-	// NB No need to free the request/key - as this is freed by the hash table destructor
-	g_free ( data );
+	const RenderRequest *rra = a;
+	const RenderRequest *rrb = b;
+	if ( rra->visible != rrb->visible )
+		return rra->visible ? -1 : 1;
+	if ( rra->generation != rrb->generation )
+		return rra->generation > rrb->generation ? -1 : 1;
+	if ( rra->dist < rrb->dist ) return -1;
+	if ( rra->dist > rrb->dist ) return 1;
+	return (rra->seq < rrb->seq) ? -1 : (rra->seq > rrb->seq);
 }
 
-static void background ( RenderInfo *data, gpointer threaddata )
+static RenderScheduler *render_scheduler_new ( VikMapnikLayer *vml )
 {
-	int res = a_background_thread_progress ( threaddata, 0 );
-	if (res == 0) {
-		render ( data->vml, data->ul, data->br, data->ulmc );
+	RenderScheduler *rs = g_malloc0 ( sizeof(RenderScheduler) );
+	rs->vml = vml;
+	rs->mutex = vik_mutex_new();
+	rs->alive = TRUE;
+	rs->queue = g_sequence_new ( NULL );
+	g_cond_init ( &rs->finished );
+	rs->ref_count = 1;
+	return rs;
+}
+
+static void render_scheduler_clear ( RenderScheduler *rs )
+{
+	GSequenceIter *iter = g_sequence_get_begin_iter ( rs->queue );
+	while ( !g_sequence_iter_is_end(iter) ) {
+		render_request_drop ( g_sequence_get(iter) );
+		iter = g_sequence_iter_next ( iter );
 	}
+	g_sequence_remove_range ( g_sequence_get_begin_iter(rs->queue), g_sequence_get_end_iter(rs->queue) );
+}
 
-	g_mutex_lock(tp_mutex);
-	g_hash_table_remove (requests, data->request);
-	g_mutex_unlock(tp_mutex);
+static void render_scheduler_unref ( RenderScheduler *rs )
+{
+	if ( !g_atomic_int_dec_and_test ( &rs->ref_count ) )
+		return;
+	render_scheduler_clear ( rs );
+	g_sequence_free ( rs->queue );
+	g_cond_clear ( &rs->finished );
+	vik_mutex_free ( rs->mutex );
+	g_free ( rs );
+}
 
-	if (res == 0)
-		vik_layer_emit_update ( VIK_LAYER(data->vml), FALSE ); // NB update display from background
+/**
+ * The layer is being freed, so stop rendering for it
+ *  Any render already in progress is still using the layer, so wait for it to complete
+ */
+static void render_scheduler_detach ( RenderScheduler *rs )
+{
+	g_mutex_lock ( rs->mutex );
+	render_scheduler_clear ( rs );
+	rs->alive = FALSE;
+	while ( rs->rendering )
+		g_cond_wait ( &rs->finished, rs->mutex );
+	g_mutex_unlock ( rs->mutex );
+	render_scheduler_unref ( rs );
 }
 
-static void render_cancel_cleanup (RenderInfo *data)
+/**
+ * Whether the request is worth keeping for the current view
+ *  i.e. at the same zoom level and within one view width/height of the visible area
+ * Should be called with the scheduler mutex held
+ */
+static gboolean render_scheduler_wanted ( RenderScheduler *rs, RenderRequest *rr )
+{
+	if ( rr->generation == rs->generation )
+		return TRUE;
+	if ( rr->mc.scale != rs->scale )
+		return FALSE;
+	gint xmargin = rs->xf - rs->x0 + 1;
+	gint ymargin = rs->yf - rs->y0 + 1;
+	return ( rr->mc.x + (gint)rr->cols > rs->x0 - xmargin && rr->mc.x <= rs->xf + xmargin &&
+	         rr->mc.y + (gint)rr->rows > rs->y0 - ymargin && rr->mc.y <= rs->yf + ymargin );
+}
+
+/**
+ * Should be called with the scheduler mutex held
+ */
+static void render_request_evaluate ( RenderScheduler *rs, RenderRequest *rr )
 {
-	// Anything?
+	rr->visible = ( rr->mc.scale == rs->scale &&
+	                rr->mc.x + (gint)rr->cols > rs->x0 && rr->mc.x <= rs->xf &&
+	                rr->mc.y + (gint)rr->rows > rs->y0 && rr->mc.y <= rs->yf );
+	gdouble dx = rr->mc.x + (rr->cols / 2.0) - rs->cx;
+	gdouble dy = rr->mc.y + (rr->rows / 2.0) - rs->cy;
+	rr->dist = dx*dx + dy*dy;
 }
 
-#define REQUEST_HASHKEY_FORMAT "%d-%d-%d-%d-%d"
+/**
+ * Update the visible area, dropping or reordering the outstanding requests when it has changed
+ */
+static void render_scheduler_set_view ( RenderScheduler *rs, gint x0, gint y0, gint xf, gint yf, gint scale )
+{
+	g_mutex_lock ( rs->mutex );
+	if ( rs->generation && x0 == rs->x0 && y0 == rs->y0 && xf == rs->xf && yf == rs->yf && scale == rs->scale ) {
+		g_mutex_unlock ( rs->mutex );
+		return;
+	}
+	rs->generation++;
+	rs->x0 = x0; rs->y0 = y0;
+	rs->xf = xf; rs->yf = yf;
+	rs->scale = scale;
+	rs->cx = (x0 + xf + 1) / 2.0;
+	rs->cy = (y0 + yf + 1) / 2.0;
+
+	GSList *keep = NULL;
+	GSequenceIter *iter = g_sequence_get_begin_iter ( rs->queue );
+	while ( !g_sequence_iter_is_end(iter) ) {
+		keep = g_slist_prepend ( keep, g_sequence_get(iter) );
+		iter = g_sequence_iter_next ( iter );
+	}
+	g_sequence_remove_range ( g_sequence_get_begin_iter(rs->queue), g_sequence_get_end_iter(rs->queue) );
+
+	for ( GSList *sl = keep; sl; sl = sl->next ) {
+		RenderRequest *rr = sl->data;
+		if ( !render_scheduler_wanted ( rs, rr ) ) {
+			rs->dropped++;
+			render_request_drop ( rr );
+			continue;
+		}
+		render_request_evaluate ( rs, rr );
+		g_sequence_insert_sorted ( rs->queue, rr, render_request_compare, NULL );
+	}
+	g_slist_free ( keep );
+	g_mutex_unlock ( rs->mutex );
+}
 
 /**
- * Thread
+ * Get the next request to render, if any
+ *  When there are none the worker is finished
  */
-static void thread_add (VikMapnikLayer *vml, MapCoord *mul, VikCoord *ul, VikCoord *br, gint x, gint y, gint z, gint zoom, const gchar* name )
+static RenderRequest *render_scheduler_pop ( RenderScheduler *rs )
 {
+	RenderRequest *rr = NULL;
+	g_mutex_lock ( rs->mutex );
+	while ( !rr && rs->alive ) {
+		GSequenceIter *iter = g_sequence_get_begin_iter ( rs->queue );
+		if ( g_sequence_iter_is_end(iter) )
+			break;
+		rr = g_sequence_get ( iter );
+		g_sequence_remove ( iter );
+		// The view may have moved on since the request was made
+		if ( !render_scheduler_wanted ( rs, rr ) ) {
+			rs->dropped++;
+			render_request_drop ( rr );
+			rr = NULL;
+		}
+	}
+	if ( !rr )
+		rs->workers--;
+	g_mutex_unlock ( rs->mutex );
+	return rr;
+}
+
+static void render_scheduler_record ( RenderScheduler *rs, gdouble seconds )
+{
+	g_mutex_lock ( rs->mutex );
+	rs->times[rs->rendered % RENDER_TIMES] = seconds;
+	rs->rendered++;
+	rs->ntimes = MIN ( rs->ntimes + 1, RENDER_TIMES );
+	g_mutex_unlock ( rs->mutex );
+}
+
+static void render_worker ( RenderScheduler *rs, gpointer threaddata )
+{
+	RenderRequest *rr;
+	while ( (rr = render_scheduler_pop ( rs )) ) {
+		if ( a_background_testcancel ( threaddata ) == 0 ) {
+			// The layer may have been freed since the request was taken
+			g_mutex_lock ( rs->mutex );
+			gboolean alive = rs->alive;
+			if ( alive )
+				rs->rendering++;
+			guint queued = g_sequence_get_length ( rs->queue );
+			g_mutex_unlock ( rs->mutex );
+
+			if ( alive ) {
+				gchar *msg = g_strdup_printf ( _("Mapnik Render %d:%d:%d (%d queued)"), rr->mc.scale, rr->mc.x, rr->mc.y, queued );
+				a_background_thread_message ( threaddata, msg );
+				g_free ( msg );
+
+				gdouble seconds = render ( rs->vml, &rr->mc, rr->cols, rr->rows );
+				render_scheduler_record ( rs, seconds );
+
+				g_mutex_lock ( rs->mutex );
+				rs->rendering--;
+				if ( rs->alive )
+					vik_layer_emit_update ( VIK_LAYER(rs->vml), FALSE ); // NB update display from background
+				g_cond_broadcast ( &rs->finished );
+				g_mutex_unlock ( rs->mutex );
+			}
+		}
+		else {
+			// Cancelled, so abandon everything else queued as well
+			g_mutex_lock ( rs->mutex );
+			render_scheduler_clear ( rs );
+			g_mutex_unlock ( rs->mutex );
+		}
+
+		// Finished with, so can be requested again
+		render_request_drop ( rr );
+	}
+
+	// Nothing more to render for now, so commit what has been rendered
+	//  (the lock keeps the layer from being freed meanwhile)
+	g_mutex_lock ( rs->mutex );
+	if ( rs->alive && rs->vml->use_file_cache && rs->vml->cache_dbname )
+		a_mbtiles_cache_flush ( rs->vml->cache_dbname );
+	g_mutex_unlock ( rs->mutex );
+}
+
+/**
+ * Start another worker if there are more requests than workers
+ *  (up to the number of threads available for Mapnik)
+ */
+static void render_scheduler_start ( RenderScheduler *rs )
+{
+	guint max_workers = a_preferences_get("mapnik.background_max_threads_local_mapnik")->u;
+	g_mutex_lock ( rs->mutex );
+	gboolean start = ( rs->workers < MAX(1, max_workers) && rs->workers < g_sequence_get_length(rs->queue) );
+	if ( start ) {
+		rs->workers++;
+		g_atomic_int_inc ( &rs->ref_count );
+	}
+	g_mutex_unlock ( rs->mutex );
+
+	if ( start ) {
+		gchar *basename = g_path_get_basename ( rs->vml->filename_xml );
+		gchar *description = g_strdup_printf ( _("Mapnik Rendering %s"), basename );
+		g_free ( basename );
+		a_background_thread ( BACKGROUND_POOL_LOCAL_MAPNIK,
+		                      VIK_GTK_WINDOW_FROM_LAYER(rs->vml),
+		                      description,
+		                      (vik_thr_func) render_worker,
+		                      rs,
+		                      (vik_thr_free_func) render_scheduler_unref,
+		                      NULL,
+		                      1 );
+		g_free ( description );
+	}
+}
+
+#define REQUEST_HASHKEY_FORMAT "%d-%d-%d-%d-%d-%d"
+
+/**
+ * Queue rendering of a tile
+ *
+ * The request is for the whole metatile containing the tile,
+ *  so requests for the other tiles in the same block are not repeated
+ */
+static void thread_add (VikMapnikLayer *vml, MapCoord *mul, const gchar* name )
+{
+	RenderScheduler *rs = vml->scheduler;
+	MapCoord mtm;
+	guint cols, rows;
+	get_metatile ( vml, mul, &mtm, &cols, &rows );
+
 	// Create request
 	guint nn = name ? g_str_hash ( name ) : 0;
-	gchar *request = g_strdup_printf ( REQUEST_HASHKEY_FORMAT, x, y, z, zoom, nn );
+	gchar *request = g_strdup_printf ( REQUEST_HASHKEY_FORMAT, mtm.x, mtm.y, mtm.z, mtm.scale, vml->metatile_size, nn );
 
 	g_mutex_lock(tp_mutex);
 
@@ -737,33 +1195,66 @@ static void thread_add (VikMapnikLayer *vml, MapCoord *mul, VikCoord *ul, VikCoo
 		g_mutex_unlock (tp_mutex);
 		return;
 	}
+	g_hash_table_insert ( requests, g_strdup(request), NULL );
 
-	RenderInfo *ri = g_malloc ( sizeof(RenderInfo) );
-	ri->vml = vml;
-	ri->ul = g_malloc ( sizeof(VikCoord) );
-	ri->br = g_malloc ( sizeof(VikCoord) );
-	ri->ulmc = g_malloc ( sizeof(MapCoord) );
-	memcpy(ri->ul, ul, sizeof(VikCoord));
-	memcpy(ri->br, br, sizeof(VikCoord));
-	memcpy(ri->ulmc, mul, sizeof(MapCoord));
-	ri->request = request;
+	g_mutex_unlock (tp_mutex);
 
-	g_hash_table_insert ( requests, request, NULL );
+	RenderRequest *rr = g_malloc0 ( sizeof(RenderRequest) );
+	rr->mc = mtm;
+	rr->cols = cols;
+	rr->rows = rows;
+	rr->request = request;
+
+	g_mutex_lock ( rs->mutex );
+	rr->generation = rs->generation;
+	rr->seq = rs->seq++;
+	render_request_evaluate ( rs, rr );
+	g_sequence_insert_sorted ( rs->queue, rr, render_request_compare, NULL );
+	rs->max_queued = MAX ( rs->max_queued, g_sequence_get_length(rs->queue) );
+	g_mutex_unlock ( rs->mutex );
+
+	render_scheduler_start ( rs );
+}
 
-	g_mutex_unlock (tp_mutex);
+static gint compare_double ( gconstpointer a, gconstpointer b )
+{
+	gdouble da = *(const gdouble*)a;
+	gdouble db = *(const gdouble*)b;
+	return (da > db) - (da < db);
+}
 
-	gchar *basename = g_path_get_basename (name);
-	gchar *description = g_strdup_printf ( _("Mapnik Render %d:%d:%d %s"), zoom, x, y, basename );
-	g_free ( basename );
-	a_background_thread ( BACKGROUND_POOL_LOCAL_MAPNIK,
-	                      VIK_GTK_WINDOW_FROM_LAYER(vml),
-	                      description,
-	                      (vik_thr_func) background,
-	                      ri,
-	                      (vik_thr_free_func) render_info_free,
-	                      (vik_thr_free_func) render_cancel_cleanup,
-	                      1 );
-	g_free ( description );
+/**
+ * Rendering statistics for display
+ *
+ * Free every string element and the returned GArray itself after use
+ */
+static GArray *render_scheduler_get_stats ( RenderScheduler *rs )
+{
+	GArray *array = g_array_new (FALSE, TRUE, sizeof(gchar*));
+	gdouble times[RENDER_TIMES];
+
+	g_mutex_lock ( rs->mutex );
+	gchar *str = g_strdup_printf ( _("Render queue: %d (maximum %d), threads: %d"), g_sequence_get_length(rs->queue), rs->max_queued, rs->workers );
+	g_array_append_val ( array, str );
+	str = g_strdup_printf ( _("Rendered: %d, dropped as no longer needed: %d"), rs->rendered, rs->dropped );
+	g_array_append_val ( array, str );
+	guint ntimes = rs->ntimes;
+	memcpy ( times, rs->times, sizeof(gdouble) * ntimes );
+	g_mutex_unlock ( rs->mutex );
+
+	if ( ntimes ) {
+		qsort ( times, ntimes, sizeof(gdouble), compare_double );
+		gdouble pc[3] = { 0.5, 0.9, 0.99 };
+		gdouble values[3];
+		for ( guint ii = 0; ii < G_N_ELEMENTS(pc); ii++ ) {
+			guint idx = (guint)ceil ( pc[ii] * ntimes );
+			values[ii] = times[ idx ? idx-1 : 0 ];
+		}
+		str = g_strdup_printf ( _("Render time (last %d): median %.2fs, 90%% %.2fs, 99%% %.2fs, maximum %.2fs"),
+		                        ntimes, values[0], values[1], values[2], times[ntimes-1] );
+		g_array_append_val ( array, str );
+	}
+	return array;
 }
 
 /**
@@ -776,6 +1267,31 @@ static GdkPixbuf *load_pixbuf ( VikMapnikLayer *vml, MapCoord *ulm, MapCoord *br
 {
 	*rerender = FALSE;
 	GdkPixbuf *pixbuf = NULL;
+
+	if ( vml->cache_dbname ) {
+		time_t mtime = 0;
+		GBytes *bytes = a_mbtiles_cache_get ( vml->cache_dbname, ulm->x, ulm->y, (17-ulm->scale), &mtime );
+		if ( bytes ) {
+			GError *error = NULL;
+			pixbuf = ui_pixbuf_new_from_bytes ( bytes, &error );
+			if ( !pixbuf ) {
+				g_warning ("%s: %s", __FUNCTION__, error ? error->message : "decode failed" );
+				if ( error )
+					g_error_free ( error );
+			}
+			else {
+				if ( vml->alpha < 255 )
+					pixbuf = ui_pixbuf_set_alpha ( pixbuf, vml->alpha );
+				a_mapcache_add ( pixbuf, (mapcache_extra_t) { -42.0 }, ulm->x, ulm->y, ulm->z, MAP_ID_MAPNIK_RENDER, ulm->scale, vml->alpha, 0.0, 0.0, vml->filename_xml );
+			}
+			// The stored time comes with the tile, so no separate check is needed
+			if ( planet_import_time < mtime )
+				*rerender = TRUE;
+			g_bytes_unref ( bytes );
+		}
+		return pixbuf;
+	}
+
 	gchar *filename = get_filename ( vml->file_cache_dir, ulm->x, ulm->y, ulm->scale );
 
 	GStatBuf gsb;
@@ -808,12 +1324,8 @@ static GdkPixbuf *load_pixbuf ( VikMapnikLayer *vml, MapCoord *ulm, MapCoord *br
  */
 static GdkPixbuf *get_pixbuf ( VikMapnikLayer *vml, MapCoord *ulm, MapCoord *brm )
 {
-	VikCoord ul; VikCoord br;
 	GdkPixbuf *pixbuf = NULL;
 
-	map_utils_iTMS_to_vikcoord (ulm, &ul);
-	map_utils_iTMS_to_vikcoord (brm, &br);
-
 	pixbuf = a_mapcache_get ( ulm->x, ulm->y, ulm->z, MAP_ID_MAPNIK_RENDER, ulm->scale, vml->alpha, 0.0, 0.0, vml->filename_xml );
 
 	if ( ! pixbuf ) {
@@ -822,10 +1334,10 @@ static GdkPixbuf *get_pixbuf ( VikMapnikLayer *vml, MapCoord *ulm, MapCoord *brm
 			pixbuf = load_pixbuf ( vml, ulm, brm, &rerender );
 		if ( ! pixbuf || rerender ) {
 			if ( TRUE )
-				thread_add (vml, ulm, &ul, &br, ulm->x, ulm->y, ulm->z, ulm->scale, vml->filename_xml );
+				thread_add (vml, ulm, vml->filename_xml );
 			else {
 				// Run in the foreground
-				render ( vml, &ul, &br, ulm );
+				render ( vml, ulm, 1, 1 );
 				vik_layer_emit_update ( VIK_LAYER(vml), FALSE );
 			}
 		}
@@ -876,6 +1388,9 @@ static void mapnik_layer_draw ( VikMapnikLayer *vml, VikViewport *vvp )
 		gint xmin = MIN(ulm.x, brm.x), xmax = MAX(ulm.x, brm.x);
 		gint ymin = MIN(ulm.y, brm.y), ymax = MAX(ulm.y, brm.y);
 
+		// Any renders no longer needed for this view are dropped
+		render_scheduler_set_view ( vml->scheduler, xmin, ymin, xmax, ymax, ulm.scale );
+
 		// Split rendering into a grid for the current viewport
 		//  thus each individual 'tile' can then be stored in the map cache
 		for (gint x = xmin; x <= xmax; x++ ) {
@@ -925,11 +1440,13 @@ static void mapnik_layer_draw ( VikMapnikLayer *vml, VikViewport *vvp )
  */
 static void mapnik_layer_free ( VikMapnikLayer *vml )
 {
+	render_scheduler_detach ( vml->scheduler );
 	mapnik_interface_free ( vml->mi );
 	if ( vml->filename_css )
 		g_free ( vml->filename_css );
 	if ( vml->filename_xml )
 		g_free ( vml->filename_xml );
+	g_free ( vml->cache_dbname );
 }
 
 static VikMapnikLayer *mapnik_layer_create ( VikViewport *vp )
@@ -987,8 +1504,10 @@ static void mapnik_layer_carto ( menu_array_values values )
 		                           ans );
 		g_free ( ans );
 	}
-	else
+	else {
+		mapnik_layer_set_cache_db ( vml );
 		mapnik_layer_draw ( vml, vvp );
+	}
 }
 
 /**
@@ -999,7 +1518,10 @@ static void mapnik_layer_information ( menu_array_values values )
 	VikMapnikLayer *vml = values[MA_VML];
 	if ( !vml->mi )
 		return;
-	GArray *array = mapnik_interface_get_parameters( vml->mi );
+	GArray *array = render_scheduler_get_stats ( vml->scheduler );
+	GArray *params = mapnik_interface_get_parameters( vml->mi );
+	g_array_append_vals ( array, params->data, params->len );
+	g_array_free ( params, TRUE );
 	if ( array->len ) {
 		a_dialog_list (  VIK_GTK_WINDOW_FROM_LAYER(vml), _("Mapnik Information"), array, 1 );
 		// Free the copied strings
@@ -1061,7 +1583,7 @@ static void mapnik_layer_rerender ( VikMapnikLayer *vml )
 	brm.x = brm.x+1;
 	brm.y = brm.y+1;
 	map_utils_iTMS_to_vikcoord (&brm, &vml->rerender_br );
-	thread_add (vml, &ulm, &vml->rerender_ul, &vml->rerender_br, ulm.x, ulm.y, ulm.z, ulm.scale, vml->filename_xml );
+	thread_add (vml, &ulm, vml->filename_xml );
 }
 
 /**
@@ -1078,8 +1600,21 @@ static void mapnik_layer_tile_info ( VikMapnikLayer *vml )
 	gchar *filename = get_filename ( vml->file_cache_dir, ulm.x, ulm.y, ulm.scale );
 	gchar *filemsg = NULL;
 	gchar *timemsg = NULL;
+	time_t mtime = 0;
 
-	if ( g_file_test ( filename, G_FILE_TEST_EXISTS ) ) {
+	if ( vml->cache_dbname ) {
+		if ( a_mbtiles_cache_exists ( vml->cache_dbname, ulm.x, ulm.y, (17-ulm.scale), &mtime ) ) {
+			filemsg = g_strconcat ( "Tile Database: ", vml->cache_dbname, NULL );
+			gchar time_buf[64];
+			strftime ( time_buf, sizeof(time_buf), "%c", gmtime(&mtime) );
+			timemsg = g_strdup_printf ( _("Tile Timestamp: %s"), time_buf );
+		}
+		else {
+			filemsg = g_strdup_printf ( "Tile Database: %s [Not Available]", vml->cache_dbname );
+			timemsg = g_strdup("");
+		}
+	}
+	else if ( g_file_test ( filename, G_FILE_TEST_EXISTS ) ) {
 		filemsg = g_strconcat ( "Tile File: ", filename, NULL );
 		// Get some timestamp information of the tile
 		GStatBuf stat_buf;
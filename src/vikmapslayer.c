@@ -38,6 +38,12 @@
 #include "background.h"
 #include "vikmapslayer.h"
 #include "metatile.h"
+#include "metatilecache.h"
+#include "tileindex.h"
+#include "cachequota.h"
+#include "mapseed.h"
+#include "drawstats.h"
+#include "mbtilescache.h"
 #include "map_ids.h"
 
 #ifdef HAVE_SQLITE3_H
@@ -65,6 +71,24 @@ static guint SCALE_INC_DOWN = 4;
 #define VIK_SETTINGS_MAP_SCALE_SMALLER_ZOOM_FIRST "maps_scale_smaller_zoom_first"
 static gboolean SCALE_SMALLER_ZOOM_FIRST = TRUE;
 
+#define VIK_SETTINGS_MAP_ASYNC_DECODE "maps_async_decode"
+static gboolean ASYNC_DECODE = TRUE;
+// Number of zoom levels to combine tiles from, for tiles not in the cache (0 disables)
+#define VIK_SETTINGS_MAP_OVERVIEW_LEVELS "maps_overview_levels"
+static gint OVERVIEW_LEVELS = 2;
+
+// Number of tiles downloaded at once by each download thread
+//  (unless the map source specifies its own value)
+#define VIK_SETTINGS_MAP_DOWNLOAD_CONCURRENCY "maps_download_concurrency"
+static gint DOWNLOAD_CONCURRENCY = 4;
+
+// Maximum number of tiles just outside the view to read (and download) ahead of panning or zooming (0 disables)
+#define VIK_SETTINGS_MAP_PREFETCH_BUDGET "maps_prefetch_budget"
+static gint PREFETCH_BUDGET = 32;
+// How far ahead (in seconds) the panning motion is extrapolated
+#define VIK_SETTINGS_MAP_PREFETCH_LOOKAHEAD "maps_prefetch_lookahead"
+static gdouble PREFETCH_LOOKAHEAD = 0.5;
+
 #define VIK_SETTINGS_MAP_CACHE_NO_FILE_COLOR "maps_cache_status_no_file_color"
 #define VIK_SETTINGS_MAP_CACHE_EXPIRED_COLOR "maps_cache_status_expired_color"
 #define VIK_SETTINGS_MAP_CACHE_DOWNLOAD_ERROR_COLOR "maps_cache_status_download_error_color"
@@ -109,6 +133,18 @@ static VikLayerToolFuncStatus maps_layer_download_click ( VikMapsLayer *vml, Gdk
 static gpointer maps_layer_download_create ( VikWindow *vw, VikViewport *vvp );
 static void maps_layer_set_cache_dir ( VikMapsLayer *vml, const gchar *dir );
 static void start_download_thread ( VikMapsLayer *vml, VikViewport *vvp, const VikCoord *ul, const VikCoord *br, gint redownload );
+static void maps_layer_schedule_view ( VikMapsLayer *vml, VikViewport *vvp, const VikCoord *ul, const VikCoord *br, gint redownload );
+static void maps_layer_prefetch ( VikMapsLayer *vml, VikViewport *vvp, VikMapSource *map, MapCoord *view,
+                                  gint xmin, gint xmax, gint ymin, gint ymax, gdouble xshrinkfactor, gdouble yshrinkfactor, guint vp_scale );
+static void maps_layer_prefetch_used ( VikMapsLayer *vml, MapCoord *mc );
+typedef struct _DecodeInfo DecodeInfo;
+static void decode_job_release ( DecodeInfo *di );
+static void overview_cache_tile_changed ( guint16 id, const gchar *name, MapCoord *mc );
+static void overview_cache_flush ( guint16 id );
+static void maps_layer_cache_quota_register ( VikMapsLayer *vml, VikMapSource *map );
+static void maps_layer_seed_resume ( VikMapsLayer *vml );
+typedef struct _TileScheduler TileScheduler;
+static void tile_scheduler_detach ( TileScheduler *ts );
 static void maps_layer_add_menu_items ( VikMapsLayer *vml, GtkMenu *menu, VikLayersPanel *vlp, VikStdLayerMenuItem selection );
 static guint map_uniq_id_to_index ( guint uniq_id );
 
@@ -136,7 +172,7 @@ static VikLayerParamData file_default ( void )
 static VikLayerParamData alpha_default ( void ) { return VIK_LPD_UINT ( 255 ); }
 static VikLayerParamData mapzoom_default ( void ) { return VIK_LPD_UINT ( 0 ); }
 
-static gchar *cache_types[] = { "Viking", N_("OSM"), NULL };
+static gchar *cache_types[] = { "Viking", N_("OSM"), N_("MBTiles"), NULL };
 static VikMapsCacheLayout cache_layout_default_value = VIK_MAPS_CACHE_LAYOUT_OSM;
 static VikLayerParamData cache_layout_default ( void ) { return VIK_LPD_UINT ( cache_layout_default_value ); }
 
@@ -294,8 +330,25 @@ VikLayerInterface vik_maps_layer_interface = {
   (VikLayerFuncSelectedViewportMenu)    NULL,
 
   (VikLayerFuncRefresh)                 NULL,
+
+  (VikLayerDrawCache)                   VIK_LAYER_DRAW_CACHE_PAN,
 };
 
+// Tracking of the view movement between draws, to read tiles ahead of where the view is going
+typedef struct {
+  VikCoord center;       // View centre when last drawn
+  gint64 time;           // When last drawn (0 for never)
+  gint z, scale;         // Tile zoom when last drawn
+  gint x0, xf, y0, yf;   // Visible tiles when last drawn
+  gdouble vx, vy;        // Smoothed panning velocity in tiles per second
+  gint zoom_dir;         // +1 zooming in, -1 zooming out, 0 neither
+  gint64 zoom_time;      // When the zoom last changed
+  GHashTable *pending;   // Tiles prefetched but not yet drawn
+  guint prefetched;      // Counts for this layer
+  guint used;
+  DecodeInfo *job;       // Background reading of the prefetched tiles, reused from draw to draw
+} MapPrefetch;
+
 struct _VikMapsLayer {
   VikLayer vl;
   guint maptype;
@@ -311,6 +364,10 @@ struct _VikMapsLayer {
   VikCoord *last_center;
   gdouble last_xmpp;
   gdouble last_ympp;
+  // How tiles were last drawn, so downloaded tiles can be put in the mapcache ready for drawing
+  guint draw_vp_scale;
+  gdouble draw_xshrinkfactor;
+  gdouble draw_yshrinkfactor;
 
   // Specifically not a layer property, e.g no need to save/restore etc...
   //  just a temporary session flag to control drawing of cache status
@@ -321,10 +378,15 @@ struct _VikMapsLayer {
   GtkMenu *dl_right_click_menu;
   VikCoord redownload_ul, redownload_br; /* right click menu only */
   VikViewport *redownload_vvp;
+  TileScheduler *scheduler; // Autodownload and seeding requests
+  gboolean seeds_resumed;   // Whether unfinished seeding jobs have been looked for
   gchar *filename;
 #ifdef HAVE_SQLITE3_H
   sqlite3 *mbtiles;
 #endif
+  MBTilesPool *mbtiles_pool; // Tile reads for MBTiles maps
+  DecodeInfo *decode_job;    // Background reading of the tiles to draw, reused from draw to draw
+  MapPrefetch prefetch;
 };
 
 enum { REDOWNLOAD_NONE = 0,    /* download only missing maps */
@@ -337,8 +399,17 @@ static VikLayerParamData mpl_dir_default ( void ) {
   VikLayerParamData data; data.s = maps_layer_default_dir(); return data;
 }
 
+static VikLayerParamScale prefs_scales[] = {
+  /* min, max, step, digits (decimal places) */
+ { 0, 1000000, 100, 0 }, /* cache quota (MB) */
+};
+
+static VikLayerParamData mpl_quota_default ( void ) { return VIK_LPD_UINT ( 0 ); }
+
 static VikLayerParam prefs[] = {
   { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_NAMESPACE "maplayer_default_dir", VIK_LAYER_PARAM_STRING, VIK_LAYER_GROUP_NONE, N_("Default map layer directory:"), VIK_LAYER_WIDGET_FOLDERENTRY, NULL, NULL, N_("Choose a directory to store cached Map tiles for this layer"), mpl_dir_default, NULL, NULL },
+  { VIK_LAYER_NUM_TYPES, VIKING_PREFERENCES_NAMESPACE "maplayer_cache_quota", VIK_LAYER_PARAM_UINT, VIK_LAYER_GROUP_NONE, N_("Map cache size limit (MB):"), VIK_LAYER_WIDGET_SPINBUTTON, &prefs_scales[0], NULL,
+    N_("The least recently used tiles are removed from each map cache directory to keep it within this size. 0 means no limit."), mpl_quota_default, NULL, NULL },
 };
 
 // Single global tracking of requests (as opposed to per map layer)
@@ -346,6 +417,10 @@ static VikLayerParam prefs[] = {
 //  as well as the same requests from a single layer
 static GMutex *rq_mutex;
 static GHashTable *requests = NULL;
+// Similarly for tiles being read in by the background decoder
+static GHashTable *decode_requests = NULL;
+// Incremented whenever tiles an overview may be built from change, see overview_build()
+static guint overview_generation = 0;
 
 static GdkColor black_color;
 
@@ -365,7 +440,8 @@ static void set_color_from_setting ( const gchar* setting, GdkColor *color )
 
 void maps_layer_init ()
 {
-  a_preferences_register ( prefs, (VikLayerParamData){0}, VIKING_PREFERENCES_GROUP_KEY );
+  a_preferences_register ( &prefs[0], (VikLayerParamData){0}, VIKING_PREFERENCES_GROUP_KEY );
+  a_preferences_register ( &prefs[1], (VikLayerParamData){0}, VIKING_PREFERENCES_GROUP_KEY );
 
   gint max_tiles = MAX_TILES;
   if ( a_settings_get_integer ( VIK_SETTINGS_MAP_MAX_TILES, &max_tiles ) )
@@ -392,10 +468,24 @@ void maps_layer_init ()
   if ( a_settings_get_boolean ( VIK_SETTINGS_MAP_SCALE_SMALLER_ZOOM_FIRST, &gbtmp ) )
     SCALE_SMALLER_ZOOM_FIRST = gbtmp;
 
+  if ( a_settings_get_boolean ( VIK_SETTINGS_MAP_ASYNC_DECODE, &gbtmp ) )
+    ASYNC_DECODE = gbtmp;
+  if ( a_settings_get_integer ( VIK_SETTINGS_MAP_OVERVIEW_LEVELS, &gitmp ) && gitmp >= 0 )
+    OVERVIEW_LEVELS = gitmp;
+
+  if ( a_settings_get_integer ( VIK_SETTINGS_MAP_DOWNLOAD_CONCURRENCY, &gitmp ) )
+    DOWNLOAD_CONCURRENCY = gitmp;
+
+  if ( a_settings_get_integer ( VIK_SETTINGS_MAP_PREFETCH_BUDGET, &gitmp ) && gitmp >= 0 )
+    PREFETCH_BUDGET = gitmp;
+  if ( a_settings_get_double ( VIK_SETTINGS_MAP_PREFETCH_LOOKAHEAD, &gdtmp ) && gdtmp >= 0.0 )
+    PREFETCH_LOOKAHEAD = gdtmp;
+
   rq_mutex = vik_mutex_new();
 
   // Just storing keys only
   requests = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+  decode_requests = g_hash_table_new_full ( a_mapcache_key_hash, a_mapcache_key_equal, g_free, NULL );
 
   (void)gdk_color_parse ( "#000000", &black_color );
 
@@ -416,6 +506,7 @@ void maps_layer_uninit ()
 {
   vik_mutex_free ( rq_mutex );
   g_hash_table_destroy ( requests );
+  g_hash_table_destroy ( decode_requests );
   rq_mutex = NULL;
   g_strfreev ( params_maptypes );
   g_free ( params_maptypes_ids );
@@ -567,6 +658,9 @@ gchar *vik_maps_layer_get_map_label(VikMapsLayer *vml)
 #define DIRECTDIRACCESS "%s%d" G_DIR_SEPARATOR_S "%d" G_DIR_SEPARATOR_S "%d%s"
 #define DIRECTDIRACCESS_WITH_NAME "%s%s" G_DIR_SEPARATOR_S "%d" G_DIR_SEPARATOR_S "%d" G_DIR_SEPARATOR_S "%d%s"
 #define DIRSTRUCTURE "%st%ds%dz%d" G_DIR_SEPARATOR_S "%d" G_DIR_SEPARATOR_S "%d"
+// MBTiles cache layout: the database and where tiles are downloaded to before being stored in the database
+#define MBTILESCACHE "%s%s.mbtiles"
+#define MBTILESSTAGING "%smbtiles.tmp" G_DIR_SEPARATOR_S "%d-%d-%d-%d"
 #define MAPS_CACHE_DIR maps_layer_default_dir()
 
 #ifdef WINDOWS
@@ -741,7 +835,11 @@ static gboolean maps_layer_set_param ( VikMapsLayer *vml, VikLayerSetParam *vlsp
       break;
     }
     case PARAM_CACHE_LAYOUT:
-      if ( vlsp->data.u < VIK_MAPS_CACHE_LAYOUT_NUM )
+      if ( vlsp->data.u == VIK_MAPS_CACHE_LAYOUT_MBTILES && !a_mbtiles_cache_available() ) {
+        g_warning ( _("MBTiles cache layout not available - using OSM layout instead") );
+        changed = vik_layer_param_change_uint ( VIK_LPD_UINT(VIK_MAPS_CACHE_LAYOUT_OSM), &vml->cache_layout );
+      }
+      else if ( vlsp->data.u < VIK_MAPS_CACHE_LAYOUT_NUM )
         changed = vik_layer_param_change_uint ( vlsp->data, &vml->cache_layout );
       break;
     case PARAM_CACHE_EXPIRY_AGE:
@@ -935,6 +1033,8 @@ static VikMapsLayer *maps_layer_new ( VikViewport *vvp )
   vml->last_ympp = 0.0;
 
   vml->dl_right_click_menu = NULL;
+  vml->scheduler = NULL;
+  vml->prefetch.pending = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
   return vml;
 }
 
@@ -946,8 +1046,20 @@ static void maps_layer_free ( VikMapsLayer *vml )
     g_object_ref_sink ( G_OBJECT(vml->dl_right_click_menu) );
   g_free(vml->last_center);
   vml->last_center = NULL;
+  if ( vml->scheduler )
+    tile_scheduler_detach ( vml->scheduler );
+  vml->scheduler = NULL;
   g_free ( vml->filename );
   vml->filename = NULL;
+  if ( vml->prefetch.pending )
+    g_hash_table_destroy ( vml->prefetch.pending );
+  vml->prefetch.pending = NULL;
+  if ( vml->prefetch.job )
+    decode_job_release ( vml->prefetch.job );
+  vml->prefetch.job = NULL;
+  if ( vml->decode_job )
+    decode_job_release ( vml->decode_job );
+  vml->decode_job = NULL;
 
 #ifdef HAVE_SQLITE3_H
   VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
@@ -961,6 +1073,8 @@ static void maps_layer_free ( VikMapsLayer *vml )
     }
   }
 #endif
+  a_mbtiles_pool_unref ( vml->mbtiles_pool );
+  vml->mbtiles_pool = NULL;
 }
 
 static gchar* maps_layer_get_new_name ( VikLayer *vl )
@@ -1102,6 +1216,10 @@ static void maps_layer_mbtiles_open ( VikMapsLayer *vml, VikViewport *vp, VikMap
         }
       }
     }
+    // The layer connection is kept for the metadata,
+    //  tiles are read via the pool so several threads can read at once
+    if ( vml->mbtiles && !vml->mbtiles_pool )
+      vml->mbtiles_pool = a_mbtiles_pool_new ( vml->filename );
   }
 }
 #endif
@@ -1139,6 +1257,8 @@ static void maps_layer_post_read (VikLayer *vl, VikViewport *vp, gboolean from_f
     g_free ( vml->filename );
     vml->filename = g_strdup (vml->cache_dir);
   }
+
+  maps_layer_cache_quota_register ( vml, map );
 }
 
 static const gchar* maps_layer_tooltip ( VikMapsLayer *vml )
@@ -1169,6 +1289,20 @@ static gboolean maps_layer_is_cached_storage ( VikMapSource *map )
              vik_map_source_is_osm_meta_tiles(map) );
 }
 
+/**
+ * Apply the current cache size limit to the layer's cache directory
+ */
+static void maps_layer_cache_quota_register ( VikMapsLayer *vml, VikMapSource *map )
+{
+  if ( !maps_layer_is_cached_storage(map) || !vml->cache_dir )
+    return;
+  guint64 quota = 0;
+  VikLayerParamData *pref = a_preferences_get(VIKING_PREFERENCES_NAMESPACE "maplayer_cache_quota");
+  if ( pref )
+    quota = (guint64)pref->u * 1024 * 1024;
+  a_cache_quota_register ( vml->cache_dir, quota );
+}
+
 /*********************/
 /****** DRAWING ******/
 /*********************/
@@ -1198,78 +1332,33 @@ static int sql_select_tile_dump_cb (void *data, int cols, char **fields, char **
 /**
  *
  */
-static GdkPixbuf *get_pixbuf_sql_exec ( sqlite3 *sql, gint xx, gint yy, gint zoom )
+static GdkPixbuf *get_pixbuf_sql_exec ( MBTilesPool *pool, gint xx, gint yy, gint zoom, GBytes **encoded )
 {
   GdkPixbuf *pixbuf = NULL;
 
-  // MBTiles stored internally with the flipping y thingy (i.e. TMS scheme).
-  gint flip_y = (gint) pow(2, zoom)-1 - yy;
-  gchar *statement = g_strdup_printf ( "SELECT tile_data FROM tiles WHERE zoom_level=%d AND tile_column=%d AND tile_row=%d;", zoom, xx, flip_y );
-
-  gboolean finished = FALSE;
-
-  sqlite3_stmt *sql_stmt = NULL;
-  int ans = sqlite3_prepare_v2 ( sql, statement, -1, &sql_stmt, NULL );
-  if ( ans != SQLITE_OK ) {
-    g_warning ( "%s: %s - %s: %s", __FUNCTION__, "prepare failure", sqlite3_errstr(ans), statement );
-    finished = TRUE;
-  }
-
-  while ( !finished ) {
-    ans = sqlite3_step ( sql_stmt );
-    switch (ans) {
-      case SQLITE_ROW: {
-        // Get tile_data blob
-        int count = sqlite3_column_count(sql_stmt);
-        if ( count != 1 )  {
-          g_warning ( "%s: %s - %d", __FUNCTION__, "count not one", count );
-          finished = TRUE;
-        }
-        else {
-          const void *data = sqlite3_column_blob ( sql_stmt, 0 );
-          int bytes = sqlite3_column_bytes ( sql_stmt, 0 );
-          if ( bytes < 1 )  {
-            g_warning ( "%s: %s (%d)", __FUNCTION__, "not enough bytes", bytes );
-            finished = TRUE;
-          }
-          else {
-            // Convert these blob bytes into a pixbuf via these streaming operations
-            GInputStream *stream = g_memory_input_stream_new_from_data ( data, bytes, NULL );
-            GError *error = NULL;
-            pixbuf = gdk_pixbuf_new_from_stream ( stream, NULL, &error );
-            if ( error ) {
-              g_warning ( "%s: %s", __FUNCTION__, error->message );
-              g_error_free ( error );
-            }
-            g_input_stream_close ( stream, NULL, NULL );
-          }
-        }
-        break;
-      }
-      default:
-       // e.g. SQLITE_DONE | SQLITE_ERROR | SQLITE_MISUSE | etc...
-       // Finished normally
-       //  and give up on any errors
-       if ( ans != SQLITE_DONE )
-         g_warning ( "%s: %s - %s", __FUNCTION__, "step issue", sqlite3_errstr(ans) );
-       finished = TRUE;
-       break;
+  GBytes *blob = a_mbtiles_pool_get ( pool, xx, yy, zoom, NULL );
+  if ( blob ) {
+    GError *error = NULL;
+    pixbuf = ui_pixbuf_new_from_bytes ( blob, &error );
+    if ( error ) {
+      g_warning ( "%s: %s", __FUNCTION__, error->message );
+      g_error_free ( error );
     }
+    if ( pixbuf && encoded )
+      *encoded = g_bytes_ref ( blob );
+    g_bytes_unref ( blob );
   }
-  (void)sqlite3_finalize ( sql_stmt );
-
-  g_free ( statement );
 
   return pixbuf;
 }
 #endif
 
-static GdkPixbuf *get_mbtiles_pixbuf ( VikMapsLayer *vml, gint xx, gint yy, gint zoom )
+static GdkPixbuf *get_mbtiles_pixbuf ( VikMapsLayer *vml, gint xx, gint yy, gint zoom, GBytes **encoded )
 {
   GdkPixbuf *pixbuf = NULL;
 
 #ifdef HAVE_SQLITE3_H
-  if ( vml->mbtiles ) {
+  if ( vml->mbtiles_pool ) {
     /*
     gchar *statement = g_strdup_printf ( "SELECT name FROM sqlite_master WHERE type='table';" );
     char *errMsg = NULL;
@@ -1283,71 +1372,59 @@ static GdkPixbuf *get_mbtiles_pixbuf ( VikMapsLayer *vml, gint xx, gint yy, gint
     */
 
     // Reading BLOBS is a bit more involved and so can't use the simpler sqlite3_exec ()
-    // Hence this specific function
-    pixbuf = get_pixbuf_sql_exec ( vml->mbtiles, xx, yy, zoom );
+    // Hence this specific function, which reuses prepared statements via the pool
+    pixbuf = get_pixbuf_sql_exec ( vml->mbtiles_pool, xx, yy, zoom, encoded );
   }
 #endif
 
   return pixbuf;
 }
 
-static GdkPixbuf *get_pixbuf_from_metatile ( VikMapsLayer *vml, gint xx, gint yy, gint zz )
+static GdkPixbuf *get_pixbuf_from_metatile ( const gchar *cache_dir, gint xx, gint yy, gint zz, GBytes **encoded )
 {
-  const int tile_max = METATILE_MAX_SIZE;
-  char err_msg[PATH_MAX];
-  char *buf;
-  int len;
-  int compressed;
-
-  buf = g_malloc(tile_max);
-  if (!buf) {
-      return NULL;
-  }
-
-  err_msg[0] = 0;
-  len = metatile_read(vml->cache_dir, xx, yy, zz, buf, tile_max, &compressed, err_msg);
-
-  if (len > 0) {
-    if (compressed) {
-      // Not handled yet - I don't think this is used often - so implement later if necessary
-      g_warning ( "Compressed metatiles not implemented:%s", __FUNCTION__);
-      g_free(buf);
-      return NULL;
-    }
-
-    // Convert these buf bytes into a pixbuf via these streaming operations
-    GdkPixbuf *pixbuf = NULL;
-
-    GInputStream *stream = g_memory_input_stream_new_from_data ( buf, len, NULL );
-    GError *error = NULL;
-    pixbuf = gdk_pixbuf_new_from_stream ( stream, NULL, &error );
-    if (error) {
-      g_warning ( "%s: %s", __FUNCTION__, error->message );
+  // Other tiles within the same metatile are then available from memory
+  gboolean compressed = FALSE;
+  GError *error = NULL;
+  GBytes *bytes = a_metatile_cache_get ( cache_dir, xx, yy, zz, &compressed, &error );
+  if ( !bytes ) {
+    // Missing tiles are normal (e.g. not yet rendered)
+    if ( !g_error_matches ( error, G_FILE_ERROR, G_FILE_ERROR_NOENT ) )
+      g_warning ( "FAILED:%s %s", __FUNCTION__, error ? error->message : "" );
+    if ( error )
       g_error_free ( error );
-    }
-    g_input_stream_close ( stream, NULL, NULL );
-
-    g_free(buf);
-    return pixbuf;
+    return NULL;
   }
-  else {
-    g_free(buf);
-    g_warning ( "FAILED:%s %s", __FUNCTION__, err_msg);
+
+  if (compressed) {
+    // Not handled yet - I don't think this is used often - so implement later if necessary
+    g_warning ( "Compressed metatiles not implemented:%s", __FUNCTION__);
+    g_bytes_unref ( bytes );
     return NULL;
   }
+
+  GdkPixbuf *pixbuf = ui_pixbuf_new_from_bytes ( bytes, &error );
+  if (error) {
+    g_warning ( "%s: %s", __FUNCTION__, error->message );
+    g_error_free ( error );
+  }
+  if ( pixbuf && encoded )
+    *encoded = g_bytes_ref ( bytes );
+  g_bytes_unref ( bytes );
+  return pixbuf;
 }
 
 /**
  * Caller has to decrease reference counter of returned
  * GdkPixbuf, when buffer is no longer needed.
+ *
+ * NB Can be called from a background thread, hence the layer values are passed in
  */
-static GdkPixbuf *pixbuf_apply_settings ( GdkPixbuf *pixbuf, VikMapsLayer *vml, guint vp_scale,
-                                          MapCoord *mapcoord, gdouble xshrinkfactor, gdouble yshrinkfactor, guint status )
+static GdkPixbuf *pixbuf_apply_settings_full ( GdkPixbuf *pixbuf, VikMapSource *map, guint8 alpha, const gchar *name, guint vp_scale,
+                                               MapCoord *mapcoord, gdouble xshrinkfactor, gdouble yshrinkfactor, guint status )
 {
-  VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
   // Apply alpha setting
-  if ( pixbuf && vml->alpha < 255 )
-    pixbuf = ui_pixbuf_set_alpha ( pixbuf, vml->alpha );
+  if ( pixbuf && alpha < 255 )
+    pixbuf = ui_pixbuf_set_alpha ( pixbuf, alpha );
 
   if ( pixbuf && ( xshrinkfactor != 1.0 || yshrinkfactor != 1.0 ) )
      pixbuf = pixbuf_shrink ( pixbuf, xshrinkfactor, yshrinkfactor );
@@ -1363,11 +1440,98 @@ static GdkPixbuf *pixbuf_apply_settings ( GdkPixbuf *pixbuf, VikMapsLayer *vml,
     pixbuf = pixbuf_shrink ( pixbuf, xscale, yscale );
   }
 
-  if ( pixbuf )
+  if ( pixbuf ) {
+    // Every newly decoded (or generated) tile comes through here
+    a_drawstats_add ( DRAWSTATS_TILES_DECODED, 1 );
     a_mapcache_add ( pixbuf, (mapcache_extra_t){0.0, status}, mapcoord->x, mapcoord->y,
                      mapcoord->z, vik_map_source_get_uniq_id(map),
-                     mapcoord->scale, vml->alpha, xshrinkfactor, yshrinkfactor, vml->filename );
+                     mapcoord->scale, alpha, xshrinkfactor, yshrinkfactor, name );
+  }
+
+  return pixbuf;
+}
+
+/**
+ * Caller has to decrease reference counter of returned
+ * GdkPixbuf, when buffer is no longer needed.
+ */
+static GdkPixbuf *pixbuf_apply_settings ( GdkPixbuf *pixbuf, VikMapsLayer *vml, guint vp_scale,
+                                          MapCoord *mapcoord, gdouble xshrinkfactor, gdouble yshrinkfactor, guint status )
+{
+  return pixbuf_apply_settings_full ( pixbuf, MAPS_LAYER_NTH_TYPE(vml->maptype), vml->alpha, vml->filename, vp_scale,
+                                      mapcoord, xshrinkfactor, yshrinkfactor, status );
+}
+
+/**
+ * Keep the original image data in the mapcache, consuming the reference to @encoded
+ */
+static void add_encoded ( const gchar *name, guint16 id, MapCoord *mapcoord, GBytes *encoded, guint status )
+{
+  if ( encoded ) {
+    a_mapcache_add_encoded ( encoded, (mapcache_extra_t){0.0, status}, mapcoord->x, mapcoord->y,
+                             mapcoord->z, id, mapcoord->scale, name );
+    g_bytes_unref ( encoded );
+  }
+}
+
+/**
+ * Read and decode a tile image file
+ *
+ * @status: On input the current download status of the tile,
+ *          on output updated according to the age of the file
+ * @encoded: Optionally return the file contents
+ */
+static GdkPixbuf *get_pixbuf_from_file ( const gchar *filename, guint cache_expiry_age, guint *status, GBytes **encoded, GError **error )
+{
+  time_t file_time = 0;
+  TileIndexState state = a_tile_index_lookup ( filename, &file_time );
+  if ( state == TILE_INDEX_MISSING ) {
+    g_set_error ( error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "%s: not in the tile index", filename );
+    return NULL;
+  }
+
+  // Read the file contents directly, so the data can be kept in the encoded cache
+  gchar *contents = NULL;
+  gsize length = 0;
+  GError *read_error = NULL;
+  GBytes *bytes = NULL;
+  if ( g_file_get_contents ( filename, &contents, &length, &read_error ) )
+    bytes = g_bytes_new_take ( contents, length );
+  else {
+    // A freshly downloaded tile is indexed before its file has been written
+    bytes = a_download_get_pending_save ( filename );
+    if ( bytes )
+      g_error_free ( read_error );
+    else {
+      if ( g_error_matches ( read_error, G_FILE_ERROR, G_FILE_ERROR_NOENT ) ) {
+        a_tile_index_remove ( filename );
+        a_cache_quota_remove ( filename );
+      }
+      g_propagate_error ( error, read_error );
+      return NULL;
+    }
+  }
 
+  GdkPixbuf *pixbuf = ui_pixbuf_new_from_bytes ( bytes, error );
+  if ( pixbuf ) {
+    a_cache_quota_access ( filename );
+    if ( *status >= DOWNLOAD_SUCCESS ) {
+      // On read in from file, check expiry value
+      GStatBuf buf;
+      if ( state == TILE_INDEX_UNKNOWN && g_stat(filename, &buf) == 0 ) {
+        state = TILE_INDEX_EXISTS;
+        file_time = buf.st_mtime;
+      }
+      if ( state == TILE_INDEX_EXISTS ) {
+        *status = DOWNLOAD_SUCCESS;
+        if ( (time(NULL) - file_time) > cache_expiry_age )
+          *status = MAPCACHE_STATUS_FILE_EXPIRED;
+      }
+    }
+    if ( encoded )
+      *encoded = g_bytes_ref ( bytes );
+  }
+  g_bytes_unref ( bytes );
   return pixbuf;
 }
 
@@ -1396,18 +1560,146 @@ static void get_filename ( const gchar *cache_dir,
       else
         g_snprintf ( filename_buf, buf_len, DIRECTDIRACCESS, cache_dir, (17 - scale), x, y, file_extension );
       break;
+    case VIK_MAPS_CACHE_LAYOUT_MBTILES:
+      // Only a temporary file for the download
+      g_snprintf ( filename_buf, buf_len, MBTILESSTAGING, cache_dir, id, (17 - scale), x, y );
+      break;
     default:
       g_snprintf ( filename_buf, buf_len, DIRSTRUCTURE, cache_dir, id, scale, z, x, y );
       break;
   }
 }
 
+/**
+ * Filename of a tile for map types stored as individual files
+ */
+static void get_tile_filename ( VikMapsLayer *vml, VikMapSource *map, guint16 id, const gchar* mapname, MapCoord *mapcoord,
+                                gchar *filename_buf, gint buf_len )
+{
+  if ( vik_map_source_is_direct_file_access(map) )
+    get_filename ( vml->cache_dir, VIK_MAPS_CACHE_LAYOUT_OSM, id, NULL,
+                   mapcoord->scale, mapcoord->z, mapcoord->x, mapcoord->y, filename_buf, buf_len,
+                   vik_map_source_get_file_extension(map) );
+  else
+    get_filename ( vml->cache_dir, vml->cache_layout, id, mapname,
+                   mapcoord->scale, mapcoord->z, mapcoord->x, mapcoord->y, filename_buf, buf_len,
+                   vik_map_source_get_file_extension(map) );
+}
+
+/**
+ * Database of the MBTiles cache layout
+ *  named similarly to the directory used in the OSM cache layout
+ *
+ * Free after use
+ */
+static gchar *get_mbtiles_cache_name ( const gchar *cache_dir, const gchar *name )
+{
+  if ( name && !g_strcmp0 ( cache_dir, MAPS_CACHE_DIR ) )
+    return g_strdup_printf ( MBTILESCACHE, cache_dir, name );
+  else
+    return g_strdup_printf ( MBTILESCACHE, cache_dir, "tiles" );
+}
+
+/**
+ * Whether the tile file exists, via the tile index when possible
+ */
+static gboolean tile_file_exists ( const gchar *filename )
+{
+  TileIndexState state = a_tile_index_lookup ( filename, NULL );
+  if ( state != TILE_INDEX_UNKNOWN )
+    return ( state == TILE_INDEX_EXISTS );
+  return g_file_test ( filename, G_FILE_TEST_EXISTS );
+}
+
+/**
+ * Whether the tile is in the cache
+ * For the file based layouts @filename_buf is set to the tile's file,
+ *  for the MBTiles layout this is the temporary file used for downloading
+ */
+static gboolean cache_tile_exists ( const gchar *cache_dir, VikMapsCacheLayout cl, VikMapSource *map, MapCoord *mc,
+                                    gchar *filename_buf, gint buf_len )
+{
+  get_filename ( cache_dir, cl, vik_map_source_get_uniq_id(map), vik_map_source_get_name(map),
+                 mc->scale, mc->z, mc->x, mc->y, filename_buf, buf_len,
+                 vik_map_source_get_file_extension(map) );
+
+  if ( cl == VIK_MAPS_CACHE_LAYOUT_MBTILES ) {
+    gchar *dbname = get_mbtiles_cache_name ( cache_dir, vik_map_source_get_name(map) );
+    gboolean exists = a_mbtiles_cache_exists ( dbname, mc->x, mc->y, (17 - mc->scale), NULL );
+    g_free ( dbname );
+    return exists;
+  }
+  return tile_file_exists ( filename_buf );
+}
+
+/**
+ * As get_pixbuf_from_file() but for a tile held in an MBTiles cache
+ */
+static GdkPixbuf *get_pixbuf_from_mbtiles_cache ( const gchar *dbname, MapCoord *mc, guint cache_expiry_age, guint *status, GBytes **encoded, GError **error )
+{
+  time_t mtime = 0;
+  GBytes *bytes = a_mbtiles_cache_get ( dbname, mc->x, mc->y, (17 - mc->scale), &mtime );
+  if ( !bytes )
+    return NULL;
+
+  GdkPixbuf *pixbuf = ui_pixbuf_new_from_bytes ( bytes, error );
+  if ( pixbuf ) {
+    if ( *status >= DOWNLOAD_SUCCESS ) {
+      *status = DOWNLOAD_SUCCESS;
+      if ( (time(NULL) - mtime) > cache_expiry_age )
+        *status = MAPCACHE_STATUS_FILE_EXPIRED;
+    }
+    if ( encoded )
+      *encoded = g_bytes_ref ( bytes );
+  }
+  g_bytes_unref ( bytes );
+  return pixbuf;
+}
+
+/**
+ * Move a downloaded tile into the MBTiles cache
+ *
+ * Returns: The tile data
+ */
+static GBytes *mbtiles_cache_store ( const gchar *cache_dir, VikMapSource *map, MapCoord *mc )
+{
+  guint16 id = vik_map_source_get_uniq_id ( map );
+  gchar *filename = g_strdup_printf ( MBTILESSTAGING, cache_dir, id, (17 - mc->scale), mc->x, mc->y );
+  GBytes *bytes = NULL;
+
+  gchar *contents = NULL;
+  gsize length = 0;
+  if ( g_file_get_contents ( filename, &contents, &length, NULL ) ) {
+    bytes = g_bytes_new_take ( contents, length );
+    gchar *dbname = get_mbtiles_cache_name ( cache_dir, vik_map_source_get_name(map) );
+    if ( !a_mbtiles_cache_put ( dbname, mc->x, mc->y, (17 - mc->scale), bytes ) ) {
+      g_bytes_unref ( bytes );
+      bytes = NULL;
+    }
+    g_free ( dbname );
+    if ( g_remove ( filename ) )
+      g_warning ( "%s: failed to remove: %s", __FUNCTION__, filename );
+  }
+
+  // Any etag is not much use, as the temporary file is no longer available for server time comparisons
+  gchar *etagfile = g_strdup_printf ( "%s.etag", filename );
+  if ( g_file_test(etagfile, G_FILE_TEST_EXISTS) )
+    (void)g_remove ( etagfile );
+  g_free ( etagfile );
+
+  g_free ( filename );
+  return bytes;
+}
+
 /**
  * Caller has to decrease reference counter of returned
  * GdkPixbuf, when buffer is no longer needed.
+ *
+ * @cache_only: Only return what is already decoded in the mapcache,
+ *               i.e. don't read nor decode anything here
  */
 static GdkPixbuf *get_pixbuf ( VikMapsLayer *vml, guint16 id, guint vp_scale, const gchar* mapname, MapCoord *mapcoord,
-                               gchar *filename_buf, gint buf_len, gdouble xshrinkfactor, gdouble yshrinkfactor )
+                               gchar *filename_buf, gint buf_len, gdouble xshrinkfactor, gdouble yshrinkfactor, gboolean cache_only )
 {
   GdkPixbuf *pixbuf;
 
@@ -1415,35 +1707,64 @@ static GdkPixbuf *get_pixbuf ( VikMapsLayer *vml, guint16 id, guint vp_scale, co
   pixbuf = a_mapcache_get ( mapcoord->x, mapcoord->y, mapcoord->z,
                             id, mapcoord->scale, vml->alpha, xshrinkfactor, yshrinkfactor, vml->filename );
 
+  if ( pixbuf || cache_only )
+    return pixbuf;
+
+  if ( ! pixbuf ) {
+    // Next try the original image data that is still in memory
+    mapcache_extra_t extra;
+    GBytes *encoded = a_mapcache_get_encoded ( mapcoord->x, mapcoord->y, mapcoord->z,
+                                               id, mapcoord->scale, vml->filename, &extra );
+    if ( encoded ) {
+      pixbuf = ui_pixbuf_new_from_bytes ( encoded, NULL );
+      g_bytes_unref ( encoded );
+      if ( pixbuf )
+        return pixbuf_apply_settings ( pixbuf, vml, vp_scale, mapcoord, xshrinkfactor, yshrinkfactor, extra.status );
+    }
+  }
+
   if ( ! pixbuf ) {
     VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
+    GBytes *encoded = NULL;
     if ( vik_map_source_is_direct_file_access(map) ) {
       // ATM MBTiles must be 'a direct access type'
       if ( vik_map_source_is_mbtiles(map) ) {
-        pixbuf = get_mbtiles_pixbuf ( vml, mapcoord->x, mapcoord->y, (17 - mapcoord->scale) );
+        pixbuf = get_mbtiles_pixbuf ( vml, mapcoord->x, mapcoord->y, (17 - mapcoord->scale), &encoded );
+        add_encoded ( vml->filename, id, mapcoord, encoded, DOWNLOAD_SUCCESS );
         pixbuf = pixbuf_apply_settings ( pixbuf, vml, vp_scale, mapcoord, xshrinkfactor, yshrinkfactor, DOWNLOAD_SUCCESS );
         // return now to avoid file tests that aren't appropriate for this map type
         return pixbuf;
       }
       else if ( vik_map_source_is_osm_meta_tiles(map) ) {
-        pixbuf = get_pixbuf_from_metatile ( vml, mapcoord->x, mapcoord->y, (17 - mapcoord->scale) );
+        pixbuf = get_pixbuf_from_metatile ( vml->cache_dir, mapcoord->x, mapcoord->y, (17 - mapcoord->scale), &encoded );
+        add_encoded ( vml->filename, id, mapcoord, encoded, DOWNLOAD_SUCCESS );
         pixbuf = pixbuf_apply_settings ( pixbuf, vml, vp_scale, mapcoord, xshrinkfactor, yshrinkfactor, DOWNLOAD_SUCCESS );
         return pixbuf;
       }
-      else
-        get_filename ( vml->cache_dir, VIK_MAPS_CACHE_LAYOUT_OSM, id, NULL,
-                       mapcoord->scale, mapcoord->z, mapcoord->x, mapcoord->y, filename_buf, buf_len,
-                       vik_map_source_get_file_extension(map) );
     }
-    else
-      get_filename ( vml->cache_dir, vml->cache_layout, id, mapname,
-                     mapcoord->scale, mapcoord->z, mapcoord->x, mapcoord->y, filename_buf, buf_len,
-                     vik_map_source_get_file_extension(map) );
+    else if ( vml->cache_layout == VIK_MAPS_CACHE_LAYOUT_MBTILES ) {
+      mapcache_extra_t extra = a_mapcache_get_extra ( mapcoord->x, mapcoord->y, mapcoord->z, id, mapcoord->scale,
+                                                      vml->alpha, xshrinkfactor, yshrinkfactor, vml->filename );
+      guint status = extra.status;
+      gchar *dbname = get_mbtiles_cache_name ( vml->cache_dir, mapname );
+      pixbuf = get_pixbuf_from_mbtiles_cache ( dbname, mapcoord, vml->cache_expiry_age, &status, &encoded, NULL );
+      g_free ( dbname );
+      if ( pixbuf ) {
+        add_encoded ( vml->filename, id, mapcoord, encoded, status );
+        pixbuf = pixbuf_apply_settings ( pixbuf, vml, vp_scale, mapcoord, xshrinkfactor, yshrinkfactor, status );
+      }
+      return pixbuf;
+    }
+    get_tile_filename ( vml, map, id, mapname, mapcoord, filename_buf, buf_len );
 
-    if ( g_file_test ( filename_buf, G_FILE_TEST_EXISTS ) == TRUE)
+    if ( tile_file_exists ( filename_buf ) )
     {
+      // Maintain any download result status value that is already in the mapcache
+      mapcache_extra_t extra = a_mapcache_get_extra ( mapcoord->x, mapcoord->y, mapcoord->z, id, mapcoord->scale,
+                                                      vml->alpha, xshrinkfactor, yshrinkfactor, vml->filename );
+      guint status = extra.status;
       GError *gx = NULL;
-      pixbuf = gdk_pixbuf_new_from_file ( filename_buf, &gx );
+      pixbuf = get_pixbuf_from_file ( filename_buf, vml->cache_expiry_age, &status, &encoded, &gx );
 
       /* free the pixbuf on error */
       if (gx)
@@ -1462,71 +1783,731 @@ static GdkPixbuf *get_pixbuf ( VikMapsLayer *vml, guint16 id, guint vp_scale, co
           g_object_unref ( G_OBJECT(pixbuf) );
         pixbuf = NULL;
       } else {
-        // Maintain any download result status value that is already in the mapcache
-        mapcache_extra_t extra = a_mapcache_get_extra ( mapcoord->x, mapcoord->y, mapcoord->z, id, mapcoord->scale,
-                                                        vml->alpha, xshrinkfactor, yshrinkfactor, vml->filename );
-        guint status = extra.status;
-        if ( extra.status >= DOWNLOAD_SUCCESS ) {
-          // On read in from file, check expiry value
-          GStatBuf buf;
-          if ( g_stat(filename_buf, &buf) == 0 ) {
-            status = DOWNLOAD_SUCCESS;
-            time_t file_time = buf.st_mtime;
-            if ( (time(NULL) - file_time) > vml->cache_expiry_age )
-              status = MAPCACHE_STATUS_FILE_EXPIRED;
-          }
-        }
+        add_encoded ( vml->filename, id, mapcoord, encoded, status );
+        encoded = NULL;
         pixbuf = pixbuf_apply_settings ( pixbuf, vml, vp_scale, mapcoord, xshrinkfactor, yshrinkfactor, status );
       }
     }
+    if ( encoded )
+      g_bytes_unref ( encoded );
   }
   return pixbuf;
 }
 
-static gboolean should_start_autodownload(VikMapsLayer *vml, VikViewport *vvp)
+/*
+ * Background decoding of tiles
+ *
+ * Reading and decoding tiles can take a noticeable amount of time,
+ *  so when drawing, tiles not already in the mapcache are passed to a background thread
+ *  and the display is updated as the tiles become available.
+ * Each layer has one such job, which picks up the tiles queued by later draws while it runs.
+ * In the meantime the drawing falls back to any other scales already in the mapcache.
+ */
+
+// Don't request redraws more often than this (microseconds)
+#define DECODE_UPDATE_INTERVAL 100000
+
+typedef struct {
+  MapCoord mapcoord;
+  gchar *filename; // NULL for metatiles and MBTiles maps
+  mapcache_key_t *request;
+} DecodeTile;
+
+struct _DecodeInfo {
+  VikMapsLayer *vml;
+  gboolean map_layer_alive;
+  GMutex *mutex;
+  gint ref_count;
+  // Copies of the layer values, so they can be used regardless of the layer lifetime
+  VikMapSource *map;
+  gchar *cache_dir;
+  VikMapsCacheLayout cache_layout;
+  gchar *mbtiles_cache; // Only for the MBTiles cache layout
+  MBTilesPool *mbtiles_pool; // Only for MBTiles maps
+  GHashTable *prefetched; // Tile data read in one go for MBTiles maps
+  gchar *name;
+  guint8 alpha;
+  guint cache_expiry_age;
+  guint vp_scale;
+  gdouble xshrinkfactor;
+  gdouble yshrinkfactor;
+  gboolean overviews; // Whether to generate overviews for tiles not available
+  // Tiles are added while the job runs:
+  GSList *tiles;
+  guint count;
+  gboolean running; // Thread started and still taking tiles
+  gint scale, z, x0, xf, y0, yf; // The view the layer was last drawn at, as only tiles in view need a redraw
+};
+
+static void decode_tile_free ( DecodeTile *dt )
 {
-  const VikCoord *center = vik_viewport_get_center ( vvp );
+  g_free ( dt->filename );
+  g_free ( dt->request );
+  g_free ( dt );
+}
 
-  if (vik_window_get_pan_move (VIK_WINDOW(VIK_GTK_WINDOW_FROM_WIDGET(GTK_WIDGET(vvp)))))
-    /* D'n'D pan in action: do not download */
-    return FALSE;
+static void decode_request_complete ( DecodeTile *dt )
+{
+  // Ensure mutex (and therefore hash) is available
+  //  as can become unavailable on program exit
+  if ( rq_mutex && dt->request ) {
+    g_mutex_lock ( rq_mutex );
+    (void)g_hash_table_remove ( decode_requests, dt->request );
+    g_mutex_unlock ( rq_mutex );
+    g_free ( dt->request );
+    dt->request = NULL;
+  }
+}
 
-  // Don't attempt to download unsupported zoom levels
-  gdouble xzoom = vik_viewport_get_xmpp ( vvp );
-  VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
-  guint8 zl = map_utils_mpp_to_zoom_level ( xzoom );
-  if ( zl < vik_map_source_get_zoom_min(map) || zl > vik_map_source_get_zoom_max(map) )
+static DecodeInfo *decode_info_new ( VikMapsLayer *vml, VikMapSource *map, guint vp_scale, gdouble xshrinkfactor, gdouble yshrinkfactor )
+{
+  DecodeInfo *di = g_malloc0 ( sizeof(DecodeInfo) );
+  di->vml = vml;
+  di->map_layer_alive = TRUE;
+  di->mutex = vik_mutex_new();
+  di->ref_count = 1;
+  di->map = g_object_ref ( map );
+  di->cache_dir = g_strdup ( vml->cache_dir );
+  di->cache_layout = vml->cache_layout;
+  if ( vml->cache_layout == VIK_MAPS_CACHE_LAYOUT_MBTILES && !vik_map_source_is_direct_file_access(map) )
+    di->mbtiles_cache = get_mbtiles_cache_name ( vml->cache_dir, vik_map_source_get_name(map) );
+  if ( vik_map_source_is_mbtiles(map) && vml->mbtiles_pool )
+    di->mbtiles_pool = a_mbtiles_pool_ref ( vml->mbtiles_pool );
+  di->name = g_strdup ( vml->filename );
+  di->alpha = vml->alpha;
+  di->cache_expiry_age = vml->cache_expiry_age;
+  di->vp_scale = vp_scale;
+  di->xshrinkfactor = xshrinkfactor;
+  di->yshrinkfactor = yshrinkfactor;
+  return di;
+}
+
+static void decode_info_free ( DecodeInfo *di )
+{
+  // Any tiles not processed (e.g. when cancelled) can be requested again
+  for ( GSList *iter = di->tiles; iter; iter = iter->next )
+    decode_request_complete ( iter->data );
+  g_slist_free_full ( di->tiles, (GDestroyNotify)decode_tile_free );
+
+  vik_mutex_free ( di->mutex );
+  g_object_unref ( di->map );
+  g_free ( di->cache_dir );
+  g_free ( di->mbtiles_cache );
+  a_mbtiles_pool_unref ( di->mbtiles_pool );
+  if ( di->prefetched )
+    g_hash_table_destroy ( di->prefetched );
+  g_free ( di->name );
+  g_free ( di );
+}
+
+static void decode_info_unref ( DecodeInfo *di )
+{
+  if ( !g_atomic_int_dec_and_test ( &di->ref_count ) )
+    return;
+  decode_info_free ( di );
+}
+
+/**
+ * Requests are identified in the same way as tiles in the mapcache
+ */
+static void decode_request_key ( DecodeInfo *di, guint16 id, MapCoord *mapcoord, mapcache_key_t *key )
+{
+  a_mapcache_key_init ( key, mapcoord->x, mapcoord->y, mapcoord->z, id, mapcoord->scale,
+                        di->alpha, di->xshrinkfactor, di->yshrinkfactor, di->name );
+}
+
+/**
+ * Whether the tile is queued for decoding or being decoded
+ */
+static gboolean decode_request_pending ( DecodeInfo *di, guint16 id, MapCoord *mapcoord )
+{
+  if ( !rq_mutex )
     return FALSE;
+  mapcache_key_t request;
+  decode_request_key ( di, id, mapcoord, &request );
+  g_mutex_lock ( rq_mutex );
+  gboolean pending = g_hash_table_contains ( decode_requests, &request );
+  g_mutex_unlock ( rq_mutex );
+  return pending;
+}
 
-  if (vml->last_center == NULL) {
-    VikCoord *new_center = g_malloc(sizeof(VikCoord));
-    *new_center = *center;
-    vml->last_center = new_center;
-    vml->last_xmpp = vik_viewport_get_xmpp(vvp);
-    vml->last_ympp = vik_viewport_get_ympp(vvp);
-    return TRUE;
+/**
+ * Queue a tile for decoding, unless it is already being decoded
+ * Call with the job's mutex held
+ */
+static void decode_info_add_tile ( DecodeInfo *di, VikMapsLayer *vml, guint16 id, const gchar *mapname, MapCoord *mapcoord,
+                                   gchar *filename_buf, gint buf_len )
+{
+  if ( !rq_mutex )
+    return;
+
+  mapcache_key_t request;
+  decode_request_key ( di, id, mapcoord, &request );
+  g_mutex_lock ( rq_mutex );
+  if ( g_hash_table_contains ( decode_requests, &request ) ) {
+    g_mutex_unlock ( rq_mutex );
+    return;
   }
+  g_hash_table_add ( decode_requests, g_memdup ( &request, sizeof(mapcache_key_t) ) );
+  g_mutex_unlock ( rq_mutex );
+
+  DecodeTile *dt = g_malloc0 ( sizeof(DecodeTile) );
+  dt->mapcoord = *mapcoord;
+  dt->request = g_memdup ( &request, sizeof(mapcache_key_t) );
+  if ( !vik_map_source_is_osm_meta_tiles(di->map) && !di->mbtiles_pool ) {
+    get_tile_filename ( vml, di->map, id, mapname, mapcoord, filename_buf, buf_len );
+    dt->filename = g_strdup ( filename_buf );
+  }
+  di->tiles = g_slist_prepend ( di->tiles, dt );
+  di->count++;
+}
 
-  /* TODO: perhaps vik_coord_diff() */
-  if (vik_coord_equals(vml->last_center, center)
-      && (vml->last_xmpp == vik_viewport_get_xmpp(vvp))
-      && (vml->last_ympp == vik_viewport_get_ympp(vvp)))
-    return FALSE;
+static gint64 *prefetch_key ( gint x, gint y )
+{
+  gint64 *key = g_malloc ( sizeof(gint64) );
+  *key = ((gint64)x << 32) | (guint32)y;
+  return key;
+}
 
-  *(vml->last_center) = *center;
-    vml->last_xmpp = vik_viewport_get_xmpp(vvp);
-    vml->last_ympp = vik_viewport_get_ympp(vvp);
-  return TRUE;
+static void prefetch_tile_cb ( gint x, gint y, GBytes *data, GHashTable *prefetched )
+{
+  g_hash_table_replace ( prefetched, prefetch_key(x, y), g_bytes_ref(data) );
 }
 
 /**
- *
+ * Read all the queued tiles of an MBTiles map in one query,
+ *  rather than a query per tile.
+ * Only when the tiles are at the same scale and mostly fill the area covering them
+ *  (e.g. not just a few tiles at the edges of the view when panning).
  */
-gboolean try_draw_scale_down (VikMapsLayer *vml, VikViewport *vvp, guint vp_scale, MapCoord ulm, gint xx, gint yy, gint tilesize_x_ceil, gint tilesize_y_ceil,
-                              gdouble xshrinkfactor, gdouble yshrinkfactor, guint id, const gchar *mapname, gchar *path_buf, guint max_path_len, gdouble off_x, gdouble off_y)
+static void decode_prefetch_rect ( DecodeInfo *di, GSList *tiles, guint count )
 {
-  GdkPixbuf *pixbuf;
-  int scale_inc;
+  DecodeTile *first = tiles->data;
+  gint x0 = first->mapcoord.x, xf = x0, y0 = first->mapcoord.y, yf = y0;
+  for ( GSList *iter = tiles->next; iter; iter = iter->next ) {
+    MapCoord *mc = &(((DecodeTile*)iter->data)->mapcoord);
+    if ( mc->scale != first->mapcoord.scale )
+      return;
+    x0 = MIN(x0, mc->x); xf = MAX(xf, mc->x);
+    y0 = MIN(y0, mc->y); yf = MAX(yf, mc->y);
+  }
+  if ( (gint64)(xf-x0+1) * (yf-y0+1) > 2 * count )
+    return;
+
+  di->prefetched = g_hash_table_new_full ( g_int64_hash, g_int64_equal, g_free, (GDestroyNotify)g_bytes_unref );
+  (void)a_mbtiles_pool_get_rect ( di->mbtiles_pool, (17 - first->mapcoord.scale), x0, y0, xf, yf,
+                                  (MBTilesTileFunc)prefetch_tile_cb, di->prefetched );
+}
+
+/**
+ * Returns: The tile data from the prefetch or NULL if the tile is not in the file
+ */
+static GBytes *decode_take_prefetched ( DecodeInfo *di, MapCoord *mc )
+{
+  gint64 key = ((gint64)mc->x << 32) | (guint32)mc->y;
+  GBytes *data = g_hash_table_lookup ( di->prefetched, &key );
+  if ( data ) {
+    g_bytes_ref ( data );
+    (void)g_hash_table_remove ( di->prefetched, &key );
+  }
+  return data;
+}
+
+/**
+ * Read and decode a single tile (in a background thread)
+ */
+static GdkPixbuf *decode_tile ( DecodeInfo *di, DecodeTile *dt )
+{
+  guint16 id = vik_map_source_get_uniq_id ( di->map );
+  MapCoord *mc = &(dt->mapcoord);
+
+  mapcache_extra_t extra;
+  GdkPixbuf *pixbuf = NULL;
+  guint status = DOWNLOAD_SUCCESS;
+  GBytes *encoded = a_mapcache_get_encoded ( mc->x, mc->y, mc->z, id, mc->scale, di->name, &extra );
+  if ( encoded ) {
+    pixbuf = ui_pixbuf_new_from_bytes ( encoded, NULL );
+    g_bytes_unref ( encoded );
+    status = extra.status;
+  }
+  else {
+    GError *error = NULL;
+    if ( di->mbtiles_pool ) {
+      if ( di->prefetched )
+        encoded = decode_take_prefetched ( di, mc );
+      else
+        encoded = a_mbtiles_pool_get ( di->mbtiles_pool, mc->x, mc->y, (17 - mc->scale), NULL );
+      if ( encoded )
+        pixbuf = ui_pixbuf_new_from_bytes ( encoded, &error );
+    }
+    else if ( dt->filename ) {
+      // Maintain any download result status value that is already in the mapcache
+      extra = a_mapcache_get_extra ( mc->x, mc->y, mc->z, id, mc->scale, di->alpha, di->xshrinkfactor, di->yshrinkfactor, di->name );
+      status = extra.status;
+      if ( di->mbtiles_cache )
+        pixbuf = get_pixbuf_from_mbtiles_cache ( di->mbtiles_cache, mc, di->cache_expiry_age, &status, &encoded, &error );
+      else
+        pixbuf = get_pixbuf_from_file ( dt->filename, di->cache_expiry_age, &status, &encoded, &error );
+    }
+    else
+      pixbuf = get_pixbuf_from_metatile ( di->cache_dir, mc->x, mc->y, (17 - mc->scale), &encoded );
+
+    if ( error ) {
+      // Missing files are normal (e.g. not yet downloaded)
+      if ( !g_error_matches ( error, G_FILE_ERROR, G_FILE_ERROR_NOENT ) &&
+           !g_error_matches ( error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_CORRUPT_IMAGE ) )
+        g_warning ( "%s: %s", __FUNCTION__, error->message );
+      g_error_free ( error );
+      if ( pixbuf )
+        g_object_unref ( G_OBJECT(pixbuf) );
+      pixbuf = NULL;
+    }
+    if ( pixbuf ) {
+      add_encoded ( di->name, id, mc, encoded, status );
+      encoded = NULL;
+    }
+    if ( encoded )
+      g_bytes_unref ( encoded );
+  }
+
+  return pixbuf_apply_settings_full ( pixbuf, di->map, di->alpha, di->name, di->vp_scale, mc, di->xshrinkfactor, di->yshrinkfactor, status );
+}
+
+/*
+ * Overview tiles
+ *
+ * When zoomed out over an area only downloaded at higher zoom levels,
+ *  each missing tile would otherwise be drawn by scaling (potentially many) tiles at draw time.
+ * Instead after the available tiles have been decoded,
+ *  missing tiles are generated in the background by downsampling each 2x2 block of tiles at the next zoom level
+ *  (recursively, up to 'maps_overview_levels').
+ * The generated tiles are only kept in the mapcache, so they never get mistaken for real tiles in the cache.
+ *
+ * Building an overview reads up to 4^levels tiles, and tiles that can not be built are requested again on every redraw,
+ *  so each result (including the intermediate levels and failures) is also kept in the mapcache,
+ *  under a type of its own so it is not mistaken for the map's tiles.
+ * An entry stays valid until a tile it may be built from is downloaded or deleted (or it is evicted).
+ */
+
+// The mapcache type for the overviews of a map
+#define OVERVIEW_TYPE(id) ((guint16)((id) | 0x8000))
+
+/**
+ * Returns: Whether the overview is in the mapcache, with @pixbuf set to a new reference of it (or NULL if it can not be built)
+ */
+static gboolean overview_cache_get ( guint16 id, const gchar *name, MapCoord *mc, GdkPixbuf **pixbuf, guint *generation )
+{
+  if ( !rq_mutex )
+    return FALSE;
+  g_mutex_lock ( rq_mutex );
+  *generation = overview_generation;
+  g_mutex_unlock ( rq_mutex );
+  *pixbuf = a_mapcache_get ( mc->x, mc->y, mc->z, OVERVIEW_TYPE(id), mc->scale, 255, 1.0, 1.0, name );
+  if ( *pixbuf )
+    return TRUE;
+  mapcache_extra_t extra = a_mapcache_get_extra ( mc->x, mc->y, mc->z, OVERVIEW_TYPE(id), mc->scale, 255, 1.0, 1.0, name );
+  return ( extra.status != MAPCACHE_STATUS_NOT_IN_CACHE );
+}
+
+/**
+ * Keep the result of building an overview,
+ *  unless any tiles have changed since it was started (as it may then be out of date)
+ */
+static void overview_cache_add ( guint16 id, const gchar *name, MapCoord *mc, GdkPixbuf *pixbuf, guint generation )
+{
+  if ( !rq_mutex )
+    return;
+  g_mutex_lock ( rq_mutex );
+  if ( generation == overview_generation )
+    a_mapcache_add ( pixbuf, (mapcache_extra_t){0.0, MAPCACHE_STATUS_OVERVIEW}, mc->x, mc->y, mc->z,
+                     OVERVIEW_TYPE(id), mc->scale, 255, 1.0, 1.0, name );
+  g_mutex_unlock ( rq_mutex );
+}
+
+/**
+ * A tile has been downloaded or deleted, so forget the overviews it may be part of
+ */
+static void overview_cache_tile_changed ( guint16 id, const gchar *name, MapCoord *mc )
+{
+  if ( !rq_mutex )
+    return;
+  g_mutex_lock ( rq_mutex );
+  overview_generation++;
+  for ( gint level = 1; level <= OVERVIEW_LEVELS; level++ ) {
+    MapCoord parent = *mc;
+    parent.x = mc->x >> level;
+    parent.y = mc->y >> level;
+    parent.scale = mc->scale + level;
+    a_mapcache_remove_all_shrinkfactors ( parent.x, parent.y, parent.z, OVERVIEW_TYPE(id), parent.scale, name );
+  }
+  g_mutex_unlock ( rq_mutex );
+}
+
+static void overview_cache_flush ( guint16 id )
+{
+  if ( !rq_mutex )
+    return;
+  g_mutex_lock ( rq_mutex );
+  overview_generation++;
+  a_mapcache_flush_type ( OVERVIEW_TYPE(id) );
+  g_mutex_unlock ( rq_mutex );
+}
+
+/**
+ * Read a tile as is (i.e. without any layer settings applied)
+ */
+static GdkPixbuf *overview_read_tile ( DecodeInfo *di, MapCoord *mc )
+{
+  guint16 id = vik_map_source_get_uniq_id ( di->map );
+  gint zoom = 17 - mc->scale;
+  GBytes *bytes = a_mapcache_get_encoded ( mc->x, mc->y, mc->z, id, mc->scale, di->name, NULL );
+  if ( !bytes ) {
+    if ( di->mbtiles_pool )
+      bytes = a_mbtiles_pool_get ( di->mbtiles_pool, mc->x, mc->y, zoom, NULL );
+    else if ( di->mbtiles_cache )
+      bytes = a_mbtiles_cache_get ( di->mbtiles_cache, mc->x, mc->y, zoom, NULL );
+    else if ( vik_map_source_is_osm_meta_tiles ( di->map ) ) {
+      gboolean compressed = FALSE;
+      bytes = a_metatile_cache_get ( di->cache_dir, mc->x, mc->y, zoom, &compressed, NULL );
+      if ( bytes && compressed ) {
+        g_bytes_unref ( bytes );
+        bytes = NULL;
+      }
+    }
+    else if ( !vik_map_source_is_mbtiles ( di->map ) ) {
+      gchar filename[PATH_MAX];
+      if ( vik_map_source_is_direct_file_access ( di->map ) )
+        get_filename ( di->cache_dir, VIK_MAPS_CACHE_LAYOUT_OSM, id, NULL, mc->scale, mc->z, mc->x, mc->y,
+                       filename, sizeof(filename), vik_map_source_get_file_extension(di->map) );
+      else
+        get_filename ( di->cache_dir, di->cache_layout, id, vik_map_source_get_name(di->map), mc->scale, mc->z, mc->x, mc->y,
+                       filename, sizeof(filename), vik_map_source_get_file_extension(di->map) );
+      gchar *contents = NULL;
+      gsize length = 0;
+      if ( tile_file_exists ( filename ) && g_file_get_contents ( filename, &contents, &length, NULL ) )
+        bytes = g_bytes_new_take ( contents, length );
+    }
+  }
+  if ( !bytes )
+    return NULL;
+
+  GdkPixbuf *pixbuf = ui_pixbuf_new_from_bytes ( bytes, NULL );
+  g_bytes_unref ( bytes );
+  return pixbuf;
+}
+
+/**
+ * Generate a tile by downsampling the 2x2 tiles at the next zoom level,
+ *  which themselves may be generated from further levels.
+ * All four tiles are required, otherwise the existing drawing fallbacks give a better result.
+ */
+static GdkPixbuf *overview_build ( DecodeInfo *di, MapCoord *mc, gint levels )
+{
+  guint16 id = vik_map_source_get_uniq_id ( di->map );
+  GdkPixbuf *pixbuf = NULL;
+  guint generation = 0;
+  if ( overview_cache_get ( id, di->name, mc, &pixbuf, &generation ) )
+    return pixbuf;
+
+  GdkPixbuf *quads[4] = { NULL, NULL, NULL, NULL };
+  gboolean complete = TRUE;
+  for ( guint qq = 0; qq < 4 && complete; qq++ ) {
+    MapCoord child = *mc;
+    child.x = mc->x * 2 + (qq % 2);
+    child.y = mc->y * 2 + (qq / 2);
+    child.scale = mc->scale - 1;
+    quads[qq] = overview_read_tile ( di, &child );
+    if ( !quads[qq] && levels > 1 )
+      quads[qq] = overview_build ( di, &child, levels - 1 );
+    complete = ( quads[qq] != NULL );
+  }
+
+  if ( complete ) {
+    gint width = gdk_pixbuf_get_width ( quads[0] );
+    gint height = gdk_pixbuf_get_height ( quads[0] );
+    pixbuf = gdk_pixbuf_new ( GDK_COLORSPACE_RGB, TRUE, 8, width, height );
+    gdk_pixbuf_fill ( pixbuf, 0x00000000 );
+    for ( guint qq = 0; qq < 4; qq++ ) {
+      gint dest_x = (qq % 2) * (width / 2);
+      gint dest_y = (qq / 2) * (height / 2);
+      gdk_pixbuf_scale ( quads[qq], pixbuf, dest_x, dest_y, width / 2, height / 2,
+                         dest_x, dest_y,
+                         (gdouble)(width / 2) / gdk_pixbuf_get_width(quads[qq]),
+                         (gdouble)(height / 2) / gdk_pixbuf_get_height(quads[qq]),
+                         GDK_INTERP_BILINEAR );
+    }
+  }
+  for ( guint qq = 0; qq < 4; qq++ )
+    if ( quads[qq] )
+      g_object_unref ( quads[qq] );
+
+  overview_cache_add ( id, di->name, mc, pixbuf, generation );
+  return pixbuf;
+}
+
+static void decode_emit_update ( DecodeInfo *di )
+{
+  g_mutex_lock ( di->mutex );
+  if ( di->map_layer_alive )
+    vik_layer_emit_update ( VIK_LAYER(di->vml), FALSE ); // NB update display from background
+  g_mutex_unlock ( di->mutex );
+}
+
+/**
+ * Whether the tile is in the view the layer was last drawn at
+ */
+static gboolean decode_tile_visible ( DecodeInfo *di, MapCoord *mc )
+{
+  g_mutex_lock ( di->mutex );
+  gboolean visible = ( di->map_layer_alive && mc->scale == di->scale && mc->z == di->z &&
+                       mc->x >= di->x0 && mc->x <= di->xf && mc->y >= di->y0 && mc->y <= di->yf );
+  g_mutex_unlock ( di->mutex );
+  return visible;
+}
+
+/**
+ * Fill in what can be of the tiles not available from other zoom levels
+ * Returns: Whether any overviews were made
+ */
+static gboolean decode_overviews ( DecodeInfo *di, GSList *missing, gpointer threaddata )
+{
+  guint16 id = vik_map_source_get_uniq_id ( di->map );
+  gboolean made = FALSE;
+  for ( GSList *iter = missing; iter; iter = iter->next ) {
+    MapCoord *mc = iter->data;
+    // No longer needed once out of view
+    if ( !decode_tile_visible ( di, mc ) )
+      continue;
+    GdkPixbuf *pixbuf = overview_build ( di, mc, OVERVIEW_LEVELS );
+    if ( pixbuf ) {
+      // Unless the tile has since become available (downloads record their result without any shrinkfactor)
+      mapcache_extra_t extra = a_mapcache_get_extra ( mc->x, mc->y, mc->z, id, mc->scale, di->alpha, 1.0, 1.0, di->name );
+      if ( extra.status == MAPCACHE_STATUS_NOT_IN_CACHE || extra.status < DOWNLOAD_SUCCESS ) {
+        pixbuf = pixbuf_apply_settings_full ( pixbuf, di->map, di->alpha, di->name, di->vp_scale, mc,
+                                              di->xshrinkfactor, di->yshrinkfactor, MAPCACHE_STATUS_OVERVIEW );
+        made = TRUE;
+      }
+      g_object_unref ( pixbuf );
+    }
+    if ( a_background_testcancel ( threaddata ) )
+      break;
+  }
+  return made;
+}
+
+/**
+ * Read the tiles queued on a layer's job (in a background thread),
+ *  including any queued while it is running
+ */
+static void decode_thread ( DecodeInfo *di, gpointer threaddata )
+{
+  gint64 last_update = g_get_monotonic_time ();
+  gboolean pending = FALSE;
+  gboolean cancelled = FALSE;
+  guint done = 0;
+
+  while ( TRUE ) {
+    g_mutex_lock ( di->mutex );
+    GSList *tiles = g_slist_reverse ( di->tiles );
+    di->tiles = NULL;
+    guint count = MAX ( di->count, 1 );
+    guint batch = g_slist_length ( tiles );
+    // Any tiles queued after this are for a new thread
+    gboolean last = ( !tiles || cancelled );
+    if ( last ) {
+      di->running = FALSE;
+      di->count = 0;
+    }
+    g_mutex_unlock ( di->mutex );
+
+    if ( di->mbtiles_pool && batch > 1 && !cancelled )
+      decode_prefetch_rect ( di, tiles, batch );
+
+    GSList *missing = NULL; // MapCoords of tiles not available, for which to try generating overviews
+    while ( tiles ) {
+      DecodeTile *dt = tiles->data;
+      tiles = g_slist_delete_link ( tiles, tiles );
+      if ( !cancelled ) {
+        GdkPixbuf *pixbuf = decode_tile ( di, dt );
+        // Only redraw for tiles (still) in view
+        if ( pixbuf ) {
+          g_object_unref ( pixbuf );
+          if ( decode_tile_visible ( di, &dt->mapcoord ) )
+            pending = TRUE;
+        }
+        else if ( di->overviews && OVERVIEW_LEVELS > 0 )
+          missing = g_slist_prepend ( missing, g_memdup ( &dt->mapcoord, sizeof(MapCoord) ) );
+        // Only redraw when something new is available, otherwise tiles that don't exist would cause continual redraws
+        if ( pending && (g_get_monotonic_time() - last_update) > DECODE_UPDATE_INTERVAL ) {
+          decode_emit_update ( di );
+          last_update = g_get_monotonic_time ();
+          pending = FALSE;
+        }
+        if ( a_background_thread_progress ( threaddata, (gdouble)(++done) / count ) )
+          cancelled = TRUE;
+      }
+      decode_request_complete ( dt );
+      decode_tile_free ( dt );
+    }
+
+    if ( di->prefetched ) {
+      g_hash_table_destroy ( di->prefetched );
+      di->prefetched = NULL;
+    }
+
+    if ( missing && !cancelled ) {
+      missing = g_slist_reverse ( missing );
+      if ( decode_overviews ( di, missing, threaddata ) )
+        pending = TRUE;
+      cancelled = a_background_testcancel ( threaddata );
+    }
+    g_slist_free_full ( missing, g_free );
+
+    if ( last )
+      break;
+  }
+
+  if ( pending )
+    decode_emit_update ( di );
+}
+
+/**
+ * A layer's job stops taking tiles and is freed once its thread has finished with it
+ */
+static void decode_job_release ( DecodeInfo *di )
+{
+  g_mutex_lock ( di->mutex );
+  di->map_layer_alive = FALSE;
+  GSList *tiles = di->tiles;
+  di->tiles = NULL;
+  g_mutex_unlock ( di->mutex );
+
+  for ( GSList *iter = tiles; iter; iter = iter->next )
+    decode_request_complete ( iter->data );
+  g_slist_free_full ( tiles, (GDestroyNotify)decode_tile_free );
+  decode_info_unref ( di );
+}
+
+static void decode_job_set_view ( DecodeInfo *di, MapCoord *view, gint x0, gint xf, gint y0, gint yf )
+{
+  g_mutex_lock ( di->mutex );
+  di->scale = view->scale;
+  di->z = view->z;
+  di->x0 = x0; di->xf = xf;
+  di->y0 = y0; di->yf = yf;
+  g_mutex_unlock ( di->mutex );
+}
+
+/**
+ * Returns: The layer's job held in @job, replacing it when the tiles would now be read differently
+ */
+static DecodeInfo *decode_job_get ( VikMapsLayer *vml, DecodeInfo **job, VikMapSource *map, guint vp_scale,
+                                    gdouble xshrinkfactor, gdouble yshrinkfactor, gboolean overviews )
+{
+  DecodeInfo *di = *job;
+  if ( di && ( di->map != map || di->vp_scale != vp_scale ||
+               di->xshrinkfactor != xshrinkfactor || di->yshrinkfactor != yshrinkfactor ||
+               di->alpha != vml->alpha || di->cache_layout != vml->cache_layout ||
+               g_strcmp0 ( di->cache_dir, vml->cache_dir ) || g_strcmp0 ( di->name, vml->filename ) ) ) {
+    decode_job_release ( di );
+    di = NULL;
+  }
+  if ( !di ) {
+    di = decode_info_new ( vml, map, vp_scale, xshrinkfactor, yshrinkfactor );
+    di->overviews = overviews;
+    *job = di;
+  }
+  return di;
+}
+
+/**
+ * Queue a tile on a layer's job
+ */
+static void decode_job_add_tile ( DecodeInfo *di, VikMapsLayer *vml, guint16 id, const gchar *mapname, MapCoord *mapcoord,
+                                  gchar *filename_buf, gint buf_len )
+{
+  g_mutex_lock ( di->mutex );
+  decode_info_add_tile ( di, vml, id, mapname, mapcoord, filename_buf, buf_len );
+  g_mutex_unlock ( di->mutex );
+}
+
+/**
+ * Only one thread per job, which picks up tiles queued since it started
+ */
+static void decode_job_start ( DecodeInfo *di, VikMapsLayer *vml, gboolean prefetch )
+{
+  g_mutex_lock ( di->mutex );
+  gboolean start = ( di->tiles && !di->running );
+  if ( start ) {
+    di->running = TRUE;
+    g_atomic_int_inc ( &di->ref_count );
+  }
+  guint count = di->count;
+  g_mutex_unlock ( di->mutex );
+
+  if ( !start )
+    return;
+
+  gchar *job;
+  if ( prefetch )
+    job = g_strdup_printf ( ngettext("Prefetching %d tile for %s", "Prefetching %d tiles for %s", count), count, vik_maps_layer_get_map_label(vml) );
+  else
+    job = g_strdup_printf ( ngettext("Reading %d tile for %s", "Reading %d tiles for %s", count), count, vik_maps_layer_get_map_label(vml) );
+  a_background_thread ( BACKGROUND_POOL_LOCAL,
+                        VIK_GTK_WINDOW_FROM_LAYER(vml),
+                        job,
+                        (vik_thr_func) decode_thread,
+                        di,
+                        (vik_thr_free_func) decode_info_unref,
+                        NULL,
+                        count );
+  g_free ( job );
+}
+
+static gboolean should_start_autodownload(VikMapsLayer *vml, VikViewport *vvp)
+{
+  const VikCoord *center = vik_viewport_get_center ( vvp );
+
+  if (vik_window_get_pan_move (VIK_WINDOW(VIK_GTK_WINDOW_FROM_WIDGET(GTK_WIDGET(vvp)))))
+    /* D'n'D pan in action: do not download */
+    return FALSE;
+
+  // Don't attempt to download unsupported zoom levels
+  gdouble xzoom = vik_viewport_get_xmpp ( vvp );
+  VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
+  guint8 zl = map_utils_mpp_to_zoom_level ( xzoom );
+  if ( zl < vik_map_source_get_zoom_min(map) || zl > vik_map_source_get_zoom_max(map) )
+    return FALSE;
+
+  if (vml->last_center == NULL) {
+    VikCoord *new_center = g_malloc(sizeof(VikCoord));
+    *new_center = *center;
+    vml->last_center = new_center;
+    vml->last_xmpp = vik_viewport_get_xmpp(vvp);
+    vml->last_ympp = vik_viewport_get_ympp(vvp);
+    return TRUE;
+  }
+
+  /* TODO: perhaps vik_coord_diff() */
+  if (vik_coord_equals(vml->last_center, center)
+      && (vml->last_xmpp == vik_viewport_get_xmpp(vvp))
+      && (vml->last_ympp == vik_viewport_get_ympp(vvp)))
+    return FALSE;
+
+  *(vml->last_center) = *center;
+    vml->last_xmpp = vik_viewport_get_xmpp(vvp);
+    vml->last_ympp = vik_viewport_get_ympp(vvp);
+  return TRUE;
+}
+
+/**
+ *
+ */
+gboolean try_draw_scale_down (VikMapsLayer *vml, VikViewport *vvp, guint vp_scale, MapCoord ulm, gint xx, gint yy, gint tilesize_x_ceil, gint tilesize_y_ceil,
+                              gdouble xshrinkfactor, gdouble yshrinkfactor, guint id, const gchar *mapname, gchar *path_buf, guint max_path_len, gdouble off_x, gdouble off_y, gboolean cache_only)
+{
+  GdkPixbuf *pixbuf;
+  int scale_inc;
   for (scale_inc = 1; scale_inc <= SCALE_INC_DOWN; scale_inc++) {
     // Try with smaller zooms
     int scale_factor = 1 << scale_inc;  /*  2^scale_inc */
@@ -1534,7 +2515,7 @@ gboolean try_draw_scale_down (VikMapsLayer *vml, VikViewport *vvp, guint vp_scal
     ulm2.x = ulm.x / scale_factor;
     ulm2.y = ulm.y / scale_factor;
     ulm2.scale = ulm.scale + scale_inc;
-    pixbuf = get_pixbuf ( vml, id, vp_scale, mapname, &ulm2, path_buf, max_path_len, xshrinkfactor * scale_factor, yshrinkfactor * scale_factor );
+    pixbuf = get_pixbuf ( vml, id, vp_scale, mapname, &ulm2, path_buf, max_path_len, xshrinkfactor * scale_factor, yshrinkfactor * scale_factor, cache_only );
     if ( pixbuf ) {
       gint src_x = (ulm.x % scale_factor) * tilesize_x_ceil;
       gint src_y = (ulm.y % scale_factor) * tilesize_y_ceil;
@@ -1561,7 +2542,7 @@ gboolean try_draw_scale_down (VikMapsLayer *vml, VikViewport *vvp, guint vp_scal
  *
  */
 gboolean try_draw_scale_up (VikMapsLayer *vml, VikViewport *vvp, guint vp_scale, MapCoord ulm, gint xx, gint yy, gint tilesize_x_ceil, gint tilesize_y_ceil,
-                            gdouble xshrinkfactor, gdouble yshrinkfactor, guint id, const gchar *mapname, gchar *path_buf, guint max_path_len, gdouble off_x, gdouble off_y)
+                            gdouble xshrinkfactor, gdouble yshrinkfactor, guint id, const gchar *mapname, gchar *path_buf, guint max_path_len, gdouble off_x, gdouble off_y, gboolean cache_only)
 {
   GdkPixbuf *pixbuf;
   gboolean ans = FALSE;
@@ -1579,7 +2560,7 @@ gboolean try_draw_scale_up (VikMapsLayer *vml, VikViewport *vvp, guint vp_scale,
         MapCoord ulm3 = ulm2;
         ulm3.x += pict_x;
         ulm3.y += pict_y;
-        pixbuf = get_pixbuf ( vml, id, vp_scale, mapname, &ulm3, path_buf, max_path_len, xshrinkfactor / scale_factor, yshrinkfactor / scale_factor );
+        pixbuf = get_pixbuf ( vml, id, vp_scale, mapname, &ulm3, path_buf, max_path_len, xshrinkfactor / scale_factor, yshrinkfactor / scale_factor, cache_only );
         if ( pixbuf ) {
           gint dest_x = xx + pict_x * (tilesize_x_ceil / scale_factor);
           gint dest_y = yy + pict_y * (tilesize_y_ceil / scale_factor);
@@ -1637,6 +2618,7 @@ static void maps_layer_draw_section ( VikMapsLayer *vml, VikViewport *vvp, VikCo
     const gint ymin = MIN(ulm.y, brm.y), ymax = MAX(ulm.y, brm.y);
     const guint16 id = vik_map_source_get_uniq_id(map);
     const gchar *mapname = vik_map_source_get_name(map);
+    MapCoord view = ulm;
 
     VikCoord coord;
     gint xx, yy, width, height;
@@ -1656,14 +2638,30 @@ static void maps_layer_draw_section ( VikMapsLayer *vml, VikViewport *vvp, VikCo
 
     guint vp_scale = vik_viewport_get_scale ( vvp );
 
+    // MBTiles maps can only be read in the background via the connection pool
+    DecodeInfo *di = NULL;
+    if ( ASYNC_DECODE && !existence_only && (!vik_map_source_is_mbtiles(map) || vml->mbtiles_pool) ) {
+      di = decode_job_get ( vml, &vml->decode_job, map, vp_scale, xshrinkfactor, yshrinkfactor, TRUE );
+      decode_job_set_view ( di, &view, xmin, xmax, ymin, ymax );
+    }
+
+    if ( !existence_only ) {
+      g_mutex_lock ( rq_mutex );
+      vml->draw_vp_scale = vp_scale;
+      vml->draw_xshrinkfactor = xshrinkfactor;
+      vml->draw_yshrinkfactor = yshrinkfactor;
+      g_mutex_unlock ( rq_mutex );
+    }
+    const gboolean cache_only = (di != NULL);
+
     if ( (!existence_only) && vml->autodownload  && should_start_autodownload(vml, vvp)) {
       g_debug("%s: Starting autodownload", __FUNCTION__);
       if ( !vml->adl_only_missing && vik_map_source_supports_download_only_new (map) )
         // Try to download newer tiles
-        start_download_thread ( vml, vvp, ul, br, REDOWNLOAD_NEW );
+        maps_layer_schedule_view ( vml, vvp, ul, br, REDOWNLOAD_NEW );
       else
         // Download only missing tiles
-        start_download_thread ( vml, vvp, ul, br, REDOWNLOAD_NONE );
+        maps_layer_schedule_view ( vml, vvp, ul, br, REDOWNLOAD_NONE );
     }
 
     // Get drawing offset (ATM a single value that applies to all zoom levels)
@@ -1676,7 +2674,12 @@ static void maps_layer_draw_section ( VikMapsLayer *vml, VikViewport *vvp, VikCo
         for ( y = ymin; y <= ymax; y++ ) {
           ulm.x = x;
           ulm.y = y;
-          pixbuf = get_pixbuf ( vml, id, vp_scale, mapname, &ulm, path_buf, max_path_len, xshrinkfactor, yshrinkfactor );
+          pixbuf = get_pixbuf ( vml, id, vp_scale, mapname, &ulm, path_buf, max_path_len, xshrinkfactor, yshrinkfactor, cache_only );
+          if ( !pixbuf ) {
+            a_drawstats_add ( DRAWSTATS_TILES_MISSED, 1 );
+            if ( di )
+              decode_job_add_tile ( di, vml, id, mapname, &ulm, path_buf, max_path_len );
+          }
           if ( pixbuf ) {
             width = gdk_pixbuf_get_width ( pixbuf );
             height = gdk_pixbuf_get_height ( pixbuf );
@@ -1688,6 +2691,7 @@ static void maps_layer_draw_section ( VikMapsLayer *vml, VikViewport *vvp, VikCo
 
             vik_viewport_draw_pixbuf ( vvp, pixbuf, 0, 0, xx+xa, yy+ya, width, height );
             g_object_unref(pixbuf);
+            a_drawstats_add ( DRAWSTATS_TILES_DRAWN, 1 );
           }
         }
       }
@@ -1712,46 +2716,62 @@ static void maps_layer_draw_section ( VikMapsLayer *vml, VikViewport *vvp, VikCo
       xx -= (tilesize_x/2);
       const gint base_yy = yy - (tilesize_y/2);
 
+      // Only the parts of the view actually being drawn (e.g. just the edges exposed by panning)
+      gint n_area;
+      GdkRectangle *area = vik_viewport_get_draw_area ( vvp, &n_area );
+
       for ( x = ((xinc == 1) ? xmin : xmax); x != xend; x+=xinc ) {
         yy = base_yy;
         for ( y = ((yinc == 1) ? ymin : ymax); y != yend; y+=yinc ) {
           ulm.x = x;
           ulm.y = y;
 
+          if ( !vik_viewport_draw_area_contains ( area, n_area, xx+xa, yy+ya, tilesize_x_ceil, tilesize_y_ceil ) ) {
+            yy += tilesize_y;
+            continue;
+          }
+
           if ( existence_only ) {
-            if ( vik_map_source_is_direct_file_access (MAPS_LAYER_NTH_TYPE(vml->maptype)) )
+            gboolean exists;
+            if ( vik_map_source_is_direct_file_access (MAPS_LAYER_NTH_TYPE(vml->maptype)) ) {
               get_filename ( vml->cache_dir, VIK_MAPS_CACHE_LAYOUT_OSM, id, mapname,
                              ulm.scale, ulm.z, ulm.x, ulm.y, path_buf, max_path_len, vik_map_source_get_file_extension(map) );
+              exists = tile_file_exists ( path_buf );
+            }
             else
-              get_filename ( vml->cache_dir, vml->cache_layout, id, mapname,
-                             ulm.scale, ulm.z, ulm.x, ulm.y, path_buf, max_path_len, vik_map_source_get_file_extension(map) );
+              exists = cache_tile_exists ( vml->cache_dir, vml->cache_layout, map, &ulm, path_buf, max_path_len );
 
-            if ( g_file_test ( path_buf, G_FILE_TEST_EXISTS ) == TRUE ) {
+            if ( exists ) {
 	      GdkGC *black_gc = vik_viewport_get_black_gc(vvp);
               vik_viewport_draw_line ( vvp, black_gc, xx+tilesize_x_ceil, yy, xx, yy+tilesize_y_ceil, &black_color, 1 );
             }
           } else {
             // Try correct scale first
             int scale_factor = 1;
-            pixbuf = get_pixbuf ( vml, id, vp_scale, mapname, &ulm, path_buf, max_path_len, xshrinkfactor * scale_factor, yshrinkfactor * scale_factor );
+            pixbuf = get_pixbuf ( vml, id, vp_scale, mapname, &ulm, path_buf, max_path_len, xshrinkfactor * scale_factor, yshrinkfactor * scale_factor, cache_only );
+            if ( !pixbuf && di )
+              decode_job_add_tile ( di, vml, id, mapname, &ulm, path_buf, max_path_len );
             if ( pixbuf ) {
+              maps_layer_prefetch_used ( vml, &ulm );
               gint src_x = (ulm.x % scale_factor) * tilesize_x_ceil;
               gint src_y = (ulm.y % scale_factor) * tilesize_y_ceil;
               vik_viewport_draw_pixbuf ( vvp, pixbuf, src_x, src_y, xx+xa, yy+ya, tilesize_x_ceil, tilesize_y_ceil );
               g_object_unref(pixbuf);
+              a_drawstats_add ( DRAWSTATS_TILES_DRAWN, 1 );
             }
             else {
               // Otherwise try different scales
+              gboolean drawn;
               if ( SCALE_SMALLER_ZOOM_FIRST ) {
-                if ( !try_draw_scale_down(vml,vvp,vp_scale,ulm,xx,yy,tilesize_x_ceil,tilesize_y_ceil,xshrinkfactor,yshrinkfactor,id,mapname,path_buf,max_path_len, xa, ya) ) {
-                  try_draw_scale_up(vml,vvp,vp_scale,ulm,xx,yy,tilesize_x_ceil,tilesize_y_ceil,xshrinkfactor,yshrinkfactor,id,mapname,path_buf,max_path_len, xa, ya);
-                }
+                drawn = try_draw_scale_down(vml,vvp,vp_scale,ulm,xx,yy,tilesize_x_ceil,tilesize_y_ceil,xshrinkfactor,yshrinkfactor,id,mapname,path_buf,max_path_len, xa, ya, cache_only) ||
+                        try_draw_scale_up(vml,vvp,vp_scale,ulm,xx,yy,tilesize_x_ceil,tilesize_y_ceil,xshrinkfactor,yshrinkfactor,id,mapname,path_buf,max_path_len, xa, ya, cache_only);
               }
               else {
-                if ( !try_draw_scale_up(vml,vvp,vp_scale,ulm,xx,yy,tilesize_x_ceil,tilesize_y_ceil,xshrinkfactor,yshrinkfactor,id,mapname,path_buf,max_path_len, xa, ya) ) {
-                  try_draw_scale_down(vml,vvp,vp_scale,ulm,xx,yy,tilesize_x_ceil,tilesize_y_ceil,xshrinkfactor,yshrinkfactor,id,mapname,path_buf,max_path_len, xa, ya);
-                }
+                drawn = try_draw_scale_up(vml,vvp,vp_scale,ulm,xx,yy,tilesize_x_ceil,tilesize_y_ceil,xshrinkfactor,yshrinkfactor,id,mapname,path_buf,max_path_len, xa, ya, cache_only) ||
+                        try_draw_scale_down(vml,vvp,vp_scale,ulm,xx,yy,tilesize_x_ceil,tilesize_y_ceil,xshrinkfactor,yshrinkfactor,id,mapname,path_buf,max_path_len, xa, ya, cache_only);
               }
+              // Each tile position counts once, whether filled in from another scale or not at all
+              a_drawstats_add ( drawn ? DRAWSTATS_TILES_DRAWN : DRAWSTATS_TILES_MISSED, 1 );
             }
           }
 
@@ -1759,6 +2779,7 @@ static void maps_layer_draw_section ( VikMapsLayer *vml, VikViewport *vvp, VikCo
         }
         xx += tilesize_x;
       }
+      g_free ( area );
 
       //
       // Optionally draw status of each map tile from value held in cache
@@ -1777,7 +2798,8 @@ static void maps_layer_draw_section ( VikMapsLayer *vml, VikViewport *vvp, VikCo
             GdkColor *status_color;
             mapcache_extra_t extra = a_mapcache_get_extra ( x, y, ulm.z, id, ulm.scale, vml->alpha, 1.0, 1.0, vml->filename );
             switch ( extra.status ) {
-            case MAPCACHE_STATUS_NOT_IN_CACHE: status_color = &cache_no_file_color; break;
+            case MAPCACHE_STATUS_NOT_IN_CACHE:
+            case MAPCACHE_STATUS_OVERVIEW: status_color = &cache_no_file_color; break;
             case MAPCACHE_STATUS_FILE_EXPIRED: status_color = &cache_expired_color; break;
             default:
               // ATM not going to try to distinguish being the various download error codes
@@ -1825,6 +2847,13 @@ static void maps_layer_draw_section ( VikMapsLayer *vml, VikViewport *vvp, VikCo
 
     }
     g_free ( path_buf );
+
+    if ( di ) {
+      decode_job_start ( di, vml, FALSE );
+      // Then read ahead of where the view is going
+      if ( vik_map_source_get_tilesize_x(map) )
+        maps_layer_prefetch ( vml, vvp, map, &view, xmin, xmax, ymin, ymax, xshrinkfactor, yshrinkfactor, vp_scale );
+    }
   }
 }
 
@@ -1834,6 +2863,12 @@ static void maps_layer_draw ( VikMapsLayer *vml, VikViewport *vvp )
   {
     VikCoord ul, br;
 
+    // Continue seeding from a previous session once the layer is in use
+    if ( !vml->seeds_resumed ) {
+      vml->seeds_resumed = TRUE;
+      maps_layer_seed_resume ( vml );
+    }
+
     /* Copyright */
     gdouble level = vik_viewport_get_zoom ( vvp );
     LatLonBBox bbox = vik_viewport_get_bbox ( vvp );
@@ -1883,11 +2918,14 @@ typedef struct {
   VikViewport *vvp;
   gboolean map_layer_alive;
   GMutex *mutex;
+  GHashTable *in_flight; // File names of tiles being downloaded concurrently, only used from the download thread
 } MapDownloadInfo;
 
 static void mdi_free ( MapDownloadInfo *mdi )
 {
   vik_mutex_free(mdi->mutex);
+  if ( mdi->in_flight )
+    g_hash_table_destroy ( mdi->in_flight );
   g_free ( mdi->cache_dir );
   mdi->cache_dir = NULL;
   g_free ( mdi->filename_buf );
@@ -1922,234 +2960,1333 @@ static gboolean is_in_area (VikMapSource *map, MapCoord mc)
   return vik_coord_inside ( &vc, &vctl, &vcbr );
 }
 
-// Free after use
-static gchar *create_request_string ( MapDownloadInfo *mdi, guint16 id, gint x, gint y )
+// Free after use
+static gchar *create_request_string ( guint16 id, MapCoord *mc )
+{
+  return g_strdup_printf ( "%d-%d-%d-%d-%d", id, mc->x, mc->y, mc->scale, mc->z );
+}
+
+static void mark_request_complete ( guint16 id, MapCoord *mc )
+{
+  // Ensure mutex (and therefore hash) is available
+  //  as can become unavailable on program exit
+  //  yet this function may still be called from existing threads
+  if ( rq_mutex ) {
+    gchar *request = create_request_string ( id, mc );
+    g_mutex_lock ( rq_mutex );
+    (void)g_hash_table_remove ( requests, request );
+    g_mutex_unlock ( rq_mutex );
+    if ( vik_verbose )
+      g_debug ( "%s: %s", __FUNCTION__, request );
+    g_free ( request );
+  }
+}
+
+static void unref_weak_ref_cb ( MapDownloadInfo *mdi )
+{
+  g_mutex_lock ( mdi->mutex );
+  if ( mdi->map_layer_alive )
+    g_object_weak_unref ( G_OBJECT(mdi->vml), weak_ref_cb, mdi );
+  g_mutex_unlock ( mdi->mutex );
+}
+
+/**
+ * Handle the result of a tile download:
+ *  report errors, release the request and update the memory cache
+ *
+ * When the tile was downloaded into memory, bytes holds the data (which is saved separately)
+ *  and pixbuf the decoded image, which is consumed here.
+ *
+ * Returns: The size of the tile stored (0 if none)
+ */
+static guint64 tile_download_finish ( MapDownloadInfo *mdi, guint16 id, MapCoord *mc, DownloadResult_t dr, gboolean need_download, gboolean remove_mem_cache, GBytes *bytes, GdkPixbuf *pixbuf )
+{
+  guint64 size = 0;
+  switch ( dr ) {
+    case DOWNLOAD_PARAMETERS_ERROR:
+    case DOWNLOAD_HTTP_ERROR:
+    case DOWNLOAD_CONTENT_ERROR: {
+      // TODO: ?? count up the number of download errors somehow...
+      gchar* msg = g_strdup_printf ( "%s: %s", vik_maps_layer_get_map_label (mdi->vml), _("Failed to download tile") );
+      vik_window_statusbar_update ( (VikWindow*)VIK_GTK_WINDOW_FROM_LAYER(mdi->vml), msg, VIK_STATUSBAR_INFO );
+      g_free (msg);
+      break;
+    }
+    case DOWNLOAD_FILE_WRITE_ERROR: {
+      gchar* msg = g_strdup_printf ( "%s: %s", vik_maps_layer_get_map_label (mdi->vml), _("Unable to save tile") );
+      vik_window_statusbar_update ( (VikWindow*)VIK_GTK_WINDOW_FROM_LAYER(mdi->vml), msg, VIK_STATUSBAR_INFO );
+      g_free (msg);
+      break;
+    }
+    case DOWNLOAD_SUCCESS: break;
+    case DOWNLOAD_NOT_REQUIRED:
+      need_download = FALSE;
+      break;
+    case DOWNLOAD_USER_ABORTED:
+      break;
+    default:
+      break;
+  }
+
+  // Move the downloaded tile into the database (before the request is complete, so it won't be requested again)
+  GBytes *stored = NULL;
+  if ( mdi->cache_layout == VIK_MAPS_CACHE_LAYOUT_MBTILES && bytes && dr == DOWNLOAD_SUCCESS ) {
+    // Straight from memory - no staging file
+    VikMapSource *map = MAPS_LAYER_NTH_TYPE(mdi->maptype);
+    gchar *dbname = get_mbtiles_cache_name ( mdi->cache_dir, vik_map_source_get_name(map) );
+    if ( a_mbtiles_cache_put ( dbname, mc->x, mc->y, (17 - mc->scale), bytes ) ) {
+      stored = g_bytes_ref ( bytes );
+      size = g_bytes_get_size ( bytes );
+    }
+    g_free ( dbname );
+  }
+  else if ( mdi->cache_layout == VIK_MAPS_CACHE_LAYOUT_MBTILES && (dr == DOWNLOAD_SUCCESS || dr == DOWNLOAD_NOT_REQUIRED) ) {
+    stored = mbtiles_cache_store ( mdi->cache_dir, MAPS_LAYER_NTH_TYPE(mdi->maptype), mc );
+    if ( stored && dr == DOWNLOAD_SUCCESS )
+      size = g_bytes_get_size ( stored );
+  }
+  else if ( dr == DOWNLOAD_SUCCESS ) {
+    VikMapSource *map = MAPS_LAYER_NTH_TYPE(mdi->maptype);
+    gchar filename[PATH_MAX];
+    get_filename ( mdi->cache_dir, mdi->cache_layout, id, vik_map_source_get_name(map),
+                   mc->scale, mc->z, mc->x, mc->y, filename, sizeof(filename),
+                   vik_map_source_get_file_extension(map) );
+    a_tile_index_add ( filename, time(NULL) );
+    if ( bytes ) {
+      // The file is still being written, so keep the data in memory until then
+      size = g_bytes_get_size ( bytes );
+      a_cache_quota_add ( filename, size );
+      stored = g_bytes_ref ( bytes );
+    }
+    else {
+      GStatBuf stat_buf;
+      if ( g_stat ( filename, &stat_buf ) == 0 ) {
+        size = stat_buf.st_size;
+        a_cache_quota_add ( filename, size );
+      }
+    }
+  }
+
+  mark_request_complete ( id, mc );
+
+  // Avoid attempting to update mapcache when download aborted
+  //  1. Since no real change to track
+  //  2. more importantly, if the program is ending then the mapcache may have been removed
+  if ( dr != DOWNLOAD_USER_ABORTED ) {
+
+    g_mutex_lock(mdi->mutex);
+    if (remove_mem_cache)
+      a_mapcache_remove_all_shrinkfactors ( mc->x, mc->y, mc->z, id, mc->scale, mdi->vml->filename );
+
+    if ( dr == DOWNLOAD_SUCCESS )
+      overview_cache_tile_changed ( id, mdi->vml->filename, mc );
+
+    // Save download result - must be after remove_all_shrinkfactors() otherwise that would remove this result!
+    a_mapcache_add ( NULL, (mapcache_extra_t){0.0, dr}, mc->x, mc->y, mc->z, id,
+                     mc->scale, mdi->vml->alpha, 1.0, 1.0, mdi->vml->filename );
+
+    // Also keep the data in memory, so it can be drawn without waiting for the database batch to be committed
+    if ( stored ) {
+      add_encoded ( mdi->vml->filename, id, mc, stored, DOWNLOAD_SUCCESS );
+      stored = NULL;
+    }
+
+    // Put the decoded tile in the memory cache ready to be drawn
+    if ( pixbuf && mdi->map_layer_alive && mdi->vml->draw_vp_scale ) {
+      g_mutex_lock ( rq_mutex );
+      guint vp_scale = mdi->vml->draw_vp_scale;
+      gdouble xshrinkfactor = mdi->vml->draw_xshrinkfactor;
+      gdouble yshrinkfactor = mdi->vml->draw_yshrinkfactor;
+      g_mutex_unlock ( rq_mutex );
+      GdkPixbuf *drawn = pixbuf_apply_settings ( pixbuf, mdi->vml, vp_scale, mc, xshrinkfactor, yshrinkfactor, DOWNLOAD_SUCCESS );
+      pixbuf = NULL;
+      if ( drawn )
+        g_object_unref ( drawn );
+    }
+
+    if (mdi->refresh_display && mdi->map_layer_alive) {
+      /* TODO: check if it's on visible area */
+      if ( need_download ) {
+        vik_layer_emit_update ( VIK_LAYER(mdi->vml), FALSE ); // NB update display from background
+      }
+    }
+
+    g_mutex_unlock(mdi->mutex);
+  }
+  if ( stored )
+    g_bytes_unref ( stored );
+  if ( pixbuf )
+    g_object_unref ( pixbuf );
+  return size;
+}
+
+/**
+ * Ensure downloaded tiles are saved
+ */
+static void mdi_flush ( MapDownloadInfo *mdi )
+{
+  if ( mdi->cache_layout == VIK_MAPS_CACHE_LAYOUT_MBTILES ) {
+    gchar *dbname = get_mbtiles_cache_name ( mdi->cache_dir, vik_map_source_get_name(MAPS_LAYER_NTH_TYPE(mdi->maptype)) );
+    a_mbtiles_cache_flush ( dbname );
+    g_free ( dbname );
+  }
+}
+
+/**
+ * Decide what needs doing for a tile according to the redownload mode
+ *  and set mdi->filename_buf to where the tile is to be downloaded to
+ *
+ * Returns: FALSE if there is nothing to be done for this tile
+ */
+static gboolean tile_check_redownload ( MapDownloadInfo *mdi, VikMapSource *map, MapCoord *mc, gint redownload, gboolean *need_download, gboolean *remove_mem_cache )
+{
+  *need_download = FALSE;
+  *remove_mem_cache = FALSE;
+
+  if ( !cache_tile_exists ( mdi->cache_dir, mdi->cache_layout, map, mc, mdi->filename_buf, mdi->maxlen ) ) {
+    *need_download = TRUE;
+    *remove_mem_cache = TRUE;
+
+  } else {  /* in case map file already exists */
+    switch (redownload) {
+      case REDOWNLOAD_NONE:
+        return FALSE;
+
+      case REDOWNLOAD_BAD:
+      {
+        /* see if this one is bad or what */
+        GError *gx = NULL;
+        GdkPixbuf *pixbuf = NULL;
+        if ( mdi->cache_layout == VIK_MAPS_CACHE_LAYOUT_MBTILES ) {
+          gchar *dbname = get_mbtiles_cache_name ( mdi->cache_dir, vik_map_source_get_name(map) );
+          GBytes *bytes = a_mbtiles_cache_get ( dbname, mc->x, mc->y, (17 - mc->scale), NULL );
+          if ( bytes ) {
+            pixbuf = ui_pixbuf_new_from_bytes ( bytes, &gx );
+            g_bytes_unref ( bytes );
+          }
+          if ( gx || (!pixbuf) )
+            a_mbtiles_cache_remove ( dbname, mc->x, mc->y, (17 - mc->scale) );
+          g_free ( dbname );
+        }
+        else {
+          pixbuf = gdk_pixbuf_new_from_file ( mdi->filename_buf, &gx );
+          if ( gx || (!pixbuf) ) {
+            if ( g_remove ( mdi->filename_buf ) )
+              g_warning ( "REDOWNLOAD failed to remove: %s", mdi->filename_buf );
+            a_tile_index_remove ( mdi->filename_buf );
+            a_cache_quota_remove ( mdi->filename_buf );
+          }
+        }
+        if (gx || (!pixbuf)) {
+          *need_download = TRUE;
+          *remove_mem_cache = TRUE;
+          if ( gx )
+            g_error_free ( gx );
+          if ( pixbuf )
+            g_object_unref ( pixbuf );
+
+        } else {
+          g_object_unref ( pixbuf );
+        }
+        break;
+      }
+
+      case REDOWNLOAD_NEW:
+        // The download checks the age of the existing file,
+        //  so for the MBTiles layout it is given the time the tile was stored instead
+        if ( mdi->cache_layout == VIK_MAPS_CACHE_LAYOUT_MBTILES ) {
+          gchar *dbname = get_mbtiles_cache_name ( mdi->cache_dir, vik_map_source_get_name(map) );
+          time_t mtime = 0;
+          if ( a_mbtiles_cache_exists ( dbname, mc->x, mc->y, (17 - mc->scale), &mtime ) )
+            a_download_set_stored_time ( mdi->filename_buf, mtime );
+          g_free ( dbname );
+        }
+        *need_download = TRUE;
+        *remove_mem_cache = TRUE;
+        break;
+
+      case REDOWNLOAD_ALL:
+        *need_download = TRUE;
+        *remove_mem_cache = TRUE;
+        break;
+
+      case DOWNLOAD_OR_REFRESH:
+        *remove_mem_cache = TRUE;
+        break;
+
+      default:
+        g_warning ( "redownload state %d unknown", redownload);
+    }
+  }
+  return TRUE;
+}
+
+typedef struct {
+  MapDownloadInfo *mdi;
+  guint16 id;
+  MapCoord mc;
+  gboolean remove_mem_cache;
+  MapSeedJob *seed; // When part of a seeding job
+  guint64 seed_index;
+  const gchar *filename; // When in mdi->in_flight
+} MapDownloadTile;
+
+static MapDownloadTile *tile_download_new ( MapDownloadInfo *mdi, guint16 id, MapCoord *mc, gboolean remove_mem_cache, MapSeedJob *seed, guint64 seed_index )
+{
+  MapDownloadTile *mdt = g_malloc0 ( sizeof(MapDownloadTile) );
+  mdt->mdi = mdi;
+  mdt->id = id;
+  mdt->mc = *mc;
+  mdt->remove_mem_cache = remove_mem_cache;
+  mdt->seed = seed ? a_map_seed_job_ref ( seed ) : NULL;
+  mdt->seed_index = seed_index;
+  return mdt;
+}
+
+/**
+ * Tile downloaded (or not) - the data is decoded here rather than read back from the file,
+ *  which also serves as the check that the data received is an image.
+ *
+ * Returns: Whether the data should be saved to the file
+ */
+static gboolean tile_download_done ( DownloadResult_t dr, GBytes *bytes, gpointer user_data )
+{
+  MapDownloadTile *mdt = (MapDownloadTile*)user_data;
+  GdkPixbuf *pixbuf = NULL;
+  if ( bytes && dr == DOWNLOAD_SUCCESS ) {
+    GError *gx = NULL;
+    pixbuf = ui_pixbuf_new_from_bytes ( bytes, &gx );
+    if ( !pixbuf ) {
+      g_warning ( "%s: %s", __FUNCTION__, gx ? gx->message : "decode failed" );
+      if ( gx )
+        g_error_free ( gx );
+      dr = DOWNLOAD_CONTENT_ERROR;
+      bytes = NULL;
+    }
+  }
+  // MBTiles are put in the database directly
+  gboolean save = pixbuf && mdt->mdi->cache_layout != VIK_MAPS_CACHE_LAYOUT_MBTILES;
+
+  guint64 size = tile_download_finish ( mdt->mdi, mdt->id, &mdt->mc, dr, TRUE, mdt->remove_mem_cache, bytes, pixbuf );
+  if ( mdt->filename )
+    g_hash_table_remove ( mdt->mdi->in_flight, mdt->filename );
+  if ( mdt->seed ) {
+    // Aborted tiles are left to be retried when the job is resumed
+    if ( dr != DOWNLOAD_USER_ABORTED )
+      a_map_seed_job_complete ( mdt->seed, mdt->seed_index, size );
+    a_map_seed_job_unref ( mdt->seed );
+  }
+  g_free ( mdt );
+  return save;
+}
+
+/**
+ * Stop downloading, aborting any downloads in progress
+ */
+static int map_download_abort ( MapDownloadInfo *mdi, VikMapSource *map, void *handle, void *multi )
+{
+  if ( multi )
+    a_download_multi_free ( multi );
+  requests_clear ( mdi->maptype );
+  mdi_flush ( mdi );
+  vik_map_source_download_handle_cleanup ( map, handle );
+  return -1;
+}
+
+static int map_download_thread ( MapDownloadInfo *mdi, gpointer threaddata )
+{
+  VikMapSource *map = MAPS_LAYER_NTH_TYPE(mdi->maptype);
+  void *handle = vik_map_source_download_handle_init ( map );
+  guint donemaps = 0;
+  MapCoord mcoord = mdi->mapcoord;
+  gint x, y;
+  gboolean needed[mdi->xf-mdi->x0+1][mdi->yf-mdi->y0+1];
+  const guint16 id = vik_map_source_get_uniq_id ( map );
+
+  // Downloads are run concurrently when the map source supports it
+  //  otherwise each tile is downloaded in turn
+  guint concurrency = vik_map_source_get_concurrent_downloads ( map );
+  if ( concurrency == 0 )
+    concurrency = DOWNLOAD_CONCURRENCY > 1 ? DOWNLOAD_CONCURRENCY : 1;
+  void *multi = NULL;
+  if ( concurrency > 1 ) {
+    multi = a_download_multi_new ( concurrency );
+    mdi->in_flight = g_hash_table_new_full ( g_str_hash, g_str_equal, g_free, NULL );
+  }
+
+  for ( x = mdi->x0; x <= mdi->xf; x++ ) {
+    mcoord.x = x;
+    for ( y = mdi->y0; y <= mdi->yf; y++ ) {
+      mcoord.y = y;
+      // Only attempt to download a tile from supported areas
+      if ( is_in_area(map, mcoord) ) {
+        gchar *request = create_request_string ( id, &mcoord );
+
+        // Avoid requesting the same tile when already waiting for this request to complete from another thread
+        //  such as scrolling the map around and/or zoomed in/out and come back to a view covering the same tiles
+        g_mutex_lock ( rq_mutex );
+	needed[mdi->xf-x][mdi->yf-y] = ! g_hash_table_lookup_extended ( requests, request, NULL, NULL );
+        if ( needed[mdi->xf-x][mdi->yf-y] ) {
+          if ( vik_verbose )
+            g_debug ( "%s: %d %d Inserting request %s", __FUNCTION__, mdi->xf-x, mdi->yf-y, request );
+          g_hash_table_insert ( requests, request, NULL );
+        }
+        g_mutex_unlock ( rq_mutex );
+
+        if ( !needed[mdi->xf-x][mdi->yf-y] ) {
+          if ( vik_verbose )
+            g_debug ( "%s: Request for %s already in progress", __FUNCTION__, request );
+          g_free ( request );
+        }
+      }
+    }
+  }
+
+  for ( x = mdi->x0; x <= mdi->xf; x++ ) {
+    mcoord.x = x;
+    for ( y = mdi->y0; y <= mdi->yf; y++ ) {
+      mcoord.y = y;
+
+      // Only attempt to download a tile from supported areas
+      if ( is_in_area(map, mcoord) ) {
+
+        gboolean remove_mem_cache = FALSE;
+        gboolean need_download = FALSE;
+        donemaps++;
+        int res = a_background_thread_progress ( threaddata, ((gdouble)donemaps) / mdi->mapstoget ); /* this also calls testcancel */
+        if (res != 0)
+          return map_download_abort ( mdi, map, handle, multi );
+        // Skip as already being requested
+        if ( !needed[mdi->xf-x][mdi->yf-y] ) {
+          continue;
+        }
+
+        if ( !tile_check_redownload ( mdi, map, &mcoord, mdi->redownload, &need_download, &remove_mem_cache ) ) {
+          mark_request_complete ( id, &mcoord );
+          continue;
+        }
+
+        if ( need_download && multi ) {
+          // Several tiles are downloading at once, so rather than mdi->mapcoord,
+          //  mdi_cancel_cleanup() uses the file names recorded until each download completes
+          MapDownloadTile *mdt = tile_download_new ( mdi, id, &mcoord, remove_mem_cache, NULL, 0 );
+          gchar *filename = g_strdup ( mdi->filename_buf );
+          g_hash_table_add ( mdi->in_flight, filename );
+          mdt->filename = filename;
+          if ( vik_map_source_download_multi_add_bytes ( map, &mcoord, mdi->filename_buf, multi, tile_download_done, mdt ) ) {
+            // Keep the configured number of downloads in flight
+            while ( a_download_multi_perform ( multi, 100 ) >= concurrency ) {
+              if ( a_background_testcancel ( threaddata ) )
+                return map_download_abort ( mdi, map, handle, multi );
+            }
+            continue;
+          }
+          // Not supported by this map source, so fallback to one at a time
+          g_hash_table_remove ( mdi->in_flight, filename );
+          g_free ( mdt );
+          while ( a_download_multi_perform ( multi, 100 ) > 0 );
+          a_download_multi_free ( multi );
+          multi = NULL;
+        }
+
+        mdi->mapcoord.x = x; mdi->mapcoord.y = y;
+
+        DownloadResult_t dr = DOWNLOAD_NOT_REQUIRED;
+        if (need_download)
+          dr = vik_map_source_download_bytes ( map, &(mdi->mapcoord), mdi->filename_buf, handle, tile_download_done,
+                                               tile_download_new ( mdi, id, &mcoord, remove_mem_cache, NULL, 0 ) );
+        else
+          tile_download_finish ( mdi, id, &mcoord, dr, need_download, remove_mem_cache, NULL, NULL );
+
+        if ( dr != DOWNLOAD_USER_ABORTED )
+          mdi->mapcoord.x = mdi->mapcoord.y = 0; /* we're temporarily between downloads */
+      }
+    }
+  }
+
+  if ( multi ) {
+    // Wait for the remaining downloads
+    while ( a_download_multi_perform ( multi, 100 ) > 0 ) {
+      if ( a_background_testcancel ( threaddata ) )
+        return map_download_abort ( mdi, map, handle, multi );
+    }
+    a_download_multi_free ( multi );
+  }
+
+  mdi_flush ( mdi );
+
+  vik_map_source_download_handle_cleanup ( map, handle );
+
+  unref_weak_ref_cb ( mdi );
+
+  return 0;
+}
+
+static void cancel_cleanup_file ( const gchar *filename )
+{
+  if ( g_file_test ( filename, G_FILE_TEST_EXISTS ) == TRUE )
+  {
+    if ( g_remove ( filename ) )
+      g_warning ( "Cleanup failed to remove: %s", filename );
+    a_tile_index_remove ( filename );
+    a_cache_quota_remove ( filename );
+  }
+}
+
+static void mdi_cancel_cleanup ( MapDownloadInfo *mdi )
+{
+  if ( mdi->mapcoord.x || mdi->mapcoord.y )
+  {
+    get_filename ( mdi->cache_dir, mdi->cache_layout,
+                   vik_map_source_get_uniq_id(MAPS_LAYER_NTH_TYPE(mdi->maptype)),
+                   vik_map_source_get_name(MAPS_LAYER_NTH_TYPE(mdi->maptype)),
+                   mdi->mapcoord.scale, mdi->mapcoord.z, mdi->mapcoord.x, mdi->mapcoord.y, mdi->filename_buf, mdi->maxlen,
+                   vik_map_source_get_file_extension(MAPS_LAYER_NTH_TYPE(mdi->maptype)) );
+    cancel_cleanup_file ( mdi->filename_buf );
+  }
+
+  if ( mdi->in_flight ) {
+    GHashTableIter iter;
+    gpointer filename;
+    g_hash_table_iter_init ( &iter, mdi->in_flight );
+    while ( g_hash_table_iter_next ( &iter, &filename, NULL ) )
+      cancel_cleanup_file ( filename );
+  }
+
+  requests_clear ( mdi->maptype );
+
+  unref_weak_ref_cb ( mdi );
+}
+
+/*************************/
+/**** TILE SCHEDULER *****/
+/*************************/
+
+/*
+ * Autodownload requests are handled by a per layer scheduler,
+ *  rather than a separate thread for each drawn rectangle.
+ * Queued tiles are ordered by priority and then outwards from the centre of the view,
+ *  so when the view changes requests that are no longer visible
+ *  are demoted (if still nearby) or dropped rather than being downloaded first.
+ *
+ * Seeding jobs (downloading whole areas) are also run by the scheduler,
+ *  with their tiles only being queued (a few at a time) when there is nothing else to do.
+ */
+
+// Number of seeding tiles to queue at once
+#define SEED_BATCH 16
+// Microseconds between updates of the seeding progress
+#define SEED_REPORT_INTERVAL (2 * G_USEC_PER_SEC)
+
+typedef enum {
+  SCHED_PRIORITY_VISIBLE = 0,
+  SCHED_PRIORITY_PREFETCH,
+  SCHED_PRIORITY_SEED,
+  SCHED_PRIORITY_NUM
+} SchedPriority;
+
+typedef struct {
+  MapCoord mc;
+  gint redownload;
+  SchedPriority priority;
+  guint64 seq;
+  gdouble dist; // Squared distance in tiles from the view centre
+  gchar *request; // Key into the global requests table
+  MapSeedJob *seed; // When part of a seeding job
+  guint64 seed_index;
+} TileRequest;
+
+struct _TileScheduler {
+  MapDownloadInfo *mdi; // Download context shared with the worker thread
+  GMutex *mutex;        // Protects all the following
+  GSequence *queue[SCHED_PRIORITY_NUM];
+  guint64 seq;
+  gdouble cx, cy;       // Tile position of the view centre
+  gint x0, y0, xf, yf;  // Visible tiles
+  gint z, scale;
+  gboolean running;
+  guint job_items;      // Number of items the worker was started with
+  gint ref_count;
+  guint dropped, demoted;
+  GList *seeds;         // MapSeedJob, in the order requested
+};
+
+static void tile_request_free ( TileRequest *tr )
+{
+  if ( tr->seed )
+    a_map_seed_job_unref ( tr->seed );
+  g_free ( tr->request );
+  g_free ( tr );
+}
+
+static gint tile_request_compare ( gconstpointer a, gconstpointer b, gpointer user_data )
+{
+  const TileRequest *tra = a;
+  const TileRequest *trb = b;
+  // Seeding is in order requested, otherwise nearest first
+  if ( tra->priority != SCHED_PRIORITY_SEED ) {
+    if ( tra->dist < trb->dist ) return -1;
+    if ( tra->dist > trb->dist ) return 1;
+  }
+  return (tra->seq < trb->seq) ? -1 : (tra->seq > trb->seq);
+}
+
+/**
+ * Remove a queued request that will no longer be downloaded,
+ *  so it can be requested again later on
+ */
+static void tile_request_drop ( TileRequest *tr )
+{
+  if ( rq_mutex ) {
+    g_mutex_lock ( rq_mutex );
+    (void)g_hash_table_remove ( requests, tr->request );
+    g_mutex_unlock ( rq_mutex );
+  }
+  tile_request_free ( tr );
+}
+
+static TileScheduler *tile_scheduler_new ( VikMapsLayer *vml )
+{
+  TileScheduler *ts = g_malloc0 ( sizeof(TileScheduler) );
+  MapDownloadInfo *mdi = g_malloc0 ( sizeof(MapDownloadInfo) );
+
+  mdi->vml = vml;
+  mdi->map_layer_alive = TRUE;
+  mdi->mutex = vik_mutex_new();
+  mdi->refresh_display = TRUE;
+  mdi->cache_dir = g_strdup ( vml->cache_dir );
+  mdi->maxlen = strlen ( vml->cache_dir ) + 40;
+  mdi->filename_buf = g_malloc ( mdi->maxlen * sizeof(gchar) );
+  mdi->cache_layout = vml->cache_layout;
+  mdi->maptype = vml->maptype;
+  g_object_weak_ref ( G_OBJECT(vml), weak_ref_cb, mdi );
+
+  ts->mdi = mdi;
+  ts->mutex = vik_mutex_new();
+  for ( guint pp = 0; pp < SCHED_PRIORITY_NUM; pp++ )
+    ts->queue[pp] = g_sequence_new ( NULL );
+  ts->ref_count = 1;
+  return ts;
+}
+
+static void tile_scheduler_clear ( TileScheduler *ts )
+{
+  for ( guint pp = 0; pp < SCHED_PRIORITY_NUM; pp++ ) {
+    GSequenceIter *iter = g_sequence_get_begin_iter ( ts->queue[pp] );
+    while ( !g_sequence_iter_is_end(iter) ) {
+      tile_request_drop ( g_sequence_get(iter) );
+      iter = g_sequence_iter_next ( iter );
+    }
+    g_sequence_remove_range ( g_sequence_get_begin_iter(ts->queue[pp]), g_sequence_get_end_iter(ts->queue[pp]) );
+  }
+  // Any seeding jobs not finished are kept in their journals
+  g_list_free_full ( ts->seeds, (GDestroyNotify)a_map_seed_job_unref );
+  ts->seeds = NULL;
+}
+
+static void tile_scheduler_unref ( TileScheduler *ts )
+{
+  if ( !g_atomic_int_dec_and_test ( &ts->ref_count ) )
+    return;
+  tile_scheduler_clear ( ts );
+  for ( guint pp = 0; pp < SCHED_PRIORITY_NUM; pp++ )
+    g_sequence_free ( ts->queue[pp] );
+  vik_mutex_free ( ts->mutex );
+  mdi_free ( ts->mdi );
+  g_free ( ts );
+}
+
+/**
+ * The layer no longer uses this scheduler (either being deleted or the map type/cache has changed)
+ *  any downloads in progress are allowed to finish, but nothing else is started
+ */
+static void tile_scheduler_detach ( TileScheduler *ts )
+{
+  g_mutex_lock ( ts->mutex );
+  tile_scheduler_clear ( ts );
+  g_mutex_unlock ( ts->mutex );
+
+  unref_weak_ref_cb ( ts->mdi );
+  g_mutex_lock ( ts->mdi->mutex );
+  ts->mdi->map_layer_alive = FALSE;
+  g_mutex_unlock ( ts->mdi->mutex );
+
+  tile_scheduler_unref ( ts );
+}
+
+static guint tile_scheduler_length ( TileScheduler *ts )
+{
+  guint len = 0;
+  for ( guint pp = 0; pp < SCHED_PRIORITY_NUM; pp++ )
+    len += g_sequence_get_length ( ts->queue[pp] );
+  return len;
+}
+
+static gboolean tile_scheduler_add ( TileScheduler *ts, VikMapSource *map, MapCoord *mc, gint redownload, SchedPriority priority, MapSeedJob *seed, guint64 seed_index );
+
+/**
+ * Queue the next few tiles of the seeding jobs
+ *  and forget about jobs that have been completed
+ * Should be called with the scheduler mutex held
+ */
+static void tile_scheduler_seed ( TileScheduler *ts )
+{
+  VikMapSource *map = MAPS_LAYER_NTH_TYPE(ts->mdi->maptype);
+  GList *iter = ts->seeds;
+  while ( iter && g_sequence_get_length ( ts->queue[SCHED_PRIORITY_SEED] ) < SEED_BATCH ) {
+    MapSeedJob *job = iter->data;
+    MapCoord mc;
+    guint64 index;
+    if ( a_map_seed_job_next ( job, &mc, &index ) ) {
+      // Tiles outside of the map's area or already requested need nothing further
+      if ( !tile_scheduler_add ( ts, map, &mc, a_map_seed_job_get_redownload(job), SCHED_PRIORITY_SEED, job, index ) )
+        a_map_seed_job_complete ( job, index, 0 );
+      continue;
+    }
+    GList *next = iter->next;
+    if ( a_map_seed_job_is_finished ( job ) ) {
+      a_map_seed_job_unref ( job );
+      ts->seeds = g_list_delete_link ( ts->seeds, iter );
+    }
+    // Otherwise still waiting for the last tiles of this job
+    iter = next;
+  }
+}
+
+/**
+ * Get the next tile to download, or NULL when there is none
+ * If @finish is set and there is nothing queued then the worker is considered finished
+ */
+static TileRequest *tile_scheduler_pop ( TileScheduler *ts, gboolean finish )
+{
+  TileRequest *tr = NULL;
+  g_mutex_lock ( ts->mutex );
+  if ( ts->seeds && tile_scheduler_length ( ts ) == 0 )
+    tile_scheduler_seed ( ts );
+  for ( guint pp = 0; pp < SCHED_PRIORITY_NUM && !tr; pp++ ) {
+    GSequenceIter *iter = g_sequence_get_begin_iter ( ts->queue[pp] );
+    if ( !g_sequence_iter_is_end(iter) ) {
+      tr = g_sequence_get ( iter );
+      g_sequence_remove ( iter );
+    }
+  }
+  if ( !tr && finish )
+    ts->running = FALSE;
+  g_mutex_unlock ( ts->mutex );
+  return tr;
+}
+
+/**
+ * Show the progress of the current seeding job every so often
+ */
+static void tile_scheduler_report ( TileScheduler *ts, gpointer threaddata, gint64 *reported )
+{
+  gint64 now = g_get_monotonic_time ();
+  if ( now - *reported < SEED_REPORT_INTERVAL )
+    return;
+  *reported = now;
+
+  gchar *status = NULL;
+  g_mutex_lock ( ts->mutex );
+  if ( ts->seeds )
+    status = a_map_seed_job_get_status ( ts->seeds->data );
+  guint jobs = g_list_length ( ts->seeds );
+  g_mutex_unlock ( ts->mutex );
+
+  if ( status ) {
+    gchar *msg;
+    if ( jobs > 1 )
+      msg = g_strdup_printf ( _("Seeding %s maps (%d jobs): %s"), MAPS_LAYER_NTH_LABEL(ts->mdi->maptype), jobs, status );
+    else
+      msg = g_strdup_printf ( _("Seeding %s maps: %s"), MAPS_LAYER_NTH_LABEL(ts->mdi->maptype), status );
+    a_background_thread_message ( threaddata, msg );
+    g_free ( msg );
+    g_free ( status );
+  }
+}
+
+static int tile_scheduler_thread ( TileScheduler *ts, gpointer threaddata )
+{
+  MapDownloadInfo *mdi = ts->mdi;
+  VikMapSource *map = MAPS_LAYER_NTH_TYPE(mdi->maptype);
+  const guint16 id = vik_map_source_get_uniq_id ( map );
+  void *handle = vik_map_source_download_handle_init ( map );
+
+  g_mutex_lock ( ts->mutex );
+  guint total = ts->job_items;
+  g_mutex_unlock ( ts->mutex );
+  guint donemaps = 0;
+
+  guint concurrency = vik_map_source_get_concurrent_downloads ( map );
+  if ( concurrency == 0 )
+    concurrency = DOWNLOAD_CONCURRENCY > 1 ? DOWNLOAD_CONCURRENCY : 1;
+  void *multi = NULL;
+  if ( concurrency > 1 )
+    multi = a_download_multi_new ( concurrency );
+  guint in_flight = 0;
+  gint64 reported = 0;
+
+  while ( TRUE ) {
+    if ( a_background_testcancel ( threaddata ) ) {
+      if ( multi )
+        a_download_multi_free ( multi ); // Any downloads in progress are aborted
+      g_mutex_lock ( ts->mutex );
+      tile_scheduler_clear ( ts );
+      ts->running = FALSE;
+      g_mutex_unlock ( ts->mutex );
+      mdi_flush ( mdi );
+      vik_map_source_download_handle_cleanup ( map, handle );
+      return -1;
+    }
+
+    tile_scheduler_report ( ts, threaddata, &reported );
+
+    TileRequest *tr = tile_scheduler_pop ( ts, in_flight == 0 );
+    if ( !tr ) {
+      if ( in_flight == 0 )
+        break;
+      in_flight = a_download_multi_perform ( multi, 100 );
+      continue;
+    }
+
+    // Further requests may have been added since the job started,
+    //  but only the number of items it was started with can be reported
+    if ( donemaps < total ) {
+      donemaps++;
+      (void)a_background_thread_progress ( threaddata, ((gdouble)donemaps) / total );
+    }
+
+    gboolean need_download, remove_mem_cache;
+    if ( !tile_check_redownload ( mdi, map, &tr->mc, tr->redownload, &need_download, &remove_mem_cache ) ) {
+      mark_request_complete ( id, &tr->mc );
+      if ( tr->seed )
+        a_map_seed_job_complete ( tr->seed, tr->seed_index, 0 );
+      tile_request_free ( tr );
+      continue;
+    }
+
+    if ( need_download && multi ) {
+      MapDownloadTile *mdt = tile_download_new ( mdi, id, &tr->mc, remove_mem_cache, tr->seed, tr->seed_index );
+      if ( vik_map_source_download_multi_add_bytes ( map, &tr->mc, mdi->filename_buf, multi, tile_download_done, mdt ) ) {
+        tile_request_free ( tr );
+        // Keep the configured number of downloads in flight
+        while ( (in_flight = a_download_multi_perform ( multi, 100 )) >= concurrency ) {
+          if ( a_background_testcancel ( threaddata ) )
+            break; // Detected at the start of the next iteration
+        }
+        continue;
+      }
+      // Not supported by this map source, so fallback to one at a time
+      if ( mdt->seed )
+        a_map_seed_job_unref ( mdt->seed );
+      g_free ( mdt );
+      while ( a_download_multi_perform ( multi, 100 ) > 0 );
+      a_download_multi_free ( multi );
+      multi = NULL;
+      in_flight = 0;
+    }
+
+    if ( need_download ) {
+      // Completion (including any seeding job) is handled by tile_download_done()
+      (void)vik_map_source_download_bytes ( map, &tr->mc, mdi->filename_buf, handle, tile_download_done,
+                                            tile_download_new ( mdi, id, &tr->mc, remove_mem_cache, tr->seed, tr->seed_index ) );
+    }
+    else {
+      (void)tile_download_finish ( mdi, id, &tr->mc, DOWNLOAD_NOT_REQUIRED, FALSE, remove_mem_cache, NULL, NULL );
+      if ( tr->seed )
+        a_map_seed_job_complete ( tr->seed, tr->seed_index, 0 );
+    }
+    tile_request_free ( tr );
+  }
+
+  if ( multi )
+    a_download_multi_free ( multi );
+  mdi_flush ( mdi );
+  vik_map_source_download_handle_cleanup ( map, handle );
+
+  g_mutex_lock ( ts->mutex );
+  if ( ts->dropped || ts->demoted )
+    g_debug ( "%s: dropped %d demoted %d", __FUNCTION__, ts->dropped, ts->demoted );
+  g_mutex_unlock ( ts->mutex );
+
+  return 0;
+}
+
+/**
+ * Add a tile to the queue, unless it is already requested
+ * Should be called with the scheduler mutex held
+ *
+ * Returns: Whether the tile was queued
+ */
+static gboolean tile_scheduler_add ( TileScheduler *ts, VikMapSource *map, MapCoord *mc, gint redownload, SchedPriority priority, MapSeedJob *seed, guint64 seed_index )
+{
+  // Only attempt to download a tile from supported areas
+  if ( !is_in_area(map, *mc) )
+    return FALSE;
+
+  gchar *request = create_request_string ( vik_map_source_get_uniq_id(map), mc );
+
+  // Avoid requesting the same tile when already waiting for this request to complete,
+  //  either from this scheduler or any other download
+  g_mutex_lock ( rq_mutex );
+  gboolean needed = ! g_hash_table_lookup_extended ( requests, request, NULL, NULL );
+  if ( needed )
+    g_hash_table_insert ( requests, g_strdup(request), NULL );
+  g_mutex_unlock ( rq_mutex );
+
+  if ( !needed ) {
+    g_free ( request );
+    return FALSE;
+  }
+
+  TileRequest *tr = g_malloc ( sizeof(TileRequest) );
+  tr->mc = *mc;
+  tr->redownload = redownload;
+  tr->priority = priority;
+  tr->seq = ts->seq++;
+  tr->request = request;
+  tr->seed = seed ? a_map_seed_job_ref ( seed ) : NULL;
+  tr->seed_index = seed_index;
+  gdouble dx = mc->x + 0.5 - ts->cx;
+  gdouble dy = mc->y + 0.5 - ts->cy;
+  tr->dist = dx*dx + dy*dy;
+  g_sequence_insert_sorted ( ts->queue[priority], tr, tile_request_compare, NULL );
+  return TRUE;
+}
+
+/**
+ * Re-evaluate the outstanding requests against the current view
+ * Should be called with the scheduler mutex held
+ */
+static void tile_scheduler_reprioritize ( TileScheduler *ts )
+{
+  GSList *keep = NULL;
+  // Only the view dependent queues; seeding is independent of what is being shown
+  for ( guint pp = SCHED_PRIORITY_VISIBLE; pp <= SCHED_PRIORITY_PREFETCH; pp++ ) {
+    GSequenceIter *iter = g_sequence_get_begin_iter ( ts->queue[pp] );
+    while ( !g_sequence_iter_is_end(iter) ) {
+      keep = g_slist_prepend ( keep, g_sequence_get(iter) );
+      iter = g_sequence_iter_next ( iter );
+    }
+    g_sequence_remove_range ( g_sequence_get_begin_iter(ts->queue[pp]), g_sequence_get_end_iter(ts->queue[pp]) );
+  }
+
+  // Requests within one view width/height of the visible area are retained for later
+  gint xmargin = ts->xf - ts->x0 + 1;
+  gint ymargin = ts->yf - ts->y0 + 1;
+
+  for ( GSList *iter = keep; iter; iter = iter->next ) {
+    TileRequest *tr = iter->data;
+    if ( tr->mc.z != ts->z || tr->mc.scale != ts->scale ||
+         tr->mc.x < ts->x0 - xmargin || tr->mc.x > ts->xf + xmargin ||
+         tr->mc.y < ts->y0 - ymargin || tr->mc.y > ts->yf + ymargin ) {
+      ts->dropped++;
+      tile_request_drop ( tr );
+      continue;
+    }
+    SchedPriority priority = SCHED_PRIORITY_VISIBLE;
+    if ( tr->mc.x < ts->x0 || tr->mc.x > ts->xf || tr->mc.y < ts->y0 || tr->mc.y > ts->yf ) {
+      priority = SCHED_PRIORITY_PREFETCH;
+      if ( tr->priority == SCHED_PRIORITY_VISIBLE )
+        ts->demoted++;
+    }
+    tr->priority = priority;
+    gdouble dx = tr->mc.x + 0.5 - ts->cx;
+    gdouble dy = tr->mc.y + 0.5 - ts->cy;
+    tr->dist = dx*dx + dy*dy;
+    g_sequence_insert_sorted ( ts->queue[priority], tr, tile_request_compare, NULL );
+  }
+  g_slist_free ( keep );
+}
+
+/**
+ * Get the scheduler for this layer, creating a new one if necessary
+ */
+static TileScheduler *maps_layer_get_scheduler ( VikMapsLayer *vml )
+{
+  TileScheduler *ts = vml->scheduler;
+  if ( ts && (ts->mdi->maptype != vml->maptype ||
+              ts->mdi->cache_layout != vml->cache_layout ||
+              g_strcmp0 ( ts->mdi->cache_dir, vml->cache_dir )) ) {
+    tile_scheduler_detach ( ts );
+    ts = NULL;
+  }
+  if ( !ts )
+    ts = tile_scheduler_new ( vml );
+  vml->scheduler = ts;
+  return ts;
+}
+
+/**
+ * Start the worker for the queued requests and seeding jobs, unless already running
+ */
+static void tile_scheduler_start ( TileScheduler *ts, VikMapsLayer *vml )
+{
+  g_mutex_lock ( ts->mutex );
+  guint queued = tile_scheduler_length ( ts );
+  gboolean seeding = ( ts->seeds != NULL );
+  for ( GList *iter = ts->seeds; iter; iter = iter->next )
+    queued += MIN ( a_map_seed_job_get_remaining ( iter->data ), G_MAXINT / 2 );
+  gboolean start = ( queued > 0 && !ts->running );
+  if ( start ) {
+    ts->running = TRUE;
+    ts->job_items = queued;
+    g_atomic_int_inc ( &ts->ref_count );
+  }
+  g_mutex_unlock ( ts->mutex );
+
+  if ( start ) {
+    gchar *tmp;
+    if ( seeding )
+      tmp = g_strdup_printf ( _("Seeding %s maps..."), MAPS_LAYER_NTH_LABEL(vml->maptype) );
+    else
+      tmp = g_strdup_printf ( _("Downloading %s maps..."), MAPS_LAYER_NTH_LABEL(vml->maptype) );
+    a_background_thread ( BACKGROUND_POOL_REMOTE,
+                          VIK_GTK_WINDOW_FROM_LAYER(vml), /* parent window */
+                          tmp,                                              /* description string */
+                          (vik_thr_func) tile_scheduler_thread,             /* function to call within thread */
+                          ts,                                               /* pass along data */
+                          (vik_thr_free_func) tile_scheduler_unref,         /* function to free pass along data */
+                          NULL,
+                          queued );
+    g_free ( tmp );
+  }
+}
+
+/**
+ * Queue download of the tiles for the current view
+ */
+static void maps_layer_schedule_view ( VikMapsLayer *vml, VikViewport *vvp, const VikCoord *ul, const VikCoord *br, gint redownload )
+{
+  gdouble xzoom = vml->xmapzoom ? vml->xmapzoom : vik_viewport_get_xmpp ( vvp );
+  gdouble yzoom = vml->ymapzoom ? vml->ymapzoom : vik_viewport_get_ympp ( vvp );
+  MapCoord ulm, brm;
+  VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
+
+  // Don't ever attempt download on direct access
+  if ( vik_map_source_is_direct_file_access ( map ) )
+    return;
+
+  if ( !vik_map_source_coord_to_mapcoord ( map, ul, xzoom, yzoom, &ulm ) ||
+       !vik_map_source_coord_to_mapcoord ( map, br, xzoom, yzoom, &brm ) )
+    return;
+
+  maps_layer_cache_quota_register ( vml, map );
+
+  TileScheduler *ts = maps_layer_get_scheduler ( vml );
+
+  g_mutex_lock ( ts->mutex );
+  ts->x0 = MIN(ulm.x, brm.x);
+  ts->xf = MAX(ulm.x, brm.x);
+  ts->y0 = MIN(ulm.y, brm.y);
+  ts->yf = MAX(ulm.y, brm.y);
+  ts->cx = (ts->x0 + ts->xf + 1) / 2.0;
+  ts->cy = (ts->y0 + ts->yf + 1) / 2.0;
+  ts->z = ulm.z;
+  ts->scale = ulm.scale;
+
+  tile_scheduler_reprioritize ( ts );
+
+  MapCoord mcoord = ulm;
+  for ( mcoord.x = ts->x0; mcoord.x <= ts->xf; mcoord.x++ )
+    for ( mcoord.y = ts->y0; mcoord.y <= ts->yf; mcoord.y++ )
+      (void)tile_scheduler_add ( ts, map, &mcoord, redownload, SCHED_PRIORITY_VISIBLE, NULL, 0 );
+  g_mutex_unlock ( ts->mutex );
+
+  tile_scheduler_start ( ts, vml );
+}
+
+/*
+ * Prefetching
+ *
+ * Only the visible tiles are requested when drawing, so when panning quickly
+ *  the tiles coming into view are always still being read (or downloaded).
+ * Instead the movement of the view between draws is tracked and extrapolated,
+ *  so that the ring of tiles just outside the view (further out in the direction of panning)
+ *  and the tiles of the next zoom level (when zooming in or out) are read into the mapcache beforehand.
+ * The number of tiles is limited so they only use spare capacity of the mapcache,
+ *  otherwise tiles of the view itself could be evicted.
+ */
+
+// Forget the panning motion when the view hasn't been drawn for this long (microseconds)
+#define PREFETCH_MOTION_TIMEOUT 500000
+// Keep prefetching the next zoom level for this long after the zoom changed (microseconds)
+#define PREFETCH_ZOOM_TIMEOUT 3000000
+
+typedef struct {
+  MapCoord mc;
+  gdouble score; // Lower is likely to be needed sooner
+} PrefetchTile;
+
+static gchar *prefetch_tile_key ( MapCoord *mc )
+{
+  return g_strdup_printf ( "%d-%d-%d-%d", mc->x, mc->y, mc->z, mc->scale );
+}
+
+static gint prefetch_tile_compare ( gconstpointer aa, gconstpointer bb )
 {
-  return g_strdup_printf ( "%d-%d-%d-%d-%d", id, x, y, mdi->mapcoord.scale, mdi->mapcoord.z );
+  gdouble sa = ((const PrefetchTile*)aa)->score;
+  gdouble sb = ((const PrefetchTile*)bb)->score;
+  return (sa > sb) - (sa < sb);
 }
 
-static void mark_request_complete ( MapDownloadInfo *mdi, guint16 id, gint x, gint y )
+/**
+ * Update the velocity (in tiles per second) and zoom direction from the change since the last draw
+ */
+static void prefetch_update_motion ( MapPrefetch *pf, VikViewport *vvp, MapCoord *view, gint xinc, gint yinc,
+                                     gdouble tilesize_x, gdouble tilesize_y )
 {
-  // Ensure mutex (and therefore hash) is available
-  //  as can become unavailable on program exit
-  //  yet this function may still be called from existing threads
-  if ( rq_mutex ) {
-    gchar *request = create_request_string ( mdi, id, x, y );
-    g_mutex_lock ( rq_mutex );
-    (void)g_hash_table_remove ( requests, request );
-    g_mutex_unlock ( rq_mutex );
-    if ( vik_verbose )
-      g_debug ( "%s: %s", __FUNCTION__, request );
-    g_free ( request );
+  const VikCoord *center = vik_viewport_get_center ( vvp );
+  gint64 now = g_get_monotonic_time ();
+
+  if ( pf->time && (view->scale != pf->scale || view->z != pf->z) ) {
+    if ( view->z == pf->z ) {
+      pf->zoom_dir = ( view->scale < pf->scale ) ? 1 : -1;
+      pf->zoom_time = now;
+    }
+    pf->vx = pf->vy = 0.0;
   }
-}
+  else if ( pf->time && !vik_coord_equals ( &pf->center, center ) && (now - pf->time) < PREFETCH_MOTION_TIMEOUT ) {
+    // Where the previous centre is now drawn gives how far the view has moved
+    gint sx, sy;
+    vik_viewport_coord_to_screen ( vvp, &pf->center, &sx, &sy );
+    gdouble secs = (gdouble)MAX(now - pf->time, 1) / G_USEC_PER_SEC;
+    gdouble vx = xinc * (vik_viewport_get_width(vvp)/2 - sx) / tilesize_x / secs;
+    gdouble vy = yinc * (vik_viewport_get_height(vvp)/2 - sy) / tilesize_y / secs;
+    // Smooth out the unevenness of individual draws
+    pf->vx = (pf->vx + vx) / 2.0;
+    pf->vy = (pf->vy + vy) / 2.0;
+  }
+  else if ( pf->time && vik_coord_equals ( &pf->center, center ) && (now - pf->time) < PREFETCH_MOTION_TIMEOUT )
+    // Redrawn in place (e.g. as tiles become available) so the motion is unknown until the next move
+    return;
+  else
+    pf->vx = pf->vy = 0.0;
 
-static void unref_weak_ref_cb ( MapDownloadInfo *mdi )
-{
-  g_mutex_lock ( mdi->mutex );
-  if ( mdi->map_layer_alive )
-    g_object_weak_unref ( G_OBJECT(mdi->vml), weak_ref_cb, mdi );
-  g_mutex_unlock ( mdi->mutex );
+  if ( pf->zoom_dir && (now - pf->zoom_time) > PREFETCH_ZOOM_TIMEOUT )
+    pf->zoom_dir = 0;
+
+  pf->center = *center;
+  pf->time = now;
+  pf->z = view->z;
+  pf->scale = view->scale;
 }
 
-static int map_download_thread ( MapDownloadInfo *mdi, gpointer threaddata )
+/**
+ * Queue reading of the tiles the view is expected to need next,
+ *  and for missing tiles a download when autodownloading
+ */
+static void maps_layer_prefetch ( VikMapsLayer *vml, VikViewport *vvp, VikMapSource *map, MapCoord *view,
+                                  gint xmin, gint xmax, gint ymin, gint ymax, gdouble xshrinkfactor, gdouble yshrinkfactor, guint vp_scale )
 {
-  VikMapSource *map = MAPS_LAYER_NTH_TYPE(mdi->maptype);
-  void *handle = vik_map_source_download_handle_init ( map );
-  guint donemaps = 0;
-  MapCoord mcoord = mdi->mapcoord;
-  gint x, y;
-  gboolean needed[mdi->xf-mdi->x0+1][mdi->yf-mdi->y0+1];
-  const guint16 id = vik_map_source_get_uniq_id ( map );
+  MapPrefetch *pf = &vml->prefetch;
+  const gdouble tilesize_x = vik_map_source_get_tilesize_x(map) * xshrinkfactor * vp_scale;
+  const gdouble tilesize_y = vik_map_source_get_tilesize_y(map) * yshrinkfactor * vp_scale;
+  // Tile numbers may increase in the opposite direction to the screen
+  const gint xinc = (view->x == xmin) ? 1 : -1;
+  const gint yinc = (view->y == ymin) ? 1 : -1;
+
+  prefetch_update_motion ( pf, vvp, view, xinc, yinc, tilesize_x, tilesize_y );
+  pf->x0 = xmin; pf->xf = xmax;
+  pf->y0 = ymin; pf->yf = ymax;
+  if ( pf->job )
+    decode_job_set_view ( pf->job, view, xmin, xmax, ymin, ymax );
+
+  if ( PREFETCH_BUDGET == 0 )
+    return;
 
-  for ( x = mdi->x0; x <= mdi->xf; x++ ) {
-    mcoord.x = x;
-    for ( y = mdi->y0; y <= mdi->yf; y++ ) {
-      mcoord.y = y;
-      // Only attempt to download a tile from supported areas
-      if ( is_in_area(map, mcoord) ) {
-        gchar *request = create_request_string ( mdi, id, x, y );
+  // Only use spare capacity of the mapcache,
+  //  allowing for the view itself and for tiles of other zoom levels drawn in place of missing ones
+  const gint width = xmax - xmin + 1;
+  const gint height = ymax - ymin + 1;
+  guint tile_bytes = MAX ( 1, (guint)(ceil(tilesize_x) * ceil(tilesize_y) * 4) );
+  gint budget = MIN ( PREFETCH_BUDGET, (gint)(a_mapcache_get_max_size() / tile_bytes / 2) - width * height );
+  if ( budget <= 0 )
+    return;
 
-        // Avoid requesting the same tile when already waiting for this request to complete from another thread
-        //  such as scrolling the map around and/or zoomed in/out and come back to a view covering the same tiles
-        g_mutex_lock ( rq_mutex );
-	needed[mdi->xf-x][mdi->yf-y] = ! g_hash_table_lookup_extended ( requests, request, NULL, NULL );
-        if ( needed[mdi->xf-x][mdi->yf-y] ) {
-          if ( vik_verbose )
-            g_debug ( "%s: %d %d Inserting request %s", __FUNCTION__, mdi->xf-x, mdi->yf-y, request );
-          g_hash_table_insert ( requests, request, NULL );
-        }
-        g_mutex_unlock ( rq_mutex );
+  GArray *candidates = g_array_new ( FALSE, FALSE, sizeof(PrefetchTile) );
+  PrefetchTile pt;
+
+  // The ring of tiles around the view, widened to where the panning would take it
+  const gdouble ax = pf->vx * PREFETCH_LOOKAHEAD;
+  const gdouble ay = pf->vy * PREFETCH_LOOKAHEAD;
+  const gdouble speed = sqrt ( ax*ax + ay*ay );
+  const gint left = 1 + (gint)ceil ( CLAMP(-ax, 0.0, width) );
+  const gint right = 1 + (gint)ceil ( CLAMP(ax, 0.0, width) );
+  const gint top = 1 + (gint)ceil ( CLAMP(-ay, 0.0, height) );
+  const gint bottom = 1 + (gint)ceil ( CLAMP(ay, 0.0, height) );
+  pt.mc = *view;
+  for ( pt.mc.x = xmin - left; pt.mc.x <= xmax + right; pt.mc.x++ ) {
+    for ( pt.mc.y = ymin - top; pt.mc.y <= ymax + bottom; pt.mc.y++ ) {
+      gint dx = (pt.mc.x < xmin) ? (pt.mc.x - xmin) : (pt.mc.x > xmax) ? (pt.mc.x - xmax) : 0;
+      gint dy = (pt.mc.y < ymin) ? (pt.mc.y - ymin) : (pt.mc.y > ymax) ? (pt.mc.y - ymax) : 0;
+      if ( dx == 0 && dy == 0 )
+        continue;
+      // Tiles the view is heading towards are needed sooner
+      gboolean ahead = ( dx * ax + dy * ay ) > 0.0;
+      pt.score = (ABS(dx) + ABS(dy)) / ( ahead ? 1.0 + speed : 1.0 );
+      g_array_append_val ( candidates, pt );
+    }
+  }
 
-        if ( !needed[mdi->xf-x][mdi->yf-y] ) {
-          if ( vik_verbose )
-            g_debug ( "%s: Request for %s already in progress", __FUNCTION__, request );
-          g_free ( request );
+  // The next zoom level in the direction of zooming, for the same sized area about the centre
+  //  (only for web mercator maps drawn at the Viking zoom level, as then each level is half the scale of the next)
+  const gboolean mercator = ( vik_map_source_get_drawmode(map) == VIK_VIEWPORT_DRAWMODE_MERCATOR );
+  if ( pf->zoom_dir && mercator && !vml->xmapzoom ) {
+    gint zoom = 17 - (view->scale - pf->zoom_dir);
+    if ( zoom >= vik_map_source_get_zoom_min(map) && zoom <= vik_map_source_get_zoom_max(map) ) {
+      gdouble factor = ( pf->zoom_dir > 0 ) ? 2.0 : 0.5;
+      gdouble cx = (xmin + xmax + 1) / 2.0 * factor;
+      gdouble cy = (ymin + ymax + 1) / 2.0 * factor;
+      pt.mc = *view;
+      pt.mc.scale = view->scale - pf->zoom_dir;
+      for ( pt.mc.x = (gint)floor(cx - width/2.0); pt.mc.x < cx + width/2.0; pt.mc.x++ ) {
+        for ( pt.mc.y = (gint)floor(cy - height/2.0); pt.mc.y < cy + height/2.0; pt.mc.y++ ) {
+          // Comparable with the nearest ring, central tiles first
+          pt.score = (ABS(pt.mc.x + 0.5 - cx) + ABS(pt.mc.y + 0.5 - cy)) / (width + height);
+          g_array_append_val ( candidates, pt );
         }
       }
     }
   }
 
-  for ( x = mdi->x0; x <= mdi->xf; x++ ) {
-    mcoord.x = x;
-    for ( y = mdi->y0; y <= mdi->yf; y++ ) {
-      mcoord.y = y;
-
-      // Only attempt to download a tile from supported areas
-      if ( is_in_area(map, mcoord) ) {
-
-        gboolean remove_mem_cache = FALSE;
-        gboolean need_download = FALSE;
-        donemaps++;
-        int res = a_background_thread_progress ( threaddata, ((gdouble)donemaps) / mdi->mapstoget ); /* this also calls testcancel */
-        if (res != 0) {
-          requests_clear ( mdi->maptype );
-          vik_map_source_download_handle_cleanup ( map, handle );
-          return -1;
-        }
-        // Skip as already being requested
-        if ( !needed[mdi->xf-x][mdi->yf-y] ) {
-          continue;
-        }
-
-        get_filename ( mdi->cache_dir, mdi->cache_layout, id,
-                       vik_map_source_get_name(map),
-                       mdi->mapcoord.scale, mdi->mapcoord.z, x, y, mdi->filename_buf, mdi->maxlen,
-                       vik_map_source_get_file_extension(map) );
-
-        if ( g_file_test ( mdi->filename_buf, G_FILE_TEST_EXISTS ) == FALSE ) {
-          need_download = TRUE;
-          remove_mem_cache = TRUE;
-
-        } else {  /* in case map file already exists */
-          switch (mdi->redownload) {
-            case REDOWNLOAD_NONE:
-              mark_request_complete ( mdi, id, x, y );
-              continue;
-
-            case REDOWNLOAD_BAD:
-            {
-              /* see if this one is bad or what */
-              GError *gx = NULL;
-              GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file ( mdi->filename_buf, &gx );
-              if (gx || (!pixbuf)) {
-                if ( g_remove ( mdi->filename_buf ) )
-                  g_warning ( "REDOWNLOAD failed to remove: %s", mdi->filename_buf );
-                need_download = TRUE;
-                remove_mem_cache = TRUE;
-                g_error_free ( gx );
-
-              } else {
-                g_object_unref ( pixbuf );
-              }
-              break;
-            }
-
-            case REDOWNLOAD_NEW:
-              need_download = TRUE;
-              remove_mem_cache = TRUE;
-              break;
-
-            case REDOWNLOAD_ALL:
-              need_download = TRUE;
-              remove_mem_cache = TRUE;
-              break;
-
-            case DOWNLOAD_OR_REFRESH:
-              remove_mem_cache = TRUE;
-              break;
+  g_array_sort ( candidates, prefetch_tile_compare );
+
+  // Forget about prefetched tiles that never got drawn
+  if ( g_hash_table_size(pf->pending) > (guint)PREFETCH_BUDGET * 16 )
+    g_hash_table_remove_all ( pf->pending );
+
+  // Missing tiles can be downloaded too, but only once the view itself has been scheduled
+  TileScheduler *ts = NULL;
+  if ( vml->autodownload && maps_layer_is_cached_storage(map) && vml->scheduler &&
+       !vik_window_get_pan_move ( VIK_WINDOW(VIK_GTK_WINDOW_FROM_WIDGET(GTK_WIDGET(vvp))) ) ) {
+    ts = vml->scheduler;
+    g_mutex_lock ( ts->mutex );
+    if ( ts->z != view->z || ts->scale != view->scale ) {
+      g_mutex_unlock ( ts->mutex );
+      ts = NULL;
+    }
+  }
 
-            default:
-              g_warning ( "redownload state %d unknown", mdi->redownload);
-          }
-        }
+  DecodeInfo *di = decode_job_get ( vml, &pf->job, map, vp_scale, xshrinkfactor, yshrinkfactor, FALSE );
+  decode_job_set_view ( di, view, xmin, xmax, ymin, ymax );
+  const guint16 id = vik_map_source_get_uniq_id ( map );
+  const gchar *mapname = vik_map_source_get_name ( map );
+  guint max_path_len = strlen(vml->cache_dir) + 40;
+  gchar *path_buf = g_malloc ( max_path_len * sizeof(char) );
+  gint queued = 0;
+  gboolean downloads = FALSE;
+
+  g_mutex_lock ( di->mutex );
+  for ( guint nn = 0; nn < candidates->len && queued < budget; nn++ ) {
+    MapCoord *mc = &g_array_index ( candidates, PrefetchTile, nn ).mc;
+    if ( mercator ) {
+      gint max = 1 << (17 - mc->scale);
+      if ( mc->x < 0 || mc->y < 0 || mc->x >= max || mc->y >= max )
+        continue;
+    }
+    // Already available, or already known to be unavailable
+    mapcache_extra_t extra = a_mapcache_get_extra ( mc->x, mc->y, mc->z, id, mc->scale, vml->alpha, xshrinkfactor, yshrinkfactor, vml->filename );
+    if ( extra.status != MAPCACHE_STATUS_NOT_IN_CACHE )
+      continue;
+    queued++;
+
+    gchar *key = prefetch_tile_key ( mc );
+    if ( g_hash_table_contains ( pf->pending, key ) ) {
+      // Once read but nothing was found, try downloading it
+      if ( ts && mc->scale == view->scale && !decode_request_pending ( di, id, mc ) )
+        downloads |= tile_scheduler_add ( ts, map, mc, REDOWNLOAD_NONE, SCHED_PRIORITY_PREFETCH, NULL, 0 );
+      g_free ( key );
+      continue;
+    }
+    g_hash_table_add ( pf->pending, key );
+    pf->prefetched++;
+    decode_info_add_tile ( di, vml, id, mapname, mc, path_buf, max_path_len );
+  }
+  g_mutex_unlock ( di->mutex );
 
-        mdi->mapcoord.x = x; mdi->mapcoord.y = y;
+  decode_job_start ( di, vml, TRUE );
 
-        DownloadResult_t dr = DOWNLOAD_NOT_REQUIRED;
-        if (need_download) {
-          dr = vik_map_source_download ( map, &(mdi->mapcoord), mdi->filename_buf, handle );
-          switch ( dr ) {
-            case DOWNLOAD_PARAMETERS_ERROR:
-            case DOWNLOAD_HTTP_ERROR:
-            case DOWNLOAD_CONTENT_ERROR: {
-              // TODO: ?? count up the number of download errors somehow...
-              gchar* msg = g_strdup_printf ( "%s: %s", vik_maps_layer_get_map_label (mdi->vml), _("Failed to download tile") );
-              vik_window_statusbar_update ( (VikWindow*)VIK_GTK_WINDOW_FROM_LAYER(mdi->vml), msg, VIK_STATUSBAR_INFO );
-              g_free (msg);
-              break;
-            }
-            case DOWNLOAD_FILE_WRITE_ERROR: {
-              gchar* msg = g_strdup_printf ( "%s: %s", vik_maps_layer_get_map_label (mdi->vml), _("Unable to save tile") );
-              vik_window_statusbar_update ( (VikWindow*)VIK_GTK_WINDOW_FROM_LAYER(mdi->vml), msg, VIK_STATUSBAR_INFO );
-              g_free (msg);
-              break;
-            }
-            case DOWNLOAD_SUCCESS: break;
-            case DOWNLOAD_NOT_REQUIRED:
-	      need_download = FALSE;
-	      break;
-            case DOWNLOAD_USER_ABORTED:
-              break;
-            default:
-              break;
-          }
-        }
+  if ( ts ) {
+    g_mutex_unlock ( ts->mutex );
+    if ( downloads )
+      tile_scheduler_start ( ts, vml );
+  }
 
-        mark_request_complete ( mdi, id, x, y );
+  g_free ( path_buf );
+  g_array_free ( candidates, TRUE );
+}
 
-        // Avoid attempting to update mapcache when download aborted
-        //  1. Since no real change to track
-        //  2. more importantly, if the program is ending then the mapcache may have been removed
-        if ( dr != DOWNLOAD_USER_ABORTED ) {
+/**
+ * Record when a prefetched tile gets drawn
+ */
+static void maps_layer_prefetch_used ( VikMapsLayer *vml, MapCoord *mc )
+{
+  if ( g_hash_table_size(vml->prefetch.pending) == 0 )
+    return;
+  gchar *key = prefetch_tile_key ( mc );
+  if ( g_hash_table_remove ( vml->prefetch.pending, key ) )
+    vml->prefetch.used++;
+  g_free ( key );
+}
 
-          g_mutex_lock(mdi->mutex);
-          if (remove_mem_cache)
-            a_mapcache_remove_all_shrinkfactors ( x, y, mdi->mapcoord.z, id, mdi->mapcoord.scale, mdi->vml->filename );
+/**
+ * Run the seeding jobs via the layer's scheduler
+ */
+static void maps_layer_seed_start ( VikMapsLayer *vml, GList *jobs )
+{
+  if ( !jobs )
+    return;
+  maps_layer_cache_quota_register ( vml, MAPS_LAYER_NTH_TYPE(vml->maptype) );
+  TileScheduler *ts = maps_layer_get_scheduler ( vml );
+  g_mutex_lock ( ts->mutex );
+  ts->seeds = g_list_concat ( ts->seeds, jobs );
+  g_mutex_unlock ( ts->mutex );
+  tile_scheduler_start ( ts, vml );
+}
 
-          // Save download result - must be after remove_all_shrinkfactors() otherwise that would remove this result!
-          a_mapcache_add ( NULL, (mapcache_extra_t){0.0, dr}, mdi->mapcoord.x, mdi->mapcoord.y, mdi->mapcoord.z, id,
-                           mdi->mapcoord.scale, mdi->vml->alpha, 1.0, 1.0, mdi->vml->filename );
+/**
+ * Download the areas (given as pairs of upper left and bottom right coordinates) at each of the zoom levels,
+ *  as a seeding job that can be resumed if interrupted
+ */
+static void maps_layer_seed ( VikMapsLayer *vml, const VikCoord *corners, guint n_areas, const gdouble *zooms, guint n_zooms, gint download_method )
+{
+  VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
 
-          if (mdi->refresh_display && mdi->map_layer_alive) {
-            /* TODO: check if it's on visible area */
-            if ( need_download ) {
-              vik_layer_emit_update ( VIK_LAYER(mdi->vml), FALSE ); // NB update display from background
-            }
-          }
+  // Don't ever attempt download on direct access
+  if ( vik_map_source_is_direct_file_access ( map ) )
+    return;
 
-          g_mutex_unlock(mdi->mutex);
-          mdi->mapcoord.x = mdi->mapcoord.y = 0; /* we're temporarily between downloads */
-        }
+  MapSeedJob *job = a_map_seed_job_new ( vik_map_source_get_uniq_id(map), vml->cache_dir, vml->cache_layout, download_method );
+  for ( guint zz = 0; zz < n_zooms; zz++ ) {
+    for ( guint aa = 0; aa < n_areas; aa++ ) {
+      MapCoord ulm, brm;
+      if ( !vik_map_source_coord_to_mapcoord ( map, &corners[2*aa], zooms[zz], zooms[zz], &ulm ) ||
+           !vik_map_source_coord_to_mapcoord ( map, &corners[2*aa+1], zooms[zz], zooms[zz], &brm ) ) {
+        g_warning ( "%s() coord_to_mapcoord() failed", __PRETTY_FUNCTION__ );
+        continue;
       }
+      a_map_seed_job_add_area ( job, ulm.scale, ulm.z, ulm.x, ulm.y, brm.x, brm.y );
     }
   }
-  vik_map_source_download_handle_cleanup ( map, handle );
 
-  unref_weak_ref_cb ( mdi );
-
-  return 0;
+  if ( a_map_seed_job_get_remaining ( job ) == 0 ) {
+    a_map_seed_job_unref ( job );
+    return;
+  }
+  a_map_seed_job_save ( job );
+  maps_layer_seed_start ( vml, g_list_append ( NULL, job ) );
 }
 
-static void mdi_cancel_cleanup ( MapDownloadInfo *mdi )
+/**
+ * Continue any unfinished seeding jobs for this map
+ */
+static void maps_layer_seed_resume ( VikMapsLayer *vml )
 {
-  if ( mdi->mapcoord.x || mdi->mapcoord.y )
-  {
-    get_filename ( mdi->cache_dir, mdi->cache_layout,
-                   vik_map_source_get_uniq_id(MAPS_LAYER_NTH_TYPE(mdi->maptype)),
-                   vik_map_source_get_name(MAPS_LAYER_NTH_TYPE(mdi->maptype)),
-                   mdi->mapcoord.scale, mdi->mapcoord.z, mdi->mapcoord.x, mdi->mapcoord.y, mdi->filename_buf, mdi->maxlen,
-                   vik_map_source_get_file_extension(MAPS_LAYER_NTH_TYPE(mdi->maptype)) );
-    if ( g_file_test ( mdi->filename_buf, G_FILE_TEST_EXISTS ) == TRUE)
-    {
-      if ( g_remove ( mdi->filename_buf ) )
-        g_warning ( "Cleanup failed to remove: %s", mdi->filename_buf );
-    }
-  }
-
-  requests_clear ( mdi->maptype );
-
-  unref_weak_ref_cb ( mdi );
+  VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
+  if ( vik_map_source_is_direct_file_access ( map ) )
+    return;
+  maps_layer_seed_start ( vml, a_map_seed_jobs_claim ( vik_map_source_get_uniq_id(map), vml->cache_dir, vml->cache_layout ) );
 }
 
 static void start_download_thread ( VikMapsLayer *vml, VikViewport *vvp, const VikCoord *ul, const VikCoord *br, gint redownload )
@@ -2169,10 +4306,13 @@ static void start_download_thread ( VikMapsLayer *vml, VikViewport *vvp, const V
     MapDownloadInfo *mdi = g_malloc ( sizeof(MapDownloadInfo) );
     gint a, b;
 
+    maps_layer_cache_quota_register ( vml, map );
+
     mdi->vml = vml;
     mdi->vvp = vvp;
     mdi->map_layer_alive = TRUE;
     mdi->mutex = vik_mutex_new();
+    mdi->in_flight = NULL;
     mdi->refresh_display = TRUE;
 
     /* cache_dir and buffer for dest filename */
@@ -2202,7 +4342,7 @@ static void start_download_thread ( VikMapsLayer *vml, VikViewport *vvp, const V
         mcoord.y = b;
         // Only count tiles from supported areas
         if ( is_in_area (map, mcoord) ) {
-          gchar *request = create_request_string ( mdi, id, a, b );
+          gchar *request = create_request_string ( id, &mcoord );
           // Only count it if not an outstanding request
           if ( !g_hash_table_lookup_extended(requests, request, NULL, NULL ) ) {
             if ( mdi->redownload )
@@ -2213,11 +4353,7 @@ static void start_download_thread ( VikMapsLayer *vml, VikViewport *vvp, const V
               mdi->mapstoget++;
             else {
               // Otherwise only if file is missing
-              get_filename ( mdi->cache_dir, mdi->cache_layout, id,
-                             vik_map_source_get_name(map),
-                             ulm.scale, ulm.z, a, b, mdi->filename_buf, mdi->maxlen,
-                             vik_map_source_get_file_extension(map) );
-              if ( g_file_test ( mdi->filename_buf, G_FILE_TEST_EXISTS ) == FALSE ) {
+              if ( !cache_tile_exists ( mdi->cache_dir, mdi->cache_layout, map, &mcoord, mdi->filename_buf, mdi->maxlen ) ) {
                 mdi->mapstoget++;
               }
             }
@@ -2264,92 +4400,6 @@ static void start_download_thread ( VikMapsLayer *vml, VikViewport *vvp, const V
   }
 }
 
-static void maps_layer_download_section ( VikMapsLayer *vml, VikViewport *vvp, VikCoord *ul, VikCoord *br, gdouble zoom, gint download_method )
-{
-  MapCoord ulm, brm;
-  VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
-
-  // Don't ever attempt download on direct access
-  if ( vik_map_source_is_direct_file_access ( map ) )
-    return;
-
-  if (!vik_map_source_coord_to_mapcoord(map, ul, zoom, zoom, &ulm)
-    || !vik_map_source_coord_to_mapcoord(map, br, zoom, zoom, &brm)) {
-    g_warning("%s() coord_to_mapcoord() failed", __PRETTY_FUNCTION__);
-    return;
-  }
-
-  MapDownloadInfo *mdi = g_malloc(sizeof(MapDownloadInfo));
-  gint i, j;
-
-  mdi->vml = vml;
-  mdi->vvp = vvp;
-  mdi->map_layer_alive = TRUE;
-  mdi->mutex = vik_mutex_new();
-  mdi->refresh_display = TRUE;
-
-  mdi->cache_dir = g_strdup ( vml->cache_dir );
-  mdi->maxlen = strlen ( vml->cache_dir ) + 40;
-  mdi->filename_buf = g_malloc ( mdi->maxlen * sizeof(gchar) );
-  mdi->maptype = vml->maptype;
-  mdi->cache_layout = vml->cache_layout;
-
-  mdi->mapcoord = ulm;
-  mdi->redownload = download_method;
-
-  mdi->x0 = MIN(ulm.x, brm.x);
-  mdi->xf = MAX(ulm.x, brm.x);
-  mdi->y0 = MIN(ulm.y, brm.y);
-  mdi->yf = MAX(ulm.y, brm.y);
-
-  mdi->mapstoget = 0;
-
-  MapCoord mcoord = mdi->mapcoord;
-
-  for (i = mdi->x0; i <= mdi->xf; i++) {
-    mcoord.x = i;
-    for (j = mdi->y0; j <= mdi->yf; j++) {
-      mcoord.y = j;
-      // Only count tiles from supported areas
-      if ( is_in_area (map, mcoord) ) {
-        get_filename ( mdi->cache_dir, mdi->cache_layout,
-                       vik_map_source_get_uniq_id(map),
-                       vik_map_source_get_name(map),
-                       ulm.scale, ulm.z, i, j, mdi->filename_buf, mdi->maxlen,
-                       vik_map_source_get_file_extension(map) );
-        if ( g_file_test ( mdi->filename_buf, G_FILE_TEST_EXISTS ) == FALSE )
-              mdi->mapstoget++;
-      }
-    }
-  }
-
-  mdi->mapcoord.x = mdi->mapcoord.y = 0; /* for cleanup -- no current map */
-
-  if (mdi->mapstoget) {
-    gchar *tmp;
-    const gchar *fmt;
-    fmt = ngettext("Downloading %d %s map...",
-                   "Downloading %d %s maps...",
-		   mdi->mapstoget);
-    tmp = g_strdup_printf ( fmt, mdi->mapstoget, MAPS_LAYER_NTH_LABEL(vml->maptype) );
-
-    g_object_weak_ref(G_OBJECT(mdi->vml), weak_ref_cb, mdi);
-
-    // launch the thread
-    a_background_thread ( BACKGROUND_POOL_REMOTE,
-                          VIK_GTK_WINDOW_FROM_LAYER(vml), /* parent window */
-                          tmp,                                /* description string */
-                          (vik_thr_func) map_download_thread, /* function to call within thread */
-                          mdi,                                /* pass along data */
-                          (vik_thr_free_func) mdi_free,       /* function to free pass along data */
-                          (vik_thr_free_func) mdi_cancel_cleanup,
-                          mdi->mapstoget );
-    g_free ( tmp );
-  }
-  else
-    mdi_free ( mdi );
-}
-
 /**
  * vik_maps_layer_download_section:
  * @vml:  The Map Layer
@@ -2362,7 +4412,22 @@ static void maps_layer_download_section ( VikMapsLayer *vml, VikViewport *vvp, V
  */
 void vik_maps_layer_download_section ( VikMapsLayer *vml, VikViewport *vvp, VikCoord *ul, VikCoord *br, gdouble zoom )
 {
-  maps_layer_download_section (vml, vvp, ul, br, zoom, REDOWNLOAD_NONE);
+  VikCoord corners[2] = { *ul, *br };
+  maps_layer_seed ( vml, corners, 1, &zoom, 1, REDOWNLOAD_NONE );
+}
+
+/**
+ * vik_maps_layer_download_sections:
+ * @vml:     The Map Layer
+ * @corners: The upper left and bottom right coordinates of each area to be downloaded
+ * @n_areas: The number of areas
+ * @zoom:    The zoom level at which the maps are to be download
+ *
+ * Download several map areas at a certain zoom level, as a single job
+ */
+void vik_maps_layer_download_sections ( VikMapsLayer *vml, const VikCoord *corners, guint n_areas, gdouble zoom )
+{
+  maps_layer_seed ( vml, corners, n_areas, &zoom, 1, REDOWNLOAD_NONE );
 }
 
 static void maps_layer_redownload_bad ( VikMapsLayer *vml )
@@ -2404,6 +4469,9 @@ static void maps_layer_delete_tiles ( VikMapsLayer *vml )
 
   guint max_path_len = strlen(vml->cache_dir) + 40;
   gchar *filename = g_malloc ( max_path_len * sizeof(char) );
+  gchar *dbname = NULL;
+  if ( vml->cache_layout == VIK_MAPS_CACHE_LAYOUT_MBTILES )
+    dbname = get_mbtiles_cache_name ( vml->cache_dir, vik_map_source_get_name(map) );
 
   MapCoord mcoord = ulm;
 
@@ -2414,6 +4482,9 @@ static void maps_layer_delete_tiles ( VikMapsLayer *vml )
 
       if ( is_in_area (map, mcoord) ) {
 
+        if ( dbname )
+          a_mbtiles_cache_remove ( dbname, xx, yy, (17 - ulm.scale) );
+
         get_filename ( vml->cache_dir,
                        vml->cache_layout,
                        vik_map_source_get_uniq_id(map),
@@ -2424,6 +4495,8 @@ static void maps_layer_delete_tiles ( VikMapsLayer *vml )
         if ( g_file_test(filename, G_FILE_TEST_EXISTS) ) {
           if ( g_remove(filename) )
             g_warning ( "%s failed to remove: %s", __FUNCTION__, filename );
+          a_tile_index_remove ( filename );
+          a_cache_quota_remove ( filename );
         }
 
         // Attempt to remove etag as well if there is one
@@ -2435,9 +4508,11 @@ static void maps_layer_delete_tiles ( VikMapsLayer *vml )
         a_mapcache_remove_all_shrinkfactors ( xx, yy, ulm.z,
                                               vik_map_source_get_uniq_id(map),
                                               ulm.scale, vml->filename );
+        overview_cache_tile_changed ( vik_map_source_get_uniq_id(map), vml->filename, &mcoord );
       }
     }
   }
+  g_free ( dbname );
   g_free ( filename );
 
   vik_layer_emit_update ( VIK_LAYER(vml), FALSE );
@@ -2459,6 +4534,7 @@ static void maps_layer_tile_info ( VikMapsLayer *vml )
 
   gchar *filename = NULL;
   gchar *source = NULL;
+  gboolean mbtiles_cache = FALSE;
 
   if ( vik_map_source_is_direct_file_access ( map ) ) {
     if ( vik_map_source_is_mbtiles ( map ) ) {
@@ -2467,11 +4543,9 @@ static void maps_layer_tile_info ( VikMapsLayer *vml )
       // And whether to bother going into the SQL to check it's really there or not...
       gchar *exists = NULL;
       gint zoom = 17 - ulm.scale;
-      if ( vml->mbtiles ) {
-        GdkPixbuf *pixbuf = get_pixbuf_sql_exec ( vml->mbtiles, ulm.x, ulm.y, zoom );
-        if ( pixbuf ) {
+      if ( vml->mbtiles_pool ) {
+        if ( a_mbtiles_pool_exists ( vml->mbtiles_pool, ulm.x, ulm.y, zoom, NULL ) ) {
           exists = g_strdup ( _("YES") );
-          g_object_unref ( G_OBJECT(pixbuf) );
         }
         else {
           exists = g_strdup ( _("NO") );
@@ -2504,6 +4578,13 @@ static void maps_layer_tile_info ( VikMapsLayer *vml )
       source = g_strconcat ( _("Source: file://"), filename, NULL );
     }
   }
+  else if ( vml->cache_layout == VIK_MAPS_CACHE_LAYOUT_MBTILES ) {
+    filename = get_mbtiles_cache_name ( vml->cache_dir, vik_map_source_get_name(map) );
+    gchar *url = vik_map_source_default_get_url_display ( VIK_MAP_SOURCE_DEFAULT(map), &ulm );
+    source = g_markup_printf_escaped ( _("Source: %s"), url );
+    g_free ( url );
+    mbtiles_cache = TRUE;
+  }
   else {
     guint max_path_len = strlen(vml->cache_dir) + 40;
     filename = g_malloc ( max_path_len * sizeof(char) );
@@ -2523,7 +4604,23 @@ static void maps_layer_tile_info ( VikMapsLayer *vml )
   gchar *filemsg = NULL;
   gchar *timemsg = NULL;
 
-  if ( g_file_test ( filename, G_FILE_TEST_EXISTS ) ) {
+  if ( mbtiles_cache ) {
+    time_t mtime = 0;
+    gint zoom = 17 - ulm.scale;
+    if ( a_mbtiles_cache_exists ( filename, ulm.x, ulm.y, zoom, &mtime ) ) {
+      filemsg = g_strdup_printf ( "Tile: %s (%d%s%d%s%d)", filename, zoom, G_DIR_SEPARATOR_S, ulm.x, G_DIR_SEPARATOR_S, ulm.y );
+      gchar time_buf[64];
+      strftime ( time_buf, sizeof(time_buf), "%c", gmtime(&mtime) );
+      timemsg = g_strdup_printf ( _("Tile File Timestamp: %s"), time_buf );
+      g_array_append_val ( array, filemsg );
+      g_array_append_val ( array, timemsg );
+    }
+    else {
+      filemsg = g_strdup_printf ( _("Tile File: %s [Not Available]"), filename );
+      g_array_append_val ( array, filemsg );
+    }
+  }
+  else if ( g_file_test ( filename, G_FILE_TEST_EXISTS ) ) {
     filemsg = g_strconcat ( "Tile File: ", filename, NULL );
     // Get some timestamp information of the tile
     GStatBuf stat_buf;
@@ -2543,9 +4640,31 @@ static void maps_layer_tile_info ( VikMapsLayer *vml )
     g_array_append_val ( array, filemsg );
   }
 
+  gchar *usagemsg = NULL;
+  guint64 used, quota;
+  guint files;
+  // Only known when there is a limit
+  if ( maps_layer_is_cached_storage(map) && a_cache_quota_get_usage ( vml->cache_dir, &used, &quota, &files ) ) {
+    gchar *used_str = g_format_size ( used );
+    gchar *quota_str = g_format_size ( quota );
+    usagemsg = g_strdup_printf ( _("Cache Usage: %s of %s (%d tiles)"), used_str, quota_str, files );
+    g_free ( quota_str );
+    g_free ( used_str );
+    g_array_append_val ( array, usagemsg );
+  }
+
+  gchar *prefetchmsg = NULL;
+  if ( vml->prefetch.prefetched ) {
+    prefetchmsg = g_strdup_printf ( _("Prefetched: %d tiles, of which %d were used (%.0f%%)"), vml->prefetch.prefetched, vml->prefetch.used,
+                                    100.0 * vml->prefetch.used / vml->prefetch.prefetched );
+    g_array_append_val ( array, prefetchmsg );
+  }
+
   a_dialog_list (  VIK_GTK_WINDOW_FROM_LAYER(vml), _("Tile Information"), array, 5 );
   g_array_free ( array, TRUE );
 
+  g_free ( prefetchmsg );
+  g_free ( usagemsg );
   g_free ( timemsg );
   g_free ( filemsg );
   g_free ( source );
@@ -2708,7 +4827,9 @@ static void maps_layer_about_debug ( menu_array_values values )
   VikViewport *vvp = VIK_VIEWPORT(values[MA_VVP]);
   gdouble xzoom = vml->xmapzoom ? vml->xmapzoom : vik_viewport_get_xmpp ( vvp );
 
-  gchar *msg = g_strdup_printf ( "%s id=%d OSMzoom=%d", label, id, map_utils_mpp_to_zoom_level(xzoom) );
+  gchar *msg = g_strdup_printf ( "%s id=%d OSMzoom=%d prefetched=%d used=%d pending=%d velocity=%.1f,%.1f", label, id, map_utils_mpp_to_zoom_level(xzoom),
+                                 vml->prefetch.prefetched, vml->prefetch.used, g_hash_table_size(vml->prefetch.pending),
+                                 vml->prefetch.vx, vml->prefetch.vy );
   a_dialog_info_msg ( VIK_GTK_WINDOW_FROM_LAYER(vml), msg );
   g_free ( msg );
 }
@@ -2727,7 +4848,7 @@ static void maps_layer_mbtiles_open_cb ( menu_array_values values )
 
 /**
  * maps_layer_how_many_maps:
- * Copied from maps_layer_download_section but without the actual download and this returns a value
+ * Count the tiles a download of the area would request, without the actual download
  */
 static gint maps_layer_how_many_maps ( VikMapsLayer *vml, VikViewport *vvp, VikCoord *ul, VikCoord *br, gdouble zoom, gint redownload )
 {
@@ -2750,6 +4871,7 @@ static gint maps_layer_how_many_maps ( VikMapsLayer *vml, VikViewport *vvp, VikC
   mdi->vvp = vvp;
   mdi->map_layer_alive = TRUE;
   mdi->mutex = vik_mutex_new();
+  mdi->in_flight = NULL;
   mdi->refresh_display = FALSE;
 
   mdi->cache_dir = g_strdup ( vml->cache_dir );
@@ -2780,23 +4902,19 @@ static gint maps_layer_how_many_maps ( VikMapsLayer *vml, VikViewport *vvp, VikC
         mcoord.y = j;
         // Only count tiles from supported areas
         if ( is_in_area ( map, mcoord ) ) {
-          get_filename ( mdi->cache_dir, mdi->cache_layout,
-                         vik_map_source_get_uniq_id(map),
-                         vik_map_source_get_name(map),
-                         ulm.scale, ulm.z, i, j, mdi->filename_buf, mdi->maxlen,
-                         vik_map_source_get_file_extension(map) );
           if ( mdi->redownload == REDOWNLOAD_NEW ) {
             // Assume the worst - always a new file
             // Absolute value would require a server lookup - but that is too slow
             mdi->mapstoget++;
           }
           else {
-            if ( g_file_test ( mdi->filename_buf, G_FILE_TEST_EXISTS ) == FALSE ) {
+            if ( !cache_tile_exists ( mdi->cache_dir, mdi->cache_layout, map, &mcoord, mdi->filename_buf, mdi->maxlen ) ) {
               // Missing
               mdi->mapstoget++;
             }
             else {
-              if ( mdi->redownload == REDOWNLOAD_BAD ) {
+              // NB Tiles in an MBTiles cache are not checked
+              if ( mdi->redownload == REDOWNLOAD_BAD && mdi->cache_layout != VIK_MAPS_CACHE_LAYOUT_MBTILES ) {
                 /* see if this one is bad or what */
                 GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file ( mdi->filename_buf, NULL );
                 if ( !pixbuf ) {
@@ -2987,10 +5105,26 @@ static void maps_layer_download_all ( menu_array_values values )
       return;
   }
 
-  // Get Maps - call for each zoom level (in reverse)
-  for ( zz = selected_zoom2; zz >= selected_zoom1; zz-- ) {
-    maps_layer_download_section ( vml, vvp, &vc_ul, &vc_br, zoom_vals[zz], selected_download_method );
-  }
+  // Get Maps - for each zoom level (in reverse)
+  gdouble zooms[G_N_ELEMENTS(zoom_vals)];
+  guint n_zooms = 0;
+  for ( zz = selected_zoom2; zz >= selected_zoom1; zz-- )
+    zooms[n_zooms++] = zoom_vals[zz];
+  VikCoord corners[2] = { vc_ul, vc_br };
+  maps_layer_seed ( vml, corners, 1, zooms, n_zooms, selected_download_method );
+}
+
+static void maps_layer_seed_resume_cb ( menu_array_values values )
+{
+  maps_layer_seed_resume ( VIK_MAPS_LAYER(values[MA_VML]) );
+}
+
+static void maps_layer_seed_discard_cb ( menu_array_values values )
+{
+  VikMapsLayer *vml = VIK_MAPS_LAYER(values[MA_VML]);
+  VikMapSource *map = MAPS_LAYER_NTH_TYPE(vml->maptype);
+  if ( a_dialog_yes_or_no ( VIK_GTK_WINDOW_FROM_LAYER(vml), _("Discard the unfinished downloads of these maps?"), NULL ) )
+    a_map_seed_jobs_discard ( vik_map_source_get_uniq_id(map), vml->cache_dir, vml->cache_layout );
 }
 
 /**
@@ -3010,6 +5144,7 @@ static void maps_layer_flush ( menu_array_values values )
 {
   VikMapsLayer *vml = VIK_MAPS_LAYER(values[MA_VML]);
   a_mapcache_flush_type ( vik_map_source_get_uniq_id(MAPS_LAYER_NTH_TYPE(vml->maptype)) );
+  overview_cache_flush ( vik_map_source_get_uniq_id(MAPS_LAYER_NTH_TYPE(vml->maptype)) );
 }
 
 static void maps_layer_add_menu_items ( VikMapsLayer *vml, GtkMenu *menu, VikLayersPanel *vlp, VikStdLayerMenuItem selection )
@@ -3029,6 +5164,11 @@ static void maps_layer_add_menu_items ( VikMapsLayer *vml, GtkMenu *menu, VikLay
     (void)vu_menu_add_item ( menu, _("Download _New Onscreen Maps"), GTK_STOCK_REDO, G_CALLBACK(maps_layer_download_new_onscreen_maps), values );
     (void)vu_menu_add_item ( menu, _("Reload _All Onscreen Maps"), GTK_STOCK_REFRESH, G_CALLBACK(maps_layer_redownload_all_onscreen_maps), values );
     (void)vu_menu_add_item ( menu, _("Download Maps in _Zoom Levels..."), GTK_STOCK_DND_MULTIPLE, G_CALLBACK(maps_layer_download_all), values );
+    // Seeding jobs that were cancelled (or otherwise not resumed)
+    if ( a_map_seed_jobs_count ( vik_map_source_get_uniq_id(map), vml->cache_dir, vml->cache_layout ) ) {
+      (void)vu_menu_add_item ( menu, _("_Resume Unfinished Downloads"), GTK_STOCK_MEDIA_PLAY, G_CALLBACK(maps_layer_seed_resume_cb), values );
+      (void)vu_menu_add_item ( menu, _("_Discard Unfinished Downloads"), GTK_STOCK_DELETE, G_CALLBACK(maps_layer_seed_discard_cb), values );
+    }
     (void)vu_menu_add_item ( menu, _("_Toggle Display of Cache Status"), GTK_STOCK_INFO, G_CALLBACK(maps_layer_cache_status_cb), values );
   }
 
@@ -50,6 +50,7 @@ typedef struct _VikMapsLayer VikMapsLayer;
 typedef enum {
   VIK_MAPS_CACHE_LAYOUT_VIKING=0, // CacheDir/t<MapId>s<VikingZoom>z0/X/Y (NB no file extension) - Legacy default layout
   VIK_MAPS_CACHE_LAYOUT_OSM,      // CacheDir/<OptionalMapName>/OSMZoomLevel/X/Y.ext (Default ext=png)
+  VIK_MAPS_CACHE_LAYOUT_MBTILES,  // CacheDir/<OptionalMapName>.mbtiles - a single SQLite database (with OSM Zoom Levels)
   VIK_MAPS_CACHE_LAYOUT_NUM       // Last enum
 } VikMapsCacheLayout;
 
@@ -65,6 +66,7 @@ void maps_layer_set_cache_default ( VikMapsCacheLayout layout );
 guint vik_maps_layer_get_default_map_type ();
 void maps_layer_register_map_source ( VikMapSource *map );
 void vik_maps_layer_download_section ( VikMapsLayer *vml, VikViewport *vvp, VikCoord *ul, VikCoord *br, gdouble zoom );
+void vik_maps_layer_download_sections ( VikMapsLayer *vml, const VikCoord *corners, guint n_areas, gdouble zoom );
 guint vik_maps_layer_get_map_type(VikMapsLayer *vml);
 void vik_maps_layer_set_map_type(VikMapsLayer *vml, guint map_type);
 gchar *vik_maps_layer_get_map_label(VikMapsLayer *vml);
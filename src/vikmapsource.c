@@ -87,6 +87,10 @@ vik_map_source_class_init (VikMapSourceClass *klass)
 	klass->download = NULL;
 	klass->download_handle_init = NULL;
 	klass->download_handle_cleanup = NULL;
+	klass->download_multi_add = NULL;
+	klass->download_bytes = NULL;
+	klass->download_multi_add_bytes = NULL;
+	klass->get_concurrent_downloads = NULL;
 
 	object_class->finalize = vik_map_source_finalize;
 }
@@ -528,3 +532,111 @@ vik_map_source_download_handle_cleanup (VikMapSource * self, void * handle)
 
 	(*klass->download_handle_cleanup)(self, handle);
 }
+
+/**
+ * vik_map_source_download_multi_add:
+ * @self:    The VikMapSource of interest.
+ * @src:     The map location to download
+ * @dest_fn: The filename to save the result in
+ * @multi:   The handle from a_download_multi_new()
+ * @func:    Called with the result when the download has finished
+ *
+ * Start a download which runs concurrently with others on the same @multi handle.
+ *
+ * Returns: FALSE if concurrent downloads are not supported by this map source
+ *  (and so vik_map_source_download() should be used instead)
+ */
+gboolean
+vik_map_source_download_multi_add (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * multi, DownloadDoneFunc func, gpointer user_data)
+{
+	VikMapSourceClass *klass;
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (VIK_IS_MAP_SOURCE (self), FALSE);
+	klass = VIK_MAP_SOURCE_GET_CLASS(self);
+
+	if (klass->download_multi_add == NULL)
+		return FALSE;
+
+	return (*klass->download_multi_add)(self, src, dest_fn, multi, func, user_data);
+}
+
+/**
+ * vik_map_source_download_bytes:
+ * @self:    The VikMapSource of interest.
+ * @src:     The map location to download
+ * @dest_fn: The filename to save the result in
+ * @handle:  Potential reusable Curl Handle (may be NULL)
+ * @func:    Called with the result and the downloaded data, before this function returns
+ *
+ * As vik_map_source_download(), but the downloaded data is given to @func straight from memory
+ *  and only saved in @dest_fn (in the background) when @func returns TRUE.
+ * The data is NULL when it is only available from @dest_fn,
+ *  e.g. when this map source can only download into files.
+ *
+ * Returns: How successful the download was as per the type #DownloadResult_t
+ */
+DownloadResult_t
+vik_map_source_download_bytes (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * handle, DownloadBytesFunc func, gpointer user_data)
+{
+	VikMapSourceClass *klass;
+	g_return_val_if_fail (self != NULL, DOWNLOAD_PARAMETERS_ERROR);
+	g_return_val_if_fail (VIK_IS_MAP_SOURCE (self), DOWNLOAD_PARAMETERS_ERROR);
+	klass = VIK_MAP_SOURCE_GET_CLASS(self);
+
+	if (klass->download_bytes == NULL) {
+		DownloadResult_t result = vik_map_source_download (self, src, dest_fn, handle);
+		(void)func (result, NULL, user_data);
+		return result;
+	}
+
+	return (*klass->download_bytes)(self, src, dest_fn, handle, func, user_data);
+}
+
+/**
+ * vik_map_source_download_multi_add_bytes:
+ * @self:    The VikMapSource of interest.
+ * @src:     The map location to download
+ * @dest_fn: The filename to save the result in
+ * @multi:   The handle from a_download_multi_new()
+ * @func:    Called with the result and the downloaded data when the download has finished
+ *
+ * Start a download as per vik_map_source_download_bytes(),
+ *  which runs concurrently with others on the same @multi handle.
+ *
+ * Returns: FALSE if concurrent downloads are not supported by this map source
+ *  (and so vik_map_source_download_bytes() should be used instead)
+ */
+gboolean
+vik_map_source_download_multi_add_bytes (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * multi, DownloadBytesFunc func, gpointer user_data)
+{
+	VikMapSourceClass *klass;
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (VIK_IS_MAP_SOURCE (self), FALSE);
+	klass = VIK_MAP_SOURCE_GET_CLASS(self);
+
+	if (klass->download_multi_add_bytes == NULL)
+		return FALSE;
+
+	return (*klass->download_multi_add_bytes)(self, src, dest_fn, multi, func, user_data);
+}
+
+/**
+ * vik_map_source_get_concurrent_downloads:
+ * @self:    The VikMapSource of interest.
+ *
+ * Returns: The number of downloads that should be in progress at once for this map source,
+ *  0 means no specific value so use the general default.
+ */
+guint
+vik_map_source_get_concurrent_downloads (VikMapSource * self)
+{
+	VikMapSourceClass *klass;
+	g_return_val_if_fail (self != NULL, 0);
+	g_return_val_if_fail (VIK_IS_MAP_SOURCE (self), 0);
+	klass = VIK_MAP_SOURCE_GET_CLASS(self);
+
+	if (klass->get_concurrent_downloads == NULL)
+		return 0;
+
+	return (*klass->get_concurrent_downloads)(self);
+}
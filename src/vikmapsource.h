@@ -75,6 +75,10 @@ struct _VikMapSourceClass
 	int (* download) (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * handle);
 	void * (* download_handle_init) (VikMapSource * self);
 	void (* download_handle_cleanup) (VikMapSource * self, void * handle);
+	gboolean (* download_multi_add) (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * multi, DownloadDoneFunc func, gpointer user_data);
+	DownloadResult_t (* download_bytes) (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * handle, DownloadBytesFunc func, gpointer user_data);
+	gboolean (* download_multi_add_bytes) (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * multi, DownloadBytesFunc func, gpointer user_data);
+	guint (* get_concurrent_downloads) (VikMapSource * self);
 };
 
 struct _VikMapSource
@@ -114,6 +118,10 @@ void vik_map_source_mapcoord_to_center_coord (VikMapSource * self, MapCoord *src
 DownloadResult_t vik_map_source_download (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * handle);
 void * vik_map_source_download_handle_init (VikMapSource * self);
 void vik_map_source_download_handle_cleanup (VikMapSource * self, void * handle);
+gboolean vik_map_source_download_multi_add (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * multi, DownloadDoneFunc func, gpointer user_data);
+DownloadResult_t vik_map_source_download_bytes (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * handle, DownloadBytesFunc func, gpointer user_data);
+gboolean vik_map_source_download_multi_add_bytes (VikMapSource * self, MapCoord * src, const gchar * dest_fn, void * multi, DownloadBytesFunc func, gpointer user_data);
+guint vik_map_source_get_concurrent_downloads (VikMapSource * self);
 
 G_END_DECLS
 
@@ -50,6 +50,10 @@ static gdouble map_source_get_offset_y (VikMapSource *self);
 static DownloadResult_t _download ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *handle );
 static void * _download_handle_init ( VikMapSource *self );
 static void _download_handle_cleanup ( VikMapSource *self, void *handle );
+static gboolean _download_multi_add ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *multi, DownloadDoneFunc func, gpointer user_data );
+static DownloadResult_t _download_bytes ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *handle, DownloadBytesFunc func, gpointer user_data );
+static gboolean _download_multi_add_bytes ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *multi, DownloadBytesFunc func, gpointer user_data );
+static guint map_source_get_concurrent_downloads (VikMapSource *self);
 
 typedef struct _VikMapSourceDefaultPrivate VikMapSourceDefaultPrivate;
 struct _VikMapSourceDefaultPrivate
@@ -70,6 +74,7 @@ struct _VikMapSourceDefaultPrivate
 	gchar *file_extension;
 	gdouble offset_x;
 	gdouble offset_y;
+	guint concurrent_downloads;
 };
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (VikMapSourceDefault, vik_map_source_default, VIK_TYPE_MAP_SOURCE);
@@ -93,6 +98,7 @@ enum
   PROP_FILE_EXTENSION,
   PROP_OFFSET_X,
   PROP_OFFSET_Y,
+  PROP_CONCURRENT_DOWNLOADS,
 };
 
 static void
@@ -204,6 +210,10 @@ vik_map_source_default_set_property (GObject      *object,
       priv->offset_y = g_value_get_double (value);
       break;
 
+    case PROP_CONCURRENT_DOWNLOADS:
+      priv->concurrent_downloads = g_value_get_uint (value);
+      break;
+
     default:
       /* We don't have any other property... */
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -273,6 +283,10 @@ vik_map_source_default_get_property (GObject    *object,
       g_value_set_double (value, priv->offset_y);
       break;
 
+    case PROP_CONCURRENT_DOWNLOADS:
+      g_value_set_uint (value, priv->concurrent_downloads);
+      break;
+
     default:
       /* We don't have any other property... */
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -308,6 +322,10 @@ vik_map_source_default_class_init (VikMapSourceDefaultClass *klass)
 	parent_class->download =                 _download;
 	parent_class->download_handle_init =     _download_handle_init;
 	parent_class->download_handle_cleanup =  _download_handle_cleanup;
+	parent_class->download_multi_add =       _download_multi_add;
+	parent_class->download_bytes =           _download_bytes;
+	parent_class->download_multi_add_bytes = _download_multi_add_bytes;
+	parent_class->get_concurrent_downloads = map_source_get_concurrent_downloads;
 
 	/* Default implementation of methods */
 	klass->get_uri = NULL;
@@ -419,6 +437,15 @@ vik_map_source_default_class_init (VikMapSourceDefaultClass *klass)
 	                             G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_OFFSET_Y, pspec);
 
+	pspec = g_param_spec_uint ("concurrent-downloads",
+	                           "Concurrent downloads",
+	                           "The number of tile downloads in progress at once (0 for the default)",
+	                           0  /* minimum value */,
+	                           64 /* maximum value */,
+	                           0  /* default value */,
+	                           G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_CONCURRENT_DOWNLOADS, pspec);
+
 	object_class->finalize = vik_map_source_default_finalize;
 }
 
@@ -551,6 +578,53 @@ _download ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *handl
    return res;
 }
 
+static gboolean
+_download_multi_add ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *multi, DownloadDoneFunc func, gpointer user_data )
+{
+   gchar *uri = vik_map_source_default_get_uri(VIK_MAP_SOURCE_DEFAULT(self), src);
+   gchar *host = vik_map_source_default_get_hostname(VIK_MAP_SOURCE_DEFAULT(self));
+   // NB The options are freed by the download once complete
+   DownloadFileOptions *options = vik_map_source_default_get_download_options(VIK_MAP_SOURCE_DEFAULT(self), src);
+   a_http_download_multi_add ( multi, host, uri, dest_fn, options, func, user_data );
+   g_free ( uri );
+   g_free ( host );
+   return TRUE;
+}
+
+static DownloadResult_t
+_download_bytes ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *handle, DownloadBytesFunc func, gpointer user_data )
+{
+   gchar *uri = vik_map_source_default_get_uri(VIK_MAP_SOURCE_DEFAULT(self), src);
+   gchar *host = vik_map_source_default_get_hostname(VIK_MAP_SOURCE_DEFAULT(self));
+   DownloadFileOptions *options = vik_map_source_default_get_download_options(VIK_MAP_SOURCE_DEFAULT(self), src);
+   DownloadResult_t res = a_http_download_get_url_bytes ( host, uri, dest_fn, options, handle, func, user_data );
+   a_download_file_options_free ( options );
+   g_free ( uri );
+   g_free ( host );
+   return res;
+}
+
+static gboolean
+_download_multi_add_bytes ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *multi, DownloadBytesFunc func, gpointer user_data )
+{
+   gchar *uri = vik_map_source_default_get_uri(VIK_MAP_SOURCE_DEFAULT(self), src);
+   gchar *host = vik_map_source_default_get_hostname(VIK_MAP_SOURCE_DEFAULT(self));
+   // NB The options are freed by the download once complete
+   DownloadFileOptions *options = vik_map_source_default_get_download_options(VIK_MAP_SOURCE_DEFAULT(self), src);
+   a_http_download_multi_add_bytes ( multi, host, uri, dest_fn, options, func, user_data );
+   g_free ( uri );
+   g_free ( host );
+   return TRUE;
+}
+
+static guint
+map_source_get_concurrent_downloads (VikMapSource *self)
+{
+	g_return_val_if_fail (VIK_IS_MAP_SOURCE_DEFAULT(self), 0);
+	VikMapSourceDefaultPrivate *priv = VIK_MAP_SOURCE_DEFAULT_PRIVATE(self);
+	return priv->concurrent_downloads;
+}
+
 static const gchar *
 map_source_get_file_extension (VikMapSource *self)
 {
@@ -32,6 +32,7 @@
 #include "vikstatus.h"
 #include "background.h"
 #include "logging.h"
+#include "drawstats.h"
 #include "maputils.h"
 
 enum
@@ -137,6 +138,11 @@ vik_statusbar_init (VikStatusbar *vs)
 
   gtk_box_pack_start ( GTK_BOX(vs), vs->status[VIK_STATUSBAR_POSITION], FALSE, FALSE, 1);
 
+  // Only shown when the draw statistics are being collected
+  gtk_widget_set_tooltip_text (GTK_WIDGET (vs->status[VIK_STATUSBAR_DRAW]), _("Time taken to draw the last frame, the map tiles and trackpoints drawn."));
+  gtk_widget_set_no_show_all ( vs->status[VIK_STATUSBAR_DRAW], !a_drawstats_enabled() );
+  gtk_box_pack_start ( GTK_BOX(vs), vs->status[VIK_STATUSBAR_DRAW], FALSE, FALSE, 1);
+
   g_signal_connect ( G_OBJECT(vs->status[VIK_STATUSBAR_LOG]), "clicked", G_CALLBACK (forward_signal), vs );
   gtk_widget_set_tooltip_text (GTK_WIDGET (vs->status[VIK_STATUSBAR_LOG]), _("Current number of log messages. Click to see them."));
   gtk_box_pack_start ( GTK_BOX(vs), vs->status[VIK_STATUSBAR_LOG], FALSE, FALSE, 1 );
@@ -173,6 +179,7 @@ vik_statusbar_new (guint scale)
   gtk_widget_set_size_request ( vs->status[VIK_STATUSBAR_ZOOM], 100*scale, -1 );
   gtk_widget_set_size_request ( vs->status[VIK_STATUSBAR_POSITION], 275*scale, -1 );
   gtk_widget_set_size_request ( vs->status[VIK_STATUSBAR_LOG], 40*scale, -1 );
+  gtk_widget_set_size_request ( vs->status[VIK_STATUSBAR_DRAW], 200*scale, -1 );
   // Set minimum overall size
   //  otherwise the individual size_requests above create an implicit overall size,
   //  and so one can't downsize horizontally as much as may be desired when the statusbar is on
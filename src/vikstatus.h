@@ -57,6 +57,7 @@ typedef enum {
   VIK_STATUSBAR_INFO,
   VIK_STATUSBAR_POSITION,
   VIK_STATUSBAR_LOG,
+  VIK_STATUSBAR_DRAW,
   VIK_STATUSBAR_NUM_TYPES
 } vik_statusbar_type_t;
 
@@ -196,6 +196,7 @@ void vik_track_free(VikTrack *tr)
     g_free ( tr->extensions );
   g_list_foreach ( tr->trackpoints, (GFunc) vik_trackpoint_free, NULL );
   g_list_free( tr->trackpoints );
+  vik_track_lod_invalidate ( tr );
   if (tr->property_dialog)
     if ( GTK_IS_WIDGET(tr->property_dialog) )
       gtk_widget_destroy ( GTK_WIDGET(tr->property_dialog) );
@@ -347,6 +348,7 @@ void vik_track_add_trackpoint ( VikTrack *tr, VikTrackpoint *tp, gboolean recalc
   // When it's the first trackpoint need to ensure the bounding box is initialized correctly
   gboolean adding_first_point = tr->trackpoints ? FALSE : TRUE;
   tr->trackpoints = g_list_append ( tr->trackpoints, tp );
+  vik_track_lod_invalidate ( tr );
   if ( adding_first_point )
     vik_track_calculate_bounds ( tr );
   else if ( recalculate )
@@ -589,6 +591,7 @@ gboolean vik_track_remove_dodgy_first_point ( VikTrack *tr, guint speed, gboolea
             deleted = TRUE;
             vik_trackpoint_free ( tp1 );
             tr->trackpoints = g_list_delete_link ( tr->trackpoints, iter );
+            vik_track_lod_invalidate ( tr );
             if ( recalc_bounds )
               vik_track_calculate_bounds ( tr );
 	  }
@@ -724,6 +727,7 @@ void vik_track_reverse ( VikTrack *tr )
     return;
 
   tr->trackpoints = g_list_reverse(tr->trackpoints);
+  vik_track_lod_invalidate ( tr );
 
   /* fix 'newsegment' */
   GList *iter = g_list_last ( tr->trackpoints );
@@ -2197,6 +2201,9 @@ void vik_track_calculate_bounds ( VikTrack *tr )
 
   g_debug ( "Bounds of track: '%s' is: %f,%f to: %f,%f", tr->name, topleft.lat, topleft.lon, bottomright.lat, bottomright.lon );
 
+  // As the trackpoints have changed
+  vik_track_lod_invalidate ( tr );
+
   tr->bbox.north = topleft.lat;
   tr->bbox.east = bottomright.lon;
   tr->bbox.south = bottomright.lat;
@@ -2479,6 +2486,7 @@ VikCoord *vik_track_cut_back_to_double_point ( VikTrack *tr )
   while ( iter->next )
     iter = iter->next;
 
+  vik_track_lod_invalidate ( tr );
 
   while ( iter->prev ) {
     VikCoord *cur_coord = &((VikTrackpoint*)iter->data)->coord;
@@ -2683,3 +2691,206 @@ GArray *vik_track_speed_splits (const VikTrack *tr, gdouble split_length )
   vik_trackpoint_free ( vtp );
   return ga;
 }
+
+/*
+ * Level of detail
+ *
+ * For drawing a track at a zoom level where many trackpoints fall on the same pixel,
+ *  a simplified version of the track (as per the Douglas-Peucker algorithm) is used.
+ * Rather than simplifying for each tolerance, the tolerance at which each trackpoint would be removed is worked out once.
+ * The trackpoints for a tolerance are then those above it, which are kept for tolerances of each power of 2.
+ */
+
+#define LOD_MIN_POINTS 256 // Not worth simplifying smaller tracks
+#define LOD_LEVELS 64      // Tolerances of 2^-32 to 2^31
+
+typedef struct {
+  VikTrackLODSpace space;
+  GList *first;           // To detect changes not notified via vik_track_lod_invalidate()
+  guint count;
+  VikTrackpoint **tps;    // All the trackpoints
+  gdouble *significance;  // The tolerance below which each trackpoint is needed
+  VikTrackpoint **levels[LOD_LEVELS];
+  guint level_counts[LOD_LEVELS];
+} VikTrackLOD;
+
+/**
+ * vik_track_lod_invalidate:
+ *
+ * Forget any simplified versions of the track.
+ * This should be called whenever a track's trackpoints are changed
+ *  (vik_track_calculate_bounds() does so)
+ */
+void vik_track_lod_invalidate ( VikTrack *tr )
+{
+  VikTrackLOD *lod = tr->lod;
+  if ( !lod )
+    return;
+  for ( guint ii = 0; ii < LOD_LEVELS; ii++ )
+    g_free ( lod->levels[ii] );
+  g_free ( lod->tps );
+  g_free ( lod->significance );
+  g_free ( lod );
+  tr->lod = NULL;
+}
+
+/**
+ * Position in the planar space.
+ * Returns FALSE if the track can't be represented in the space
+ */
+static gboolean lod_project ( VikTrackLODSpace space, const VikCoord *coord, gchar zone, gdouble *x, gdouble *y )
+{
+  if ( space == VIK_TRACK_LOD_UTM ) {
+    if ( coord->mode != VIK_COORD_UTM || coord->utm_zone != zone )
+      return FALSE;
+    *x = coord->east_west;
+    *y = coord->north_south;
+    return TRUE;
+  }
+  struct LatLon ll;
+  vik_coord_to_latlon ( coord, &ll );
+  *x = ll.lon;
+  *y = ( space == VIK_TRACK_LOD_MERCATOR ) ? MERCLAT(ll.lat) : ll.lat;
+  return TRUE;
+}
+
+/**
+ * Distance of point p from the segment a-b
+ */
+static gdouble lod_segment_distance ( gdouble px, gdouble py, gdouble ax, gdouble ay, gdouble bx, gdouble by )
+{
+  gdouble dx = bx - ax;
+  gdouble dy = by - ay;
+  gdouble len2 = dx*dx + dy*dy;
+  gdouble t = 0.0;
+  if ( len2 > 0.0 )
+    t = CLAMP ( ((px-ax)*dx + (py-ay)*dy) / len2, 0.0, 1.0 );
+  gdouble ex = ax + t*dx - px;
+  gdouble ey = ay + t*dy - py;
+  return sqrt ( ex*ex + ey*ey );
+}
+
+static VikTrackLOD *lod_build ( VikTrack *tr, VikTrackLODSpace space )
+{
+  guint count = g_list_length ( tr->trackpoints );
+  VikTrackLOD *lod = g_malloc0 ( sizeof(VikTrackLOD) );
+  lod->space = space;
+  lod->first = tr->trackpoints;
+  lod->count = count;
+  lod->tps = g_new ( VikTrackpoint*, count );
+  lod->significance = g_new ( gdouble, count );
+
+  gdouble *xs = g_new ( gdouble, count );
+  gdouble *ys = g_new ( gdouble, count );
+  gchar zone = VIK_TRACKPOINT(tr->trackpoints->data)->coord.utm_zone;
+  guint ii = 0;
+  for ( GList *iter = tr->trackpoints; iter; iter = iter->next, ii++ ) {
+    lod->tps[ii] = VIK_TRACKPOINT(iter->data);
+    if ( !lod_project ( space, &(lod->tps[ii]->coord), zone, &xs[ii], &ys[ii] ) ) {
+      // Can't simplify, so everything is always needed
+      for ( guint jj = 0; jj < count; jj++ )
+        lod->significance[jj] = G_MAXDOUBLE;
+      g_free ( xs );
+      g_free ( ys );
+      return lod;
+    }
+    lod->significance[ii] = 0.0;
+  }
+
+  // Douglas-Peucker on each segment in turn, with the ends of segments always kept
+  //  A point's significance is capped by that of the point that split its range,
+  //  so a point is only kept at a tolerance when the points it depends on are too
+  GArray *stack = g_array_new ( FALSE, FALSE, sizeof(guint) * 2 );
+  guint start = 0;
+  for ( ii = 1; ii <= count; ii++ ) {
+    if ( ii < count && !lod->tps[ii]->newsegment )
+      continue;
+    guint end = ii - 1;
+    lod->significance[start] = G_MAXDOUBLE;
+    lod->significance[end] = G_MAXDOUBLE;
+    guint range[2] = { start, end };
+    g_array_append_val ( stack, range );
+    while ( stack->len ) {
+      guint *top = &g_array_index ( stack, guint, (stack->len - 1) * 2 );
+      guint aa = top[0], bb = top[1];
+      g_array_set_size ( stack, stack->len - 1 );
+      if ( bb <= aa + 1 )
+        continue;
+      gdouble limit = MIN ( lod->significance[aa], lod->significance[bb] );
+      gdouble dmax = -1.0;
+      guint imax = aa + 1;
+      for ( guint jj = aa + 1; jj < bb; jj++ ) {
+        gdouble dd = lod_segment_distance ( xs[jj], ys[jj], xs[aa], ys[aa], xs[bb], ys[bb] );
+        if ( dd > dmax ) {
+          dmax = dd;
+          imax = jj;
+        }
+      }
+      lod->significance[imax] = MIN ( dmax, limit );
+      guint left[2] = { aa, imax };
+      guint right[2] = { imax, bb };
+      g_array_append_val ( stack, left );
+      g_array_append_val ( stack, right );
+    }
+    start = ii;
+  }
+  g_array_free ( stack, TRUE );
+  g_free ( xs );
+  g_free ( ys );
+  return lod;
+}
+
+/**
+ * vik_track_get_lod:
+ * @space:     The space in which @tolerance is measured
+ * @tolerance: The maximum distance any trackpoint left out may be from the simplified track
+ * @n:         Returns the number of trackpoints
+ *
+ * Get the trackpoints of a simplified version of the track.
+ * The points at which segments start and end are always included.
+ * The simplification used is for the largest power of 2 not more than @tolerance.
+ *
+ * Returns: An array owned by the track, valid until the trackpoints are changed,
+ *          or NULL when the full list of trackpoints should be used
+ */
+VikTrackpoint **vik_track_get_lod ( VikTrack *tr, VikTrackLODSpace space, gdouble tolerance, guint *n )
+{
+  if ( !tr->trackpoints || !(tolerance > 0.0) )
+    return NULL;
+
+  VikTrackLOD *lod = tr->lod;
+  if ( lod && (lod->space != space || lod->first != tr->trackpoints) )
+    vik_track_lod_invalidate ( tr );
+  if ( !tr->lod ) {
+    guint count = g_list_length ( tr->trackpoints );
+    if ( count < LOD_MIN_POINTS )
+      return NULL;
+    tr->lod = lod_build ( tr, space );
+  }
+  lod = tr->lod;
+
+  gint level = CLAMP ( (gint)floor ( log2 ( tolerance ) ), -LOD_LEVELS/2, LOD_LEVELS/2 - 1 );
+  guint idx = level + LOD_LEVELS/2;
+  if ( lod->level_counts[idx] == G_MAXUINT )
+    return NULL;
+  if ( !lod->levels[idx] ) {
+    gdouble level_tolerance = ldexp ( 1.0, level );
+    guint kept = 0;
+    for ( guint ii = 0; ii < lod->count; ii++ )
+      if ( lod->significance[ii] > level_tolerance )
+        kept++;
+    // Barely any simpler, so not worth it
+    if ( kept > lod->count - lod->count/8 ) {
+      lod->level_counts[idx] = G_MAXUINT;
+      return NULL;
+    }
+    lod->levels[idx] = g_new ( VikTrackpoint*, kept );
+    kept = 0;
+    for ( guint ii = 0; ii < lod->count; ii++ )
+      if ( lod->significance[ii] > level_tolerance )
+        lod->levels[idx][kept++] = lod->tps[ii];
+    lod->level_counts[idx] = kept;
+  }
+  *n = lod->level_counts[idx];
+  return lod->levels[idx];
+}
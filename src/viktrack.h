@@ -97,6 +97,7 @@ struct _VikTrack {
   gboolean has_color;
   GdkColor color;
   LatLonBBox bbox;
+  gpointer lod; // Simplified versions of the trackpoints for drawing, see vik_track_get_lod()
 };
 
 typedef struct {
@@ -225,6 +226,16 @@ void vik_track_clear_property_dialog(VikTrack *tr);
 // Array of VikTrackSpeedSplits_t
 GArray *vik_track_speed_splits (const VikTrack *tr, gdouble split_length );
 
+// The planar space in which a simplified track is to be within a tolerance of the original
+typedef enum {
+  VIK_TRACK_LOD_UTM = 0, // Easting & Northing in metres
+  VIK_TRACK_LOD_LATLON,  // Longitude & Latitude in degrees
+  VIK_TRACK_LOD_MERCATOR // Longitude & Mercator latitude in degrees
+} VikTrackLODSpace;
+
+VikTrackpoint **vik_track_get_lod ( VikTrack *tr, VikTrackLODSpace space, gdouble tolerance, guint *n );
+void vik_track_lod_invalidate ( VikTrack *tr );
+
 G_END_DECLS
 
 #endif
@@ -42,6 +42,7 @@
 #include "garminsymbols.h"
 #include "thumbnails.h"
 #include "background.h"
+#include "drawstats.h"
 #include "fit.h"
 #include "gpx.h"
 #include "geojson.h"
@@ -74,6 +75,9 @@
 #define VIK_TRW_LAYER_TRACK_GC_FAST 3
 #define VIK_TRW_LAYER_TRACK_GC_STOP 4
 #define VIK_TRW_LAYER_TRACK_GC_SINGLE 5
+// Tracks are drawn in batches for each of the GCs above, plus one for the track's own colour
+#define TRACK_PATH_MAIN VIK_TRW_LAYER_TRACK_GC
+#define TRACK_PATHS (VIK_TRW_LAYER_TRACK_GC+1)
 
 #define COLOR_STOP "#874200"
 #define COLOR_SLOW "#E6202E" // red-ish
@@ -261,12 +265,15 @@ struct _VikTrwLayer {
 #if GTK_CHECK_VERSION (3,0,0)
   cairo_t *cr; // Reference into vvp - thus do not free this here
 #endif
+
+  // Window state obtained in the main thread for the next draw (which may be in another thread)
+  gboolean draw_prepared;
+  gboolean draw_selected;
 };
 
 struct DrawingParams {
   VikViewport *vp;
   VikTrwLayer *vtl;
-  VikWindow *vw;
   gdouble xmpp, ympp;
   guint16 width, height;
   gdouble cc; // Cosine factor in track directions
@@ -276,6 +283,15 @@ struct DrawingParams {
   gdouble ce1, ce2, cn1, cn2;
   LatLonBBox bbox;
   gboolean highlight;
+  VikViewportTransform vt;
+  GPtrArray *wps; // Waypoints to be drawn
+  VikViewportPath *lines[TRACK_PATHS];  // Track lines of each colour
+  VikViewportPath *points[TRACK_PATHS]; // Trackpoints of each colour
+  VikViewportPath *elevation[2];        // Light and dark elevation shading
+  VikViewportPath *elevation_top[2];    // and the lines along their tops
+  // For GTK3 own copies of the layer's label layouts, as a layout can only be used by one thread at a time
+  PangoLayout *wplabellayout;
+  PangoLayout *tracklabellayout;
 };
 
 static gboolean trw_layer_delete_waypoint ( VikTrwLayer *vtl, VikWaypoint *wp );
@@ -306,7 +322,7 @@ static void trw_layer_edit_track_gcs ( VikTrwLayer *vtl, VikViewport *vp );
 static void trw_layer_free_track_gcs ( VikTrwLayer *vtl );
 
 static void trw_layer_draw_track_cb ( const gpointer id, VikTrack *track, struct DrawingParams *dp );
-static void trw_layer_draw_waypoint ( const gpointer id, VikWaypoint *wp, struct DrawingParams *dp );
+static void trw_layer_draw_waypoint ( VikWaypoint *wp, struct DrawingParams *dp, gint x, gint y );
 
 static void trw_layer_select_trackpoint ( VikTrwLayer *vtl, VikTrack *trk, VikTrackpoint *tpt, gboolean draw_graph_blob );
 static void goto_coord ( gpointer *vlp, gpointer vvp, gpointer vl, const VikCoord *coord );
@@ -843,6 +859,7 @@ static void trw_layer_realize ( VikTrwLayer *vtl, VikTreeview *vt, GtkTreeIter *
 static void trw_layer_post_read ( VikTrwLayer *vtl, VikViewport *vvp, gboolean from_file );
 static void trw_layer_free ( VikTrwLayer *trwlayer );
 static void trw_layer_draw ( VikTrwLayer *l, VikViewport *vvp );
+static gboolean trw_layer_draw_threadsafe ( VikTrwLayer *l );
 static void trw_layer_configure ( VikTrwLayer *l, VikViewport *vvp );
 static void trw_layer_change_coord_mode ( VikTrwLayer *vtl, VikCoordMode dest_mode );
 static gdouble trw_layer_get_timestamp ( VikTrwLayer *vtl );
@@ -945,6 +962,10 @@ VikLayerInterface vik_trw_layer_interface = {
   (VikLayerFuncSelectedViewportMenu)    trw_layer_show_selected_viewport_menu,
 
   (VikLayerFuncRefresh)                 vik_trw_layer_propwin_main_refresh,
+
+  (VikLayerDrawCache)                   VIK_LAYER_DRAW_CACHE_NONE,
+
+  (VikLayerFuncDrawThreadsafe)          trw_layer_draw_threadsafe,
 };
 
 static gboolean have_geojson_export = FALSE;
@@ -2062,12 +2083,78 @@ static void trw_layer_free ( VikTrwLayer *trwlayer )
   g_free ( trwlayer->initial_file );
 }
 
+static void drawing_params_free ( struct DrawingParams *dp )
+{
+  if ( dp->wps ) {
+    g_ptr_array_free ( dp->wps, TRUE );
+    for ( guint ii = 0; ii < TRACK_PATHS; ii++ ) {
+      vik_viewport_path_free ( dp->lines[ii] );
+      vik_viewport_path_free ( dp->points[ii] );
+    }
+    vik_viewport_path_free ( dp->elevation[0] );
+    vik_viewport_path_free ( dp->elevation[1] );
+    vik_viewport_path_free ( dp->elevation_top[0] );
+    vik_viewport_path_free ( dp->elevation_top[1] );
+  }
+#if GTK_CHECK_VERSION (3,0,0)
+  if ( dp->wplabellayout )
+    g_object_unref ( dp->wplabellayout );
+  if ( dp->tracklabellayout )
+    g_object_unref ( dp->tracklabellayout );
+#endif
+  g_free ( dp );
+}
+
+static GPrivate drawing_params_key = G_PRIVATE_INIT ( (GDestroyNotify)drawing_params_free );
+
+/**
+ * The drawing params are kept between draws so their working space is reused,
+ *  with a set for each thread as layers may be drawn in parallel
+ */
+static struct DrawingParams *drawing_params_get ()
+{
+  struct DrawingParams *dp = g_private_get ( &drawing_params_key );
+  if ( !dp ) {
+    dp = g_new0 ( struct DrawingParams, 1 );
+    g_private_set ( &drawing_params_key, dp );
+  }
+  return dp;
+}
+
+#if GTK_CHECK_VERSION (3,0,0)
+/**
+ * A label layout for this thread, set up in the same way as @model
+ *  (one of the layer's layouts from the viewport widget, which are left alone whilst drawing)
+ */
+static PangoLayout *label_layout_new ( PangoLayout *model )
+{
+  // Pango gives each thread its own default font map
+  PangoContext *context = pango_font_map_create_context ( pango_cairo_font_map_get_default() );
+  PangoContext *model_context = pango_layout_get_context ( model );
+  pango_cairo_context_set_resolution ( context, pango_cairo_context_get_resolution ( model_context ) );
+  pango_cairo_context_set_font_options ( context, pango_cairo_context_get_font_options ( model_context ) );
+  PangoLayout *layout = pango_layout_new ( context );
+  g_object_unref ( context );
+  return layout;
+}
+#endif
+
 static void init_drawing_params ( struct DrawingParams *dp, VikTrwLayer *vtl, VikViewport *vp, gboolean highlight )
 {
   dp->vtl = vtl;
   dp->vp = vp;
   dp->highlight = highlight;
-  dp->vw = (VikWindow *)VIK_GTK_WINDOW_FROM_LAYER(dp->vtl);
+#if GTK_CHECK_VERSION (3,0,0)
+  if ( !dp->wplabellayout ) {
+    dp->wplabellayout = label_layout_new ( vtl->wplabellayout );
+    dp->tracklabellayout = label_layout_new ( vtl->tracklabellayout );
+  }
+  pango_layout_set_font_description ( dp->wplabellayout, pango_layout_get_font_description ( vtl->wplabellayout ) );
+  pango_layout_set_font_description ( dp->tracklabellayout, pango_layout_get_font_description ( vtl->tracklabellayout ) );
+#else
+  dp->wplabellayout = vtl->wplabellayout;
+  dp->tracklabellayout = vtl->tracklabellayout;
+#endif
   dp->xmpp = vik_viewport_get_xmpp ( vp );
   dp->ympp = vik_viewport_get_ympp ( vp );
   dp->width = vik_viewport_get_width ( vp );
@@ -2102,6 +2189,18 @@ static void init_drawing_params ( struct DrawingParams *dp, VikTrwLayer *vtl, Vi
   }
 
   dp->bbox = vik_viewport_get_bbox ( vp );
+  vik_viewport_get_transform ( vp, &dp->vt );
+  if ( !dp->wps ) {
+    dp->wps = g_ptr_array_new ();
+    for ( guint ii = 0; ii < TRACK_PATHS; ii++ ) {
+      dp->lines[ii] = vik_viewport_path_new ();
+      dp->points[ii] = vik_viewport_path_new ();
+    }
+    dp->elevation[0] = vik_viewport_path_new ();
+    dp->elevation[1] = vik_viewport_path_new ();
+    dp->elevation_top[0] = vik_viewport_path_new ();
+    dp->elevation_top[1] = vik_viewport_path_new ();
+  }
 }
 
 /*
@@ -2130,29 +2229,28 @@ static gint track_section_colour_by_speed ( VikTrwLayer *vtl, VikTrackpoint *tp1
 
 
 #if GTK_CHECK_VERSION (3,0,0)
-static GdkColor track_section_gdkcolour_by_speed ( VikTrwLayer *vtl, VikTrackpoint *tp1, VikTrackpoint *tp2, gdouble average_speed, gdouble low_speed, gdouble high_speed )
+/*
+ * The colour of each of the track GCs
+ */
+static GdkColor *track_gc_gdkcolor ( VikTrwLayer *vtl, gint gc_index )
 {
-  if ( !isnan(tp1->timestamp) && !isnan(tp2->timestamp) ) {
-    if ( average_speed > 0 ) {
-      gdouble spd = ( vik_coord_diff ( &(tp1->coord), &(tp2->coord) ) / (tp1->timestamp - tp2->timestamp) );
-      if ( spd < low_speed )
-        return vtl->slow_color;
-      else if ( spd > high_speed )
-        return vtl->fast_color;
-      else
-        return vtl->aver_color;
-    }
+  switch ( gc_index ) {
+  case VIK_TRW_LAYER_TRACK_GC_SLOW: return &vtl->slow_color;
+  case VIK_TRW_LAYER_TRACK_GC_AVER: return &vtl->aver_color;
+  case VIK_TRW_LAYER_TRACK_GC_FAST: return &vtl->fast_color;
+  case VIK_TRW_LAYER_TRACK_GC_STOP: return &vtl->stop_color;
+  case VIK_TRW_LAYER_TRACK_GC_SINGLE: return &vtl->track_color;
+  default: return &vtl->black_color;
   }
-  return vtl->black_color;
 }
 #endif
 
-static void draw_utm_skip_insignia ( VikViewport *vvp, GdkGC *gc, gint x, gint y, GdkColor *clr, guint lt )
+static void draw_utm_skip_insignia ( VikViewport *vvp, VikViewportPath *path, gint x, gint y )
 {
-  vik_viewport_draw_line ( vvp, gc, x+5, y, x-5, y, clr, lt );
-  vik_viewport_draw_line ( vvp, gc, x, y+5, x, y-5, clr, lt );
-  vik_viewport_draw_line ( vvp, gc, x+5, y+5, x-5, y-5, clr, lt );
-  vik_viewport_draw_line ( vvp, gc, x+5, y-5, x-5, y+5, clr, lt );
+  vik_viewport_path_add_line ( vvp, path, x+5, y, x-5, y );
+  vik_viewport_path_add_line ( vvp, path, x, y+5, x, y-5 );
+  vik_viewport_path_add_line ( vvp, path, x+5, y+5, x-5, y-5 );
+  vik_viewport_path_add_line ( vvp, path, x+5, y-5, x-5, y+5 );
 }
 
 static void trw_layer_draw_track_label ( gchar *name, gchar *fgcolour, gchar *bgcolour, struct DrawingParams *dp, VikCoord *coord )
@@ -2160,19 +2258,19 @@ static void trw_layer_draw_track_label ( gchar *name, gchar *fgcolour, gchar *bg
   gchar *label_markup = g_strdup_printf ( "<span foreground=\"%s\" background=\"%s\" size=\"%s\">%s</span>", fgcolour, bgcolour, dp->vtl->track_fsize_str, name );
 
   if ( pango_parse_markup ( label_markup, -1, 0, NULL, NULL, NULL, NULL ) )
-    pango_layout_set_markup ( dp->vtl->tracklabellayout, label_markup, -1 );
+    pango_layout_set_markup ( dp->tracklabellayout, label_markup, -1 );
   else
     // Fallback if parse failure
-    pango_layout_set_text ( dp->vtl->tracklabellayout, name, -1 );
+    pango_layout_set_text ( dp->tracklabellayout, name, -1 );
 
   g_free ( label_markup );
 
   gint label_x, label_y;
   gint width, height;
-  pango_layout_get_pixel_size ( dp->vtl->tracklabellayout, &width, &height );
+  pango_layout_get_pixel_size ( dp->tracklabellayout, &width, &height );
 
   vik_viewport_coord_to_screen ( dp->vp, coord, &label_x, &label_y );
-  vik_viewport_draw_layout ( dp->vp, dp->vtl->track_bg_gc, label_x-width/2, label_y-height/2, dp->vtl->tracklabellayout, &dp->vtl->track_bg_color );
+  vik_viewport_draw_layout ( dp->vp, dp->vtl->track_bg_gc, label_x-width/2, label_y-height/2, dp->tracklabellayout, &dp->vtl->track_bg_color );
 }
 
 /**
@@ -2459,7 +2557,100 @@ static void trw_layer_draw_point_names ( struct DrawingParams *dp, VikTrack *trk
   g_free ( bgcolour );
 }
 
-static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct DrawingParams *dp, gboolean draw_track_outline )
+/**
+ * Whether the trackpoint is within the area of the view to be drawn
+ *  (from the coordinates alone, so without working out where it is on the screen)
+ */
+static gboolean trw_layer_tp_in_view ( struct DrawingParams *dp, VikTrackpoint *tp )
+{
+  /* check some stuff -- but only if we're in UTM and there's only ONE ZONE; or lat lon */
+  return (!dp->one_zone && !dp->lat_lon) ||     /* UTM & zones; do everything */
+    ( ((!dp->one_zone) || tp->coord.utm_zone == dp->center->utm_zone) &&   /* only check zones if UTM & one_zone */
+      tp->coord.east_west < dp->ce2 && tp->coord.east_west > dp->ce1 &&  /* both UTM and lat lon */
+      tp->coord.north_south > dp->cn1 && tp->coord.north_south < dp->cn2 );
+}
+
+/**
+ * The trackpoints of the simplified version of the track for the current zoom level,
+ *  such that the lines are drawn no more than half a pixel away from where the full track would be.
+ * Returns NULL when all the trackpoints should be drawn
+ */
+static VikTrackpoint **trw_layer_track_lod ( VikTrack *trk, struct DrawingParams *dp, gboolean drawpoints, guint *n )
+{
+  // Every point is wanted when they are drawn (and stops are only drawn with points)
+  if ( drawpoints )
+    return NULL;
+
+  if ( dp->vt.coord_mode == VIK_COORD_UTM )
+    return vik_track_get_lod ( trk, VIK_TRACK_LOD_UTM, 0.5 * MIN(dp->xmpp, dp->ympp), n );
+  else if ( dp->vt.drawmode == VIK_VIEWPORT_DRAWMODE_LATLON )
+    return vik_track_get_lod ( trk, VIK_TRACK_LOD_LATLON, 0.5 / MAX(dp->vt.xmfactor, dp->vt.ymfactor), n );
+  else if ( dp->vt.drawmode == VIK_VIEWPORT_DRAWMODE_MERCATOR )
+    return vik_track_get_lod ( trk, VIK_TRACK_LOD_MERCATOR, 0.5 / MAX(dp->vt.xmfactor, dp->vt.ymfactor), n );
+  // Expedia drawmode isn't a linear projection
+  return NULL;
+}
+
+/*
+ * Draw everything collected for a track, bottom-most first
+ *  (the equivalent of the order the individual parts used to be drawn as each trackpoint was reached)
+ * Each path is drawn in one go and then emptied ready for the next track
+ */
+static void trw_layer_draw_track_paths ( struct DrawingParams *dp, GdkGC *main_gc, GdkColor *main_gcolor, guint lt )
+{
+  GdkGC *gcs[TRACK_PATHS];
+  GdkColor *gcolors[TRACK_PATHS];
+  for ( guint ii = 0; ii < VIK_TRW_LAYER_TRACK_GC; ii++ ) {
+    gcs[ii] = g_array_index(dp->vtl->track_gc, GdkGC *, ii);
+#if GTK_CHECK_VERSION (3,0,0)
+    gcolors[ii] = track_gc_gdkcolor ( dp->vtl, ii );
+#else
+    gcolors[ii] = NULL;
+#endif
+  }
+  gcs[TRACK_PATH_MAIN] = main_gc;
+  gcolors[TRACK_PATH_MAIN] = main_gcolor;
+
+  // The outline is the same lines again, just wider and underneath
+  if ( dp->vtl->bg_line_thickness )
+    for ( guint ii = 0; ii < TRACK_PATHS; ii++ )
+      vik_viewport_stroke_path ( dp->vp, dp->vtl->track_bg_gc, dp->lines[ii], &dp->vtl->track_bg_color, dp->vtl->line_thickness + dp->vtl->bg_line_thickness );
+
+  // Stops first so the trackpoints are drawn on top
+  vik_viewport_fill_path ( dp->vp, gcs[VIK_TRW_LAYER_TRACK_GC_STOP], dp->points[VIK_TRW_LAYER_TRACK_GC_STOP], gcolors[VIK_TRW_LAYER_TRACK_GC_STOP] );
+  for ( guint ii = 0; ii < TRACK_PATHS; ii++ )
+    if ( ii != VIK_TRW_LAYER_TRACK_GC_STOP )
+      vik_viewport_fill_path ( dp->vp, gcs[ii], dp->points[ii], gcolors[ii] );
+
+  for ( guint ii = 0; ii < TRACK_PATHS; ii++ )
+    vik_viewport_stroke_path ( dp->vp, gcs[ii], dp->lines[ii], gcolors[ii], lt );
+
+  for ( guint ii = 0; ii < 2; ii++ ) {
+    if ( vik_viewport_path_is_empty(dp->elevation[ii]) )
+      continue;
+#if GTK_CHECK_VERSION (3,0,0)
+    GdkGC *elev_gc = main_gc;
+    GdkColor *elev_gcolor = ii ? &dp->vtl->dark_color : &dp->vtl->light_color;
+#else
+    GdkGC *elev_gc = ii ? gtk_widget_get_style(GTK_WIDGET(dp->vp))->dark_gc[0] : gtk_widget_get_style(GTK_WIDGET(dp->vp))->light_gc[3];
+    GdkColor *elev_gcolor = NULL;
+#endif
+    vik_viewport_fill_path ( dp->vp, elev_gc, dp->elevation[ii], elev_gcolor );
+    // The top line is always drawn with the track's GC
+    vik_viewport_stroke_path ( dp->vp, main_gc, dp->elevation_top[ii], elev_gcolor, lt );
+  }
+
+  for ( guint ii = 0; ii < TRACK_PATHS; ii++ ) {
+    vik_viewport_path_clear ( dp->lines[ii] );
+    vik_viewport_path_clear ( dp->points[ii] );
+  }
+  vik_viewport_path_clear ( dp->elevation[0] );
+  vik_viewport_path_clear ( dp->elevation[1] );
+  vik_viewport_path_clear ( dp->elevation_top[0] );
+  vik_viewport_path_clear ( dp->elevation_top[1] );
+}
+
+static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct DrawingParams *dp )
 {
   if ( ! track->visible )
     return;
@@ -2468,8 +2659,8 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
   GList *list = track->trackpoints;
   gboolean useoldvals = TRUE;
 
-  gboolean drawpoints;
-  gboolean drawstops;
+  gboolean drawpoints = dp->vtl->drawpoints;
+  gboolean drawstops = dp->vtl->drawstops;
   gboolean drawelevation;
   gdouble min_alt, max_alt, alt_diff = 0;
 
@@ -2482,17 +2673,6 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
       alt_diff = max_alt - min_alt;
   }
 
-  /* admittedly this is not an efficient way to do it because we go through the whole GC thing all over... */
-  if ( dp->vtl->bg_line_thickness && !draw_track_outline )
-    trw_layer_draw_track ( id, track, dp, TRUE );
-
-  if ( draw_track_outline )
-    drawpoints = drawstops = FALSE;
-  else {
-    drawpoints = dp->vtl->drawpoints;
-    drawstops = dp->vtl->drawstops;
-  }
-
   gboolean drawing_highlight = FALSE;
 
   GdkGC *main_gc = NULL;
@@ -2524,7 +2704,7 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
 	break;
       default:
         // Mostly for DRAWMODE_ALL_SAME_COLOR
-        // but includes DRAWMODE_BY_SPEED, main_gc is set later on as necessary
+        // but includes DRAWMODE_BY_SPEED, the colour is set later on as necessary
         main_gc = g_array_index(dp->vtl->track_gc, GdkGC *, VIK_TRW_LAYER_TRACK_GC_SINGLE);
         main_gcolor = dp->vtl->track_color;
         break;
@@ -2534,17 +2714,62 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
 
   if (list) {
     int x, y, oldx, oldy;
-    VikTrackpoint *tp = VIK_TRACKPOINT(list->data);
 
-    tp_size = (list == dp->vtl->current_tpl) ? tp_size_cur : tp_size_reg;
+    // Rather than drawing each part as it is reached,
+    //  the lines and points are collected by colour and then each colour is drawn in one go
+    // 'colour' is the index of the path currently being added to
+    gint colour = TRACK_PATH_MAIN;
+
+    // Use a simplified version of the track when it would look the same
+    guint ntp = 0;
+    VikTrackpoint **tps = trw_layer_track_lod ( track, dp, drawpoints, &ntp );
+    gboolean own_tps = ( tps == NULL );
+    if ( own_tps ) {
+      ntp = g_list_length ( list );
+      tps = g_new ( VikTrackpoint*, ntp );
+      guint ii = 0;
+      for ( GList *iter = list; iter; iter = iter->next )
+        tps[ii++] = VIK_TRACKPOINT(iter->data);
+    }
+
+    // Only the positions of the first couple of points (the line from the start)
+    //  and those in or next to the view are used,
+    //  which are converted in one go rather than each point as it is reached
+    gboolean *in_view = g_new ( gboolean, ntp );
+    for ( guint ii = 0; ii < ntp; ii++ )
+      in_view[ii] = trw_layer_tp_in_view ( dp, tps[ii] );
+    const VikCoord **coords = g_new ( const VikCoord*, ntp );
+    guint *wanted = g_new ( guint, ntp );
+    guint nwanted = 0;
+    for ( guint ii = 0; ii < ntp; ii++ ) {
+      if ( ii <= 1 || in_view[ii] || in_view[ii-1] || (ii+1 < ntp && in_view[ii+1]) ) {
+        wanted[nwanted] = ii;
+        coords[nwanted++] = &(tps[ii]->coord);
+      }
+    }
+    gint *xs = g_new0 ( gint, ntp );
+    gint *ys = g_new0 ( gint, ntp );
+    vik_viewport_transform_coords ( &dp->vt, coords, nwanted, xs, ys );
+    // Then spread out into place, working backwards so no converted value is overwritten before it is moved
+    for ( guint nn = nwanted; nn-- > 0; ) {
+      xs[wanted[nn]] = xs[nn];
+      ys[wanted[nn]] = ys[nn];
+    }
+    g_free ( wanted );
+    g_free ( coords );
+
+    const VikTrackpoint *current_tp = dp->vtl->current_tpl ? VIK_TRACKPOINT(dp->vtl->current_tpl->data) : NULL;
+    VikTrackpoint *tp = tps[0];
+    tp_size = (tp == current_tp) ? tp_size_cur : tp_size_reg;
 
-    vik_viewport_coord_to_screen ( dp->vp, &(tp->coord), &x, &y );
+    x = xs[0];
+    y = ys[0];
 
     // Draw the first point as something a bit different from the normal points
     // ATM it's slightly bigger and a triangle
     if ( drawpoints ) {
       GdkPoint trian[3] = { { x, y-(3*tp_size) }, { x-(2*tp_size), y+(2*tp_size) }, {x+(2*tp_size), y+(2*tp_size)} };
-      vik_viewport_draw_polygon ( dp->vp, main_gc, TRUE, trian, 3, &main_gcolor );
+      vik_viewport_path_add_polygon ( dp->points[colour], trian, 3 );
     }
 
     oldx = x;
@@ -2561,12 +2786,14 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
       high_speed = average_speed + (average_speed*(dp->vtl->track_draw_speed_factor/100.0));
     }
 
-    while ((list = g_list_next(list)))
+    guint ndrawn = 0;
+    for ( guint ii = 1; ii < ntp; ii++ )
     {
-      tp = VIK_TRACKPOINT(list->data);
-      tp_size = (list == dp->vtl->current_tpl) ? tp_size_cur : tp_size_reg;
+      tp = tps[ii];
+      tp_size = (tp == current_tp) ? tp_size_cur : tp_size_reg;
 
-      VikTrackpoint *tp2 = VIK_TRACKPOINT(list->prev->data);
+      VikTrackpoint *tp2 = tps[ii-1];
+      VikTrackpoint *tp_next = (ii+1 < ntp) ? tps[ii+1] : NULL;
       // See if in a different lat/lon 'quadrant' so don't draw massively long lines (presumably wrong way around the Earth)
       //  Mainly to prevent wrong lines drawn when a track crosses the 180 degrees East-West longitude boundary
       //  (since vik_viewport_draw_line() only copes with pixel value and has no concept of the globe)
@@ -2576,13 +2803,10 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
         useoldvals = FALSE;
         continue;
       }
-      /* check some stuff -- but only if we're in UTM and there's only ONE ZONE; or lat lon */
-      if ( (!dp->one_zone && !dp->lat_lon) ||     /* UTM & zones; do everything */
-             ( ((!dp->one_zone) || tp->coord.utm_zone == dp->center->utm_zone) &&   /* only check zones if UTM & one_zone */
-             tp->coord.east_west < dp->ce2 && tp->coord.east_west > dp->ce1 &&  /* both UTM and lat lon */
-             tp->coord.north_south > dp->cn1 && tp->coord.north_south < dp->cn2 ) )
+      if ( in_view[ii] )
       {
-        vik_viewport_coord_to_screen ( dp->vp, &(tp->coord), &x, &y );
+        x = xs[ii];
+        y = ys[ii];
 
 	/*
 	 * If points are the same in display coordinates, don't draw.
@@ -2590,46 +2814,42 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
 	if ( useoldvals && x == oldx && y == oldy )
 	{
 	  // Still need to process points to ensure 'stops' are drawn if required
-	  if ( drawstops && drawpoints && ! draw_track_outline && list->next &&
-	       (VIK_TRACKPOINT(list->next->data)->timestamp - VIK_TRACKPOINT(list->data)->timestamp > dp->vtl->stop_length) )
-	    vik_viewport_draw_arc ( dp->vp, g_array_index(dp->vtl->track_gc, GdkGC *, VIK_TRW_LAYER_TRACK_GC_STOP), TRUE, x-(3*tp_size), y-(3*tp_size), 6*tp_size, 6*tp_size, 0, 360*64, NULL );
+	  if ( drawstops && drawpoints && tp_next &&
+	       (tp_next->timestamp - tp->timestamp > dp->vtl->stop_length) )
+	    vik_viewport_path_add_circle ( dp->points[VIK_TRW_LAYER_TRACK_GC_STOP], x-(3*tp_size), y-(3*tp_size), 6*tp_size );
 
 	  goto skip;
 	}
+        ndrawn++;
 
         if ( drawpoints || dp->vtl->drawlines ) {
-          // setup main_gc for both point and line drawing
-          if ( !drawing_highlight && (dp->vtl->drawmode == DRAWMODE_BY_SPEED) ) {
-#if GTK_CHECK_VERSION (3,0,0)
-            main_gcolor = track_section_gdkcolour_by_speed ( dp->vtl, tp, tp2, average_speed, low_speed, high_speed );
-#else
-            main_gc = g_array_index(dp->vtl->track_gc, GdkGC *, track_section_colour_by_speed ( dp->vtl, tp, tp2, average_speed, low_speed, high_speed ) );
-#endif
-          }
+          // setup the colour for both point and line drawing
+          if ( !drawing_highlight && (dp->vtl->drawmode == DRAWMODE_BY_SPEED) )
+            colour = track_section_colour_by_speed ( dp->vtl, tp, tp2, average_speed, low_speed, high_speed );
         }
 
-        if ( drawpoints && ! draw_track_outline )
+        if ( drawpoints )
         {
 
-          if ( list->next ) {
+          if ( tp_next ) {
 	    /*
 	     * The concept of drawing stops is that a trackpoint
 	     * that is if the next trackpoint has a timestamp far into
 	     * the future, we draw a circle of 6x trackpoint size,
 	     * instead of a rectangle of 2x trackpoint size.
-	     * This is drawn first so the trackpoint will be drawn on top
+	     * Stops are drawn first so the trackpoint will be drawn on top
 	     */
             /* stops */
-            if ( drawstops && VIK_TRACKPOINT(list->next->data)->timestamp - VIK_TRACKPOINT(list->data)->timestamp > dp->vtl->stop_length )
+            if ( drawstops && tp_next->timestamp - tp->timestamp > dp->vtl->stop_length )
 	      /* Stop point.  Draw 6x circle. Always in redish colour */
-              vik_viewport_draw_arc ( dp->vp, g_array_index(dp->vtl->track_gc, GdkGC *, VIK_TRW_LAYER_TRACK_GC_STOP), TRUE, x-(3*tp_size), y-(3*tp_size), 6*tp_size, 6*tp_size, 0, 360*64, NULL );
+              vik_viewport_path_add_circle ( dp->points[VIK_TRW_LAYER_TRACK_GC_STOP], x-(3*tp_size), y-(3*tp_size), 6*tp_size );
 
 	    /* Regular point - draw 2x square. */
-	    vik_viewport_draw_rectangle ( dp->vp, main_gc, TRUE, x-tp_size, y-tp_size, 2*tp_size, 2*tp_size, &main_gcolor );
+	    vik_viewport_path_add_rectangle ( dp->vp, dp->points[colour], x-tp_size, y-tp_size, 2*tp_size, 2*tp_size );
           }
           else
 	    /* Final point - draw 4x circle. */
-            vik_viewport_draw_arc ( dp->vp, main_gc, TRUE, x-(2*tp_size), y-(2*tp_size), 4*tp_size, 4*tp_size, 0, 360*64, &main_gcolor );
+            vik_viewport_path_add_circle ( dp->points[colour], x-(2*tp_size), y-(2*tp_size), 4*tp_size );
         }
 
         if ((!tp->newsegment) && (dp->vtl->drawlines))
@@ -2637,51 +2857,32 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
 
           /* UTM only: zone check */
           if ( drawpoints && dp->vtl->coord_mode == VIK_COORD_UTM && tp->coord.utm_zone != dp->center->utm_zone )
-            draw_utm_skip_insignia ( dp->vp, main_gc, x, y, &main_gcolor, lt );
-
-          if (!useoldvals)
-            vik_viewport_coord_to_screen ( dp->vp, &(tp2->coord), &oldx, &oldy );
+            draw_utm_skip_insignia ( dp->vp, dp->lines[colour], x, y );
 
-          if ( draw_track_outline ) {
-            vik_viewport_draw_line ( dp->vp, dp->vtl->track_bg_gc, oldx, oldy, x, y, &dp->vtl->track_bg_color, dp->vtl->line_thickness + dp->vtl->bg_line_thickness );
+          if (!useoldvals) {
+            oldx = xs[ii-1];
+            oldy = ys[ii-1];
           }
-          else {
 
-            vik_viewport_draw_line ( dp->vp, main_gc, oldx, oldy, x, y, &main_gcolor, lt );
-
-            if ( dp->vtl->drawelevation && list->next && !isnan(VIK_TRACKPOINT(list->next->data)->altitude) ) {
-              GdkPoint tmp[4];
-              #define FIXALTITUDE(what) ((VIK_TRACKPOINT((what))->altitude-min_alt)/alt_diff*DRAW_ELEVATION_FACTOR*dp->vtl->elevation_factor/dp->xmpp)
-
-	      tmp[0].x = oldx;
-	      tmp[0].y = oldy;
-	      tmp[1].x = oldx;
-	      tmp[1].y = oldy-FIXALTITUDE(list->data);
-	      tmp[2].x = x;
-	      tmp[2].y = y-FIXALTITUDE(list->next->data);
-	      tmp[3].x = x;
-	      tmp[3].y = y;
-
-	      GdkGC *tmp_gc = main_gc;
-              GdkColor gcl = { 0,0,0,0 };
-              tmp_gc = main_gc;
-
-	      if ( ((oldx - x) > 0 && (oldy - y) > 0) || ((oldx - x) < 0 && (oldy - y) < 0))
-#if GTK_CHECK_VERSION (3,0,0)
-                gcl = dp->vtl->light_color;
-#else
-		tmp_gc = gtk_widget_get_style(GTK_WIDGET(dp->vp))->light_gc[3];
-#endif
-	      else
-#if GTK_CHECK_VERSION (3,0,0)
-                gcl = dp->vtl->dark_color;
-#else
-		tmp_gc = gtk_widget_get_style(GTK_WIDGET(dp->vp))->dark_gc[0];
-#endif
-	      vik_viewport_draw_polygon ( dp->vp, tmp_gc, TRUE, tmp, 4, &gcl );
-
-              vik_viewport_draw_line ( dp->vp, main_gc, oldx, oldy-FIXALTITUDE(list->data), x, y-FIXALTITUDE(list->next->data), &gcl, lt );
-            }
+          vik_viewport_path_add_line ( dp->vp, dp->lines[colour], oldx, oldy, x, y );
+
+          if ( dp->vtl->drawelevation && tp_next && !isnan(tp_next->altitude) ) {
+            GdkPoint tmp[4];
+            #define FIXALTITUDE(what) ((VIK_TRACKPOINT((what))->altitude-min_alt)/alt_diff*DRAW_ELEVATION_FACTOR*dp->vtl->elevation_factor/dp->xmpp)
+
+            tmp[0].x = oldx;
+            tmp[0].y = oldy;
+            tmp[1].x = oldx;
+            tmp[1].y = oldy-FIXALTITUDE(tp);
+            tmp[2].x = x;
+            tmp[2].y = y-FIXALTITUDE(tp_next);
+            tmp[3].x = x;
+            tmp[3].y = y;
+
+            // Light shading when going one way, dark the other
+            guint shade = ( ((oldx - x) > 0 && (oldy - y) > 0) || ((oldx - x) < 0 && (oldy - y) < 0) ) ? 0 : 1;
+            vik_viewport_path_add_polygon ( dp->elevation[shade], tmp, 4 );
+            vik_viewport_path_add_line ( dp->vp, dp->elevation_top[shade], oldx, oldy-FIXALTITUDE(tp), x, y-FIXALTITUDE(tp_next) );
           }
         }
 
@@ -2696,8 +2897,8 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
           if ( len > 1 ) {
             gdouble dx = (oldx - midx) / len;
             gdouble dy = (oldy - midy) / len;
-            vik_viewport_draw_line ( dp->vp, main_gc, midx, midy, midx + (dx * dp->cc + dy * dp->ss), midy + (dy * dp->cc - dx * dp->ss), &main_gcolor, lt );
-            vik_viewport_draw_line ( dp->vp, main_gc, midx, midy, midx + (dx * dp->cc - dy * dp->ss), midy + (dy * dp->cc + dx * dp->ss), &main_gcolor, lt );
+            vik_viewport_path_add_line ( dp->vp, dp->lines[colour], midx, midy, midx + (dx * dp->cc + dy * dp->ss), midy + (dy * dp->cc - dx * dp->ss) );
+            vik_viewport_path_add_line ( dp->vp, dp->lines[colour], midx, midy, midx + (dx * dp->cc - dy * dp->ss), midy + (dy * dp->cc + dx * dp->ss) );
           }
         }
 
@@ -2711,22 +2912,17 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
         {
           if ( dp->vtl->coord_mode != VIK_COORD_UTM || tp->coord.utm_zone == dp->center->utm_zone )
           {
-            vik_viewport_coord_to_screen ( dp->vp, &(tp->coord), &x, &y );
+            x = xs[ii];
+            y = ys[ii];
 
-            if ( !drawing_highlight && (dp->vtl->drawmode == DRAWMODE_BY_SPEED) ) {
-              main_gc = g_array_index(dp->vtl->track_gc, GdkGC *, track_section_colour_by_speed ( dp->vtl, tp, tp2, average_speed, low_speed, high_speed ));
-	    }
+            if ( !drawing_highlight && (dp->vtl->drawmode == DRAWMODE_BY_SPEED) )
+              colour = track_section_colour_by_speed ( dp->vtl, tp, tp2, average_speed, low_speed, high_speed );
 
 	    /*
 	     * If points are the same in display coordinates, don't draw.
 	     */
 	    if ( x != oldx || y != oldy )
-	      {
-		if ( draw_track_outline )
-		  vik_viewport_draw_line ( dp->vp, dp->vtl->track_bg_gc, oldx, oldy, x, y, &dp->vtl->track_bg_color, dp->vtl->line_thickness + dp->vtl->bg_line_thickness );
-		else
-		  vik_viewport_draw_line ( dp->vp, main_gc, oldx, oldy, x, y, &main_gcolor, lt );
-	      }
+	      vik_viewport_path_add_line ( dp->vp, dp->lines[colour], oldx, oldy, x, y );
           }
           else
           {
@@ -2735,14 +2931,24 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
 	     */
 	    if ( x != oldx || y != oldy )
 	      {
-		vik_viewport_coord_to_screen ( dp->vp, &(tp2->coord), &x, &y );
-		draw_utm_skip_insignia ( dp->vp, main_gc, x, y, &main_gcolor, lt );
+		x = xs[ii-1];
+		y = ys[ii-1];
+		draw_utm_skip_insignia ( dp->vp, dp->lines[colour], x, y );
 	      }
           }
         }
         useoldvals = FALSE;
       }
     }
+    a_drawstats_add ( DRAWSTATS_TRACKPOINTS_VISITED, ntp );
+    a_drawstats_add ( DRAWSTATS_TRACKPOINTS_DRAWN, ndrawn );
+    g_free ( xs );
+    g_free ( ys );
+    g_free ( in_view );
+    if ( own_tps )
+      g_free ( tps );
+
+    trw_layer_draw_track_paths ( dp, main_gc, &main_gcolor, lt );
 
     // Labels drawn after the trackpoints, so the labels are on top
     if ( dp->vtl->track_draw_labels ) {
@@ -2756,251 +2962,288 @@ static void trw_layer_draw_track ( const gpointer id, VikTrack *track, struct Dr
       }
     }
   }
-
-#if GTK_CHECK_VERSION (3,0,0)
-  //  if ( main_gc )
-  //    cairo_stroke ( main_gc );
-#endif
 }
 
 static void trw_layer_draw_track_cb ( const gpointer id, VikTrack *track, struct DrawingParams *dp )
 {
   if ( BBOX_INTERSECT ( track->bbox, dp->bbox ) ) {
-    trw_layer_draw_track ( id, track, dp, FALSE );
+    trw_layer_draw_track ( id, track, dp );
   }
 }
 
-static void trw_layer_draw_waypoint ( const gpointer id, VikWaypoint *wp, struct DrawingParams *dp )
+static void trw_layer_draw_waypoint ( VikWaypoint *wp, struct DrawingParams *dp, gint x, gint y )
 {
-  if ( wp->visible )
-  if ( (!dp->one_zone && !dp->lat_lon) || ( ( dp->lat_lon || wp->coord.utm_zone == dp->center->utm_zone ) &&
-             wp->coord.east_west < dp->ce2 && wp->coord.east_west > dp->ce1 &&
-             wp->coord.north_south > dp->cn1 && wp->coord.north_south < dp->cn2 ) )
-  {
-    gint x, y;
-    vik_viewport_coord_to_screen ( dp->vp, &(wp->coord), &x, &y );
+  /* if in shrunken_cache, get that. If not, get and add to shrunken_cache */
 
-    /* if in shrunken_cache, get that. If not, get and add to shrunken_cache */
+  if ( wp->image && dp->vtl->drawimages )
+  {
+    if ( dp->vtl->image_alpha == 0)
+      return;
 
-    if ( wp->image && dp->vtl->drawimages )
+    GdkPixbuf *pixbuf = g_hash_table_lookup ( dp->vtl->image_cache, wp->image );
+    if ( !pixbuf )
     {
-      if ( dp->vtl->image_alpha == 0)
-        return;
-
-      GdkPixbuf *pixbuf = g_hash_table_lookup ( dp->vtl->image_cache, wp->image );
-      if ( !pixbuf )
+      gchar *image = wp->image;
+      GdkPixbuf *regularthumb = a_thumbnails_get ( wp->image );
+      if ( ! regularthumb )
       {
-        gchar *image = wp->image;
-        GdkPixbuf *regularthumb = a_thumbnails_get ( wp->image );
-        if ( ! regularthumb )
+        regularthumb = a_thumbnails_get_default (); /* cache one 'not yet loaded' for all thumbs not loaded */
+        image = "\x12\x00"; /* this shouldn't occur naturally. */
+      }
+      if ( regularthumb )
+      {
+        if ( dp->vtl->image_size == 128 )
+          pixbuf = regularthumb;
+        else
         {
-          regularthumb = a_thumbnails_get_default (); /* cache one 'not yet loaded' for all thumbs not loaded */
-          image = "\x12\x00"; /* this shouldn't occur naturally. */
+          pixbuf = a_thumbnails_scale_pixbuf(regularthumb, dp->vtl->image_size, dp->vtl->image_size);
+          g_object_unref ( G_OBJECT(regularthumb) );
         }
-        if ( regularthumb )
-        {
-          if ( dp->vtl->image_size == 128 )
-            pixbuf = regularthumb;
-          else
-          {
-            pixbuf = a_thumbnails_scale_pixbuf(regularthumb, dp->vtl->image_size, dp->vtl->image_size);
-            g_object_unref ( G_OBJECT(regularthumb) );
-          }
 
-          // Apply alpha setting to the image before the pixbuf gets stored in the cache
-          if ( dp->vtl->image_alpha != 255 )
-            pixbuf = ui_pixbuf_set_alpha ( pixbuf, dp->vtl->image_alpha );
+        // Apply alpha setting to the image before the pixbuf gets stored in the cache
+        if ( dp->vtl->image_alpha != 255 )
+          pixbuf = ui_pixbuf_set_alpha ( pixbuf, dp->vtl->image_alpha );
 
-          /* needed so 'click picture' tool knows how big the pic is; we don't
-           * store it in the cache because they may have been freed already. */
-          wp->image_width = gdk_pixbuf_get_width ( pixbuf );
-          wp->image_height = gdk_pixbuf_get_height ( pixbuf );
+        /* needed so 'click picture' tool knows how big the pic is; we don't
+         * store it in the cache because they may have been freed already. */
+        wp->image_width = gdk_pixbuf_get_width ( pixbuf );
+        wp->image_height = gdk_pixbuf_get_height ( pixbuf );
 
-          if ( g_hash_table_size(dp->vtl->image_cache) < dp->vtl->image_cache_size )
-            g_hash_table_insert ( dp->vtl->image_cache, image, pixbuf );
-        }
-        else
-        {
-          pixbuf = a_thumbnails_get_default (); /* thumbnail not yet loaded */
-        }
+        if ( g_hash_table_size(dp->vtl->image_cache) < dp->vtl->image_cache_size )
+          g_hash_table_insert ( dp->vtl->image_cache, image, pixbuf );
       }
-      if ( pixbuf )
+      else
       {
-        gint w, h;
-        w = gdk_pixbuf_get_width ( pixbuf );
-        h = gdk_pixbuf_get_height ( pixbuf );
-
-        if ( x+(w/2) > 0 && y+(h/2) > 0 && x-(w/2) < dp->width && y-(h/2) < dp->height ) /* always draw within boundaries */
-        {
-          if ( dp->highlight ) {
-            // Highlighted - so draw a little border around the chosen one
-            // single line seems a little weak so draw 2 of them
-            GdkColor hcolor = vik_viewport_get_highlight_gdkcolor ( dp->vp );
-            vik_viewport_draw_rectangle (dp->vp, vik_viewport_get_gc_highlight (dp->vp), FALSE,
-                                         x - (w/2) - 1, y - (h/2) - 1, w + 2, h + 2, &hcolor);
-            vik_viewport_draw_rectangle (dp->vp, vik_viewport_get_gc_highlight (dp->vp), FALSE,
-                                         x - (w/2) - 2, y - (h/2) - 2, w + 4, h + 4, &hcolor);
-          }
-
-          vik_viewport_draw_pixbuf ( dp->vp, pixbuf, 0, 0, x - (w/2), y - (h/2), w, h );
-        }
-        return; /* if failed to draw picture, default to drawing regular waypoint (below) */
+        pixbuf = a_thumbnails_get_default (); /* thumbnail not yet loaded */
       }
     }
+    if ( pixbuf )
+    {
+      gint w, h;
+      w = gdk_pixbuf_get_width ( pixbuf );
+      h = gdk_pixbuf_get_height ( pixbuf );
 
-    // Proximity drawing - only in LATLON mode ATM
-    if ( dp->vtl->wp_draw_proximity && !isnan(wp->proximity) && dp->vtl->coord_mode == VIK_COORD_LATLON ) {
-      struct LatLon ll, ll2;
-      VikCoord coord;
-      gint x2, y2;
-      vik_viewport_screen_to_coord ( dp->vp, x, y, &coord );
-      vik_coord_to_latlon ( &coord, &ll );
-
-      GdkColor pcolor = dp->vtl->waypoint_color;
-      if ( dp->highlight )
-        pcolor = vik_viewport_get_highlight_gdkcolor(dp->vp);
-
-      a_coords_latlon_destination ( &ll, wp->proximity, 90.0, &ll2 );
-
-      vik_coord_load_from_latlon ( &coord, VIK_COORD_LATLON, &ll2 );
-      vik_viewport_coord_to_screen ( dp->vp, &coord, &x2, &y2 );
-      gint cr = abs(x-x2);
-      // Only try to draw if not too small or too big
-      if ( (cr > dp->vtl->wp_size*2) && (cr < dp->width/2) )
-        vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - cr, y - cr, 2*cr, 2*cr, 0, 360*64, &pcolor );
-    }
-
-    // Draw appropriate symbol - either symbol image or simple types
-    if ( dp->vtl->wp_draw_symbols && wp->symbol && wp->symbol_pixbuf ) {
-      vik_viewport_draw_pixbuf ( dp->vp, wp->symbol_pixbuf, 0, 0, x - gdk_pixbuf_get_width(wp->symbol_pixbuf)/2, y - gdk_pixbuf_get_height(wp->symbol_pixbuf)/2, -1, -1 );
-    }
-    else if ( wp == dp->vtl->current_wp ) {
-      switch ( dp->vtl->wp_symbol ) {
-      case WP_SYMBOL_FILLED_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - (dp->vtl->wp_size), y - (dp->vtl->wp_size), dp->vtl->wp_size*2, dp->vtl->wp_size*2, &dp->vtl->waypoint_color ); break;
-      case WP_SYMBOL_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - (dp->vtl->wp_size), y - (dp->vtl->wp_size), dp->vtl->wp_size*2, dp->vtl->wp_size*2, &dp->vtl->waypoint_color ); break;
-        case WP_SYMBOL_CIRCLE: vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - dp->vtl->wp_size, y - dp->vtl->wp_size, dp->vtl->wp_size*2, dp->vtl->wp_size*2, 0, 360*64, &dp->vtl->waypoint_color ); break;
-      case WP_SYMBOL_X:
-        vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x - dp->vtl->wp_size, y - dp->vtl->wp_size, x + dp->vtl->wp_size, y + dp->vtl->wp_size, &dp->vtl->waypoint_color, 2 );
-        vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x - dp->vtl->wp_size, y + dp->vtl->wp_size, x + dp->vtl->wp_size, y - dp->vtl->wp_size, &dp->vtl->waypoint_color, 2 );
-        break;
-      default: break;
-      }
-    }
-    else {
-      switch ( dp->vtl->wp_symbol ) {
-      case WP_SYMBOL_FILLED_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - dp->vtl->wp_size/2, y - dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size, &dp->vtl->waypoint_color ); break;
-      case WP_SYMBOL_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - dp->vtl->wp_size/2, y - dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size, &dp->vtl->waypoint_color ); break;
-      case WP_SYMBOL_CIRCLE: vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, TRUE, x-dp->vtl->wp_size/2, y-dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size, 0, 360*64, &dp->vtl->waypoint_color ); break;
-      case WP_SYMBOL_X:
-        vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x-dp->vtl->wp_size/2, y-dp->vtl->wp_size/2, x+dp->vtl->wp_size/2, y+dp->vtl->wp_size/2, &dp->vtl->waypoint_color, 2 );
-        vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x-dp->vtl->wp_size/2, y+dp->vtl->wp_size/2, x+dp->vtl->wp_size/2, y-dp->vtl->wp_size/2, &dp->vtl->waypoint_color, 2 );
-        break;
-      default: break;
+      if ( x+(w/2) > 0 && y+(h/2) > 0 && x-(w/2) < dp->width && y-(h/2) < dp->height ) /* always draw within boundaries */
+      {
+        if ( dp->highlight ) {
+          // Highlighted - so draw a little border around the chosen one
+          // single line seems a little weak so draw 2 of them
+          GdkColor hcolor = vik_viewport_get_highlight_gdkcolor ( dp->vp );
+          vik_viewport_draw_rectangle (dp->vp, vik_viewport_get_gc_highlight (dp->vp), FALSE,
+                                       x - (w/2) - 1, y - (h/2) - 1, w + 2, h + 2, &hcolor);
+          vik_viewport_draw_rectangle (dp->vp, vik_viewport_get_gc_highlight (dp->vp), FALSE,
+                                       x - (w/2) - 2, y - (h/2) - 2, w + 4, h + 4, &hcolor);
+        }
+
+        vik_viewport_draw_pixbuf ( dp->vp, pixbuf, 0, 0, x - (w/2), y - (h/2), w, h );
       }
+      return; /* if failed to draw picture, default to drawing regular waypoint (below) */
     }
+  }
 
-    if ( dp->vtl->drawlabels && !wp->hide_name )
-    {
-      /* thanks to the GPSDrive people (Fritz Ganter et al.) for hints on this part ... yah, I'm too lazy to study documentation */
-      gint label_x, label_y;
-      gint width, height;
-      // Hopefully name won't break the markup (may need to sanitize - g_markup_escape_text())
+  // Proximity drawing - only in LATLON mode ATM
+  if ( dp->vtl->wp_draw_proximity && !isnan(wp->proximity) && dp->vtl->coord_mode == VIK_COORD_LATLON ) {
+    struct LatLon ll, ll2;
+    VikCoord coord;
+    gint x2, y2;
+    vik_viewport_screen_to_coord ( dp->vp, x, y, &coord );
+    vik_coord_to_latlon ( &coord, &ll );
 
-      // Could this stored in the waypoint rather than recreating each pass?
-      gchar *wp_label_markup = g_strdup_printf ( "<span size=\"%s\">%s</span>", dp->vtl->wp_fsize_str, wp->name );
+    GdkColor pcolor = dp->vtl->waypoint_color;
+    if ( dp->highlight )
+      pcolor = vik_viewport_get_highlight_gdkcolor(dp->vp);
 
-      if ( pango_parse_markup ( wp_label_markup, -1, 0, NULL, NULL, NULL, NULL ) )
-        pango_layout_set_markup ( dp->vtl->wplabellayout, wp_label_markup, -1 );
-      else
-        // Fallback if parse failure
-        pango_layout_set_text ( dp->vtl->wplabellayout, wp->name, -1 );
+    a_coords_latlon_destination ( &ll, wp->proximity, 90.0, &ll2 );
 
-      g_free ( wp_label_markup );
+    vik_coord_load_from_latlon ( &coord, VIK_COORD_LATLON, &ll2 );
+    vik_viewport_coord_to_screen ( dp->vp, &coord, &x2, &y2 );
+    gint cr = abs(x-x2);
+    // Only try to draw if not too small or too big
+    if ( (cr > dp->vtl->wp_size*2) && (cr < dp->width/2) )
+      vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - cr, y - cr, 2*cr, 2*cr, 0, 360*64, &pcolor );
+  }
 
-      pango_layout_get_pixel_size ( dp->vtl->wplabellayout, &width, &height );
-      label_x = x - width/2;
-      if ( wp->symbol_pixbuf )
-        label_y = y - height - 2 - gdk_pixbuf_get_height(wp->symbol_pixbuf)/2;
-      else
-        label_y = y - dp->vtl->wp_size - height - 2;
+  // Draw appropriate symbol - either symbol image or simple types
+  if ( dp->vtl->wp_draw_symbols && wp->symbol && wp->symbol_pixbuf ) {
+    vik_viewport_draw_pixbuf ( dp->vp, wp->symbol_pixbuf, 0, 0, x - gdk_pixbuf_get_width(wp->symbol_pixbuf)/2, y - gdk_pixbuf_get_height(wp->symbol_pixbuf)/2, -1, -1 );
+  }
+  else if ( wp == dp->vtl->current_wp ) {
+    switch ( dp->vtl->wp_symbol ) {
+    case WP_SYMBOL_FILLED_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - (dp->vtl->wp_size), y - (dp->vtl->wp_size), dp->vtl->wp_size*2, dp->vtl->wp_size*2, &dp->vtl->waypoint_color ); break;
+    case WP_SYMBOL_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - (dp->vtl->wp_size), y - (dp->vtl->wp_size), dp->vtl->wp_size*2, dp->vtl->wp_size*2, &dp->vtl->waypoint_color ); break;
+      case WP_SYMBOL_CIRCLE: vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - dp->vtl->wp_size, y - dp->vtl->wp_size, dp->vtl->wp_size*2, dp->vtl->wp_size*2, 0, 360*64, &dp->vtl->waypoint_color ); break;
+    case WP_SYMBOL_X:
+      vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x - dp->vtl->wp_size, y - dp->vtl->wp_size, x + dp->vtl->wp_size, y + dp->vtl->wp_size, &dp->vtl->waypoint_color, 2 );
+      vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x - dp->vtl->wp_size, y + dp->vtl->wp_size, x + dp->vtl->wp_size, y - dp->vtl->wp_size, &dp->vtl->waypoint_color, 2 );
+      break;
+    default: break;
+    }
+  }
+  else {
+    switch ( dp->vtl->wp_symbol ) {
+    case WP_SYMBOL_FILLED_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, TRUE, x - dp->vtl->wp_size/2, y - dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size, &dp->vtl->waypoint_color ); break;
+    case WP_SYMBOL_SQUARE: vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_gc, FALSE, x - dp->vtl->wp_size/2, y - dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size, &dp->vtl->waypoint_color ); break;
+    case WP_SYMBOL_CIRCLE: vik_viewport_draw_arc ( dp->vp, dp->vtl->waypoint_gc, TRUE, x-dp->vtl->wp_size/2, y-dp->vtl->wp_size/2, dp->vtl->wp_size, dp->vtl->wp_size, 0, 360*64, &dp->vtl->waypoint_color ); break;
+    case WP_SYMBOL_X:
+      vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x-dp->vtl->wp_size/2, y-dp->vtl->wp_size/2, x+dp->vtl->wp_size/2, y+dp->vtl->wp_size/2, &dp->vtl->waypoint_color, 2 );
+      vik_viewport_draw_line ( dp->vp, dp->vtl->waypoint_gc, x-dp->vtl->wp_size/2, y+dp->vtl->wp_size/2, x+dp->vtl->wp_size/2, y-dp->vtl->wp_size/2, &dp->vtl->waypoint_color, 2 );
+      break;
+    default: break;
+    }
+  }
+
+  if ( dp->vtl->drawlabels && !wp->hide_name )
+  {
+    /* thanks to the GPSDrive people (Fritz Ganter et al.) for hints on this part ... yah, I'm too lazy to study documentation */
+    gint label_x, label_y;
+    gint width, height;
+    // Hopefully name won't break the markup (may need to sanitize - g_markup_escape_text())
 
-      // Cater for 'longer' waypoint names, to ensure background is always shown correctly
-      //  as otherwise vik_viewport_draw_rectangle() will not draw it if too big -ve offset
-      //  hence perform adjustment here, including reducing the width as necessary
-      gint lx_bkgr = (label_x > 0) ? label_x - 1 : 0;
-      gint width_bkgr = (label_x > 0) ? width + 2 : width + 1 - abs(label_x);
+    // Could this stored in the waypoint rather than recreating each pass?
+    gchar *wp_label_markup = g_strdup_printf ( "<span size=\"%s\">%s</span>", dp->vtl->wp_fsize_str, wp->name );
 
-      // Ensure background drawing is congruent with text layout limits
-      if (label_x > -VIK_VIEWPORT_LAYOUT_MAX ) {
-        // if highlight mode on, then draw background text in highlight colour
-        if ( dp->highlight ) {
-          GdkColor hcolor = vik_viewport_get_highlight_gdkcolor(dp->vp);
+    if ( pango_parse_markup ( wp_label_markup, -1, 0, NULL, NULL, NULL, NULL ) )
+      pango_layout_set_markup ( dp->wplabellayout, wp_label_markup, -1 );
+    else
+      // Fallback if parse failure
+      pango_layout_set_text ( dp->wplabellayout, wp->name, -1 );
+
+    g_free ( wp_label_markup );
+
+    pango_layout_get_pixel_size ( dp->wplabellayout, &width, &height );
+    label_x = x - width/2;
+    if ( wp->symbol_pixbuf )
+      label_y = y - height - 2 - gdk_pixbuf_get_height(wp->symbol_pixbuf)/2;
+    else
+      label_y = y - dp->vtl->wp_size - height - 2;
+
+    // Cater for 'longer' waypoint names, to ensure background is always shown correctly
+    //  as otherwise vik_viewport_draw_rectangle() will not draw it if too big -ve offset
+    //  hence perform adjustment here, including reducing the width as necessary
+    gint lx_bkgr = (label_x > 0) ? label_x - 1 : 0;
+    gint width_bkgr = (label_x > 0) ? width + 2 : width + 1 - abs(label_x);
+
+    // Ensure background drawing is congruent with text layout limits
+    if (label_x > -VIK_VIEWPORT_LAYOUT_MAX ) {
+      // if highlight mode on, then draw background text in highlight colour
+      if ( dp->highlight ) {
+        GdkColor hcolor = vik_viewport_get_highlight_gdkcolor(dp->vp);
 #if GTK_CHECK_VERSION (3,0,0)
-          if ( dp->vtl->wpbgand ) {
-            GdkRGBA bg = { hcolor.red / 65535.0, hcolor.blue / 65535.0, hcolor.green / 65535.0, 0.5 };
-            gdk_cairo_set_source_rgba ( dp->vtl->waypoint_bg_gc, &bg );
-            vik_viewport_draw_rectangle ( dp->vp, vik_viewport_get_gc_highlight (dp->vp), TRUE, lx_bkgr, label_y-1, width_bkgr, height+2, NULL );
-          }
-          else
-#endif
-          vik_viewport_draw_rectangle ( dp->vp, vik_viewport_get_gc_highlight (dp->vp), TRUE, lx_bkgr, label_y-1, width_bkgr, height+2, &hcolor );
+        if ( dp->vtl->wpbgand ) {
+          GdkRGBA bg = { hcolor.red / 65535.0, hcolor.blue / 65535.0, hcolor.green / 65535.0, 0.5 };
+          gdk_cairo_set_source_rgba ( vik_viewport_get_gc_target(dp->vp, dp->vtl->waypoint_bg_gc), &bg );
+          vik_viewport_draw_rectangle ( dp->vp, vik_viewport_get_gc_highlight (dp->vp), TRUE, lx_bkgr, label_y-1, width_bkgr, height+2, NULL );
         }
-        else {
-#if GTK_CHECK_VERSION (3,0,0)
-          if ( dp->vtl->wpbgand ) {
-            GdkRGBA bg = { dp->vtl->waypoint_bg_color.red / 65535.0,
-                           dp->vtl->waypoint_bg_color.blue / 65535.0,
-                           dp->vtl->waypoint_bg_color.green / 65535.0,
-                           0.5 };
-            gdk_cairo_set_source_rgba ( dp->vtl->waypoint_bg_gc, &bg );
-            vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_bg_gc, TRUE, lx_bkgr, label_y-1, width_bkgr, height+2, NULL );
-          }
-          else
+        else
 #endif
-          vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_bg_gc, TRUE, lx_bkgr, label_y-1, width_bkgr, height+2, &dp->vtl->waypoint_bg_color );
+        vik_viewport_draw_rectangle ( dp->vp, vik_viewport_get_gc_highlight (dp->vp), TRUE, lx_bkgr, label_y-1, width_bkgr, height+2, &hcolor );
+      }
+      else {
+#if GTK_CHECK_VERSION (3,0,0)
+        if ( dp->vtl->wpbgand ) {
+          GdkRGBA bg = { dp->vtl->waypoint_bg_color.red / 65535.0,
+                         dp->vtl->waypoint_bg_color.blue / 65535.0,
+                         dp->vtl->waypoint_bg_color.green / 65535.0,
+                         0.5 };
+          gdk_cairo_set_source_rgba ( vik_viewport_get_gc_target(dp->vp, dp->vtl->waypoint_bg_gc), &bg );
+          vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_bg_gc, TRUE, lx_bkgr, label_y-1, width_bkgr, height+2, NULL );
         }
+        else
+#endif
+        vik_viewport_draw_rectangle ( dp->vp, dp->vtl->waypoint_bg_gc, TRUE, lx_bkgr, label_y-1, width_bkgr, height+2, &dp->vtl->waypoint_bg_color );
       }
-      vik_viewport_draw_layout ( dp->vp, dp->vtl->waypoint_text_gc, label_x, label_y, dp->vtl->wplabellayout, &dp->vtl->waypoint_text_color );
     }
+    vik_viewport_draw_layout ( dp->vp, dp->vtl->waypoint_text_gc, label_x, label_y, dp->wplabellayout, &dp->vtl->waypoint_text_color );
   }
 }
 
+/**
+ * Gather the waypoints in view, so their positions can be converted together
+ */
 static void trw_layer_draw_waypoint_cb ( gpointer id, VikWaypoint *wp, struct DrawingParams *dp )
 {
   if ( BBOX_INTERSECT ( dp->vtl->waypoints_bbox, dp->bbox ) ) {
-    trw_layer_draw_waypoint ( id, wp, dp );
+    if ( wp->visible )
+    if ( (!dp->one_zone && !dp->lat_lon) || ( ( dp->lat_lon || wp->coord.utm_zone == dp->center->utm_zone ) &&
+               wp->coord.east_west < dp->ce2 && wp->coord.east_west > dp->ce1 &&
+               wp->coord.north_south > dp->cn1 && wp->coord.north_south < dp->cn2 ) )
+      g_ptr_array_add ( dp->wps, wp );
+  }
+}
+
+/**
+ * Draw the waypoints gathered by trw_layer_draw_waypoint_cb()
+ */
+static void trw_layer_draw_waypoints ( struct DrawingParams *dp )
+{
+  guint nwp = dp->wps->len;
+  if ( nwp ) {
+    const VikCoord **coords = g_new ( const VikCoord*, nwp );
+    gint *xs = g_new ( gint, nwp );
+    gint *ys = g_new ( gint, nwp );
+    for ( guint ii = 0; ii < nwp; ii++ )
+      coords[ii] = &(VIK_WAYPOINT(g_ptr_array_index(dp->wps, ii))->coord);
+    vik_viewport_transform_coords ( &dp->vt, coords, nwp, xs, ys );
+    for ( guint ii = 0; ii < nwp; ii++ )
+      trw_layer_draw_waypoint ( g_ptr_array_index(dp->wps, ii), dp, xs[ii], ys[ii] );
+    g_free ( coords );
+    g_free ( xs );
+    g_free ( ys );
   }
+  g_ptr_array_set_size ( dp->wps, 0 );
 }
 
 static void trw_layer_draw_with_highlight ( VikTrwLayer *l, VikViewport *vvp, gboolean highlight )
 {
-  static struct DrawingParams dp;
+  struct DrawingParams *dp = drawing_params_get ();
   g_assert ( l != NULL );
 
-  init_drawing_params ( &dp, l, vvp, highlight );
+  init_drawing_params ( dp, l, vvp, highlight );
 
   if ( l->tracks_visible )
-    g_hash_table_foreach ( l->tracks, (GHFunc) trw_layer_draw_track_cb, &dp );
+    g_hash_table_foreach ( l->tracks, (GHFunc) trw_layer_draw_track_cb, dp );
 
   if ( l->routes_visible )
-    g_hash_table_foreach ( l->routes, (GHFunc) trw_layer_draw_track_cb, &dp );
+    g_hash_table_foreach ( l->routes, (GHFunc) trw_layer_draw_track_cb, dp );
 
   if (l->waypoints_visible)
-    g_hash_table_foreach ( l->waypoints, (GHFunc) trw_layer_draw_waypoint_cb, &dp );
+  {
+    g_hash_table_foreach ( l->waypoints, (GHFunc) trw_layer_draw_waypoint_cb, dp );
+    trw_layer_draw_waypoints ( dp );
+  }
 }
 
 static void trw_layer_draw ( VikTrwLayer *l, VikViewport *vvp )
 {
-  trw_ensure_layer_loaded ( l );
+  gboolean selected;
+  if ( l->draw_prepared ) {
+    // Drawing in another thread, so use what was found by trw_layer_draw_threadsafe()
+    selected = l->draw_selected;
+    l->draw_prepared = FALSE;
+  }
+  else {
+    trw_ensure_layer_loaded ( l );
+    selected = vik_window_get_selected_trw_layer ((VikWindow*)VIK_GTK_WINDOW_FROM_LAYER((VikLayer*)l)) == l;
+  }
   // If this layer is to be highlighted - then don't draw now - as it will be drawn later on in the specific highlight draw stage
   // This may seem slightly inefficient to test each time for every layer
   //  but for a layer with *lots* of tracks & waypoints this can save some effort by not drawing the items twice
-  if ( vik_viewport_get_draw_highlight ( vvp ) &&
-       vik_window_get_selected_trw_layer ((VikWindow*)VIK_GTK_WINDOW_FROM_LAYER((VikLayer*)l)) == l )
+  if ( vik_viewport_get_draw_highlight ( vvp ) && selected )
     return;
   trw_layer_draw_with_highlight ( l, vvp, FALSE );
 }
 
+static gboolean trw_layer_draw_threadsafe ( VikTrwLayer *l )
+{
+  // Loading an external layer is not something to be done outside of the main thread
+  if ( l->external_layer != VIK_TRW_LAYER_INTERNAL && !l->external_loaded )
+    return FALSE;
+  // Nor is looking at the window
+  l->draw_selected = vik_window_get_selected_trw_layer ((VikWindow*)VIK_GTK_WINDOW_FROM_LAYER((VikLayer*)l)) == l;
+  l->draw_prepared = TRUE;
+  return TRUE;
+}
+
 void vik_trw_layer_draw_highlight ( VikTrwLayer *vtl, VikViewport *vvp )
 {
   // Check the layer for visibility (including all the parents visibilities)
@@ -3021,16 +3264,17 @@ void vik_trw_layer_draw_highlight_item ( VikTrwLayer *vtl, VikTrack *trk, VikWay
   if ( !vik_treeview_item_get_visible_tree (VIK_LAYER(vtl)->vt, &(VIK_LAYER(vtl)->iter)) )
     return;
 
-  static struct DrawingParams dp;
-  init_drawing_params ( &dp, vtl, vvp, TRUE );
+  struct DrawingParams *dp = drawing_params_get ();
+  init_drawing_params ( dp, vtl, vvp, TRUE );
 
   if ( trk ) {
     gboolean draw = ( trk->is_route && vtl->routes_visible ) || ( !trk->is_route && vtl->tracks_visible );
     if ( draw )
-      trw_layer_draw_track_cb ( NULL, trk, &dp );
+      trw_layer_draw_track_cb ( NULL, trk, dp );
   }
   if ( vtl->waypoints_visible && wpt ) {
-    trw_layer_draw_waypoint_cb ( NULL, wpt, &dp );
+    trw_layer_draw_waypoint_cb ( NULL, wpt, dp );
+    trw_layer_draw_waypoints ( dp );
   }
 }
 
@@ -3099,18 +3343,20 @@ void vik_trw_layer_draw_highlight_items ( VikTrwLayer *vtl, GHashTable *trks, GH
   if ( !vik_treeview_item_get_visible_tree (VIK_LAYER(vtl)->vt, &(VIK_LAYER(vtl)->iter)) )
     return;
 
-  static struct DrawingParams dp;
-  init_drawing_params ( &dp, vtl, vvp, TRUE );
+  struct DrawingParams *dp = drawing_params_get ();
+  init_drawing_params ( dp, vtl, vvp, TRUE );
 
   if ( trks ) {
     gboolean is_routes = (trks == vtl->routes);
     gboolean draw = ( is_routes && vtl->routes_visible ) || ( !is_routes && vtl->tracks_visible );
     if ( draw )
-      g_hash_table_foreach ( trks, (GHFunc) trw_layer_draw_track_cb, &dp );
+      g_hash_table_foreach ( trks, (GHFunc) trw_layer_draw_track_cb, dp );
   }
 
-  if ( vtl->waypoints_visible && wpts )
-    g_hash_table_foreach ( wpts, (GHFunc) trw_layer_draw_waypoint_cb, &dp );
+  if ( vtl->waypoints_visible && wpts ) {
+    g_hash_table_foreach ( wpts, (GHFunc) trw_layer_draw_waypoint_cb, dp );
+    trw_layer_draw_waypoints ( dp );
+  }
 }
 
 
@@ -6695,6 +6941,7 @@ static void trw_layer_rotate ( menu_array_sublayer values )
     seg = g_list_first ( track->trackpoints );
     tp = VIK_TRACKPOINT(seg->data);
     tp->newsegment = TRUE;
+    vik_track_lod_invalidate ( track );
 
     vik_layer_emit_update ( VIK_LAYER(vtl), trw_layer_modified(vtl) );
   }
@@ -7518,6 +7765,7 @@ static void trw_layer_merge_with_other ( menu_array_sublayer values )
         else
           vik_trw_layer_delete_track (vtl, merge_track);
         track->trackpoints = g_list_sort(track->trackpoints, trackpoint_compare);
+        vik_track_lod_invalidate ( track );
       }
     }
     for (l = merge_list; l != NULL; l = g_list_next(l))
@@ -7813,6 +8061,7 @@ static void trw_layer_merge_by_timestamp ( menu_array_sublayer values )
     }
 
     orig_trk->trackpoints = g_list_sort(orig_trk->trackpoints, trackpoint_compare);
+    vik_track_lod_invalidate ( orig_trk );
   }
 
   g_list_free(nearby_tracks);
@@ -8115,6 +8364,7 @@ static void trw_layer_trackpoint_selected_delete ( VikTrwLayer *vtl, VikTrack *t
     // Delete current trackpoint
     vik_trackpoint_free ( vtl->current_tpl->data );
     trk->trackpoints = g_list_delete_link ( trk->trackpoints, vtl->current_tpl );
+    vik_track_lod_invalidate ( trk );
 
     // Set to current to the available adjacent trackpoint
     vtl->current_tpl = new_tpl;
@@ -10175,6 +10425,7 @@ static void trw_layer_insert_tp_beside_current_tp ( VikTrwLayer *vtl, gboolean b
         index = index + 1;
       // NB no recalculation of bounds since it is inserted between points
       trk->trackpoints = g_list_insert ( trk->trackpoints, tp_new, index );
+      vik_track_lod_invalidate ( trk );
     }
   }
 
@@ -12933,9 +13184,14 @@ void vik_track_download_map(VikTrack *tr, VikMapsLayer *vml, VikViewport *vvp, g
     }
   }
 
+  // All the areas as one download job
+  GArray *corners = g_array_new ( FALSE, FALSE, sizeof(VikCoord) );
   for (rect_iter = rects_to_download; rect_iter; rect_iter = rect_iter->next) {
-    vik_maps_layer_download_section (vml, vvp, &(((Rect *)(rect_iter->data))->tl), &(((Rect *)(rect_iter->data))->br), zoom_level);
+    g_array_append_val ( corners, GLRECT(rect_iter)->tl );
+    g_array_append_val ( corners, GLRECT(rect_iter)->br );
   }
+  vik_maps_layer_download_sections ( vml, (VikCoord*)corners->data, corners->len / 2, zoom_level );
+  g_array_free ( corners, TRUE );
 
   if (fillins) {
     for (iter = fillins; iter; iter = iter->next)
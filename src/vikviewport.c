@@ -84,6 +84,7 @@ struct _VikViewport {
 #endif
   gint width, height;
   gint width_2, height_2; // Half of the normal width and height
+  gboolean off_screen;    // Temporarily resized via vik_viewport_configure_manually()
   VikCoord center;
   VikCoordMode coord_mode;
   gdouble xmpp, ympp;
@@ -111,6 +112,7 @@ struct _VikViewport {
 
   GSList *copyrights;
   GSList *logos;
+  VikViewportCache *recording; // Where copyrights and logos are also noted whilst drawing into a cache
 
   /* Wether or not display OSD info */
   gboolean draw_scale;
@@ -186,6 +188,7 @@ VikViewport *vik_viewport_new ()
 #define VIK_SETTINGS_VIEW_HISTORY_DIFF_DIST "viewport_history_diff_dist"
 #define VIK_SETTINGS_VIEW_SCALE "viewport_scale"
 #define VIK_SETTINGS_VIEW_POPUP_DELAY "viewport_popup_delay"
+#define VIK_SETTINGS_VIEW_DRAW_THREADS "viewport_draw_threads"
 
 // Hacky method to enable to return a scale value
 // Mostly for places in code, such as initializers, where they have no knowledge of any vvp in use.
@@ -458,6 +461,7 @@ void configure_common ( VikViewport *vvp )
  */
 void vik_viewport_configure_manually ( VikViewport *vvp, gint width, guint height )
 {
+  vvp->off_screen = TRUE;
   vvp->width = width;
   vvp->height = height;
 
@@ -582,6 +586,7 @@ gboolean vik_viewport_configure ( VikViewport *vvp )
   if ( vvp->width != allocation.width || vvp->height != allocation.height || first )
     changed_size = TRUE;
   first = FALSE;
+  vvp->off_screen = FALSE;
   vvp->width = allocation.width;
   vvp->height = allocation.height;
 
@@ -902,6 +907,27 @@ void vik_viewport_draw_copyright ( VikViewport *vvp )
   g_object_unref(pl);
 }
 
+/**
+ * vik_viewport_draw_overlay_text:
+ *
+ * Draw some (multiline) text in the top left corner on a grey background
+ */
+void vik_viewport_draw_overlay_text ( VikViewport *vvp, const gchar *text )
+{
+  g_return_if_fail ( vvp != NULL );
+
+  PangoRectangle ink_rect, logical_rect;
+  PangoLayout *pl = gtk_widget_create_pango_layout ( GTK_WIDGET(&vvp->drawing_area), NULL );
+  pango_layout_set_font_description ( pl, gtk_widget_get_style(GTK_WIDGET(&vvp->drawing_area))->font_desc );
+  pango_layout_set_text ( pl, text, -1 );
+  pango_layout_get_pixel_extents ( pl, &ink_rect, &logical_rect );
+
+  vik_viewport_draw_rectangle ( vvp, vvp->scale_bg_gc, TRUE, PAD, PAD, logical_rect.width + PAD, logical_rect.height + PAD, &vvp->scale_bg_color );
+  vik_viewport_draw_layout ( vvp, vvp->black_gc, PAD + PAD/2, PAD + PAD/2, pl, &vvp->black_color );
+
+  g_object_unref ( pl );
+}
+
 /**
  * vik_viewport_set_draw_centermark:
  * @vvp: self object
@@ -1554,7 +1580,7 @@ void vik_viewport_screen_to_coord ( VikViewport *vvp, int x, int y, VikCoord *co
  */
 void vik_viewport_coord_to_screen ( VikViewport *vvp, const VikCoord *coord, int *x, int *y )
 {
-  static VikCoord tmp;
+  VikCoord tmp;
   g_return_if_fail ( vvp != NULL );
 
   if ( coord->mode != vvp->coord_mode )
@@ -1593,6 +1619,106 @@ void vik_viewport_coord_to_screen ( VikViewport *vvp, const VikCoord *coord, int
   }
 }
 
+/**
+ * vik_viewport_get_transform:
+ *
+ * Take the values needed by vik_viewport_transform_coords()
+ */
+void vik_viewport_get_transform ( VikViewport *vvp, VikViewportTransform *vt )
+{
+  g_return_if_fail ( vvp != NULL );
+
+  vt->coord_mode = vvp->coord_mode;
+  vt->drawmode = vvp->drawmode;
+  vt->one_utm_zone = vvp->one_utm_zone;
+  vt->width_2 = vvp->width_2;
+  vt->height_2 = vvp->height_2;
+  vt->xmpp = vvp->xmpp;
+  vt->ympp = vvp->ympp;
+  vt->xmfactor = vvp->xmfactor;
+  vt->ymfactor = vvp->ymfactor;
+  vt->center_x = vvp->center.east_west;
+  vt->center_y = vvp->center.north_south;
+  if ( vvp->coord_mode == VIK_COORD_LATLON && vvp->drawmode == VIK_VIEWPORT_DRAWMODE_MERCATOR )
+    vt->center_y = MERCLAT ( vvp->center.north_south );
+  vt->center_zone = vvp->center.utm_zone;
+  vt->utm_zone_width = vvp->utm_zone_width;
+}
+
+// Coordinates are converted in blocks of this many,
+//  with each projection being a simple loop over plain arrays that the compiler can vectorize
+#define TRANSFORM_BLOCK 256
+
+/**
+ * vik_viewport_transform_coords:
+ * @vt:     From vik_viewport_get_transform()
+ * @coords: The coordinates to convert
+ * @n:      Number of coordinates
+ * @x:      Array of @n for the screen x positions
+ * @y:      Array of @n for the screen y positions
+ *
+ * The array equivalent of vik_viewport_coord_to_screen(), giving the same positions
+ */
+void vik_viewport_transform_coords ( const VikViewportTransform *vt, const VikCoord * const *coords, guint n, gint *x, gint *y )
+{
+  gdouble ew[TRANSFORM_BLOCK];
+  gdouble ns[TRANSFORM_BLOCK];
+  gint zone[TRANSFORM_BLOCK];
+
+  for ( guint start = 0; start < n; start += TRANSFORM_BLOCK ) {
+    guint count = MIN ( TRANSFORM_BLOCK, n - start );
+    gint *xx = x + start;
+    gint *yy = y + start;
+
+    for ( guint ii = 0; ii < count; ii++ ) {
+      const VikCoord *coord = coords[start+ii];
+      if ( coord->mode != vt->coord_mode ) {
+        VikCoord tmp;
+        vik_coord_copy_convert ( coord, vt->coord_mode, &tmp );
+        ew[ii] = tmp.east_west;
+        ns[ii] = tmp.north_south;
+        zone[ii] = tmp.utm_zone;
+      }
+      else {
+        ew[ii] = coord->east_west;
+        ns[ii] = coord->north_south;
+        zone[ii] = coord->utm_zone;
+      }
+    }
+
+    if ( vt->coord_mode == VIK_COORD_UTM ) {
+      for ( guint ii = 0; ii < count; ii++ ) {
+        xx[ii] = ( (ew[ii] - vt->center_x) / vt->xmpp ) + vt->width_2 - (vt->center_zone - zone[ii]) * vt->utm_zone_width / vt->xmpp;
+        yy[ii] = vt->height_2 - ( (ns[ii] - vt->center_y) / vt->ympp );
+      }
+      if ( vt->one_utm_zone )
+        for ( guint ii = 0; ii < count; ii++ )
+          if ( zone[ii] != vt->center_zone )
+            xx[ii] = yy[ii] = VIK_VIEWPORT_UTM_WRONG_ZONE;
+    }
+    else if ( vt->drawmode == VIK_VIEWPORT_DRAWMODE_LATLON ) {
+      for ( guint ii = 0; ii < count; ii++ ) {
+        xx[ii] = vt->width_2 + ( vt->xmfactor * (ew[ii] - vt->center_x) );
+        yy[ii] = vt->height_2 + ( vt->ymfactor * (vt->center_y - ns[ii]) );
+      }
+    }
+    else if ( vt->drawmode == VIK_VIEWPORT_DRAWMODE_MERCATOR ) {
+      for ( guint ii = 0; ii < count; ii++ ) {
+        xx[ii] = vt->width_2 + ( vt->xmfactor * (ew[ii] - vt->center_x) );
+        yy[ii] = vt->height_2 + ( vt->ymfactor * ( vt->center_y - MERCLAT(ns[ii]) ) );
+      }
+    }
+    else if ( vt->drawmode == VIK_VIEWPORT_DRAWMODE_EXPEDIA ) {
+      for ( guint ii = 0; ii < count; ii++ ) {
+        double dx, dy;
+        calcxy ( &dx, &dy, vt->center_x, vt->center_y, ew[ii], ns[ii], vt->xmpp * ALTI_TO_MPP, vt->ympp * ALTI_TO_MPP, vt->width_2, vt->height_2 );
+        xx[ii] = dx;
+        yy[ii] = dy;
+      }
+    }
+  }
+}
+
 /**
  * a_viewport_clip_line:
  * @x1: screen coord
@@ -1669,6 +1795,33 @@ void a_viewport_clip_line ( gint *x1, gint *y1, gint *x2, gint *y2 )
   }
 }
 
+#if GTK_CHECK_VERSION (3,0,0)
+// Drawing done in another thread goes into that thread's own cairo context,
+//  rather than the viewport one all the GCs share
+static GPrivate thread_target;
+
+static GdkGC *viewport_target ( GdkGC *gc )
+{
+  cairo_t *cr = g_private_get ( &thread_target );
+  return cr ? cr : gc;
+}
+#endif
+
+/**
+ * vik_viewport_get_gc_target:
+ *
+ * For GTK3, the GC to use for any direct drawing with the given viewport GC,
+ *  as when drawing from another thread this is not the viewport one.
+ */
+GdkGC *vik_viewport_get_gc_target ( VikViewport *vvp, GdkGC *gc )
+{
+#if GTK_CHECK_VERSION (3,0,0)
+  return viewport_target ( gc );
+#else
+  return gc;
+#endif
+}
+
 /**
  * For GTK3 Need to pass in the color and thickness each time
  *
@@ -1680,6 +1833,7 @@ void vik_viewport_draw_line ( VikViewport *vvp, GdkGC *gc, gint x1, gint y1, gin
        ( x1 > vvp->width && x2 > vvp->width ) || ( y1 > vvp->height && y2 > vvp->height ) ) ) {
 #if GTK_CHECK_VERSION (3,0,0)
     g_return_if_fail ( gc != NULL );
+    gc = viewport_target ( gc );
     cairo_set_line_width ( gc, thickness );
     if ( gcolor )
       gdk_cairo_set_source_color ( gc, gcolor );
@@ -1702,6 +1856,7 @@ void vik_viewport_draw_rectangle ( VikViewport *vvp, GdkGC *gc, gboolean filled,
   if ( x1 > -32 && x1 < vvp->width + 32 && y1 > -32 && y1 < vvp->height + 32 ) {
 #if GTK_CHECK_VERSION (3,0,0)
     g_return_if_fail ( gc != NULL );
+    gc = viewport_target ( gc );
     if ( gcolor )
       gdk_cairo_set_source_color ( gc, gcolor );
     ui_cr_draw_rectangle ( gc, filled, x1, y1, x2, y2 );
@@ -1724,10 +1879,11 @@ void vik_viewport_draw_pixbuf ( VikViewport *vvp, GdkPixbuf *pixbuf, gint src_x,
 {
 #if GTK_CHECK_VERSION (3,0,0)
   // TODO confirm this draws with negative dest_x & dest_y values...
-  gdk_cairo_set_source_pixbuf ( vvp->crt, pixbuf, dest_x, dest_y );
+  cairo_t *cr = viewport_target ( vvp->crt );
+  gdk_cairo_set_source_pixbuf ( cr, pixbuf, dest_x, dest_y );
   // This is needed after each pixbuf is applied
   //  (i.e. can't group together a series of pixbuf requests and paint once only at the end)
-  cairo_paint ( vvp->crt );
+  cairo_paint ( cr );
 #else
   gdk_draw_pixbuf ( vvp->scr_buffer,
                     NULL,
@@ -1747,6 +1903,7 @@ void vik_viewport_draw_arc ( VikViewport *vvp, GdkGC *gc, gboolean filled, gint
 {
 #if GTK_CHECK_VERSION (3,0,0)
   g_return_if_fail ( gc != NULL );
+  gc = viewport_target ( gc );
   // ATM Only used for drawing circles - so height is ignored
   //  other arc drawing usage also currently uses width==height
   if ( gcolor )
@@ -1772,6 +1929,7 @@ void vik_viewport_draw_polygon ( VikViewport *vvp, GdkGC *gc, gboolean filled, G
 {
 #if GTK_CHECK_VERSION (3,0,0)
   g_return_if_fail ( gc != NULL );
+  gc = viewport_target ( gc );
   if ( gcolor )
     gdk_cairo_set_source_color ( gc, gcolor );
   // Using cairo no obvious draw polygon method,
@@ -1789,6 +1947,726 @@ void vik_viewport_draw_polygon ( VikViewport *vvp, GdkGC *gc, gboolean filled, G
 #endif
 }
 
+typedef enum {
+  PATH_LINE,
+  PATH_RECTANGLE,
+  PATH_CIRCLE,
+  PATH_POLYGON, // Followed by PATH_POINT entries, x1 holds how many
+  PATH_POINT,
+} VikViewportPathOp;
+
+typedef struct {
+  VikViewportPathOp op;
+  gint x1, y1, x2, y2;
+} VikViewportPathItem;
+
+struct _VikViewportPath {
+  GArray *items;
+  guint lines;  // Number of PATH_LINE items
+  guint shapes; // Number of filled items
+};
+
+VikViewportPath *vik_viewport_path_new ()
+{
+  VikViewportPath *path = g_new0 ( VikViewportPath, 1 );
+  path->items = g_array_new ( FALSE, FALSE, sizeof(VikViewportPathItem) );
+  return path;
+}
+
+void vik_viewport_path_free ( VikViewportPath *path )
+{
+  if ( !path )
+    return;
+  g_array_free ( path->items, TRUE );
+  g_free ( path );
+}
+
+/**
+ * Empty the path, keeping the memory for reuse
+ */
+void vik_viewport_path_clear ( VikViewportPath *path )
+{
+  g_array_set_size ( path->items, 0 );
+  path->lines = 0;
+  path->shapes = 0;
+}
+
+gboolean vik_viewport_path_is_empty ( VikViewportPath *path )
+{
+  return path->items->len == 0;
+}
+
+static void path_append ( VikViewportPath *path, VikViewportPathOp op, gint x1, gint y1, gint x2, gint y2 )
+{
+  VikViewportPathItem item = { op, x1, y1, x2, y2 };
+  g_array_append_val ( path->items, item );
+}
+
+/**
+ * Same limits as vik_viewport_draw_line()
+ */
+void vik_viewport_path_add_line ( VikViewport *vvp, VikViewportPath *path, gint x1, gint y1, gint x2, gint y2 )
+{
+  if ( ( x1 < 0 && x2 < 0 ) || ( y1 < 0 && y2 < 0 ) ||
+       ( x1 > vvp->width && x2 > vvp->width ) || ( y1 > vvp->height && y2 > vvp->height ) )
+    return;
+  path_append ( path, PATH_LINE, x1, y1, x2, y2 );
+  path->lines++;
+}
+
+/**
+ * A filled rectangle, with the same limits as vik_viewport_draw_rectangle()
+ */
+void vik_viewport_path_add_rectangle ( VikViewport *vvp, VikViewportPath *path, gint x, gint y, gint width, gint height )
+{
+  if ( x > -32 && x < vvp->width + 32 && y > -32 && y < vvp->height + 32 ) {
+    path_append ( path, PATH_RECTANGLE, x, y, width, height );
+    path->shapes++;
+  }
+}
+
+/**
+ * A filled circle within the square of the given width at x,y
+ */
+void vik_viewport_path_add_circle ( VikViewportPath *path, gint x, gint y, gint width )
+{
+  path_append ( path, PATH_CIRCLE, x, y, width, width );
+  path->shapes++;
+}
+
+/**
+ * A filled polygon
+ */
+void vik_viewport_path_add_polygon ( VikViewportPath *path, GdkPoint *points, gint npoints )
+{
+  if ( npoints < 1 )
+    return;
+  path_append ( path, PATH_POLYGON, npoints, 0, 0, 0 );
+  for ( gint nn = 0; nn < npoints; nn++ )
+    path_append ( path, PATH_POINT, points[nn].x, points[nn].y, 0, 0 );
+  path->shapes++;
+}
+
+/**
+ * Draw all the lines in the path with one stroke
+ * For GTK2 the colour and thickness are those of the gc
+ */
+void vik_viewport_stroke_path ( VikViewport *vvp, GdkGC *gc, VikViewportPath *path, GdkColor *gcolor, guint thickness )
+{
+  if ( !path->lines )
+    return;
+#if GTK_CHECK_VERSION (3,0,0)
+  g_return_if_fail ( gc != NULL );
+  gc = viewport_target ( gc );
+  cairo_save ( gc );
+  cairo_new_path ( gc );
+  // Consecutive lines that meet are kept joined up, so a track is one continuous line
+  //  (and round joins avoid mitre spikes on sharp turns)
+  cairo_set_line_join ( gc, CAIRO_LINE_JOIN_ROUND );
+  gboolean joined = FALSE;
+  gint lastx = 0, lasty = 0;
+  for ( guint ii = 0; ii < path->items->len; ii++ ) {
+    VikViewportPathItem *item = &g_array_index ( path->items, VikViewportPathItem, ii );
+    if ( item->op != PATH_LINE ) {
+      joined = FALSE;
+      continue;
+    }
+    if ( !joined || item->x1 != lastx || item->y1 != lasty )
+      cairo_move_to ( gc, item->x1-0.5, item->y1-0.5 );
+    cairo_line_to ( gc, item->x2-0.5, item->y2-0.5 );
+    lastx = item->x2;
+    lasty = item->y2;
+    joined = TRUE;
+  }
+  cairo_set_line_width ( gc, thickness );
+  if ( gcolor )
+    gdk_cairo_set_source_color ( gc, gcolor );
+  cairo_stroke ( gc );
+  cairo_restore ( gc );
+#else
+  GdkSegment *segs = g_new ( GdkSegment, path->lines );
+  guint nn = 0;
+  for ( guint ii = 0; ii < path->items->len; ii++ ) {
+    VikViewportPathItem *item = &g_array_index ( path->items, VikViewportPathItem, ii );
+    if ( item->op != PATH_LINE )
+      continue;
+    segs[nn].x1 = item->x1;
+    segs[nn].y1 = item->y1;
+    segs[nn].x2 = item->x2;
+    segs[nn].y2 = item->y2;
+    a_viewport_clip_line ( &segs[nn].x1, &segs[nn].y1, &segs[nn].x2, &segs[nn].y2 );
+    nn++;
+  }
+  gdk_draw_segments ( vvp->scr_buffer, gc, segs, nn );
+  g_free ( segs );
+#endif
+}
+
+/**
+ * Draw all the filled shapes in the path with one fill
+ * For GTK2 the colour is that of the gc
+ */
+void vik_viewport_fill_path ( VikViewport *vvp, GdkGC *gc, VikViewportPath *path, GdkColor *gcolor )
+{
+  if ( !path->shapes )
+    return;
+#if GTK_CHECK_VERSION (3,0,0)
+  g_return_if_fail ( gc != NULL );
+  gc = viewport_target ( gc );
+  cairo_new_path ( gc );
+  for ( guint ii = 0; ii < path->items->len; ii++ ) {
+    VikViewportPathItem *item = &g_array_index ( path->items, VikViewportPathItem, ii );
+    switch ( item->op ) {
+    case PATH_RECTANGLE:
+      cairo_rectangle ( gc, item->x1, item->y1, item->x2, item->y2 );
+      break;
+    case PATH_CIRCLE:
+      cairo_new_sub_path ( gc );
+      cairo_arc ( gc, item->x1+item->x2/2.0, item->y1+item->x2/2.0, item->x2/2.0, 0, 2*M_PI );
+      cairo_close_path ( gc );
+      break;
+    case PATH_POLYGON:
+      for ( gint nn = 0; nn < item->x1; nn++ ) {
+        VikViewportPathItem *pt = &g_array_index ( path->items, VikViewportPathItem, ii+1+nn );
+        if ( nn == 0 )
+          cairo_move_to ( gc, pt->x1, pt->y1 );
+        else
+          cairo_line_to ( gc, pt->x1, pt->y1 );
+      }
+      cairo_close_path ( gc );
+      ii += item->x1;
+      break;
+    default:
+      break;
+    }
+  }
+  if ( gcolor )
+    gdk_cairo_set_source_color ( gc, gcolor );
+  cairo_fill ( gc );
+#else
+  for ( guint ii = 0; ii < path->items->len; ii++ ) {
+    VikViewportPathItem *item = &g_array_index ( path->items, VikViewportPathItem, ii );
+    switch ( item->op ) {
+    case PATH_RECTANGLE:
+      gdk_draw_rectangle ( vvp->scr_buffer, gc, TRUE, item->x1, item->y1, item->x2, item->y2 );
+      break;
+    case PATH_CIRCLE:
+      gdk_draw_arc ( vvp->scr_buffer, gc, TRUE, item->x1, item->y1, item->x2, item->y2, 0, 360*64 );
+      break;
+    case PATH_POLYGON: {
+      GdkPoint *points = g_new ( GdkPoint, item->x1 );
+      for ( gint nn = 0; nn < item->x1; nn++ ) {
+        VikViewportPathItem *pt = &g_array_index ( path->items, VikViewportPathItem, ii+1+nn );
+        points[nn].x = pt->x1;
+        points[nn].y = pt->y1;
+      }
+      gdk_draw_polygon ( vvp->scr_buffer, gc, TRUE, points, item->x1 );
+      g_free ( points );
+      ii += item->x1;
+      break;
+    }
+    default:
+      break;
+    }
+  }
+#endif
+}
+
+struct _VikViewportCache {
+  gint dirty;            // Accessed atomically, as it may be invalidated from a background thread
+  gboolean provisional;  // Drawn whilst the view was still being moved
+#if GTK_CHECK_VERSION (3,0,0)
+  cairo_surface_t *surface;
+#endif
+  VikViewportTransform vt; // The view that was drawn
+  VikCoord center;
+  gint width, height;
+  guint scale;
+  GSList *copyrights;    // Copyrights and logos added whilst drawing
+  GSList *logos;
+};
+
+VikViewportCache *vik_viewport_cache_new ()
+{
+  VikViewportCache *cache = g_new0 ( VikViewportCache, 1 );
+  cache->dirty = TRUE;
+  return cache;
+}
+
+static void cache_reset_attribution ( VikViewportCache *cache )
+{
+  g_slist_free_full ( cache->copyrights, g_free );
+  cache->copyrights = NULL;
+  g_slist_free_full ( cache->logos, g_object_unref );
+  cache->logos = NULL;
+}
+
+void vik_viewport_cache_free ( VikViewportCache *cache )
+{
+  if ( !cache )
+    return;
+#if GTK_CHECK_VERSION (3,0,0)
+  if ( cache->surface )
+    cairo_surface_destroy ( cache->surface );
+#endif
+  cache_reset_attribution ( cache );
+  g_free ( cache );
+}
+
+/**
+ * Ensure the next draw is done afresh
+ * Can be called from any thread
+ */
+void vik_viewport_cache_invalidate ( VikViewportCache *cache )
+{
+  if ( cache )
+    g_atomic_int_set ( &cache->dirty, TRUE );
+}
+
+static void cache_record_copyright ( VikViewportCache *cache, const gchar *copyright )
+{
+  if ( !g_slist_find_custom ( cache->copyrights, copyright, (GCompareFunc)strcmp ) )
+    cache->copyrights = g_slist_append ( cache->copyrights, g_strdup(copyright) );
+}
+
+static void cache_record_logo ( VikViewportCache *cache, const GdkPixbuf *logo )
+{
+  if ( !g_slist_find ( cache->logos, logo ) )
+    cache->logos = g_slist_append ( cache->logos, g_object_ref((gpointer)logo) );
+}
+
+#if GTK_CHECK_VERSION (3,0,0)
+/**
+ * Whether the cached drawing is of the same scale and projection as the view now,
+ *  i.e. could only differ by where the view is centered
+ */
+static gboolean cache_same_scale ( VikViewport *vvp, VikViewportCache *cache, const VikViewportTransform *vt )
+{
+  return cache->surface &&
+    cache->width == vvp->width && cache->height == vvp->height && cache->scale == vvp->scale &&
+    cache->vt.coord_mode == vt->coord_mode && cache->vt.drawmode == vt->drawmode &&
+    cache->vt.one_utm_zone == vt->one_utm_zone && cache->vt.center_zone == vt->center_zone &&
+    cache->vt.xmpp == vt->xmpp && cache->vt.ympp == vt->ympp &&
+    cache->vt.xmfactor == vt->xmfactor && cache->vt.ymfactor == vt->ymfactor &&
+    cache->vt.utm_zone_width == vt->utm_zone_width;
+}
+
+static gboolean cache_is_dirty ( VikViewportCache *cache, gboolean provisional )
+{
+  return g_atomic_int_get ( &cache->dirty ) || ( cache->provisional && !provisional );
+}
+
+/**
+ * Work out how far the view has been panned since the cached drawing in whole pixels
+ * Returns FALSE if it is not a clean shift of the previous drawing
+ *  (whether it would not land on exact pixel boundaries or there is nothing left to reuse)
+ */
+static gboolean cache_get_shift ( VikViewport *vvp, VikViewportCache *cache, const VikViewportTransform *vt, gint *dx, gint *dy )
+{
+  // Where the new center was in the cached drawing, and where the old center is now
+  //  should be the same move in opposite directions
+  const VikCoord *coords[1];
+  gint ox, oy, nx, ny;
+  coords[0] = &vvp->center;
+  vik_viewport_transform_coords ( &cache->vt, coords, 1, &ox, &oy );
+  coords[0] = &cache->center;
+  vik_viewport_transform_coords ( vt, coords, 1, &nx, &ny );
+  *dx = nx - vt->width_2;
+  *dy = ny - vt->height_2;
+  if ( *dx != cache->vt.width_2 - ox || *dy != cache->vt.height_2 - oy )
+    return FALSE;
+  return ABS(*dx) < vvp->width && ABS(*dy) < vvp->height;
+}
+
+/**
+ * Whether drawing via the cache now would shift the previous drawing by dx,dy
+ *  and so only need the newly exposed edges drawn
+ */
+static gboolean cache_would_shift ( VikViewport *vvp, VikViewportCache *cache, gboolean allow_shift, gboolean provisional, gint *dx, gint *dy )
+{
+  VikViewportTransform vt;
+  vik_viewport_get_transform ( vvp, &vt );
+  *dx = *dy = 0;
+  return allow_shift && !cache_is_dirty ( cache, provisional ) && cache_same_scale ( vvp, cache, &vt ) &&
+    cache_get_shift ( vvp, cache, &vt, dx, dy );
+}
+
+/**
+ * Move the cached drawing along by dx,dy in place
+ * (a surface can not be painted onto itself)
+ */
+static void cache_shift_surface ( cairo_surface_t *surface, gint dx, gint dy )
+{
+  cairo_surface_flush ( surface );
+  guchar *data = cairo_image_surface_get_data ( surface );
+  const gint stride = cairo_image_surface_get_stride ( surface );
+  const gint width = cairo_image_surface_get_width ( surface );
+  const gint height = cairo_image_surface_get_height ( surface );
+  // 4 bytes per pixel for ARGB32
+  const gsize bytes = (width - ABS(dx)) * 4;
+  const gint src_x = MAX(0, -dx) * 4;
+  const gint dst_x = MAX(0, dx) * 4;
+  // Rows in the order that doesn't overwrite any yet to be moved
+  if ( dy > 0 ) {
+    for ( gint yy = height-1; yy >= dy; yy-- )
+      memmove ( data + yy*stride + dst_x, data + (yy-dy)*stride + src_x, bytes );
+  }
+  else {
+    for ( gint yy = 0; yy < height+dy; yy++ )
+      memmove ( data + yy*stride + dst_x, data + (yy-dy)*stride + src_x, bytes );
+  }
+  cairo_surface_mark_dirty ( surface );
+}
+
+/**
+ * Add the parts of the view not covered by the previous drawing once shifted by dx,dy
+ */
+static void cache_exposed_path ( cairo_t *cr, gint width, gint height, gint dx, gint dy )
+{
+  if ( dx > 0 )
+    cairo_rectangle ( cr, 0, 0, dx, height );
+  else if ( dx < 0 )
+    cairo_rectangle ( cr, width+dx, 0, -dx, height );
+  if ( dy > 0 )
+    cairo_rectangle ( cr, 0, 0, width, dy );
+  else if ( dy < 0 )
+    cairo_rectangle ( cr, 0, height+dy, width, -dy );
+}
+#endif
+
+/**
+ * vik_viewport_cache_draw:
+ * @allow_shift:  Whether the drawing can be shifted when the view is panned -
+ *                only suitable when what is drawn is fixed to the map (i.e. nothing is positioned relative to the viewport edges)
+ * @provisional:  Whether the view is in the middle of being changed -
+ *                a drawing made now is reused for shifting, but is drawn afresh once the view settles.
+ *                This is for drawing functions that hold off some of their work (e.g. downloads) whilst the view is being moved.
+ * @func:         The actual drawing function
+ *
+ * Draw into the viewport via the cache,
+ *  calling the drawing function (with a clip to the newly exposed area when shifting) only when necessary
+ */
+void vik_viewport_cache_draw ( VikViewport *vvp, VikViewportCache *cache, gboolean allow_shift, gboolean provisional, VikViewportCacheDrawFunc func, gpointer data )
+{
+#if GTK_CHECK_VERSION (3,0,0)
+  g_return_if_fail ( vvp->crt != NULL );
+
+  VikViewportTransform vt;
+  vik_viewport_get_transform ( vvp, &vt );
+
+  gboolean same_scale = !cache_is_dirty ( cache, provisional ) && cache_same_scale ( vvp, cache, &vt );
+
+  if ( same_scale && cache->vt.center_x == vt.center_x && cache->vt.center_y == vt.center_y ) {
+    // Nothing has changed
+    for ( GSList *iter = cache->copyrights; iter; iter = iter->next )
+      vik_viewport_add_copyright ( vvp, iter->data );
+    for ( GSList *iter = cache->logos; iter; iter = iter->next )
+      vik_viewport_add_logo ( vvp, iter->data );
+  }
+  else {
+    gint dx = 0, dy = 0;
+    gboolean shift = allow_shift && same_scale && cache_get_shift ( vvp, cache, &vt, &dx, &dy );
+
+    // The surface is kept from draw to draw, only replaced when the size changes
+    if ( cache->surface &&
+         ( cairo_image_surface_get_width(cache->surface) != vvp->width ||
+           cairo_image_surface_get_height(cache->surface) != vvp->height ) ) {
+      cairo_surface_destroy ( cache->surface );
+      cache->surface = NULL;
+    }
+    if ( !cache->surface )
+      cache->surface = cairo_image_surface_create ( CAIRO_FORMAT_ARGB32, vvp->width, vvp->height );
+    if ( shift )
+      cache_shift_surface ( cache->surface, dx, dy );
+
+    // Cleared beforehand, so any invalidation whilst drawing is not lost
+    g_atomic_int_set ( &cache->dirty, FALSE );
+
+    // Draw straight into the cache, by making it the target of all the GCs for this thread
+    //  (which are otherwise references to the viewport's cairo context)
+    // When shifted the clip limits drawing to the newly exposed parts, see vik_viewport_get_draw_area()
+    cairo_t *cr = cairo_create ( cache->surface );
+    if ( shift ) {
+      cache_exposed_path ( cr, vvp->width, vvp->height, dx, dy );
+      cairo_clip ( cr );
+    }
+    cairo_save ( cr );
+    cairo_set_operator ( cr, CAIRO_OPERATOR_CLEAR );
+    cairo_paint ( cr );
+    cairo_restore ( cr );
+
+    cache_reset_attribution ( cache );
+    vvp->recording = cache;
+    cairo_t *previous = g_private_get ( &thread_target );
+    g_private_set ( &thread_target, cr );
+    func ( data, vvp );
+    g_private_set ( &thread_target, previous );
+    vvp->recording = NULL;
+    cairo_destroy ( cr );
+    cairo_surface_flush ( cache->surface );
+
+    cache->vt = vt;
+    cache->center = vvp->center;
+    cache->width = vvp->width;
+    cache->height = vvp->height;
+    cache->scale = vvp->scale;
+    cache->provisional = provisional;
+  }
+
+  cairo_t *cr = viewport_target ( vvp->crt );
+  cairo_save ( cr );
+  cairo_set_source_surface ( cr, cache->surface, 0, 0 );
+  cairo_paint ( cr );
+  cairo_restore ( cr );
+#else
+  func ( data, vvp );
+#endif
+}
+
+/**
+ * vik_viewport_get_draw_area:
+ * @n_rects: Returns the number of rectangles
+ *
+ * The parts of the view actually being drawn into,
+ *  so drawing functions can skip work for anything outside of them -
+ *  such as when drawing via a cache after the view has been panned, when only the newly exposed edges are wanted.
+ *
+ * Returns: The rectangles in screen coordinates (free with g_free())
+ */
+GdkRectangle *vik_viewport_get_draw_area ( VikViewport *vvp, gint *n_rects )
+{
+  GdkRectangle *rects = NULL;
+  *n_rects = 1;
+#if GTK_CHECK_VERSION (3,0,0)
+  cairo_rectangle_list_t *list = cairo_copy_clip_rectangle_list ( viewport_target(vvp->crt) );
+  // Not representable includes when there is no clip at all
+  if ( list->status == CAIRO_STATUS_SUCCESS ) {
+    *n_rects = list->num_rectangles;
+    rects = g_new ( GdkRectangle, MAX(*n_rects, 1) );
+    for ( gint nn = 0; nn < *n_rects; nn++ ) {
+      rects[nn].x = floor ( list->rectangles[nn].x );
+      rects[nn].y = floor ( list->rectangles[nn].y );
+      rects[nn].width = ceil ( list->rectangles[nn].x + list->rectangles[nn].width ) - rects[nn].x;
+      rects[nn].height = ceil ( list->rectangles[nn].y + list->rectangles[nn].height ) - rects[nn].y;
+    }
+  }
+  cairo_rectangle_list_destroy ( list );
+  if ( rects )
+    return rects;
+#endif
+  rects = g_new ( GdkRectangle, 1 );
+  rects[0].x = 0;
+  rects[0].y = 0;
+  rects[0].width = vvp->width;
+  rects[0].height = vvp->height;
+  return rects;
+}
+
+/**
+ * vik_viewport_draw_area_contains:
+ *
+ * Whether any of the given screen area is within the area from vik_viewport_get_draw_area()
+ */
+gboolean vik_viewport_draw_area_contains ( const GdkRectangle *rects, gint n_rects, gint x, gint y, gint width, gint height )
+{
+  for ( gint nn = 0; nn < n_rects; nn++ )
+    if ( x < rects[nn].x + rects[nn].width && x + width > rects[nn].x &&
+         y < rects[nn].y + rects[nn].height && y + height > rects[nn].y )
+      return TRUE;
+  return FALSE;
+}
+
+/**
+ * vik_viewport_is_off_screen:
+ *
+ * Whether the viewport has been temporarily resized for drawing an image (e.g. to save it),
+ *  rather than what is being shown on the screen
+ */
+gboolean vik_viewport_is_off_screen ( VikViewport *vvp )
+{
+  return vvp->off_screen;
+}
+
+/**
+ * vik_viewport_cache_is_current:
+ *
+ * Whether drawing via the cache now would simply put back the previous drawing
+ *  (i.e. without calling the drawing function at all)
+ */
+gboolean vik_viewport_cache_is_current ( VikViewport *vvp, VikViewportCache *cache, gboolean provisional )
+{
+#if GTK_CHECK_VERSION (3,0,0)
+  VikViewportTransform vt;
+  vik_viewport_get_transform ( vvp, &vt );
+  return !cache_is_dirty ( cache, provisional ) && cache_same_scale ( vvp, cache, &vt ) &&
+    cache->vt.center_x == vt.center_x && cache->vt.center_y == vt.center_y;
+#else
+  return FALSE;
+#endif
+}
+
+struct _VikViewportDrawJob {
+  VikViewport *vvp;
+  VikViewportCacheDrawFunc func;
+  gpointer data;
+#if GTK_CHECK_VERSION (3,0,0)
+  cairo_surface_t *surface;
+#endif
+  gboolean shift; // Only the edges exposed by shifting a cached drawing by dx,dy are drawn
+  gint dx, dy;
+  gboolean done; // Protected by draw_job_mutex
+};
+
+#if GTK_CHECK_VERSION (3,0,0)
+static GThreadPool *draw_pool = NULL;
+static GMutex draw_job_mutex;
+static GCond draw_job_cond;
+
+static void draw_job_run ( VikViewportDrawJob *job, gpointer user_data )
+{
+  cairo_t *cr = cairo_create ( job->surface );
+  if ( job->shift ) {
+    cache_exposed_path ( cr, cairo_image_surface_get_width(job->surface), cairo_image_surface_get_height(job->surface), job->dx, job->dy );
+    cairo_clip ( cr );
+  }
+  g_private_set ( &thread_target, cr );
+  job->func ( job->data, job->vvp );
+  g_private_set ( &thread_target, NULL );
+  cairo_destroy ( cr );
+
+  g_mutex_lock ( &draw_job_mutex );
+  job->done = TRUE;
+  g_cond_broadcast ( &draw_job_cond );
+  g_mutex_unlock ( &draw_job_mutex );
+}
+
+static void draw_job_wait ( VikViewportDrawJob *job )
+{
+  g_mutex_lock ( &draw_job_mutex );
+  while ( !job->done )
+    g_cond_wait ( &draw_job_cond, &draw_job_mutex );
+  g_mutex_unlock ( &draw_job_mutex );
+}
+
+static VikViewportDrawJob *draw_job_start ( VikViewport *vvp, VikViewportCacheDrawFunc func, gpointer data, gboolean shift, gint dx, gint dy )
+{
+  g_return_val_if_fail ( vvp->crt != NULL, NULL );
+
+  if ( !draw_pool ) {
+    gint threads = g_get_num_processors();
+    gint tmp;
+    if ( a_settings_get_integer ( VIK_SETTINGS_VIEW_DRAW_THREADS, &tmp ) && tmp > 0 )
+      threads = tmp;
+    draw_pool = g_thread_pool_new ( (GFunc)draw_job_run, NULL, threads, FALSE, NULL );
+  }
+
+  VikViewportDrawJob *job = g_new0 ( VikViewportDrawJob, 1 );
+  job->vvp = vvp;
+  job->func = func;
+  job->data = data;
+  job->shift = shift;
+  job->dx = dx;
+  job->dy = dy;
+  job->surface = cairo_image_surface_create ( CAIRO_FORMAT_ARGB32, vvp->width, vvp->height );
+  g_thread_pool_push ( draw_pool, job, NULL );
+  return job;
+}
+#endif
+
+/**
+ * vik_viewport_draw_job_start:
+ * @func: The drawing function, which must only draw via the vik_viewport_draw_*() functions
+ *        (or direct drawing with a GC from vik_viewport_get_gc_target())
+ *        and otherwise be safe to run outside of the main thread.
+ *
+ * Start drawing in another thread into its own surface (of the whole viewport).
+ * The viewport must not be changed until the drawing has been finished with vik_viewport_draw_job_free().
+ *
+ * Returns: The drawing in progress, or NULL if not possible (i.e. GTK2), in which case just draw directly.
+ */
+VikViewportDrawJob *vik_viewport_draw_job_start ( VikViewport *vvp, VikViewportCacheDrawFunc func, gpointer data )
+{
+#if GTK_CHECK_VERSION (3,0,0)
+  return draw_job_start ( vvp, func, data, FALSE, 0, 0 );
+#else
+  return NULL;
+#endif
+}
+
+/**
+ * vik_viewport_cache_draw_job_start:
+ *
+ * As vik_viewport_draw_job_start() for drawing that is to go via the cache with vik_viewport_cache_draw_job(),
+ *  so when the view has only been panned just the newly exposed edges are drawn.
+ */
+VikViewportDrawJob *vik_viewport_cache_draw_job_start ( VikViewport *vvp, VikViewportCache *cache, gboolean allow_shift, gboolean provisional,
+                                                        VikViewportCacheDrawFunc func, gpointer data )
+{
+#if GTK_CHECK_VERSION (3,0,0)
+  gint dx, dy;
+  gboolean shift = cache_would_shift ( vvp, cache, allow_shift, provisional, &dx, &dy );
+  return draw_job_start ( vvp, func, data, shift, dx, dy );
+#else
+  return NULL;
+#endif
+}
+
+/**
+ * vik_viewport_cache_draw_job:
+ *
+ * Put the drawing from vik_viewport_cache_draw_job_start() into the viewport via the cache
+ *  (with the same arguments as when it was started).
+ * Should the cache have since changed (e.g. been invalidated), so the drawing of just the edges is not enough,
+ *  then it is drawn afresh instead.
+ */
+void vik_viewport_cache_draw_job ( VikViewport *vvp, VikViewportCache *cache, gboolean allow_shift, gboolean provisional, VikViewportDrawJob *job )
+{
+#if GTK_CHECK_VERSION (3,0,0)
+  gint dx, dy;
+  gboolean shift = cache_would_shift ( vvp, cache, allow_shift, provisional, &dx, &dy );
+  if ( job->shift && !( shift && dx == job->dx && dy == job->dy ) ) {
+    draw_job_wait ( job );
+    vik_viewport_cache_draw ( vvp, cache, allow_shift, provisional, job->func, job->data );
+    return;
+  }
+#endif
+  vik_viewport_cache_draw ( vvp, cache, allow_shift, provisional, (VikViewportCacheDrawFunc)vik_viewport_draw_job_paint, job );
+}
+
+/**
+ * vik_viewport_draw_job_paint:
+ *
+ * Wait for the drawing to complete and then put it into the viewport
+ * (so it can be used as a #VikViewportCacheDrawFunc)
+ */
+void vik_viewport_draw_job_paint ( VikViewportDrawJob *job, VikViewport *vvp )
+{
+#if GTK_CHECK_VERSION (3,0,0)
+  draw_job_wait ( job );
+  cairo_t *cr = viewport_target ( vvp->crt );
+  cairo_save ( cr );
+  cairo_set_source_surface ( cr, job->surface, 0, 0 );
+  cairo_paint ( cr );
+  cairo_restore ( cr );
+#endif
+}
+
+/**
+ * vik_viewport_draw_job_free:
+ *
+ * Wait for the drawing to complete (if it hasn't already) and then discard it
+ */
+void vik_viewport_draw_job_free ( VikViewportDrawJob *job )
+{
+  if ( !job )
+    return;
+#if GTK_CHECK_VERSION (3,0,0)
+  draw_job_wait ( job );
+  cairo_surface_destroy ( job->surface );
+#endif
+  g_free ( job );
+}
+
 VikCoordMode vik_viewport_get_coord_mode ( const VikViewport *vvp )
 {
   g_assert ( vvp );
@@ -1906,6 +2784,7 @@ void vik_viewport_draw_layout ( VikViewport *vvp, GdkGC *gc, gint x, gint y, Pan
 {
   if ( x > -VIK_VIEWPORT_LAYOUT_MAX && x < vvp->width + VIK_VIEWPORT_LAYOUT_MAX && y > -VIK_VIEWPORT_LAYOUT_MAX && y < vvp->height + VIK_VIEWPORT_LAYOUT_MAX ) {
 #if GTK_CHECK_VERSION (3,0,0)
+    gc = viewport_target ( gc );
     if ( gcolor )
       gdk_cairo_set_source_color ( gc, gcolor );
     ui_cr_draw_layout ( gc, x, y, layout );
@@ -2022,6 +2901,8 @@ void vik_viewport_add_copyright ( VikViewport *vp, const gchar *copyright )
       gchar *duple = g_strdup ( copyright );
       vp->copyrights = g_slist_prepend ( vp->copyrights, duple );
     }
+    if ( vp->recording )
+      cache_record_copyright ( vp->recording, copyright );
   }
 }
 
@@ -2043,6 +2924,8 @@ void vik_viewport_add_logo ( VikViewport *vp, const GdkPixbuf *logo )
     {
       vp->logos = g_slist_prepend ( vp->logos, (gpointer)logo );
     }
+    if ( vp->recording )
+      cache_record_logo ( vp->recording, logo );
   }
 }
 
@@ -63,12 +63,35 @@ GType vik_viewport_get_type ();
 VikViewport *vik_viewport_new ();
 void vik_viewport_configure_manually ( VikViewport *vvp, gint width, guint height ); /* for off-screen viewports */
 gboolean vik_viewport_configure ( VikViewport *vp );
+gboolean vik_viewport_is_off_screen ( VikViewport *vvp );
 
 
 /* coordinate transformations */
 void vik_viewport_screen_to_coord ( VikViewport *vvp, int x, int y, VikCoord *coord );
 void vik_viewport_coord_to_screen ( VikViewport *vvp, const VikCoord *coord, int *x, int *y );
 
+/*
+ * A snapshot of the viewport values for converting coordinates to screen positions,
+ *  so many coordinates can be converted at once (and from any thread),
+ *  without looking up the viewport or deciding the projection for each one.
+ * Only valid until the viewport is changed (zoom, center, size or drawmode)
+ */
+typedef struct {
+  VikCoordMode coord_mode;
+  gint drawmode; // VikViewportDrawMode
+  gboolean one_utm_zone;
+  gint width_2, height_2;
+  gdouble xmpp, ympp;
+  gdouble xmfactor, ymfactor;
+  gdouble center_x; // Easting or longitude
+  gdouble center_y; // Northing, latitude or Mercator latitude as per the drawmode
+  gchar center_zone;
+  gdouble utm_zone_width;
+} VikViewportTransform;
+
+void vik_viewport_get_transform ( VikViewport *vvp, VikViewportTransform *vt );
+void vik_viewport_transform_coords ( const VikViewportTransform *vt, const VikCoord * const *coords, guint n, gint *x, gint *y );
+
 
 /* viewport scale */
 void vik_viewport_set_ympp ( VikViewport *vvp, gdouble ympp );
@@ -149,6 +172,7 @@ void vik_viewport_draw_scale ( VikViewport *vvp );
 void vik_viewport_set_draw_scale ( VikViewport *vvp, gboolean draw_scale );
 gboolean vik_viewport_get_draw_scale ( VikViewport *vvp );
 void vik_viewport_draw_copyright ( VikViewport *vvp );
+void vik_viewport_draw_overlay_text ( VikViewport *vvp, const gchar *text );
 void vik_viewport_draw_centermark ( VikViewport *vvp );
 void vik_viewport_set_draw_centermark ( VikViewport *vvp, gboolean draw_centermark );
 gboolean vik_viewport_get_draw_centermark ( VikViewport *vvp );
@@ -183,6 +207,57 @@ void vik_viewport_draw_arc ( VikViewport *vvp, GdkGC *gc, gboolean filled, gint
 void vik_viewport_draw_polygon ( VikViewport *vvp, GdkGC *gc, gboolean filled, GdkPoint *points, gint npoints, GdkColor *gcolor );
 void vik_viewport_draw_layout ( VikViewport *vvp, GdkGC *gc, gint x, gint y, PangoLayout *layout, GdkColor *gcolor );
 
+/*
+ * Shapes collected up so that all those of the same colour are drawn in one go,
+ *  e.g. for GTK3 all the lines of a track are stroked as a single cairo path,
+ *  rather than every line being a separate stroke with the colour and thickness set again.
+ * The same path can be drawn several times, such as for an outline then the line itself.
+ */
+typedef struct _VikViewportPath VikViewportPath;
+
+VikViewportPath *vik_viewport_path_new ();
+void vik_viewport_path_free ( VikViewportPath *path );
+void vik_viewport_path_clear ( VikViewportPath *path );
+gboolean vik_viewport_path_is_empty ( VikViewportPath *path );
+void vik_viewport_path_add_line ( VikViewport *vvp, VikViewportPath *path, gint x1, gint y1, gint x2, gint y2 );
+void vik_viewport_path_add_rectangle ( VikViewport *vvp, VikViewportPath *path, gint x, gint y, gint width, gint height );
+void vik_viewport_path_add_circle ( VikViewportPath *path, gint x, gint y, gint width );
+void vik_viewport_path_add_polygon ( VikViewportPath *path, GdkPoint *points, gint npoints );
+void vik_viewport_stroke_path ( VikViewport *vvp, GdkGC *gc, VikViewportPath *path, GdkColor *gcolor, guint thickness );
+void vik_viewport_fill_path ( VikViewport *vvp, GdkGC *gc, VikViewportPath *path, GdkColor *gcolor );
+
+/*
+ * An offscreen copy of what something (e.g. a layer) drew into the viewport,
+ *  so it can be put back without drawing it again while the view is unchanged,
+ *  or shifted along when the view has only been panned so just the newly exposed edges need drawing.
+ * Any copyrights and logos added whilst drawing are remembered too.
+ * Only for GTK3 - otherwise everything is always drawn afresh.
+ */
+typedef struct _VikViewportCache VikViewportCache;
+typedef void (*VikViewportCacheDrawFunc) ( gpointer data, VikViewport *vvp );
+
+VikViewportCache *vik_viewport_cache_new ();
+void vik_viewport_cache_free ( VikViewportCache *cache );
+void vik_viewport_cache_invalidate ( VikViewportCache *cache );
+void vik_viewport_cache_draw ( VikViewport *vvp, VikViewportCache *cache, gboolean allow_shift, gboolean provisional, VikViewportCacheDrawFunc func, gpointer data );
+gboolean vik_viewport_cache_is_current ( VikViewport *vvp, VikViewportCache *cache, gboolean provisional );
+GdkRectangle *vik_viewport_get_draw_area ( VikViewport *vvp, gint *n_rects );
+gboolean vik_viewport_draw_area_contains ( const GdkRectangle *rects, gint n_rects, gint x, gint y, gint width, gint height );
+
+/*
+ * Drawing in a separate thread into a surface of its own, which is then put into the viewport.
+ * Only for GTK3 - otherwise vik_viewport_draw_job_start() returns NULL and drawing should be done directly.
+ */
+typedef struct _VikViewportDrawJob VikViewportDrawJob;
+
+VikViewportDrawJob *vik_viewport_draw_job_start ( VikViewport *vvp, VikViewportCacheDrawFunc func, gpointer data );
+void vik_viewport_draw_job_paint ( VikViewportDrawJob *job, VikViewport *vvp );
+void vik_viewport_draw_job_free ( VikViewportDrawJob *job );
+VikViewportDrawJob *vik_viewport_cache_draw_job_start ( VikViewport *vvp, VikViewportCache *cache, gboolean allow_shift, gboolean provisional,
+                                                        VikViewportCacheDrawFunc func, gpointer data );
+void vik_viewport_cache_draw_job ( VikViewport *vvp, VikViewportCache *cache, gboolean allow_shift, gboolean provisional, VikViewportDrawJob *job );
+GdkGC *vik_viewport_get_gc_target ( VikViewport *vvp, GdkGC *gc );
+
 void vik_viewport_draw_popup ( VikViewport *vvp, gchar *msg, gint x, gint y );
 
 /* Utilities */
@@ -29,6 +29,7 @@
 #include "vikgoto.h"
 #include "dems.h"
 #include "mapcache.h"
+#include "drawstats.h"
 #include "maputils.h"
 #include "print.h"
 #include "toolbar.h"
@@ -101,6 +102,7 @@ static void center_changed_cb ( VikWindow *vw );
 static gboolean window_configure_event ( VikWindow *vw, GdkEventConfigure *event, gpointer user_data );
 static gboolean draw_sync ( VikWindow *vw );
 static void draw_redraw ( VikWindow *vw );
+static void draw_redraw_screen ( VikWindow *vw );
 static gboolean draw_scroll  ( VikWindow *vw, GdkEventScroll *event );
 static gboolean draw_click  ( VikWindow *vw, GdkEventButton *event );
 static gboolean draw_release ( VikWindow *vw, GdkEventButton *event );
@@ -1813,7 +1815,7 @@ static void newwindow_cb ( GtkAction *a, VikWindow *vw )
 
 static void draw_update ( VikWindow *vw )
 {
-  draw_redraw (vw);
+  draw_redraw_screen (vw);
   (void)draw_sync (vw);
 }
 
@@ -1880,6 +1882,12 @@ static void draw_status ( VikWindow *vw )
     old_zoom_str = g_strdup ( zoom_level );
   }
 
+  gchar *stats = a_drawstats_get_summary ();
+  if ( stats ) {
+    vik_statusbar_set_message ( vw->viking_vs, VIK_STATUSBAR_DRAW, stats );
+    g_free ( stats );
+  }
+
   draw_status_tool ( vw );
 }
 
@@ -1926,7 +1934,7 @@ static gboolean window_configure_event ( VikWindow *vw, GdkEventConfigure *event
   }
 #endif
 
-  draw_redraw ( vw );
+  draw_redraw_screen ( vw );
 
   if ( first ) {
     // This is a hack to initialize the cursor to the corresponding tool
@@ -1981,6 +1989,23 @@ static void draw_redraw ( VikWindow *vw )
   vik_viewport_draw_logo ( vw->viking_vvp );
 }
 
+/**
+ * Redraw for showing on screen (as opposed to saving to an image),
+ *  so this is what is measured for the draw statistics
+ */
+static void draw_redraw_screen ( VikWindow *vw )
+{
+  a_drawstats_frame_start ();
+  draw_redraw ( vw );
+  a_drawstats_frame_end ();
+
+  if ( a_drawstats_show_overlay() ) {
+    gchar *report = a_drawstats_get_report ();
+    vik_viewport_draw_overlay_text ( vw->viking_vvp, report );
+    g_free ( report );
+  }
+}
+
 gboolean draw_buf_done = TRUE;
 
 #if !GTK_CHECK_VERSION (3,0,0)
@@ -4331,9 +4356,14 @@ static void help_cache_info_cb ( GtkAction *a, VikWindow *vw )
   // NB: No i18n as this is just for debug
   guint byte_size = a_mapcache_get_size();
   gchar *msg_sz = g_format_size_full ( byte_size, G_FORMAT_SIZE_LONG_FORMAT );
-  gchar *msg = g_strdup_printf ( "Map Cache size is %s with %d items", msg_sz, a_mapcache_get_count());
+  gchar *msg_esz = g_format_size_full ( a_mapcache_get_encoded_size(), G_FORMAT_SIZE_LONG_FORMAT );
+  gchar *msg = g_strdup_printf ( "Map Cache size is %s with %u items (hits %u, misses %u)\n"
+                                 "Compressed tiles size is %s with %u items (hits %u, misses %u)",
+                                 msg_sz, a_mapcache_get_count(), a_mapcache_get_hits(), a_mapcache_get_misses(),
+                                 msg_esz, a_mapcache_get_encoded_count(), a_mapcache_get_encoded_hits(), a_mapcache_get_encoded_misses() );
   a_dialog_info_msg_extra ( GTK_WINDOW(vw), "%s", msg );
   g_free ( msg_sz );
+  g_free ( msg_esz );
   g_free ( msg );
 }
 
@@ -31,10 +31,12 @@
 #endif
 
 #include <math.h>
+#include <string.h>
 
 #include "globals.h"
 #include "vikwmscmapsource.h"
 #include "maputils.h"
+#include "ui_util.h"
 
 static gboolean _coord_to_mapcoord ( VikMapSource *self, const VikCoord *src, gdouble xzoom, gdouble yzoom, MapCoord *dest );
 static void _mapcoord_to_center_coord ( VikMapSource *self, MapCoord *src, VikCoord *dest );
@@ -54,6 +56,9 @@ static gchar *_get_hostname( VikMapSourceDefault *self );
 static DownloadFileOptions *_get_download_options( VikMapSourceDefault *self, MapCoord *src );
 static void _set_expiry_age( VikMapSourceDefault *self, guint age );
 
+static DownloadResult_t _download_bytes ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *handle, DownloadBytesFunc func, gpointer user_data );
+static gboolean _download_multi_add_bytes ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *multi, DownloadBytesFunc func, gpointer user_data );
+
 typedef struct _VikWmscMapSourcePrivate VikWmscMapSourcePrivate;
 struct _VikWmscMapSourcePrivate
 {
@@ -67,6 +72,10 @@ struct _VikWmscMapSourcePrivate
   gdouble lat_max; // Degrees
   gdouble lon_min; // Degrees
   gdouble lon_max; // Degrees
+  guint metatile_size; // Number of tiles along each side of a single GetMap request
+  GMutex metatile_mutex;
+  GCond metatile_cond;
+  GHashTable *metatiles; // Blocks in progress or with tiles not yet handed out, keyed by scale:x:y
 };
 
 G_DEFINE_TYPE_WITH_PRIVATE (VikWmscMapSource, vik_wmsc_map_source, VIK_TYPE_MAP_SOURCE_DEFAULT);
@@ -90,8 +99,36 @@ enum
   PROP_LAT_MAX,
   PROP_LON_MIN,
   PROP_LON_MAX,
+  PROP_METATILE_SIZE,
 };
 
+// How long tiles cut from a block are kept waiting for the rest of them to be requested
+#define METATILE_KEEP_SECS 60
+
+typedef struct {
+	gint ref_count;
+	VikWmscMapSource *source;
+	gchar *key;
+	MapCoord origin;
+	guint cols;
+	guint rows;
+	gboolean pending;
+	void *multi; // The concurrent download the block is part of, NULL when downloaded directly
+	DownloadResult_t result;
+	GBytes **tiles; // Encoded tiles, each NULL once handed out
+	guint remaining;
+	gint64 finished;
+	GSList *waiters; // of WmscTileRequest
+} WmscMetatile;
+
+typedef struct {
+	MapCoord mc;
+	gchar *fn;
+	DownloadBytesFunc func;
+	gpointer user_data;
+	gboolean origin; // The request that caused the block to be downloaded
+} WmscTileRequest;
+
 static void
 vik_wmsc_map_source_init (VikWmscMapSource *self)
 {
@@ -114,6 +151,10 @@ vik_wmsc_map_source_init (VikWmscMapSource *self)
   priv->lat_max = 90.0;
   priv->lon_min = -180.0;
   priv->lon_max = 180.0;
+  priv->metatile_size = 1;
+  g_mutex_init (&priv->metatile_mutex);
+  g_cond_init (&priv->metatile_cond);
+  priv->metatiles = NULL;
 
   g_object_set (G_OBJECT (self),
                 "tilesize-x", 256,
@@ -139,6 +180,11 @@ vik_wmsc_map_source_finalize (GObject *object)
   priv->options.user_agent = NULL;
   g_free (priv->options.custom_http_headers);
   priv->options.custom_http_headers = NULL;
+  if (priv->metatiles)
+    g_hash_table_destroy (priv->metatiles);
+  priv->metatiles = NULL;
+  g_mutex_clear (&priv->metatile_mutex);
+  g_cond_clear (&priv->metatile_cond);
 
   G_OBJECT_CLASS (vik_wmsc_map_source_parent_class)->finalize (object);
 }
@@ -217,6 +263,10 @@ vik_wmsc_map_source_set_property (GObject      *object,
       priv->lon_max = g_value_get_double (value);
       break;
 
+    case PROP_METATILE_SIZE:
+      priv->metatile_size = g_value_get_uint (value);
+      break;
+
     default:
       /* We don't have any other property... */
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -286,6 +336,10 @@ vik_wmsc_map_source_get_property (GObject    *object,
       g_value_set_double (value, priv->lat_max);
       break;
 
+    case PROP_METATILE_SIZE:
+      g_value_set_uint (value, priv->metatile_size);
+      break;
+
     default:
       /* We don't have any other property... */
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -317,6 +371,8 @@ vik_wmsc_map_source_class_init (VikWmscMapSourceClass *klass)
 	grandparent_class->get_lat_max = _get_lat_max;
 	grandparent_class->get_lon_min = _get_lon_min;
 	grandparent_class->get_lon_max = _get_lon_max;
+	grandparent_class->download_bytes = _download_bytes;
+	grandparent_class->download_multi_add_bytes = _download_multi_add_bytes;
 
 	parent_class->get_uri = _get_uri;
 	parent_class->get_hostname = _get_hostname;
@@ -428,6 +484,15 @@ vik_wmsc_map_source_class_init (VikWmscMapSourceClass *klass)
 	                             G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_LON_MAX, pspec);
 
+	pspec = g_param_spec_uint ("metatile-size",
+	                           "Metatile size",
+	                           "Number of tiles along each side of the block requested from the server at once",
+	                           1,  // minimum value
+	                           16, // maximum value
+	                           1,  // default value
+	                           G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_METATILE_SIZE, pspec);
+
 	object_class->finalize = vik_wmsc_map_source_finalize;
 }
 
@@ -501,22 +566,23 @@ _mapcoord_to_center_coord ( VikMapSource *self, MapCoord *src, VikCoord *dest )
           src->x, src->y, dest->east_west, dest->north_south);
 }
 
+/**
+ * The URI for the area covered by @cols x @rows tiles from @src
+ */
 static gchar *
-_get_uri( VikMapSourceDefault *self, MapCoord *src )
+get_uri_for_area ( VikWmscMapSourcePrivate *priv, MapCoord *src, guint cols, guint rows )
 {
-	g_return_val_if_fail (VIK_IS_WMSC_MAP_SOURCE(self), NULL);
-    VikWmscMapSourcePrivate *priv = VIK_WMSC_MAP_SOURCE_PRIVATE(self);
 	gdouble socalled_mpp;
 	if (src->scale >= 0)
 		socalled_mpp = VIK_GZ(src->scale);
 	else
 		socalled_mpp = 1.0/VIK_GZ(-src->scale);
 	gdouble minx = (gdouble)src->x * 180 / VIK_GZ(17) * socalled_mpp * 2 - 180;
-	gdouble maxx = (gdouble)(src->x + 1) * 180 / VIK_GZ(17) * socalled_mpp * 2 - 180;
+	gdouble maxx = (gdouble)(src->x + cols) * 180 / VIK_GZ(17) * socalled_mpp * 2 - 180;
 	/* We should restore logic of viking:
      * tile index on Y axis follow a screen logic (top -> down)
      */
-	gdouble miny = -((gdouble)(src->y + 1) * 180 / VIK_GZ(17) * socalled_mpp * 2 - 90);
+	gdouble miny = -((gdouble)(src->y + rows) * 180 / VIK_GZ(17) * socalled_mpp * 2 - 90);
 	gdouble maxy = -((gdouble)(src->y) * 180 / VIK_GZ(17) * socalled_mpp * 2 - 90);
 
 	gchar sminx[COORDS_STR_BUFFER_SIZE];
@@ -537,6 +603,14 @@ _get_uri( VikMapSourceDefault *self, MapCoord *src )
 	return uri;
 }
 
+static gchar *
+_get_uri( VikMapSourceDefault *self, MapCoord *src )
+{
+	g_return_val_if_fail (VIK_IS_WMSC_MAP_SOURCE(self), NULL);
+	VikWmscMapSourcePrivate *priv = VIK_WMSC_MAP_SOURCE_PRIVATE(self);
+	return get_uri_for_area ( priv, src, 1, 1 );
+}
+
 static gchar *
 _get_hostname( VikMapSourceDefault *self )
 {
@@ -645,6 +719,415 @@ _set_expiry_age (VikMapSourceDefault *self, guint age)
 	priv->options.expiry_age = age;
 }
 
+/*
+ * Metatiles
+ *
+ * Rather than a GetMap request per tile, a block of metatile-size x metatile-size tiles
+ *  is requested as one larger image, which is then cut up into the individual tiles.
+ * The tiles of a block not asked for by the request that downloaded it are kept for a while,
+ *  so the requests for them (which normally follow straight away for the rest of the view)
+ *  are answered without going to the server again.
+ * Requests for tiles of a block whilst it is being downloaded wait for it rather than making their own.
+ */
+
+/**
+ * Whether blocks can be used, i.e. the tiles are only checked by decoding them
+ */
+static gboolean
+metatile_enabled ( VikWmscMapSourcePrivate *priv )
+{
+	return priv->metatile_size > 1 && priv->url &&
+		priv->options.convert_file == NULL &&
+		(priv->options.check_file == NULL || priv->options.check_file == a_check_map_file);
+}
+
+/**
+ * The block containing @src, clipped to the edges of the world
+ */
+static void
+metatile_get_area ( VikWmscMapSourcePrivate *priv, MapCoord *src, MapCoord *origin, guint *cols, guint *rows )
+{
+	gdouble socalled_mpp;
+	if (src->scale >= 0)
+		socalled_mpp = VIK_GZ(src->scale);
+	else
+		socalled_mpp = 1.0/VIK_GZ(-src->scale);
+	// Whole world is 360 degrees wide and 180 degrees high
+	gint width = (gint)ceil ( VIK_GZ(17) / socalled_mpp );
+	gint height = (gint)ceil ( VIK_GZ(17) / socalled_mpp / 2 );
+	gint size = priv->metatile_size;
+
+	*origin = *src;
+	origin->x = src->x - (src->x % size);
+	origin->y = src->y - (src->y % size);
+	*cols = CLAMP ( width - origin->x, 1, size );
+	*rows = CLAMP ( height - origin->y, 1, size );
+}
+
+/**
+ * The GetMap URI for the block, with the image size asked for made to match
+ */
+static gchar *
+metatile_get_uri ( VikWmscMapSource *self, WmscMetatile *mt )
+{
+	VikWmscMapSourcePrivate *priv = VIK_WMSC_MAP_SOURCE_PRIVATE(self);
+	gchar *uri = get_uri_for_area ( priv, &mt->origin, mt->cols, mt->rows );
+	if ( !uri )
+		return NULL;
+
+	gchar *width = g_strdup_printf ( "\\g<1>%d", mt->cols * vik_map_source_get_tilesize_x ( VIK_MAP_SOURCE(self) ) );
+	gchar *height = g_strdup_printf ( "\\g<1>%d", mt->rows * vik_map_source_get_tilesize_y ( VIK_MAP_SOURCE(self) ) );
+	GRegex *rw = g_regex_new ( "([?&]WIDTH=)[0-9]+", G_REGEX_CASELESS, 0, NULL );
+	GRegex *rh = g_regex_new ( "([?&]HEIGHT=)[0-9]+", G_REGEX_CASELESS, 0, NULL );
+	gchar *tmp = g_regex_replace ( rw, uri, -1, 0, width, 0, NULL );
+	gchar *result = tmp ? g_regex_replace ( rh, tmp, -1, 0, height, 0, NULL ) : NULL;
+	g_regex_unref ( rw );
+	g_regex_unref ( rh );
+	g_free ( tmp );
+	g_free ( width );
+	g_free ( height );
+	g_free ( uri );
+	return result;
+}
+
+static WmscMetatile *
+metatile_ref ( WmscMetatile *mt )
+{
+	g_atomic_int_inc ( &mt->ref_count );
+	return mt;
+}
+
+static void
+metatile_unref ( gpointer data )
+{
+	WmscMetatile *mt = data;
+	if ( !g_atomic_int_dec_and_test ( &mt->ref_count ) )
+		return;
+	if ( mt->tiles ) {
+		for ( guint ii = 0; ii < mt->cols * mt->rows; ii++ )
+			if ( mt->tiles[ii] )
+				g_bytes_unref ( mt->tiles[ii] );
+		g_free ( mt->tiles );
+	}
+	g_free ( mt->key );
+	g_free ( mt );
+}
+
+static void
+tile_request_free ( WmscTileRequest *req )
+{
+	g_free ( req->fn );
+	g_free ( req );
+}
+
+static WmscTileRequest *
+tile_request_new ( MapCoord *mc, const gchar *fn, DownloadBytesFunc func, gpointer user_data, gboolean origin )
+{
+	WmscTileRequest *req = g_malloc0 ( sizeof(WmscTileRequest) );
+	req->mc = *mc;
+	req->fn = g_strdup ( fn );
+	req->func = func;
+	req->user_data = user_data;
+	req->origin = origin;
+	return req;
+}
+
+static gboolean
+metatile_expired ( gpointer key, gpointer value, gpointer user_data )
+{
+	WmscMetatile *mt = value;
+	return !mt->pending && mt->finished < *(gint64*)user_data;
+}
+
+/**
+ * Find the block for a tile, forgetting any old blocks on the way.
+ * A block from which this tile has already been handed out is also forgotten,
+ *  as the tile is evidently wanted again.
+ * Call with the metatile mutex held
+ */
+static WmscMetatile *
+metatile_lookup ( VikWmscMapSourcePrivate *priv, MapCoord *mc, const gchar *key )
+{
+	if ( !priv->metatiles )
+		priv->metatiles = g_hash_table_new_full ( g_str_hash, g_str_equal, NULL, metatile_unref );
+
+	gint64 oldest = g_get_monotonic_time () - METATILE_KEEP_SECS * G_USEC_PER_SEC;
+	g_hash_table_foreach_remove ( priv->metatiles, metatile_expired, &oldest );
+
+	WmscMetatile *mt = g_hash_table_lookup ( priv->metatiles, key );
+	if ( mt && !mt->pending ) {
+		guint idx = (mc->y - mt->origin.y) * mt->cols + (mc->x - mt->origin.x);
+		if ( !mt->tiles || !mt->tiles[idx] ) {
+			g_hash_table_remove ( priv->metatiles, key );
+			mt = NULL;
+		}
+	}
+	return mt;
+}
+
+/**
+ * Create a block for downloading and make it known to other requests.
+ * Call with the metatile mutex held
+ */
+static WmscMetatile *
+metatile_new ( VikWmscMapSource *self, MapCoord *mc, gchar *key, void *multi )
+{
+	VikWmscMapSourcePrivate *priv = VIK_WMSC_MAP_SOURCE_PRIVATE(self);
+	WmscMetatile *mt = g_malloc0 ( sizeof(WmscMetatile) );
+	// One reference for the hash table and one for the download
+	mt->ref_count = 2;
+	mt->source = self;
+	mt->key = key;
+	metatile_get_area ( priv, mc, &mt->origin, &mt->cols, &mt->rows );
+	mt->pending = TRUE;
+	mt->multi = multi;
+	g_hash_table_insert ( priv->metatiles, mt->key, mt );
+	return mt;
+}
+
+/**
+ * Take the tile out of the block.
+ * Call with the metatile mutex held
+ */
+static GBytes *
+metatile_take ( VikWmscMapSourcePrivate *priv, WmscMetatile *mt, MapCoord *mc )
+{
+	if ( !mt->tiles )
+		return NULL;
+	guint idx = (mc->y - mt->origin.y) * mt->cols + (mc->x - mt->origin.x);
+	GBytes *bytes = mt->tiles[idx];
+	mt->tiles[idx] = NULL;
+	if ( bytes && --mt->remaining == 0 && g_hash_table_lookup ( priv->metatiles, mt->key ) == mt )
+		g_hash_table_remove ( priv->metatiles, mt->key );
+	return bytes;
+}
+
+/**
+ * Cut the downloaded image into the encoded tiles
+ */
+static GBytes **
+metatile_slice ( VikWmscMapSource *self, WmscMetatile *mt, GBytes *bytes )
+{
+	GError *error = NULL;
+	GdkPixbuf *pixbuf = ui_pixbuf_new_from_bytes ( bytes, &error );
+	if ( !pixbuf ) {
+		g_warning ( "%s: %s", __FUNCTION__, error ? error->message : "decode failed" );
+		if ( error )
+			g_error_free ( error );
+		return NULL;
+	}
+
+	gint tsx = vik_map_source_get_tilesize_x ( VIK_MAP_SOURCE(self) );
+	gint tsy = vik_map_source_get_tilesize_y ( VIK_MAP_SOURCE(self) );
+	gint width = mt->cols * tsx;
+	gint height = mt->rows * tsy;
+	if ( gdk_pixbuf_get_width(pixbuf) != width || gdk_pixbuf_get_height(pixbuf) != height ) {
+		// Server did not honour the size requested
+		GdkPixbuf *scaled = gdk_pixbuf_scale_simple ( pixbuf, width, height, GDK_INTERP_BILINEAR );
+		g_object_unref ( pixbuf );
+		pixbuf = scaled;
+	}
+
+	const gchar *ext = vik_map_source_get_file_extension ( VIK_MAP_SOURCE(self) );
+	const gchar *type = ( ext && (strstr ( ext, "jpg" ) || strstr ( ext, "jpeg" )) ) ? "jpeg" : "png";
+
+	GBytes **tiles = g_malloc0 ( mt->cols * mt->rows * sizeof(GBytes*) );
+	for ( guint yy = 0; yy < mt->rows; yy++ ) {
+		for ( guint xx = 0; xx < mt->cols; xx++ ) {
+			GdkPixbuf *sub = gdk_pixbuf_new_subpixbuf ( pixbuf, xx * tsx, yy * tsy, tsx, tsy );
+			gchar *buffer = NULL;
+			gsize size = 0;
+			if ( gdk_pixbuf_save_to_buffer ( sub, &buffer, &size, type, &error, NULL ) )
+				tiles[yy * mt->cols + xx] = g_bytes_new_take ( buffer, size );
+			else {
+				g_warning ( "%s: %s", __FUNCTION__, error->message );
+				g_clear_error ( &error );
+			}
+			g_object_unref ( sub );
+		}
+	}
+	g_object_unref ( pixbuf );
+	return tiles;
+}
+
+/**
+ * Hand the tile over in the same way as a download of it would
+ */
+static void
+tile_request_deliver ( WmscTileRequest *req, DownloadResult_t result, GBytes *bytes )
+{
+	a_download_deliver_bytes ( req->fn, result, bytes, req->func, req->user_data );
+	if ( bytes )
+		g_bytes_unref ( bytes );
+}
+
+/**
+ * Answer a request for a tile from a block that has finished downloading
+ * @multi or @handle are for downloading the tile by itself if necessary
+ */
+static DownloadResult_t
+metatile_serve ( WmscMetatile *mt, WmscTileRequest *req, void *multi, void *handle )
+{
+	VikWmscMapSourcePrivate *priv = VIK_WMSC_MAP_SOURCE_PRIVATE(mt->source);
+	VikMapSourceClass *klass = VIK_MAP_SOURCE_CLASS(vik_wmsc_map_source_parent_class);
+
+	g_mutex_lock ( &priv->metatile_mutex );
+	GBytes *bytes = metatile_take ( priv, mt, &req->mc );
+	g_mutex_unlock ( &priv->metatile_mutex );
+
+	// The block failing to come with any content (e.g. no newer version on the server than the first tile's file)
+	//  says nothing about the other tiles, so they are downloaded individually
+	if ( !bytes && !req->origin && (mt->result == DOWNLOAD_SUCCESS || mt->result == DOWNLOAD_NOT_REQUIRED) ) {
+		if ( multi ) {
+			(void)klass->download_multi_add_bytes ( VIK_MAP_SOURCE(mt->source), &req->mc, req->fn, multi, req->func, req->user_data );
+			return DOWNLOAD_SUCCESS;
+		}
+		return klass->download_bytes ( VIK_MAP_SOURCE(mt->source), &req->mc, req->fn, handle, req->func, req->user_data );
+	}
+	DownloadResult_t result = bytes ? DOWNLOAD_SUCCESS : mt->result;
+	tile_request_deliver ( req, result, bytes );
+	return result;
+}
+
+/**
+ * Block downloaded (or not) - cut it up and answer the requests waiting for it
+ */
+static gboolean
+metatile_download_done ( DownloadResult_t result, GBytes *bytes, gpointer user_data )
+{
+	WmscMetatile *mt = user_data;
+	VikWmscMapSourcePrivate *priv = VIK_WMSC_MAP_SOURCE_PRIVATE(mt->source);
+
+	GBytes **tiles = NULL;
+	if ( bytes && result == DOWNLOAD_SUCCESS ) {
+		tiles = metatile_slice ( mt->source, mt, bytes );
+		if ( !tiles )
+			result = DOWNLOAD_CONTENT_ERROR;
+	}
+
+	g_mutex_lock ( &priv->metatile_mutex );
+	mt->tiles = tiles;
+	mt->result = result;
+	mt->remaining = 0;
+	if ( tiles )
+		for ( guint ii = 0; ii < mt->cols * mt->rows; ii++ )
+			if ( tiles[ii] )
+				mt->remaining++;
+	mt->pending = FALSE;
+	mt->finished = g_get_monotonic_time ();
+	// Nothing to keep for later requests
+	if ( mt->remaining == 0 && g_hash_table_lookup ( priv->metatiles, mt->key ) == mt )
+		g_hash_table_remove ( priv->metatiles, mt->key );
+	GSList *waiters = g_slist_reverse ( mt->waiters );
+	mt->waiters = NULL;
+	g_cond_broadcast ( &priv->metatile_cond );
+	g_mutex_unlock ( &priv->metatile_mutex );
+
+	for ( GSList *iter = waiters; iter; iter = iter->next ) {
+		(void)metatile_serve ( mt, iter->data, mt->multi, NULL );
+		tile_request_free ( iter->data );
+	}
+	g_slist_free ( waiters );
+	metatile_unref ( mt );
+
+	// The tiles are saved individually
+	return FALSE;
+}
+
+static gchar *
+metatile_key ( VikWmscMapSourcePrivate *priv, MapCoord *src )
+{
+	gint size = priv->metatile_size;
+	return g_strdup_printf ( "%d:%d:%d", src->scale, src->x - (src->x % size), src->y - (src->y % size) );
+}
+
+static DownloadResult_t
+_download_bytes ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *handle, DownloadBytesFunc func, gpointer user_data )
+{
+	VikWmscMapSourcePrivate *priv = VIK_WMSC_MAP_SOURCE_PRIVATE(self);
+	VikMapSourceClass *klass = VIK_MAP_SOURCE_CLASS(vik_wmsc_map_source_parent_class);
+	if ( !metatile_enabled ( priv ) )
+		return klass->download_bytes ( self, src, dest_fn, handle, func, user_data );
+
+	gchar *key = metatile_key ( priv, src );
+	g_mutex_lock ( &priv->metatile_mutex );
+	WmscMetatile *mt = metatile_lookup ( priv, src, key );
+	if ( mt ) {
+		// Wait for the block to finish downloading
+		metatile_ref ( mt );
+		while ( mt->pending )
+			g_cond_wait ( &priv->metatile_cond, &priv->metatile_mutex );
+		g_mutex_unlock ( &priv->metatile_mutex );
+		g_free ( key );
+
+		WmscTileRequest req = { *src, (gchar*)dest_fn, func, user_data, FALSE };
+		DownloadResult_t result = metatile_serve ( mt, &req, NULL, handle );
+		metatile_unref ( mt );
+		return result;
+	}
+
+	mt = metatile_new ( VIK_WMSC_MAP_SOURCE(self), src, key, NULL );
+	mt->waiters = g_slist_prepend ( mt->waiters, tile_request_new ( src, dest_fn, func, user_data, TRUE ) );
+	g_mutex_unlock ( &priv->metatile_mutex );
+
+	gchar *uri = metatile_get_uri ( VIK_WMSC_MAP_SOURCE(self), mt );
+	gchar *host = vik_map_source_default_get_hostname ( VIK_MAP_SOURCE_DEFAULT(self) );
+	DownloadFileOptions *options = vik_map_source_default_get_download_options ( VIK_MAP_SOURCE_DEFAULT(self), src );
+	// NB The block is used for the requests (and released) by metatile_download_done()
+	DownloadResult_t result = a_http_download_get_url_bytes ( host, uri, dest_fn, options, handle, metatile_download_done, mt );
+	a_download_file_options_free ( options );
+	g_free ( uri );
+	g_free ( host );
+	return result;
+}
+
+static gboolean
+_download_multi_add_bytes ( VikMapSource *self, MapCoord *src, const gchar *dest_fn, void *multi, DownloadBytesFunc func, gpointer user_data )
+{
+	VikWmscMapSourcePrivate *priv = VIK_WMSC_MAP_SOURCE_PRIVATE(self);
+	VikMapSourceClass *klass = VIK_MAP_SOURCE_CLASS(vik_wmsc_map_source_parent_class);
+	if ( !metatile_enabled ( priv ) )
+		return klass->download_multi_add_bytes ( self, src, dest_fn, multi, func, user_data );
+
+	gchar *key = metatile_key ( priv, src );
+	g_mutex_lock ( &priv->metatile_mutex );
+	WmscMetatile *mt = metatile_lookup ( priv, src, key );
+	if ( mt ) {
+		g_free ( key );
+		if ( mt->pending ) {
+			// Only wait on a block that this same set of concurrent downloads is getting,
+			//  as it can't make progress whilst this is blocked
+			gboolean same = mt->multi == multi;
+			if ( same )
+				mt->waiters = g_slist_prepend ( mt->waiters, tile_request_new ( src, dest_fn, func, user_data, FALSE ) );
+			g_mutex_unlock ( &priv->metatile_mutex );
+			if ( !same )
+				return klass->download_multi_add_bytes ( self, src, dest_fn, multi, func, user_data );
+			return TRUE;
+		}
+		metatile_ref ( mt );
+		g_mutex_unlock ( &priv->metatile_mutex );
+
+		WmscTileRequest req = { *src, (gchar*)dest_fn, func, user_data, FALSE };
+		(void)metatile_serve ( mt, &req, multi, NULL );
+		metatile_unref ( mt );
+		return TRUE;
+	}
+
+	mt = metatile_new ( VIK_WMSC_MAP_SOURCE(self), src, key, multi );
+	mt->waiters = g_slist_prepend ( mt->waiters, tile_request_new ( src, dest_fn, func, user_data, TRUE ) );
+	g_mutex_unlock ( &priv->metatile_mutex );
+
+	gchar *uri = metatile_get_uri ( VIK_WMSC_MAP_SOURCE(self), mt );
+	gchar *host = vik_map_source_default_get_hostname ( VIK_MAP_SOURCE_DEFAULT(self) );
+	// NB The options are freed by the download once complete
+	DownloadFileOptions *options = vik_map_source_default_get_download_options ( VIK_MAP_SOURCE_DEFAULT(self), src );
+	a_http_download_multi_add_bytes ( multi, host, uri, dest_fn, options, metatile_download_done, mt );
+	g_free ( uri );
+	g_free ( host );
+	return TRUE;
+}
+
 VikWmscMapSource *
 vik_wmsc_map_source_new_with_id (guint16 id, const gchar *label, const gchar *hostname, const gchar *url)
 {
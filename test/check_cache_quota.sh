@@ -0,0 +1,4 @@
+#!/bin/sh
+# Copyright: CC0
+# The map cache size limit preference is applied to the cache directory of a loaded map layer
+./test_cache_quota
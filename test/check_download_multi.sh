@@ -0,0 +1,4 @@
+#!/bin/sh
+# Copyright: CC0
+# Concurrent downloads from a local HTTP server are all delivered, and aborted ones leave nothing behind
+./test_download_multi
@@ -0,0 +1,4 @@
+#!/bin/sh
+# Copyright: CC0
+# Simplified tracks keep their ends and only drop points within the tolerance
+./test_track_lod
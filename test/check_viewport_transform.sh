@@ -0,0 +1,4 @@
+#!/bin/sh
+# Copyright: CC0
+# Converting coordinates in one go must give the same screen positions as one at a time
+./test_viewport_transform
@@ -0,0 +1,4 @@
+#!/bin/sh
+# Copyright: CC0
+# WMS tiles fetched in blocks from a local server are cut from a single GetMap image
+./test_wms_block
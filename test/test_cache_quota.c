@@ -0,0 +1,117 @@
+// Copyright: CC0
+//
+// Test program to check the map cache size limit preference
+//  is applied to the cache directory of a map layer when it is loaded
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+#include "viklayer.h"
+#include "viklayer_defaults.h"
+#include "vikmapslayer.h"
+#include "settings.h"
+#include "preferences.h"
+#include "download.h"
+#include "globals.h"
+#include "file.h"
+#include "modules.h"
+#include "toolbar.h"
+#include "cachequota.h"
+
+#define QUOTA_MB 3
+
+int main(int argc, char *argv[])
+{
+#if GTK_CHECK_VERSION (3,0,0)
+  gtk_init ( NULL, NULL );
+#endif
+
+  a_settings_init ();
+  a_preferences_init ();
+  a_vik_preferences_init ();
+  a_layer_defaults_init ();
+  a_download_init();
+  modules_init();
+  maps_layer_init ();
+  a_cache_quota_init ();
+  a_toolbar_init();
+
+  int result = 0;
+
+  VikLayerParamData *pref = a_preferences_get ( VIKING_PREFERENCES_NAMESPACE "maplayer_cache_quota" );
+  if ( !pref ) {
+    fprintf ( stderr, "FAILED: maplayer_cache_quota preference not registered\n" );
+    return 1;
+  }
+  pref->u = QUOTA_MB;
+
+  gchar *dir = g_dir_make_tmp ( "viking-quota-XXXXXX", NULL );
+  gchar *tile = g_build_filename ( dir, "tile.png", NULL );
+  (void)g_file_set_contents ( tile, "1234", 4, NULL );
+
+  // OSM Mapnik tiles stored in the temporary directory
+  gchar *vik = g_strdup_printf ( "#VIKING GPS Data file\n~Layer Map\nname=Quota\nmode=13\ndirectory=%s\nautodownload=f\n~EndLayer\n", dir );
+  FILE *ff = fmemopen ( vik, strlen(vik), "r" );
+
+  VikAggregateLayer* agg = vik_aggregate_layer_new ( NULL );
+#if GTK_CHECK_VERSION (3,0,0)
+  VikWindow *vw = vik_window_new_window();
+  VikViewport* vp = vik_window_viewport(vw);
+#else
+  VikViewport* vp = vik_viewport_new ();
+#endif
+  VikLoadType_t lt = a_file_load_stream ( ff, NULL, agg, vp, NULL, TRUE, FALSE, NULL, "NotUsedName" );
+  fclose ( ff );
+  if ( lt < LOAD_TYPE_VIK_FAILURE_NON_FATAL ) {
+    fprintf ( stderr, "FAILED: Could not load map layer\n" );
+    result++;
+  }
+
+  // The directory is scanned in the background
+  gchar *cache_dir = g_strconcat ( dir, G_DIR_SEPARATOR_S, NULL );
+  guint64 used = 0, quota = 0;
+  guint files = 0;
+  gboolean known = FALSE;
+  for ( int ii = 0; ii < 100 && !known; ii++ ) {
+    known = a_cache_quota_get_usage ( cache_dir, &used, &quota, &files );
+    if ( !known )
+      g_usleep ( 50000 );
+  }
+  if ( !known ) {
+    fprintf ( stderr, "FAILED: Cache directory %s not tracked\n", cache_dir );
+    result++;
+  }
+  else {
+    if ( quota != (guint64)QUOTA_MB * 1024 * 1024 ) {
+      fprintf ( stderr, "FAILED: Quota %" G_GUINT64_FORMAT " not %d MB\n", quota, QUOTA_MB );
+      result++;
+    }
+    if ( files != 1 || used != 4 ) {
+      fprintf ( stderr, "FAILED: Usage %" G_GUINT64_FORMAT " bytes in %d files\n", used, files );
+      result++;
+    }
+  }
+
+  g_object_unref ( agg );
+
+  a_cache_quota_uninit ();
+  a_toolbar_uninit ();
+  a_download_uninit();
+  a_layer_defaults_uninit ();
+  a_preferences_uninit ();
+  a_settings_uninit ();
+
+  // Remove the tile and any access times saved alongside it
+  (void)g_remove ( tile );
+  gchar *sidecar = g_build_filename ( dir, ".viking_tile_access", NULL );
+  (void)g_remove ( sidecar );
+  (void)g_rmdir ( dir );
+  g_free ( sidecar );
+  g_free ( cache_dir );
+  g_free ( vik );
+  g_free ( tile );
+  g_free ( dir );
+
+  return result;
+}
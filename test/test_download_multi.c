@@ -0,0 +1,254 @@
+// Copyright: CC0
+//
+// Test program to check concurrent downloads via a_download_multi_*() against a local HTTP server:
+//  all the tiles are delivered (with some in parallel, but no more than the connection limit)
+//  aborted downloads are reported as such, leaving no files behind,
+//  and content recently stored elsewhere is not downloaded again.
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "download.h"
+#include "curl_download.h"
+#include "settings.h"
+#include "preferences.h"
+
+#define TILES 8
+#define MAX_CONNECTIONS 3
+#define SLOW_TILES 3
+
+static int failures = 0;
+
+static void check ( gboolean ok, const gchar *what )
+{
+  if ( !ok ) {
+    fprintf ( stderr, "FAILED: %s\n", what );
+    failures++;
+  }
+}
+
+/*
+ * Minimal HTTP server
+ *  /tile/N - responds with 'tile N' after a short delay
+ *  /slow/N - only responds after the downloads have been aborted
+ */
+static gint connections = 0;
+static gint max_connections = 0;
+static gint served = 0;
+static volatile gint aborted = 0;
+
+static gpointer serve_connection ( gpointer data )
+{
+  GSocket *client = data;
+  gint now = g_atomic_int_add ( &connections, 1 ) + 1;
+  gint max = g_atomic_int_get ( &max_connections );
+  while ( now > max && !g_atomic_int_compare_and_exchange ( &max_connections, max, now ) )
+    max = g_atomic_int_get ( &max_connections );
+
+  GString *request = g_string_new ( NULL );
+  gchar buf[1024];
+  while ( !strstr ( request->str, "\r\n\r\n" ) ) {
+    gssize len = g_socket_receive ( client, buf, sizeof(buf), NULL, NULL );
+    if ( len <= 0 )
+      break;
+    g_string_append_len ( request, buf, len );
+  }
+
+  gchar *path = NULL;
+  gchar **parts = g_strsplit ( request->str, " ", 3 );
+  if ( parts[0] && parts[1] )
+    path = g_strdup ( parts[1] );
+  g_strfreev ( parts );
+
+  if ( path && g_str_has_prefix ( path, "/slow/" ) ) {
+    while ( !g_atomic_int_get ( &aborted ) )
+      g_usleep ( 10000 );
+  }
+  else
+    g_usleep ( 100000 );
+
+  gchar *body = path ? g_strdup_printf ( "tile %s", strrchr(path, '/') + 1 ) : g_strdup ( "" );
+  gchar *response = g_strdup_printf ( "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n%s", strlen(body), body );
+  g_atomic_int_add ( &connections, -1 );
+  (void)g_socket_send ( client, response, strlen(response), NULL, NULL );
+  if ( path && g_str_has_prefix ( path, "/tile/" ) )
+    g_atomic_int_inc ( &served );
+
+  g_free ( response );
+  g_free ( body );
+  g_free ( path );
+  g_string_free ( request, TRUE );
+  (void)g_socket_close ( client, NULL );
+  g_object_unref ( client );
+  return NULL;
+}
+
+static gpointer serve ( gpointer data )
+{
+  GSocket *listener = data;
+  GSocket *client;
+  while ( (client = g_socket_accept ( listener, NULL, NULL )) )
+    g_thread_unref ( g_thread_new ( "connection", serve_connection, client ) );
+  return NULL;
+}
+
+static guint16 server_start ()
+{
+  GSocket *listener = g_socket_new ( G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL );
+  GInetAddress *loopback = g_inet_address_new_loopback ( G_SOCKET_FAMILY_IPV4 );
+  GSocketAddress *address = g_inet_socket_address_new ( loopback, 0 );
+  if ( !listener || !g_socket_bind ( listener, address, TRUE, NULL ) || !g_socket_listen ( listener, NULL ) )
+    return 0;
+  g_object_unref ( address );
+  g_object_unref ( loopback );
+
+  address = g_socket_get_local_address ( listener, NULL );
+  guint16 port = g_inet_socket_address_get_port ( G_INET_SOCKET_ADDRESS(address) );
+  g_object_unref ( address );
+  g_thread_unref ( g_thread_new ( "server", serve, listener ) );
+  return port;
+}
+
+typedef struct {
+  gint index;
+  gboolean called;
+  DownloadResult_t result;
+  gboolean content_ok;
+} TileResult;
+
+static gboolean tile_done ( DownloadResult_t result, GBytes *bytes, gpointer user_data )
+{
+  TileResult *tr = user_data;
+  tr->called = TRUE;
+  tr->result = result;
+  if ( bytes ) {
+    gchar *expected = g_strdup_printf ( "tile %d", tr->index );
+    gsize len = 0;
+    const gchar *data = g_bytes_get_data ( bytes, &len );
+    tr->content_ok = len == strlen(expected) && !strncmp ( data, expected, len );
+    g_free ( expected );
+  }
+  return tr->content_ok;
+}
+
+static void file_done ( DownloadResult_t result, gpointer user_data )
+{
+  TileResult *tr = user_data;
+  tr->called = TRUE;
+  tr->result = result;
+}
+
+int main ( int argc, char *argv[] )
+{
+  a_settings_init ();
+  a_preferences_init ();
+  a_download_init ();
+  curl_download_init ();
+
+  guint16 port = server_start ();
+  if ( !port ) {
+    fprintf ( stderr, "FAILED: Could not start local server\n" );
+    return 1;
+  }
+  gchar *host = g_strdup_printf ( "127.0.0.1:%d", port );
+  gchar *dir = g_dir_make_tmp ( "viking-download-XXXXXX", NULL );
+  gchar *fn[TILES];
+  TileResult results[TILES];
+  gint ii;
+
+  // All tiles are delivered, with several at once
+  void *multi = a_download_multi_new ( MAX_CONNECTIONS );
+  for ( ii = 0; ii < TILES; ii++ ) {
+    results[ii] = (TileResult){ ii, FALSE, DOWNLOAD_HTTP_ERROR, FALSE };
+    fn[ii] = g_strdup_printf ( "%s%ctile%d.png", dir, G_DIR_SEPARATOR, ii );
+    gchar *uri = g_strdup_printf ( "/tile/%d", ii );
+    a_http_download_multi_add_bytes ( multi, host, uri, fn[ii], NULL, tile_done, &results[ii] );
+    g_free ( uri );
+  }
+  while ( a_download_multi_perform ( multi, 100 ) > 0 );
+  a_download_multi_free ( multi );
+
+  for ( ii = 0; ii < TILES; ii++ ) {
+    gchar *what = g_strdup_printf ( "tile %d delivered", ii );
+    check ( results[ii].called && results[ii].result == DOWNLOAD_SUCCESS && results[ii].content_ok, what );
+    g_free ( what );
+  }
+  check ( g_atomic_int_get(&served) == TILES, "each tile requested once" );
+  check ( g_atomic_int_get(&max_connections) > 1, "downloads made concurrently" );
+  check ( g_atomic_int_get(&max_connections) <= MAX_CONNECTIONS, "connection limit kept" );
+
+  // Content stored elsewhere recently enough is treated as an existing file, so is not downloaded again
+  DownloadFileOptions *opt = g_malloc0 ( sizeof(DownloadFileOptions) );
+  opt->expiry_age = ONE_WEEK_SECS;
+  gchar *stored_fn = g_strdup_printf ( "%s%cstored.png", dir, G_DIR_SEPARATOR );
+  TileResult stored = { 0, FALSE, DOWNLOAD_HTTP_ERROR, FALSE };
+  a_download_set_stored_time ( stored_fn, time(NULL) );
+  multi = a_download_multi_new ( MAX_CONNECTIONS );
+  a_http_download_multi_add_bytes ( multi, host, "/tile/0", stored_fn, opt, tile_done, &stored );
+  while ( a_download_multi_perform ( multi, 100 ) > 0 );
+  a_download_multi_free ( multi );
+  check ( stored.called && stored.result == DOWNLOAD_NOT_REQUIRED, "recently stored tile not downloaded" );
+  check ( g_atomic_int_get(&served) == TILES, "no request for a recently stored tile" );
+  check ( !g_file_test ( stored_fn, G_FILE_TEST_EXISTS ), "no file for a recently stored tile" );
+  g_free ( stored_fn );
+
+  // Aborting downloads in progress reports them as aborted and leaves nothing behind
+  TileResult slow[SLOW_TILES];
+  gchar *slow_fn[SLOW_TILES];
+  multi = a_download_multi_new ( MAX_CONNECTIONS );
+  for ( ii = 0; ii < SLOW_TILES; ii++ ) {
+    slow[ii] = (TileResult){ ii, FALSE, DOWNLOAD_SUCCESS, FALSE };
+    slow_fn[ii] = g_strdup_printf ( "%s%cslow%d.png", dir, G_DIR_SEPARATOR, ii );
+    gchar *uri = g_strdup_printf ( "/slow/%d", ii );
+    // Alternately via memory and via a temporary file
+    if ( ii % 2 )
+      a_http_download_multi_add ( multi, host, uri, slow_fn[ii], NULL, file_done, &slow[ii] );
+    else
+      a_http_download_multi_add_bytes ( multi, host, uri, slow_fn[ii], NULL, tile_done, &slow[ii] );
+    g_free ( uri );
+  }
+  for ( ii = 0; ii < 5; ii++ )
+    (void)a_download_multi_perform ( multi, 100 );
+  a_download_multi_free ( multi );
+  g_atomic_int_set ( &aborted, 1 );
+
+  for ( ii = 0; ii < SLOW_TILES; ii++ ) {
+    gchar *what = g_strdup_printf ( "slow tile %d aborted", ii );
+    check ( slow[ii].called && slow[ii].result == DOWNLOAD_USER_ABORTED, what );
+    g_free ( what );
+  }
+
+  // Wait for the content to be written
+  a_download_uninit ();
+
+  for ( ii = 0; ii < TILES; ii++ ) {
+    gchar *contents = NULL;
+    gchar *expected = g_strdup_printf ( "tile %d", ii );
+    check ( g_file_get_contents ( fn[ii], &contents, NULL, NULL ) && !g_strcmp0 ( contents, expected ), "tile saved" );
+    (void)g_remove ( fn[ii] );
+    g_free ( contents );
+    g_free ( expected );
+    g_free ( fn[ii] );
+  }
+  for ( ii = 0; ii < SLOW_TILES; ii++ ) {
+    gchar *tmp = g_strdup_printf ( "%s.tmp", slow_fn[ii] );
+    check ( !g_file_test ( slow_fn[ii], G_FILE_TEST_EXISTS ) && !g_file_test ( tmp, G_FILE_TEST_EXISTS ), "nothing left by aborted download" );
+    (void)g_remove ( tmp );
+    (void)g_remove ( slow_fn[ii] );
+    g_free ( tmp );
+    g_free ( slow_fn[ii] );
+  }
+  if ( g_rmdir ( dir ) != 0 )
+    check ( FALSE, "no other files created" );
+
+  curl_download_uninit ();
+  a_preferences_uninit ();
+  a_settings_uninit ();
+  g_free ( dir );
+  g_free ( host );
+
+  return failures;
+}
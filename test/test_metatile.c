@@ -29,7 +29,116 @@
 #include <errno.h>
 #include <fcntl.h>
 
+#include <glib.h>
+
 #include "metatile.h"
+#include "metatilecache.h"
+#include "settings.h"
+
+/**
+ * Check indexing the whole metatile in memory finds the same tile as metatile_read()
+ *  and that damaged files are rejected
+ */
+static int check_index ( const char *dir, int x, int y, int z, const char *tile, int tile_len )
+{
+    char path[PATH_MAX];
+    char err_msg[PATH_MAX];
+    int offsets[METATILE_TILES];
+    int sizes[METATILE_TILES];
+    int compressed;
+    int failures = 0;
+    gchar *contents = NULL;
+    gsize len = 0;
+    size_t end = 0;
+    int ii;
+
+    int offset = xyz_to_meta(path, sizeof(path), dir, x, y, z);
+    if (!g_file_get_contents(path, &contents, &len, NULL)) {
+        fprintf(stderr, "FAILED: Could not read %s\n", path);
+        return 1;
+    }
+
+    err_msg[0] = 0;
+    if (metatile_index(contents, len, offsets, sizes, &compressed, err_msg) != 0) {
+        fprintf(stderr, "FAILED: index: %s\n", err_msg);
+        g_free(contents);
+        return 1;
+    }
+    if (sizes[offset] != tile_len || memcmp(contents + offsets[offset], tile, tile_len)) {
+        fprintf(stderr, "FAILED: indexed tile %d differs from the tile read\n", offset);
+        failures++;
+    }
+    for (ii = 0; ii < METATILE_TILES; ii++)
+        if ((size_t)offsets[ii] + sizes[ii] > end)
+            end = offsets[ii] + sizes[ii];
+
+    // Too small for the header
+    if (metatile_index(contents, 8, offsets, sizes, &compressed, err_msg) != -3) {
+        fprintf(stderr, "FAILED: short header accepted\n");
+        failures++;
+    }
+    // Truncated within the tile data
+    if (metatile_index(contents, end - 1, offsets, sizes, &compressed, err_msg) != -6) {
+        fprintf(stderr, "FAILED: truncated file accepted\n");
+        failures++;
+    }
+    // Not a metatile
+    contents[0] = 'X';
+    if (metatile_index(contents, len, offsets, sizes, &compressed, err_msg) != -4) {
+        fprintf(stderr, "FAILED: bad magic accepted\n");
+        failures++;
+    }
+
+    g_free(contents);
+    return failures;
+}
+
+/**
+ * Check the tile sliced from the kept metatile matches the tile read directly,
+ *  both on first reading the file and when it is already kept
+ */
+static int check_cache ( const char *dir, int x, int y, int z, const char *tile, int tile_len )
+{
+    int failures = 0;
+    int ii;
+
+    a_settings_init();
+    a_metatile_cache_init();
+    for (ii = 0; ii < 2; ii++) {
+        gboolean compressed = FALSE;
+        GError *error = NULL;
+        GBytes *bytes = a_metatile_cache_get(dir, x, y, z, &compressed, &error);
+        if (!bytes) {
+            fprintf(stderr, "FAILED: cache get: %s\n", error ? error->message : "");
+            if (error)
+                g_error_free(error);
+            failures++;
+            continue;
+        }
+        gsize size = 0;
+        gconstpointer data = g_bytes_get_data(bytes, &size);
+        if (size != (gsize)tile_len || memcmp(data, tile, tile_len)) {
+            fprintf(stderr, "FAILED: cached tile differs from the tile read (pass %d)\n", ii);
+            failures++;
+        }
+        g_bytes_unref(bytes);
+    }
+
+    // A metatile that does not exist
+    GError *error = NULL;
+    GBytes *none = a_metatile_cache_get(dir, x, y, 99, NULL, &error);
+    if (none) {
+        fprintf(stderr, "FAILED: tile from a missing metatile\n");
+        g_bytes_unref(none);
+        failures++;
+    }
+    if (error)
+        g_error_free(error);
+
+    a_metatile_cache_uninit();
+    a_settings_uninit();
+    return failures;
+}
 
 int main ( int argc, char *argv[] )
 {
@@ -62,6 +171,9 @@ int main ( int argc, char *argv[] )
       len = metatile_read(dir, x, y, z, buf, tile_max, &compressed, err_msg);
 
     if (len > 0) {
+        const char *base = argc > 1 ? argv[1] : dir;
+        int failures = check_index(base, x, y, z, buf, len) + check_cache(base, x, y, z, buf, len);
+
         // Do something with buf
         // Just dump to a file
         FILE *fp;
@@ -78,7 +190,7 @@ int main ( int argc, char *argv[] )
           fprintf(stderr, "Failed to open file because: %s\n", strerror(errno));
 
         free(buf);
-        return 0;
+        return failures ? 2 : 0;
     }
     else
         fprintf(stderr, "FAILED: %s\n", err_msg);
@@ -0,0 +1,122 @@
+// Copyright: CC0
+//
+// Test program to check the simplified versions of tracks from vik_track_get_lod()
+
+#include <glib.h>
+#include <glib/gprintf.h>
+#include <stdio.h>
+#include "viktrack.h"
+
+#define N_POINTS 300
+
+static int failures = 0;
+
+static void check ( gboolean ok, const gchar *what )
+{
+  if ( !ok ) {
+    (void)g_fprintf ( stderr, "FAILED: %s\n", what );
+    failures++;
+  }
+}
+
+static void add_point ( VikTrack *tr, gdouble easting, gdouble northing, gboolean newsegment )
+{
+  VikTrackpoint *tp = vik_trackpoint_new ();
+  tp->coord.mode = VIK_COORD_UTM;
+  tp->coord.east_west = 500000.0 + easting;
+  tp->coord.north_south = 5600000.0 + northing;
+  tp->coord.utm_zone = 30;
+  tp->coord.utm_letter = 'U';
+  tp->newsegment = newsegment;
+  vik_track_add_trackpoint ( tr, tp, FALSE );
+}
+
+static gboolean lod_contains ( VikTrackpoint **tps, guint n, VikTrackpoint *tp )
+{
+  for ( guint ii = 0; ii < n; ii++ )
+    if ( tps[ii] == tp )
+      return TRUE;
+  return FALSE;
+}
+
+// A straight line of evenly spaced points is just its ends
+static void test_collinear ( void )
+{
+  VikTrack *tr = vik_track_new ();
+  for ( guint ii = 0; ii < N_POINTS; ii++ )
+    add_point ( tr, ii * 10.0, ii * 5.0, FALSE );
+
+  guint n = 0;
+  VikTrackpoint **tps = vik_track_get_lod ( tr, VIK_TRACK_LOD_UTM, 1.0, &n );
+  check ( tps != NULL, "collinear track is simplified" );
+  if ( tps ) {
+    check ( n == 2, "collinear run collapses to its ends" );
+    check ( tps[0] == g_list_first(tr->trackpoints)->data, "collinear first point kept" );
+    check ( tps[n-1] == g_list_last(tr->trackpoints)->data, "collinear last point kept" );
+  }
+  vik_track_free ( tr );
+}
+
+// Wobbles smaller than the tolerance are dropped, but larger deviations are kept
+static void test_tolerance ( void )
+{
+  VikTrack *tr = vik_track_new ();
+  for ( guint ii = 0; ii < N_POINTS; ii++ ) {
+    gdouble offset = (ii % 2) ? 0.2 : -0.2;
+    if ( ii == N_POINTS/3 )
+      offset = 100.0;
+    add_point ( tr, ii * 10.0, offset, FALSE );
+  }
+  VikTrackpoint *spike = g_list_nth_data ( tr->trackpoints, N_POINTS/3 );
+
+  guint n = 0;
+  VikTrackpoint **tps = vik_track_get_lod ( tr, VIK_TRACK_LOD_UTM, 4.0, &n );
+  check ( tps != NULL, "noisy track is simplified" );
+  if ( tps ) {
+    check ( n < 10, "points within the tolerance dropped" );
+    check ( lod_contains ( tps, n, spike ), "point beyond the tolerance kept" );
+    check ( tps[0] == g_list_first(tr->trackpoints)->data, "noisy first point kept" );
+    check ( tps[n-1] == g_list_last(tr->trackpoints)->data, "noisy last point kept" );
+  }
+  vik_track_free ( tr );
+}
+
+// The ends of each segment are always kept
+static void test_segments ( void )
+{
+  VikTrack *tr = vik_track_new ();
+  for ( guint ii = 0; ii < N_POINTS; ii++ )
+    add_point ( tr, ii * 10.0, 0.0, ii == N_POINTS/2 );
+  VikTrackpoint *seg_end = g_list_nth_data ( tr->trackpoints, N_POINTS/2 - 1 );
+  VikTrackpoint *seg_start = g_list_nth_data ( tr->trackpoints, N_POINTS/2 );
+
+  guint n = 0;
+  VikTrackpoint **tps = vik_track_get_lod ( tr, VIK_TRACK_LOD_UTM, 1.0, &n );
+  check ( tps != NULL, "segmented track is simplified" );
+  if ( tps ) {
+    check ( n == 4, "each segment collapses to its ends" );
+    check ( lod_contains ( tps, n, seg_end ), "end of the first segment kept" );
+    check ( lod_contains ( tps, n, seg_start ), "start of the second segment kept" );
+  }
+  vik_track_free ( tr );
+}
+
+// Small tracks are always drawn in full
+static void test_small ( void )
+{
+  VikTrack *tr = vik_track_new ();
+  for ( guint ii = 0; ii < 10; ii++ )
+    add_point ( tr, ii * 10.0, 0.0, FALSE );
+  guint n = 0;
+  check ( vik_track_get_lod ( tr, VIK_TRACK_LOD_UTM, 1.0, &n ) == NULL, "small track not simplified" );
+  vik_track_free ( tr );
+}
+
+int main ( int argc, char *argv[] )
+{
+  test_collinear ();
+  test_tolerance ();
+  test_segments ();
+  test_small ();
+  return failures ? 1 : 0;
+}
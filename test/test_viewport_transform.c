@@ -0,0 +1,88 @@
+// Copyright: CC0
+//
+// Test program to check converting coordinates in one go via a VikViewportTransform
+//  gives the same screen positions as converting each one with vik_viewport_coord_to_screen()
+
+#include <gtk/gtk.h>
+#include <glib/gprintf.h>
+#include <stdio.h>
+#include "vikviewport.h"
+#include "settings.h"
+#include "preferences.h"
+#include "globals.h"
+
+// Positions around the centre of the view, including ones far enough away to be in other UTM zones
+static const struct LatLon positions[] = {
+  { 51.178, -1.826 },
+  { 51.0, -2.0 },
+  { 52.5, 0.5 },
+  { 50.0, -6.5 },
+  { 49.5, 2.5 },
+  { 60.0, -1.2 },
+  { -33.9, 151.2 },
+  { 0.0, 0.0 },
+  { 85.0, 179.9 },
+  { -85.0, -179.9 },
+};
+#define N_POSITIONS (sizeof(positions)/sizeof(positions[0]))
+
+static int check_drawmode ( VikViewport *vvp, VikViewportDrawMode drawmode, const gchar *name, gdouble mpp )
+{
+  int failures = 0;
+  vik_viewport_set_drawmode ( vvp, drawmode );
+  vik_viewport_set_center_latlon ( vvp, &positions[0], FALSE );
+  vik_viewport_set_zoom ( vvp, mpp );
+
+  VikCoord coords[N_POSITIONS];
+  const VikCoord *pcoords[N_POSITIONS];
+  for ( guint ii = 0; ii < N_POSITIONS; ii++ ) {
+    vik_coord_load_from_latlon ( &coords[ii], vik_viewport_get_coord_mode(vvp), &positions[ii] );
+    pcoords[ii] = &coords[ii];
+  }
+
+  VikViewportTransform vt;
+  vik_viewport_get_transform ( vvp, &vt );
+  gint xs[N_POSITIONS], ys[N_POSITIONS];
+  vik_viewport_transform_coords ( &vt, pcoords, N_POSITIONS, xs, ys );
+
+  for ( guint ii = 0; ii < N_POSITIONS; ii++ ) {
+    gint x, y;
+    vik_viewport_coord_to_screen ( vvp, &coords[ii], &x, &y );
+    if ( x != xs[ii] || y != ys[ii] ) {
+      (void)g_fprintf ( stderr, "%s at %.1f m/pixel: %f,%f transformed to %d,%d but should be %d,%d\n",
+                        name, mpp, positions[ii].lat, positions[ii].lon, xs[ii], ys[ii], x, y );
+      failures++;
+    }
+  }
+  return failures;
+}
+
+int main ( int argc, char *argv[] )
+{
+  gtk_init ( &argc, &argv );
+
+  // Some stuff must be initialized as it gets auto used
+  a_settings_init ();
+  a_preferences_init ();
+  a_vik_preferences_init ();
+
+  VikViewport *vvp = vik_viewport_new ();
+
+  int failures = 0;
+  // Both close in (a single UTM zone) and far out (multiple zones)
+  gdouble mpps[] = { 1.0, 16.0, 1024.0, 32768.0 };
+  for ( guint ii = 0; ii < sizeof(mpps)/sizeof(mpps[0]); ii++ ) {
+    failures += check_drawmode ( vvp, VIK_VIEWPORT_DRAWMODE_UTM, "UTM", mpps[ii] );
+    failures += check_drawmode ( vvp, VIK_VIEWPORT_DRAWMODE_MERCATOR, "Mercator", mpps[ii] );
+    failures += check_drawmode ( vvp, VIK_VIEWPORT_DRAWMODE_LATLON, "Lat/Lon", mpps[ii] );
+  }
+
+  g_object_ref_sink ( vvp );
+  g_object_unref ( vvp );
+
+  a_vik_preferences_uninit ();
+  a_preferences_uninit ();
+  a_settings_uninit ();
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,259 @@
+// Copyright: CC0
+//
+// Test program to check WMS tiles fetched in blocks against a local server:
+//  a single GetMap request (sized for the whole block) answers every tile of the block,
+//  with each tile being the matching part of the image.
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vikwmscmapsource.h"
+#include "download.h"
+#include "curl_download.h"
+#include "settings.h"
+#include "preferences.h"
+
+#define TILE_SIZE 256
+#define BLOCK 2
+#define SCALE 10
+
+static int failures = 0;
+
+static void check ( gboolean ok, const gchar *what )
+{
+  if ( !ok ) {
+    fprintf ( stderr, "FAILED: %s\n", what );
+    failures++;
+  }
+}
+
+/*
+ * Minimal WMS server, answering each GetMap request with an image of the size asked for.
+ * Each tile sized square of the image is a different colour:
+ *  red for the column and green for the row
+ */
+static gint getmaps = 0;
+static gchar *last_query = NULL;
+static GMutex server_mutex;
+
+static guint32 tile_colour ( gint col, gint row )
+{
+  return ((guint32)(40 + col * 100) << 24) | ((guint32)(40 + row * 100) << 16) | 0xff;
+}
+
+static gint query_value ( const gchar *query, const gchar *name )
+{
+  gchar *find = g_strdup_printf ( "%s=", name );
+  const gchar *pos = strstr ( query, find );
+  g_free ( find );
+  return pos ? atoi ( pos + strlen(name) + 1 ) : 0;
+}
+
+static gpointer serve_connection ( gpointer data )
+{
+  GSocket *client = data;
+  GString *request = g_string_new ( NULL );
+  gchar buf[1024];
+  while ( !strstr ( request->str, "\r\n\r\n" ) ) {
+    gssize len = g_socket_receive ( client, buf, sizeof(buf), NULL, NULL );
+    if ( len <= 0 )
+      break;
+    g_string_append_len ( request, buf, len );
+  }
+
+  gchar **parts = g_strsplit ( request->str, " ", 3 );
+  gchar *query = g_strdup ( parts[0] && parts[1] ? parts[1] : "" );
+  g_strfreev ( parts );
+
+  gint width = query_value ( query, "WIDTH" );
+  gint height = query_value ( query, "HEIGHT" );
+  gchar *image = NULL;
+  gsize size = 0;
+  if ( width > 0 && height > 0 ) {
+    GdkPixbuf *pixbuf = gdk_pixbuf_new ( GDK_COLORSPACE_RGB, TRUE, 8, width, height );
+    for ( gint yy = 0; yy * TILE_SIZE < height; yy++ )
+      for ( gint xx = 0; xx * TILE_SIZE < width; xx++ ) {
+        GdkPixbuf *sub = gdk_pixbuf_new_subpixbuf ( pixbuf, xx * TILE_SIZE, yy * TILE_SIZE,
+                                                    MIN(TILE_SIZE, width - xx * TILE_SIZE), MIN(TILE_SIZE, height - yy * TILE_SIZE) );
+        gdk_pixbuf_fill ( sub, tile_colour ( xx, yy ) );
+        g_object_unref ( sub );
+      }
+    (void)gdk_pixbuf_save_to_buffer ( pixbuf, &image, &size, "png", NULL, NULL );
+    g_object_unref ( pixbuf );
+  }
+
+  g_mutex_lock ( &server_mutex );
+  getmaps++;
+  g_free ( last_query );
+  last_query = g_strdup ( query );
+  g_mutex_unlock ( &server_mutex );
+
+  gchar *header = g_strdup_printf ( "HTTP/1.1 %s\r\nContent-Type: image/png\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                                    image ? "200 OK" : "400 Bad Request", size );
+  (void)g_socket_send ( client, header, strlen(header), NULL, NULL );
+  if ( image )
+    (void)g_socket_send ( client, image, size, NULL, NULL );
+
+  g_free ( header );
+  g_free ( image );
+  g_free ( query );
+  g_string_free ( request, TRUE );
+  (void)g_socket_close ( client, NULL );
+  g_object_unref ( client );
+  return NULL;
+}
+
+static gpointer serve ( gpointer data )
+{
+  GSocket *listener = data;
+  GSocket *client;
+  while ( (client = g_socket_accept ( listener, NULL, NULL )) )
+    g_thread_unref ( g_thread_new ( "connection", serve_connection, client ) );
+  return NULL;
+}
+
+static guint16 server_start ()
+{
+  GSocket *listener = g_socket_new ( G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL );
+  GInetAddress *loopback = g_inet_address_new_loopback ( G_SOCKET_FAMILY_IPV4 );
+  GSocketAddress *address = g_inet_socket_address_new ( loopback, 0 );
+  if ( !listener || !g_socket_bind ( listener, address, TRUE, NULL ) || !g_socket_listen ( listener, NULL ) )
+    return 0;
+  g_object_unref ( address );
+  g_object_unref ( loopback );
+
+  address = g_socket_get_local_address ( listener, NULL );
+  guint16 port = g_inet_socket_address_get_port ( G_INET_SOCKET_ADDRESS(address) );
+  g_object_unref ( address );
+  g_thread_unref ( g_thread_new ( "server", serve, listener ) );
+  return port;
+}
+
+static gint server_getmaps ()
+{
+  g_mutex_lock ( &server_mutex );
+  gint count = getmaps;
+  g_mutex_unlock ( &server_mutex );
+  return count;
+}
+
+typedef struct {
+  MapCoord mc;
+  gboolean called;
+  DownloadResult_t result;
+  gboolean tile_ok;
+} TileResult;
+
+/**
+ * Check the tile is the part of the block image for its position
+ */
+static gboolean tile_done ( DownloadResult_t result, GBytes *bytes, gpointer user_data )
+{
+  TileResult *tr = user_data;
+  tr->called = TRUE;
+  tr->result = result;
+  if ( !bytes )
+    return FALSE;
+
+  GInputStream *stream = g_memory_input_stream_new_from_bytes ( bytes );
+  GdkPixbuf *pixbuf = gdk_pixbuf_new_from_stream ( stream, NULL, NULL );
+  g_object_unref ( stream );
+  if ( !pixbuf )
+    return FALSE;
+
+  guint32 expected = tile_colour ( tr->mc.x % BLOCK, tr->mc.y % BLOCK );
+  guchar *pixel = gdk_pixbuf_get_pixels ( pixbuf ) + (TILE_SIZE / 2) * gdk_pixbuf_get_rowstride ( pixbuf )
+                  + (TILE_SIZE / 2) * gdk_pixbuf_get_n_channels ( pixbuf );
+  tr->tile_ok = gdk_pixbuf_get_width ( pixbuf ) == TILE_SIZE &&
+                gdk_pixbuf_get_height ( pixbuf ) == TILE_SIZE &&
+                pixel[0] == (expected >> 24) && pixel[1] == ((expected >> 16) & 0xff);
+  g_object_unref ( pixbuf );
+  return FALSE;
+}
+
+static void tile_result_init ( TileResult *tr, gint x, gint y )
+{
+  memset ( tr, 0, sizeof(TileResult) );
+  tr->mc.x = x;
+  tr->mc.y = y;
+  tr->mc.scale = SCALE;
+  tr->result = DOWNLOAD_HTTP_ERROR;
+}
+
+static void check_tile ( TileResult *tr )
+{
+  gchar *what = g_strdup_printf ( "tile %d,%d cut from the block", tr->mc.x, tr->mc.y );
+  check ( tr->called && tr->result == DOWNLOAD_SUCCESS && tr->tile_ok, what );
+  g_free ( what );
+}
+
+int main ( int argc, char *argv[] )
+{
+  a_settings_init ();
+  a_preferences_init ();
+  a_download_init ();
+  curl_download_init ();
+
+  guint16 port = server_start ();
+  if ( !port ) {
+    fprintf ( stderr, "FAILED: Could not start local server\n" );
+    return 1;
+  }
+  gchar *host = g_strdup_printf ( "127.0.0.1:%d", port );
+  gchar *dir = g_dir_make_tmp ( "viking-wms-XXXXXX", NULL );
+  gchar *fn = g_build_filename ( dir, "tile.png", NULL );
+
+  VikWmscMapSource *wms = vik_wmsc_map_source_new_with_id ( 9999, "Test WMS", host,
+    "/wms?SERVICE=WMS&VERSION=1.1.1&REQUEST=GetMap&LAYERS=test&SRS=EPSG:4326&BBOX=%s,%s,%s,%s&WIDTH=256&HEIGHT=256&FORMAT=image/png" );
+  g_object_set ( wms, "metatile-size", BLOCK, NULL );
+  VikMapSource *map = VIK_MAP_SOURCE(wms);
+
+  // Concurrent downloads of all the tiles of a block make a single request
+  TileResult results[BLOCK * BLOCK];
+  void *multi = a_download_multi_new ( 4 );
+  for ( gint ii = 0; ii < BLOCK * BLOCK; ii++ ) {
+    tile_result_init ( &results[ii], 4 + ii % BLOCK, 6 + ii / BLOCK );
+    (void)vik_map_source_download_multi_add_bytes ( map, &results[ii].mc, fn, multi, tile_done, &results[ii] );
+  }
+  while ( a_download_multi_perform ( multi, 100 ) > 0 );
+  a_download_multi_free ( multi );
+
+  for ( gint ii = 0; ii < BLOCK * BLOCK; ii++ )
+    check_tile ( &results[ii] );
+  check ( server_getmaps() == 1, "one GetMap request for a block" );
+  g_mutex_lock ( &server_mutex );
+  gchar *size = g_strdup_printf ( "WIDTH=%d&HEIGHT=%d", BLOCK * TILE_SIZE, BLOCK * TILE_SIZE );
+  check ( last_query && strstr ( last_query, size ), "GetMap sized for the whole block" );
+  g_free ( size );
+  g_mutex_unlock ( &server_mutex );
+
+  // Direct downloads of the rest of a block use the tiles kept from the first one
+  void *handle = vik_map_source_download_handle_init ( map );
+  for ( gint ii = 0; ii < BLOCK * BLOCK; ii++ ) {
+    tile_result_init ( &results[ii], 8 + ii % BLOCK, 6 + ii / BLOCK );
+    (void)vik_map_source_download_bytes ( map, &results[ii].mc, fn, handle, tile_done, &results[ii] );
+    check_tile ( &results[ii] );
+  }
+  vik_map_source_download_handle_cleanup ( map, handle );
+  check ( server_getmaps() == 2, "one further GetMap request for a second block" );
+
+  g_object_unref ( wms );
+  a_download_uninit ();
+  curl_download_uninit ();
+  a_preferences_uninit ();
+  a_settings_uninit ();
+
+  // Nothing should be saved, as tile_done() declines the content
+  check ( !g_file_test ( fn, G_FILE_TEST_EXISTS ), "declined tiles not saved" );
+  (void)g_remove ( fn );
+  (void)g_rmdir ( dir );
+  g_free ( fn );
+  g_free ( dir );
+  g_free ( host );
+
+  return failures;
+}